@@ -0,0 +1,155 @@
+#include "synthetic.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <binary_io/any_stream.hpp>
+#include <binary_io/memory_stream.hpp>
+
+#include "bsa/fo4.hpp"
+
+namespace
+{
+	struct fixture_t
+	{
+		std::vector<std::vector<std::byte>> payloads;
+		bsa::fo4::archive archive;
+		std::size_t files{ 0 };
+	};
+
+	[[nodiscard]] auto make_archive(std::size_t a_count)
+		-> fixture_t
+	{
+		fixture_t result;
+		result.payloads = synthetic::make_payloads();
+
+		const auto paths = synthetic::make_paths(a_count);
+		for (std::size_t i = 0; i < paths.size(); ++i) {
+			const auto& [dirname, filename] = paths[i];
+			const auto& payload = result.payloads[i % result.payloads.size()];
+			bsa::fo4::file f;
+			f.emplace_back().set_data(std::span{ payload });
+			if (result.archive.insert(dirname + '\\' + filename, std::move(f)).second) {
+				result.files += 1;
+			}
+		}
+
+		return result;
+	}
+
+	[[nodiscard]] auto write_to_memory(const bsa::fo4::archive& a_archive)
+		-> std::vector<std::byte>
+	{
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		a_archive.write(os, {});
+		return std::move(os.get<binary_io::memory_ostream>().rdbuf());
+	}
+
+	void fo4_read_mapped(benchmark::State& a_state)
+	{
+		const auto fixture = make_archive(static_cast<std::size_t>(a_state.range(0)));
+		const auto path = synthetic::temp_path("bsa_benchmark_fo4.ba2"sv);
+		fixture.archive.write(path, {});
+
+		for ([[maybe_unused]] auto _ : a_state) {
+			bsa::fo4::archive ba2;
+			benchmark::DoNotOptimize(ba2.read(path));
+		}
+
+		synthetic::set_throughput(a_state, std::filesystem::file_size(path), fixture.files);
+		std::filesystem::remove(path);
+	}
+
+	void fo4_read_memory(benchmark::State& a_state, bsa::copy_type a_copy)
+	{
+		const auto fixture = make_archive(static_cast<std::size_t>(a_state.range(0)));
+		const auto buffer = write_to_memory(fixture.archive);
+
+		for ([[maybe_unused]] auto _ : a_state) {
+			bsa::fo4::archive ba2;
+			benchmark::DoNotOptimize(ba2.read({ buffer, a_copy }));
+		}
+
+		synthetic::set_throughput(a_state, buffer.size(), fixture.files);
+	}
+
+	void fo4_write(benchmark::State& a_state)
+	{
+		const auto fixture = make_archive(static_cast<std::size_t>(a_state.range(0)));
+
+		std::size_t bytes = 0;
+		for ([[maybe_unused]] auto _ : a_state) {
+			const auto buffer = write_to_memory(fixture.archive);
+			bytes = buffer.size();
+			benchmark::DoNotOptimize(buffer.data());
+		}
+
+		synthetic::set_throughput(a_state, bytes, fixture.files);
+	}
+
+	void fo4_compress(benchmark::State& a_state, bsa::fo4::chunk::compression_params a_params)
+	{
+		const auto payload = synthetic::make_payload(static_cast<std::size_t>(a_state.range(0)));
+
+		bsa::fo4::chunk chunk;
+		for ([[maybe_unused]] auto _ : a_state) {
+			chunk.set_data(std::span{ payload });
+			chunk.compress(a_params);
+			benchmark::DoNotOptimize(chunk.as_bytes().data());
+		}
+
+		synthetic::set_throughput(a_state, payload.size(), 1);
+	}
+
+	void fo4_decompress(benchmark::State& a_state, bsa::fo4::chunk::compression_params a_params)
+	{
+		const auto payload = synthetic::make_payload(static_cast<std::size_t>(a_state.range(0)));
+		bsa::fo4::chunk compressed;
+		compressed.set_data(std::span{ payload });
+		compressed.compress(a_params);
+
+		std::vector<std::byte> out(payload.size());
+		for ([[maybe_unused]] auto _ : a_state) {
+			compressed.decompress_into(out, a_params.compression_format_);
+			benchmark::DoNotOptimize(out.data());
+		}
+
+		synthetic::set_throughput(a_state, payload.size(), 1);
+	}
+
+	constexpr bsa::fo4::chunk::compression_params zip_fo4{
+		.compression_format_ = bsa::fo4::compression_format::zip,
+		.compression_level_ = bsa::fo4::compression_level::fo4,
+	};
+
+	constexpr bsa::fo4::chunk::compression_params zip_fo4_xbox{
+		.compression_format_ = bsa::fo4::compression_format::zip,
+		.compression_level_ = bsa::fo4::compression_level::fo4_xbox,
+	};
+
+	constexpr bsa::fo4::chunk::compression_params zip_sf{
+		.compression_format_ = bsa::fo4::compression_format::zip,
+		.compression_level_ = bsa::fo4::compression_level::sf,
+	};
+
+	constexpr bsa::fo4::chunk::compression_params lz4{
+		.compression_format_ = bsa::fo4::compression_format::lz4,
+	};
+}
+
+BENCHMARK(fo4_read_mapped)->Apply(synthetic::file_counts);
+BENCHMARK_CAPTURE(fo4_read_memory, deep, bsa::copy_type::deep)->Apply(synthetic::file_counts);
+BENCHMARK_CAPTURE(fo4_read_memory, shallow, bsa::copy_type::shallow)->Apply(synthetic::file_counts);
+BENCHMARK(fo4_write)->Apply(synthetic::file_counts);
+
+BENCHMARK_CAPTURE(fo4_compress, zip_fo4, zip_fo4)->Apply(synthetic::payload_sizes);
+BENCHMARK_CAPTURE(fo4_compress, zip_fo4_xbox, zip_fo4_xbox)->Apply(synthetic::payload_sizes);
+BENCHMARK_CAPTURE(fo4_compress, zip_sf, zip_sf)->Apply(synthetic::payload_sizes);
+BENCHMARK_CAPTURE(fo4_compress, lz4, lz4)->Apply(synthetic::payload_sizes);
+BENCHMARK_CAPTURE(fo4_decompress, zip, zip_fo4)->Apply(synthetic::payload_sizes);
+BENCHMARK_CAPTURE(fo4_decompress, lz4, lz4)->Apply(synthetic::payload_sizes);
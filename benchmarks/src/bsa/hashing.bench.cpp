@@ -0,0 +1,84 @@
+#include "synthetic.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "bsa/fo4.hpp"
+#include "bsa/tes3.hpp"
+#include "bsa/tes4.hpp"
+
+namespace
+{
+	struct paths_t
+	{
+		std::vector<std::string> directories;
+		std::vector<std::string> files;
+		std::vector<std::string> full;
+		std::size_t bytes{ 0 };
+	};
+
+	[[nodiscard]] auto make_paths(std::size_t a_count)
+		-> paths_t
+	{
+		paths_t result;
+		for (auto& [dirname, filename] : synthetic::make_paths(a_count)) {
+			result.bytes += dirname.size() + 1 + filename.size();
+			result.full.push_back(dirname + '\\' + filename);
+			result.directories.push_back(std::move(dirname));
+			result.files.push_back(std::move(filename));
+		}
+		return result;
+	}
+
+	template <class F>
+	void hash_each(
+		benchmark::State& a_state,
+		const std::vector<std::string>& a_paths,
+		std::size_t a_bytes,
+		F a_hash)
+	{
+		for ([[maybe_unused]] auto _ : a_state) {
+			for (const auto& path : a_paths) {
+				benchmark::DoNotOptimize(a_hash(path));
+			}
+		}
+
+		synthetic::set_throughput(a_state, a_bytes, a_paths.size());
+	}
+
+	void tes3_hash_file(benchmark::State& a_state)
+	{
+		const auto paths = make_paths(static_cast<std::size_t>(a_state.range(0)));
+		hash_each(a_state, paths.full, paths.bytes, [](const std::string& a_path) {
+			return bsa::tes3::hashing::hash_file(a_path);
+		});
+	}
+
+	void tes4_hash_path(benchmark::State& a_state)
+	{
+		const auto paths = make_paths(static_cast<std::size_t>(a_state.range(0)));
+		for ([[maybe_unused]] auto _ : a_state) {
+			for (std::size_t i = 0; i < paths.files.size(); ++i) {
+				benchmark::DoNotOptimize(bsa::tes4::hashing::hash_directory(paths.directories[i]));
+				benchmark::DoNotOptimize(bsa::tes4::hashing::hash_file(paths.files[i]));
+			}
+		}
+
+		synthetic::set_throughput(a_state, paths.bytes, paths.files.size());
+	}
+
+	void fo4_hash_file(benchmark::State& a_state)
+	{
+		const auto paths = make_paths(static_cast<std::size_t>(a_state.range(0)));
+		hash_each(a_state, paths.full, paths.bytes, [](const std::string& a_path) {
+			return bsa::fo4::hashing::hash_file(a_path);
+		});
+	}
+}
+
+BENCHMARK(tes3_hash_file)->Apply(synthetic::file_counts);
+BENCHMARK(tes4_hash_path)->Apply(synthetic::file_counts);
+BENCHMARK(fo4_hash_file)->Apply(synthetic::file_counts);
@@ -0,0 +1,141 @@
+#include "synthetic.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <binary_io/any_stream.hpp>
+#include <binary_io/memory_stream.hpp>
+
+#include "bsa/tes4.hpp"
+
+namespace
+{
+	struct fixture_t
+	{
+		std::vector<std::vector<std::byte>> payloads;
+		bsa::tes4::archive archive;
+		std::size_t files{ 0 };
+	};
+
+	[[nodiscard]] auto make_archive(std::size_t a_count)
+		-> fixture_t
+	{
+		fixture_t result;
+		result.payloads = synthetic::make_payloads();
+
+		bsa::tes4::directory* dir = nullptr;
+		std::string_view last;
+		const auto paths = synthetic::make_paths(a_count);
+		for (std::size_t i = 0; i < paths.size(); ++i) {
+			const auto& [dirname, filename] = paths[i];
+			if (dir == nullptr || dirname != last) {
+				const auto [it, success] = result.archive.insert(dirname, bsa::tes4::directory{});
+				dir = &it->second;
+				last = dirname;
+			}
+
+			const auto& payload = result.payloads[i % result.payloads.size()];
+			bsa::tes4::file f;
+			f.set_data(std::span{ payload });
+			if (dir->insert(filename, std::move(f)).second) {
+				result.files += 1;
+			}
+		}
+
+		return result;
+	}
+
+	[[nodiscard]] auto write_to_memory(const bsa::tes4::archive& a_archive)
+		-> std::vector<std::byte>
+	{
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		a_archive.write(os, bsa::tes4::version::sse);
+		return std::move(os.get<binary_io::memory_ostream>().rdbuf());
+	}
+
+	void tes4_read_mapped(benchmark::State& a_state)
+	{
+		const auto fixture = make_archive(static_cast<std::size_t>(a_state.range(0)));
+		const auto path = synthetic::temp_path("bsa_benchmark_tes4.bsa"sv);
+		fixture.archive.write(path, bsa::tes4::version::sse);
+
+		for ([[maybe_unused]] auto _ : a_state) {
+			bsa::tes4::archive bsa;
+			benchmark::DoNotOptimize(bsa.read(path));
+		}
+
+		synthetic::set_throughput(a_state, std::filesystem::file_size(path), fixture.files);
+		std::filesystem::remove(path);
+	}
+
+	void tes4_read_memory(benchmark::State& a_state, bsa::copy_type a_copy)
+	{
+		const auto fixture = make_archive(static_cast<std::size_t>(a_state.range(0)));
+		const auto buffer = write_to_memory(fixture.archive);
+
+		for ([[maybe_unused]] auto _ : a_state) {
+			bsa::tes4::archive bsa;
+			benchmark::DoNotOptimize(bsa.read({ buffer, a_copy }));
+		}
+
+		synthetic::set_throughput(a_state, buffer.size(), fixture.files);
+	}
+
+	void tes4_write(benchmark::State& a_state)
+	{
+		const auto fixture = make_archive(static_cast<std::size_t>(a_state.range(0)));
+
+		std::size_t bytes = 0;
+		for ([[maybe_unused]] auto _ : a_state) {
+			const auto buffer = write_to_memory(fixture.archive);
+			bytes = buffer.size();
+			benchmark::DoNotOptimize(buffer.data());
+		}
+
+		synthetic::set_throughput(a_state, bytes, fixture.files);
+	}
+
+	void tes4_compress(benchmark::State& a_state, bsa::tes4::version a_version)
+	{
+		const auto payload = synthetic::make_payload(static_cast<std::size_t>(a_state.range(0)));
+
+		bsa::tes4::file f;
+		for ([[maybe_unused]] auto _ : a_state) {
+			f.set_data(std::span{ payload });
+			f.compress({ .version_ = a_version });
+			benchmark::DoNotOptimize(f.as_bytes().data());
+		}
+
+		synthetic::set_throughput(a_state, payload.size(), 1);
+	}
+
+	void tes4_decompress(benchmark::State& a_state, bsa::tes4::version a_version)
+	{
+		const auto payload = synthetic::make_payload(static_cast<std::size_t>(a_state.range(0)));
+		bsa::tes4::file compressed;
+		compressed.set_data(std::span{ payload });
+		compressed.compress({ .version_ = a_version });
+
+		std::vector<std::byte> out(payload.size());
+		for ([[maybe_unused]] auto _ : a_state) {
+			compressed.decompress_into(out, { .version_ = a_version });
+			benchmark::DoNotOptimize(out.data());
+		}
+
+		synthetic::set_throughput(a_state, payload.size(), 1);
+	}
+}
+
+BENCHMARK(tes4_read_mapped)->Apply(synthetic::file_counts);
+BENCHMARK_CAPTURE(tes4_read_memory, deep, bsa::copy_type::deep)->Apply(synthetic::file_counts);
+BENCHMARK_CAPTURE(tes4_read_memory, shallow, bsa::copy_type::shallow)->Apply(synthetic::file_counts);
+BENCHMARK(tes4_write)->Apply(synthetic::file_counts);
+
+BENCHMARK_CAPTURE(tes4_compress, zlib, bsa::tes4::version::tes5)->Apply(synthetic::payload_sizes);
+BENCHMARK_CAPTURE(tes4_compress, lz4, bsa::tes4::version::sse)->Apply(synthetic::payload_sizes);
+BENCHMARK_CAPTURE(tes4_decompress, zlib, bsa::tes4::version::tes5)->Apply(synthetic::payload_sizes);
+BENCHMARK_CAPTURE(tes4_decompress, lz4, bsa::tes4::version::sse)->Apply(synthetic::payload_sizes);
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using namespace std::literals;
+
+namespace synthetic
+{
+	/// The size of every file within a synthetic archive.
+	inline constexpr std::size_t file_size = 256;
+
+	/// The number of files placed within each directory of a synthetic archive.
+	inline constexpr std::size_t files_per_directory = 256;
+
+	/// Runs a benchmark over archives holding 1k, 32k, and 1M files.
+	inline void file_counts(benchmark::internal::Benchmark* a_bench)
+	{
+		a_bench
+			->ArgName("files")
+			->RangeMultiplier(32)
+			->Range(1u << 10, 1u << 20)
+			->Unit(benchmark::kMillisecond);
+	}
+
+	/// Runs a benchmark over single files ranging in size from 4KiB to 4MiB.
+	inline void payload_sizes(benchmark::internal::Benchmark* a_bench)
+	{
+		a_bench
+			->ArgName("bytes")
+			->RangeMultiplier(16)
+			->Range(4u << 10, 4u << 20)
+			->Unit(benchmark::kMicrosecond);
+	}
+
+	/// Reports throughput in both bytes/s and files/s.
+	inline void set_throughput(
+		benchmark::State& a_state,
+		std::size_t a_bytes,
+		std::size_t a_files)
+	{
+		a_state.SetBytesProcessed(
+			static_cast<std::int64_t>(a_state.iterations()) *
+			static_cast<std::int64_t>(a_bytes));
+		a_state.counters["files"] = benchmark::Counter(
+			static_cast<double>(a_files),
+			benchmark::Counter::kIsIterationInvariantRate);
+	}
+
+	/// Generates `a_size` bytes of deterministic, text-like data, which compresses
+	///	roughly as well as the loose files typically found in an archive.
+	[[nodiscard]] inline auto make_payload(
+		std::size_t a_size,
+		std::uint32_t a_seed = 0)
+		-> std::vector<std::byte>
+	{
+		constexpr std::array words{
+			"texture "sv,
+			"mesh "sv,
+			"actor "sv,
+			"sound "sv,
+			"script "sv,
+			"quest "sv,
+			"weapon "sv,
+			"armor "sv,
+			"\r\n"sv,
+			"0x0001F4 "sv,
+			"{ }; "sv,
+			"interface "sv,
+		};
+
+		std::uint32_t state = a_seed * 2654435761u + 0x9E3779B9u;
+		const auto next = [&]() noexcept {
+			// xorshift32
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		};
+
+		std::vector<std::byte> result;
+		result.reserve(a_size);
+		while (result.size() < a_size) {
+			const auto word = words[next() % words.size()];
+			for (const auto c : word) {
+				if (result.size() == a_size) {
+					break;
+				}
+				result.push_back(static_cast<std::byte>(c));
+			}
+		}
+
+		return result;
+	}
+
+	/// Generates a pool of distinct payloads for the files of a synthetic archive to share.
+	[[nodiscard]] inline auto make_payloads()
+		-> std::vector<std::vector<std::byte>>
+	{
+		std::vector<std::vector<std::byte>> result;
+		for (std::uint32_t i = 0; i < 64; ++i) {
+			result.push_back(make_payload(file_size, i));
+		}
+		return result;
+	}
+
+	/// Generates `a_count` unique (directory, file) name pairs.
+	[[nodiscard]] inline auto make_paths(std::size_t a_count)
+		-> std::vector<std::pair<std::string, std::string>>
+	{
+		std::vector<std::pair<std::string, std::string>> result;
+		result.reserve(a_count);
+		for (std::size_t i = 0; i < a_count; ++i) {
+			result.emplace_back(
+				"bench\\dir"s + std::to_string(i / files_per_directory),
+				"file"s + std::to_string(i % files_per_directory) + ".txt"s);
+		}
+		return result;
+	}
+
+	/// Returns a scratch path for archives which must be read from disk.
+	[[nodiscard]] inline auto temp_path(std::string_view a_name)
+		-> std::filesystem::path
+	{
+		return std::filesystem::temp_directory_path() / a_name;
+	}
+}
@@ -1,13 +1,25 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <concepts>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <deque>
 #include <exception>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -19,14 +31,252 @@ using namespace std::literals;
 
 namespace
 {
-	template <class UnaryFunction>
-	void for_each_file(const std::filesystem::path& a_root, UnaryFunction a_func)
+	[[nodiscard]] auto resolve_jobs(std::size_t a_jobs) noexcept
+		-> std::size_t
 	{
-		for (const auto& entry : std::filesystem::recursive_directory_iterator(a_root)) {
-			if (entry.is_regular_file()) {
-				a_func(entry.path());
+		return a_jobs != 0 ?
+		           a_jobs :
+		           (std::max)(std::thread::hardware_concurrency(), 1u);
+	}
+
+	// Times a stage of work, and reports how quickly it got through its files once it's done.
+	class stage_stats
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		explicit stage_stats(std::string_view a_name) noexcept :
+			_name(a_name)
+		{}
+
+		void start() noexcept { _start = clock::now(); }
+		void stop() noexcept { _stop = clock::now(); }
+
+		void add(std::uintmax_t a_bytes) noexcept
+		{
+			_files.fetch_add(1, std::memory_order_relaxed);
+			_bytes.fetch_add(a_bytes, std::memory_order_relaxed);
+		}
+
+		void report() const
+		{
+			const auto seconds = (std::max)(
+				std::chrono::duration<double>(_stop - _start).count(),
+				1e-9);
+			const auto files = _files.load(std::memory_order_relaxed);
+			const auto mb = static_cast<double>(_bytes.load(std::memory_order_relaxed)) / (1024.0 * 1024.0);
+			const auto flags = std::cout.flags();
+			std::cout
+				<< std::left << std::setw(9) << _name << std::right
+				<< std::setw(8) << files << " files "
+				<< std::fixed << std::setprecision(2)
+				<< std::setw(10) << mb << " MB in "
+				<< std::setw(7) << seconds << "s ("
+				<< files / seconds << " files/s, "
+				<< mb / seconds << " MB/s)\n";
+			std::cout.flags(flags);
+		}
+
+	private:
+		std::string_view _name;
+		std::atomic_size_t _files{ 0 };
+		std::atomic_uintmax_t _bytes{ 0 };
+		clock::time_point _start{ clock::now() };
+		clock::time_point _stop{ _start };
+	};
+
+	// Packs every file under `a_root` through three stages, which all run at once:
+	//	- a scanner, which walks the directory
+	//	- `a_jobs` workers, which turn each path into a file with `a_load`
+	//	- the calling thread, which hands each file to `a_insert` in the order they were scanned,
+	//		so the archive comes out the same regardless of how the workers are scheduled
+	template <class Load, class Insert>
+	void pack_pipeline(
+		const std::filesystem::path& a_root,
+		std::size_t a_jobs,
+		Load a_load,
+		Insert a_insert)
+	{
+		using file_type = std::invoke_result_t<Load&, const std::filesystem::path&>;
+
+		struct job_t
+		{
+			std::size_t index{ 0 };
+			std::filesystem::path path;
+			std::uintmax_t size{ 0 };
+		};
+
+		const auto workers = resolve_jobs(a_jobs);
+		const auto window = workers * 4;  // bounds how far any stage may run ahead
+
+		std::mutex lock;
+		std::condition_variable changed;
+		std::deque<job_t> pending;
+		std::map<std::size_t, std::pair<job_t, file_type>> loaded;
+		std::size_t scanned = 0;
+		std::size_t taken = 0;
+		std::size_t inserted = 0;
+		bool scanning = true;
+		std::exception_ptr error;
+
+		stage_stats scan{ "scan"sv };
+		stage_stats load{ "load"sv };
+		stage_stats insert{ "insert"sv };
+
+		const auto fail = [&]() {
+			const std::lock_guard l{ lock };
+			if (!error) {
+				error = std::current_exception();
+			}
+			changed.notify_all();
+		};
+
+		{
+			std::vector<std::jthread> threads;
+			threads.emplace_back([&]() {
+				try {
+					for (const auto& entry : std::filesystem::recursive_directory_iterator(a_root)) {
+						if (!entry.is_regular_file()) {
+							continue;
+						}
+
+						const auto size = entry.file_size();
+						std::unique_lock l{ lock };
+						changed.wait(l, [&]() { return error || pending.size() < window; });
+						if (error) {
+							return;
+						}
+						pending.push_back({ scanned++, entry.path(), size });
+						scan.add(size);
+						changed.notify_all();
+					}
+				} catch (...) {
+					fail();
+				}
+
+				const std::lock_guard l{ lock };
+				scan.stop();
+				scanning = false;
+				changed.notify_all();
+			});
+
+			for (std::size_t i = 0; i < workers; ++i) {
+				threads.emplace_back([&]() {
+					try {
+						for (;;) {
+							job_t job;
+							{
+								// only take up work the inserter will get to soon, so that loaded
+								//	files don't pile up behind one which is slow to compress
+								std::unique_lock l{ lock };
+								changed.wait(l, [&]() {
+									return error ||
+									       (!pending.empty() && taken - inserted < window) ||
+									       (pending.empty() && !scanning);
+								});
+								if (error || pending.empty()) {
+									return;
+								}
+								job = std::move(pending.front());
+								pending.pop_front();
+								++taken;
+								changed.notify_all();
+							}
+
+							auto file = a_load(job.path);
+							load.add(job.size);
+
+							const std::lock_guard l{ lock };
+							loaded.emplace(job.index, std::make_pair(std::move(job), std::move(file)));
+							changed.notify_all();
+						}
+					} catch (...) {
+						fail();
+					}
+				});
+			}
+
+			try {
+				for (;;) {
+					std::unique_lock l{ lock };
+					changed.wait(l, [&]() {
+						return error ||
+						       loaded.contains(inserted) ||
+						       (!scanning && inserted == scanned);
+					});
+					if (error || !loaded.contains(inserted)) {
+						break;
+					}
+
+					auto node = loaded.extract(inserted);
+					l.unlock();
+					auto& [job, file] = node.mapped();
+					a_insert(job.path, std::move(file));
+					insert.add(job.size);
+
+					l.lock();
+					++inserted;
+					changed.notify_all();
+				}
+			} catch (...) {
+				fail();
+			}
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+
+		load.stop();
+		insert.stop();
+		scan.report();
+		load.report();
+		insert.report();
+	}
+
+	// Reports how long it took to read or write the archive at `a_path`.
+	template <class F>
+	void archive_stage(
+		std::string_view a_name,
+		const std::filesystem::path& a_path,
+		F a_func)
+	{
+		stage_stats stats{ a_name };
+		a_func();
+		stats.stop();
+		stats.add(std::filesystem::file_size(a_path));
+		stats.report();
+	}
+
+	// Runs `a_func` over each index in `[0, a_count)`, across `a_jobs` threads.
+	template <class F>
+	void parallel_for(std::size_t a_count, std::size_t a_jobs, F a_func)
+	{
+		std::atomic_size_t next{ 0 };
+		std::mutex lock;
+		std::exception_ptr error;
+		{
+			std::vector<std::jthread> threads;
+			for (std::size_t i = 0; i < (std::min)(resolve_jobs(a_jobs), a_count); ++i) {
+				threads.emplace_back([&]() {
+					try {
+						for (auto idx = next++; idx < a_count; idx = next++) {
+							a_func(idx);
+						}
+					} catch (...) {
+						const std::lock_guard l{ lock };
+						if (!error) {
+							error = std::current_exception();
+						}
+						next = a_count;
+					}
+				});
 			}
 		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
 	}
 
 	template <class... Keys>
@@ -58,54 +308,65 @@ namespace
 
 	void pack_fo4(
 		const std::filesystem::path& a_input,
-		const std::filesystem::path& a_output)
+		const std::filesystem::path& a_output,
+		std::size_t a_jobs)
 	{
 		bsa::fo4::archive ba2;
-		for_each_file(
+		pack_pipeline(
 			a_input,
-			[&](const std::filesystem::path& a_path) {
+			a_jobs,
+			[](const std::filesystem::path& a_path) {
 				bsa::fo4::file f;
 				f.read(
 					a_path,
-					{
-						.format_ = bsa::fo4::format::general,
-						.compression_type_ = bsa::compression_type::compressed,
-					});
-
+					{ .format_ = bsa::fo4::format::general,
+						.compression_type_ = bsa::compression_type::compressed });
+				return f;
+			},
+			[&](const std::filesystem::path& a_path, bsa::fo4::file a_file) {
 				ba2.insert(
 					a_path
 						.lexically_relative(a_input)
 						.lexically_normal()
 						.generic_string(),
-					std::move(f));
+					std::move(a_file));
 			});
-		ba2.write(a_output, { .format_ = bsa::fo4::format::general });
+		archive_stage("write"sv, a_output, [&]() {
+			ba2.write_mapped(a_output, { .format_ = bsa::fo4::format::general }, {}, a_jobs);
+		});
 	}
 
 	void pack_tes3(
 		const std::filesystem::path& a_input,
-		const std::filesystem::path& a_output)
+		const std::filesystem::path& a_output,
+		std::size_t a_jobs)
 	{
 		bsa::tes3::archive bsa;
-		for_each_file(
+		pack_pipeline(
 			a_input,
-			[&](const std::filesystem::path& a_path) {
+			a_jobs,
+			[](const std::filesystem::path& a_path) {
 				bsa::tes3::file f;
 				f.read(a_path);
-
+				return f;
+			},
+			[&](const std::filesystem::path& a_path, bsa::tes3::file a_file) {
 				bsa.insert(
 					a_path
 						.lexically_relative(a_input)
 						.lexically_normal()
 						.generic_string(),
-					std::move(f));
+					std::move(a_file));
 			});
-		bsa.write(a_output);
+		archive_stage("write"sv, a_output, [&]() {
+			bsa.write(a_output);
+		});
 	}
 
 	void pack_tes4(
 		const std::filesystem::path& a_input,
-		const std::filesystem::path& a_output)
+		const std::filesystem::path& a_output,
+		std::size_t a_jobs)
 	{
 		const auto version = bsa::tes4::version::tes4;
 		bsa::tes4::archive bsa;
@@ -113,17 +374,18 @@ namespace
 			bsa::tes4::archive_flag::compressed |
 			bsa::tes4::archive_flag::directory_strings |
 			bsa::tes4::archive_flag::file_strings);
-		for_each_file(
+		pack_pipeline(
 			a_input,
+			a_jobs,
 			[&](const std::filesystem::path& a_path) {
 				bsa::tes4::file f;
 				f.read(
 					a_path,
-					{
-						.version_ = version,
-						.compression_type_ = bsa::compression_type::compressed,
-					});
-
+					{ .version_ = version,
+						.compression_type_ = bsa::compression_type::compressed });
+				return f;
+			},
+			[&](const std::filesystem::path& a_path, bsa::tes4::file a_file) {
 				const auto d = [&]() {
 					const auto key =
 						a_path
@@ -142,50 +404,85 @@ namespace
 						.filename()
 						.lexically_normal()
 						.generic_string(),
-					std::move(f));
+					std::move(a_file));
 			});
-		bsa.write(a_output, version);
+		archive_stage("write"sv, a_output, [&]() {
+			bsa.write_mapped(a_output, version, {}, a_jobs);
+		});
 	}
 
 	void unpack_fo4(
 		const std::filesystem::path& a_input,
-		const std::filesystem::path& a_output)
+		const std::filesystem::path& a_output,
+		std::size_t a_jobs)
 	{
 		bsa::fo4::archive ba2;
-		const auto meta = ba2.read(a_input);
-
-		for (auto& [key, file] : ba2) {
-			auto out = open_virtual_path(a_output, key);
-			file.write(out, { .format_ = meta.format_, .compression_format_ = meta.compression_format_ });
+		bsa::fo4::archive::meta_info meta;
+		archive_stage("read"sv, a_input, [&]() {
+			meta = ba2.read(a_input, a_jobs);
+		});
+
+		const bsa::fo4::file::write_params params{
+			.format_ = meta.format_,
+			.compression_format_ = meta.compression_format_,
+		};
+		stage_stats stats{ "extract"sv };
+		ba2.extract_all(a_output, params, a_jobs);
+		stats.stop();
+		for (const auto& [key, file] : ba2) {
+			stats.add(file.written_size(params));
 		}
+		stats.report();
 	}
 
 	void unpack_tes3(
 		const std::filesystem::path& a_input,
-		const std::filesystem::path& a_output)
+		const std::filesystem::path& a_output,
+		std::size_t a_jobs)
 	{
 		bsa::tes3::archive bsa;
-		bsa.read(a_input);
+		archive_stage("read"sv, a_input, [&]() {
+			bsa.read(a_input);
+		});
+
+		stage_stats stats{ "extract"sv };
+		std::vector<const bsa::tes3::archive::value_type*> files;
+		for (const auto& elem : bsa) {
+			const auto path = a_output / virtual_to_local_path(elem.first);
+			std::filesystem::create_directories(path.parent_path());
+			files.push_back(&elem);
+		}
 
-		for (const auto& [key, file] : bsa) {
+		parallel_for(files.size(), a_jobs, [&](std::size_t a_idx) {
+			const auto& [key, file] = *files[a_idx];
 			auto out = open_virtual_path(a_output, key);
 			file.write(out);
-		}
+			stats.add(file.size());
+		});
+		stats.stop();
+		stats.report();
 	}
 
 	void unpack_tes4(
 		const std::filesystem::path& a_input,
-		const std::filesystem::path& a_output)
+		const std::filesystem::path& a_output,
+		std::size_t a_jobs)
 	{
 		bsa::tes4::archive bsa;
-		const auto format = bsa.read(a_input);
-
-		for (auto& dir : bsa) {
-			for (auto& file : dir.second) {
-				auto out = open_virtual_path(a_output, dir.first, file.first);
-				file.second.write(out, { .version_ = format });
+		bsa::tes4::version format{};
+		archive_stage("read"sv, a_input, [&]() {
+			format = bsa.read(a_input);
+		});
+
+		stage_stats stats{ "extract"sv };
+		bsa.extract_all(a_output, { .version_ = format }, a_jobs);
+		stats.stop();
+		for (const auto& dir : bsa) {
+			for (const auto& [key, file] : dir.second) {
+				stats.add(file.compressed() ? file.decompressed_size() : file.size());
 			}
 		}
+		stats.report();
 	}
 
 	struct args_t
@@ -194,13 +491,16 @@ namespace
 		std::filesystem::path input;
 		std::filesystem::path output;
 		bsa::file_format format{ bsa::file_format::tes4 };
+		std::size_t jobs{ 0 };
 	};
 
 	void print_usage()
 	{
 		std::cout
-			<< "pack_unpack pack <input-directory> <output-archive> {-tes3|-tes4|-fo4}\n"
-			<< "pack_unpack unpack <input-archive> <output-directory>\n"
+			<< "pack_unpack pack <input-directory> <output-archive> {-tes3|-tes4|-fo4} [-j <jobs>]\n"
+			<< "pack_unpack unpack <input-archive> <output-directory> [-j <jobs>]\n"
+			<< '\n'
+			<< "  -j <jobs>  the number of threads to use, defaulting to one per core\n"
 			<< '\n';
 	}
 
@@ -257,8 +557,16 @@ namespace
 				}
 			}();
 
-			if (a_args.size() > expected + 1u) {
-				throw std::runtime_error("too many arguments");
+			for (auto i = expected + 1u; i < a_args.size(); ++i) {
+				if (a_args[i] != "-j"sv || i + 1 == a_args.size()) {
+					throw std::runtime_error("too many arguments");
+				}
+
+				const std::string_view arg = a_args[++i];
+				const auto [last, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), args.jobs);
+				if (ec != std::errc() || last != arg.data() + arg.size()) {
+					concat_and_throw("invalid job count: "sv, arg);
+				}
 			}
 
 			return args;
@@ -274,13 +582,13 @@ namespace
 		if (args.pack) {
 			switch (args.format) {
 			case bsa::file_format::fo4:
-				pack_fo4(args.input, args.output);
+				pack_fo4(args.input, args.output, args.jobs);
 				break;
 			case bsa::file_format::tes3:
-				pack_tes3(args.input, args.output);
+				pack_tes3(args.input, args.output, args.jobs);
 				break;
 			case bsa::file_format::tes4:
-				pack_tes4(args.input, args.output);
+				pack_tes4(args.input, args.output, args.jobs);
 				break;
 			default:
 				throw std::runtime_error("unhandled format");
@@ -293,13 +601,13 @@ namespace
 
 			switch (*format) {
 			case bsa::file_format::fo4:
-				unpack_fo4(args.input, args.output);
+				unpack_fo4(args.input, args.output, args.jobs);
 				break;
 			case bsa::file_format::tes3:
-				unpack_tes3(args.input, args.output);
+				unpack_tes3(args.input, args.output, args.jobs);
 				break;
 			case bsa::file_format::tes4:
-				unpack_tes4(args.input, args.output);
+				unpack_tes4(args.input, args.output, args.jobs);
 				break;
 			default:
 				throw std::runtime_error("unhandled format");
@@ -171,6 +171,7 @@ namespace bsa::xmem
 		compress,
 		compress_bound,
 		decompress,
+		compress_batch,
 	};
 
 	struct request_header
@@ -343,6 +344,84 @@ namespace bsa::xmem
 		return static_cast<T&>(a_stream) << a_response.bound;
 	}
 
+	template <class T>
+	decltype(auto) operator>>(
+		binary_io::istream_interface<T>& a_stream,
+		std::vector<byte_container>& a_containers)
+	{
+		auto& stream = static_cast<T&>(a_stream);
+
+		const auto [size] = a_stream.read<std::uint32_t>();
+		a_containers.clear();
+		a_containers.resize(size);
+		for (auto& container : a_containers) {
+			stream >> container;
+		}
+
+		return stream;
+	}
+
+	template <class T>
+	decltype(auto) operator<<(
+		binary_io::ostream_interface<T>& a_stream,
+		const std::vector<byte_container>& a_containers)
+	{
+		auto& stream = static_cast<T&>(a_stream);
+
+		stream.write(static_cast<std::uint32_t>(a_containers.size()));
+		for (const auto& container : a_containers) {
+			stream << container;
+		}
+
+		return stream;
+	}
+
+	// compresses every blob with a single context, and without a separate round trip to
+	//	compute the bound of each one
+	struct compress_batch_request
+	{
+		static constexpr auto expected_request = request_type::compress_batch;
+
+		std::vector<byte_container> data;
+	};
+
+	template <class T>
+	decltype(auto) operator>>(
+		binary_io::istream_interface<T>& a_stream,
+		compress_batch_request& a_request)
+	{
+		return static_cast<T&>(a_stream) >> a_request.data;
+	}
+
+	template <class T>
+	decltype(auto) operator<<(
+		binary_io::ostream_interface<T>& a_stream,
+		const compress_batch_request& a_request)
+	{
+		return static_cast<T&>(a_stream) << a_request.data;
+	}
+
+	struct compress_batch_response
+	{
+		std::vector<byte_container> data;
+	};
+
+	template <class T>
+	decltype(auto) operator>>(
+		binary_io::istream_interface<T>& a_stream,
+		compress_batch_response& a_response)
+	{
+		return static_cast<T&>(a_stream) >> a_response.data;
+	}
+
+	template <class T>
+	decltype(auto) operator<<(
+		binary_io::ostream_interface<T>& a_stream,
+		const compress_batch_response& a_response)
+	{
+		return static_cast<T&>(a_stream) << a_response.data;
+	}
+
 	[[nodiscard]] inline auto current_executable_directory()
 		-> std::optional<std::filesystem::path>
 	{
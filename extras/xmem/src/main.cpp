@@ -266,6 +266,37 @@ namespace
 		return xmem::error_code::ok;
 	}
 
+	[[nodiscard]] auto serve_compress_batch()
+		-> xmem::error_code
+	{
+		binary_stdio::bin in;
+		xmem::compress_batch_request request;
+		in >> request;
+
+		const auto context = api::create_compression_context();
+		UNWRAP_EXPECTED(context);
+
+		xmem::compress_batch_response response;
+		response.data.reserve(request.data.size());
+		for (const auto& data : request.data) {
+			const auto bound = api::compress_bound(*context, data.as_bytes());
+			UNWRAP_EXPECTED(bound);
+
+			std::vector<std::byte> bytes(*bound);
+			const auto realsz = api::compress(*context, data.as_bytes(), bytes);
+			UNWRAP_EXPECTED(realsz);
+			bytes.resize(*realsz);
+
+			response.data.emplace_back(std::move(bytes));
+		}
+
+		binary_stdio::bout out;
+		out << xmem::response_header{};
+		out << response;
+
+		return xmem::error_code::ok;
+	}
+
 	[[nodiscard]] auto serve_compress_bound()
 		-> xmem::error_code
 	{
@@ -336,6 +367,9 @@ namespace
 				case xmem::request_type::decompress:
 					ec = serve_decompress();
 					break;
+				case xmem::request_type::compress_batch:
+					ec = serve_compress_batch();
+					break;
 				default:
 					ec = xmem::error_code::serve_unhandled_request;
 					break;
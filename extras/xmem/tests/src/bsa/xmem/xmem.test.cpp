@@ -101,4 +101,23 @@ TEST_CASE("validate xmem ipc protocols", "[src]")
 				validateBytes(a_response.data);
 			});
 	}
+
+	SECTION("compress_batch")
+	{
+		validate(
+			xmem::compress_batch_request{ { bytes, bytes } },
+			[&](const xmem::compress_batch_request& a_request) {
+				REQUIRE(a_request.data.size() == 2);
+				for (const auto& data : a_request.data) {
+					validateBytes(data);
+				}
+			});
+
+		validate(
+			xmem::compress_batch_response{ { bytes } },
+			[&](const xmem::compress_batch_response& a_response) {
+				REQUIRE(a_response.data.size() == 1);
+				validateBytes(a_response.data.front());
+			});
+	}
 }
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "bsa/detail/common.hpp"
+#include "bsa/fo4.hpp"
+#include "bsa/tes4.hpp"
+
+namespace bsa::async
+{
+	/// \brief	Runs the work behind the awaitables in this namespace, e.g. the thread pool of
+	///		an event loop.
+	/// \details	Awaitables post their work to the executor when they are awaited, and the
+	///		awaiting coroutine is resumed on whichever thread ran it. Every blocking call made
+	///		on behalf of a coroutine is therefore bounded by the threads the executor owns.
+	class executor
+	{
+	public:
+		using work_type = std::function<void()>;
+
+		virtual ~executor() = default;
+
+		/// \brief	Schedules the given work to run on one of the executor's threads.
+		/// \remark	Exceptions thrown from here propagate out of the `co_await` which
+		///		posted the work.
+		virtual void post(work_type a_work) = 0;
+	};
+
+	/// \brief	An awaitable which runs a callable on an \ref executor, and completes with
+	///		its result.
+	/// \remark	Exceptions thrown by the callable are rethrown from the `co_await`.
+	template <class F>
+	class [[nodiscard]] operation final
+	{
+	public:
+		using result_type = std::invoke_result_t<F&>;
+
+		static_assert(!std::is_reference_v<result_type>);
+
+		/// \name Constructors
+		/// @{
+
+		/// \param	a_executor	The executor to run the callable on.
+		/// \param	a_work	The callable to run.
+		operation(executor& a_executor, F a_work) noexcept(
+			std::is_nothrow_move_constructible_v<F>) :
+			_executor(a_executor),
+			_work(std::move(a_work))
+		{}
+
+		operation(const operation&) = delete;
+		operation(operation&&) = delete;
+
+		/// @}
+
+		/// \name Assignment
+		/// @{
+
+		operation& operator=(const operation&) = delete;
+		operation& operator=(operation&&) = delete;
+
+		/// @}
+
+#ifndef DOXYGEN
+		[[nodiscard]] bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> a_continuation)
+		{
+			_executor.post([this, a_continuation]() {
+				try {
+					if constexpr (std::is_void_v<result_type>) {
+						std::invoke(_work);
+						_result.template emplace<1>();
+					} else {
+						_result.template emplace<1>(std::invoke(_work));
+					}
+				} catch (...) {
+					_result.template emplace<2>(std::current_exception());
+				}
+				a_continuation.resume();
+			});
+		}
+
+		auto await_resume()
+			-> result_type
+		{
+			if (_result.index() == 2) {
+				std::rethrow_exception(std::get<2>(_result));
+			}
+
+			if constexpr (!std::is_void_v<result_type>) {
+				return std::move(std::get<1>(_result));
+			}
+		}
+#endif
+
+	private:
+		using value_type = std::conditional_t<
+			std::is_void_v<result_type>,
+			std::monostate,
+			result_type>;
+
+		executor& _executor;
+		F _work;
+		std::variant<std::monostate, value_type, std::exception_ptr> _result;
+	};
+
+	/// \brief	Runs a callable on the given executor.
+	///
+	/// \param	a_executor	The executor to run the callable on.
+	/// \param	a_work	The callable to run.
+	/// \return	An awaitable which completes with the result of the callable.
+	template <class F>
+	[[nodiscard]] auto run(executor& a_executor, F a_work)
+		-> operation<F>
+	{
+		return { a_executor, std::move(a_work) };
+	}
+
+	/// \brief	Reads an archive on the given executor, as if by
+	///		`a_archive.read(read_source(a_args...))`.
+	///
+	/// \param	a_executor	The executor to read the archive on.
+	/// \param	a_archive	The archive to read into, which must outlive the awaitable.
+	/// \param	a_args	The arguments to construct the \ref read_source from, e.g. a path,
+	///		which are copied into the awaitable.
+	/// \return	An awaitable which completes with the result of `read`, e.g. the version of
+	///		a tes4 archive.
+	template <class Archive, class... Args>
+	[[nodiscard]] auto read(
+		executor& a_executor,
+		Archive& a_archive,
+		Args... a_args)
+	{
+		return async::run(
+			a_executor,
+			[&a_archive, ... args = std::move(a_args)]() {
+				return a_archive.read(read_source(args...));
+			});
+	}
+
+	/// \brief	Decompresses a file on the given executor, as if by
+	///		`a_file.decompress_into(a_out, a_args...)`.
+	///
+	/// \param	a_executor	The executor to decompress the file on.
+	/// \param	a_file	The file to decompress, which must outlive the awaitable.
+	/// \param	a_out	The buffer to decompress into, which must outlive the awaitable.
+	/// \param	a_args	Any further arguments, e.g. compression parameters, which are copied
+	///		into the awaitable.
+	/// \return	An awaitable which completes once the file is decompressed.
+	template <class File, class... Args>
+	[[nodiscard]] auto decompress_into(
+		executor& a_executor,
+		const File& a_file,
+		std::span<std::byte> a_out,
+		Args... a_args)
+	{
+		return async::run(
+			a_executor,
+			[&a_file, a_out, ... args = std::move(a_args)]() {
+				a_file.decompress_into(a_out, args...);
+			});
+	}
+
+	/// \brief	Extracts the files of an archive one at a time, on an \ref executor.
+	///
+	/// \details	Each call to \ref next extracts a single file, exactly as `extract_all`
+	///		would, so a coroutine can interleave extraction with other work:
+	///
+	///	\code{.cpp}
+	///	auto files = bsa::async::extract(executor, archive, root, params);
+	///	while (const auto path = co_await files.next()) {
+	///		// *path has been written
+	///	}
+	///	\endcode
+	///
+	/// \remark	The archive must outlive the extraction, and only one call to \ref next may
+	///		be in flight at once.
+	class extraction final
+	{
+	private:
+		struct step_t final
+		{
+		public:
+			[[nodiscard]] auto operator()() const
+				-> std::optional<std::filesystem::path>;
+
+			extraction* self{ nullptr };
+		};
+
+	public:
+		/// \name Constructors
+		/// @{
+
+		extraction(const extraction&) = delete;
+		extraction(extraction&&) noexcept = default;
+
+		/// @}
+
+		/// \name Destructor
+		/// @{
+
+		~extraction() noexcept = default;
+
+		/// @}
+
+		/// \name Assignment
+		/// @{
+
+		extraction& operator=(const extraction&) = delete;
+		extraction& operator=(extraction&&) noexcept = default;
+
+		/// @}
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Checks if every file has been extracted.
+		[[nodiscard]] bool done() const noexcept { return _next == _jobs.size(); }
+
+		/// \brief	Returns the number of files left to extract.
+		[[nodiscard]] std::size_t remaining() const noexcept { return _jobs.size() - _next; }
+
+		/// @}
+
+		/// \name Extraction
+		/// @{
+
+		/// \brief	Extracts the next file.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered. The explanation is prefixed with the path of the offending file.
+		///
+		/// \return	An awaitable which completes with the path the file was written to, or
+		///		nothing once every file has been extracted.
+		///
+		/// \remark	The file is skipped if an exception is thrown, so extraction may continue
+		///		with the next one.
+		[[nodiscard]] auto next()
+			-> operation<step_t>
+		{
+			return { *_executor, step_t{ this } };
+		}
+
+		/// @}
+
+	private:
+		friend auto extract(
+			executor&,
+			const tes4::archive&,
+			const std::filesystem::path&,
+			const tes4::file::write_params&)
+			-> extraction;
+
+		friend auto extract(
+			executor&,
+			const fo4::archive&,
+			const std::filesystem::path&,
+			const fo4::file::write_params&)
+			-> extraction;
+
+		struct job_t final
+		{
+		public:
+			std::filesystem::path path;
+			std::function<void(const std::filesystem::path&)> write;
+		};
+
+		extraction(executor& a_executor, std::vector<job_t> a_jobs) noexcept :
+			_executor(&a_executor),
+			_jobs(std::move(a_jobs))
+		{}
+
+		[[nodiscard]] auto extract_next()
+			-> std::optional<std::filesystem::path>;
+
+		executor* _executor{ nullptr };
+		std::vector<job_t> _jobs;
+		std::size_t _next{ 0 };
+		bool _prepared{ false };
+	};
+
+	/// \brief	Prepares to extract every file in the archive to disk, under the given
+	///		directory, as if by `tes4::archive::extract_all`.
+	///
+	/// \exception	bsa::exception	Thrown when the path of a file would escape `a_root`.
+	///
+	/// \param	a_executor	The executor to extract files on.
+	/// \param	a_archive	The archive to extract, which must outlive the extraction.
+	/// \param	a_root	The directory to extract the archive into.
+	/// \param	a_params	Configuration options for decompressing each file.
+	/// \return	An extraction which has yet to write anything.
+	///
+	/// \remark	Every path is validated up front, and nothing is written to disk until the
+	///		first call to \ref extraction::next.
+	[[nodiscard]] auto extract(
+		executor& a_executor,
+		const tes4::archive& a_archive,
+		const std::filesystem::path& a_root,
+		const tes4::file::write_params& a_params)
+		-> extraction;
+
+	/// \copybrief extract(executor&, const tes4::archive&, const std::filesystem::path&, const tes4::file::write_params&)
+	/// \copydetails extract(executor&, const tes4::archive&, const std::filesystem::path&, const tes4::file::write_params&)
+	[[nodiscard]] auto extract(
+		executor& a_executor,
+		const fo4::archive& a_archive,
+		const std::filesystem::path& a_root,
+		const fo4::file::write_params& a_params)
+		-> extraction;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "async.hpp"
 #include "fo4.hpp"
 #include "tes3.hpp"
 #include "tes4.hpp"
+#include "vfs.hpp"
@@ -2,19 +2,24 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <compare>
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
 #include <filesystem>
+#include <functional>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <ranges>
 #include <span>
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <unordered_set>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -121,6 +126,58 @@ namespace bsa
 		shallow
 	};
 
+	/// \brief	Hints at how an archive read from disk will be accessed, so the operating system
+	///		can page its mapping in accordingly.
+	/// \remark	Every profile is only a hint, and is silently ignored wherever the platform can
+	///		not honor it.
+	enum class access_profile
+	{
+		/// \brief	Leaves paging up to the operating system.
+		normal,
+
+		/// \brief	The archive will be read front to back, e.g. when extracting all of it.
+		///		Reads ahead aggressively, and drops pages soon after they are read.
+		sequential,
+
+		/// \brief	The archive will be read in no particular order, e.g. when looking up
+		///		individual files. Disables read ahead.
+		random,
+
+		/// \brief	Faults the entire archive in up front, before it is read.
+		prefault,
+
+		/// \brief	Backs the mapping with huge pages, where available.
+		huge_pages
+	};
+
+	/// \brief	The ways an archive can be read from disk.
+	enum class read_backend
+	{
+		/// \brief	Maps the archive into memory, and pages it in as it is read.
+		mapped,
+
+		/// \brief	Reads the archive on demand, through a deep queue of asynchronous positional
+		///		reads: io_uring on linux, and overlapped io on windows.
+		/// \details	Suits archives stored on network filesystems, where page faults stall
+		///		threads unpredictably. Only the header, records, and names of an archive are read
+		///		up front. The data of each file is read in the first time it is accessed, except
+		///		by `extract_all`, which keeps reads in flight into a fixed pool of buffers, and
+		///		decompresses each file as soon as its read completes. Readers which hold onto
+		///		their source, e.g. lazy archives, read it in its entirety up front.
+		/// \remark	A file's data can not report errors when it is read in on first access, so
+		///		failing to read it terminates the program, just as failing to page in a mapping
+		///		would crash it.
+		async
+	};
+
+	/// \brief	Asks the operating system to start paging in the given memory, e.g. the data of
+	///		the files which will be read next.
+	/// \details	Returns immediately, without waiting for the memory to be paged in. This is
+	///		only a hint, and has no effect on memory which is already resident.
+	///
+	/// \param	a_bytes	The memory to prefetch.
+	void prefetch(std::span<const std::byte> a_bytes) noexcept;
+
 	/// \brief	Indicates whether the operation should finish by compressing the data or not.
 	enum class compression_type
 	{
@@ -131,6 +188,479 @@ namespace bsa
 		compressed
 	};
 
+	/// \brief	Configures when compression is skipped for data which will not shrink.
+	/// \details	Already compressed payloads (audio, video, pre-zipped blobs, etc.) take just
+	///		as long to compress as anything else, only to shrink by a fraction, if at all. A
+	///		policy can skip such data before it is compressed, or abandon the result after, and
+	///		store the data uncompressed instead.
+	/// \remark	The default policy compresses everything, regardless of how well it compresses.
+	struct compression_policy final
+	{
+	public:
+		/// \brief	Skips compressing data whose sampled entropy, in bits per byte, exceeds
+		///		this limit, e.g. `7.9`.
+		/// \details	Only a few small windows of the data are sampled, so the probe costs a tiny
+		///		fraction of compressing the data.
+		std::optional<double> max_entropy{ std::nullopt };
+
+		/// \brief	Stores data uncompressed when compressing it does not shrink it to at most
+		///		this ratio of its original size, e.g. `0.95`.
+		std::optional<double> max_ratio{ std::nullopt };
+	};
+
+	/// \brief	The implementations zip (deflate) compression can be routed through.
+	/// \details	The library is always built with zlib, and optionally with *one* faster
+	///		backend, chosen with the `BSA_DEFLATE_BACKEND` cmake option.
+	/// \remark	Every backend decompresses to identical output. However, only zlib compresses
+	///		to the exact bytes the official tools produce, see \ref deflate_backend_is_reference.
+	///		The other backends produce valid, but different, streams.
+	enum class deflate_backend
+	{
+		/// \brief	[zlib](https://github.com/madler/zlib) - The reference implementation.
+		zlib,
+
+		/// \brief	[zlib-ng](https://github.com/zlib-ng/zlib-ng) - zlib for the next generation.
+		/// \remark	**Not** byte compatible: compressed output differs from zlib's.
+		zlib_ng,
+
+		/// \brief	[libdeflate](https://github.com/ebiggers/libdeflate) - Heavily optimized
+		///		whole buffer deflate.
+		/// \remark	**Not** byte compatible: compressed output differs from zlib's.
+		/// \remark	libdeflate can not restrict its window, so compressing with a window smaller
+		///		than 32KiB (i.e. \ref fo4::compression_level::fo4_xbox) falls back to zlib.
+		libdeflate
+	};
+
+	/// \brief	Checks if compressing with the given backend reproduces the output of the
+	///		official tools byte for byte.
+	[[nodiscard]] constexpr bool deflate_backend_is_reference(deflate_backend a_backend) noexcept
+	{
+		return a_backend == deflate_backend::zlib;
+	}
+
+	/// \brief	Checks if the library was built with the given backend.
+	[[nodiscard]] bool deflate_backend_available(deflate_backend a_backend) noexcept;
+
+	/// \brief	Returns the backend zip compression and decompression is currently routed through.
+	/// \remark	Defaults to the backend chosen with `BSA_DEFLATE_BACKEND`.
+	[[nodiscard]] auto get_deflate_backend() noexcept
+		-> deflate_backend;
+
+	/// \brief	Routes all subsequent zip compression and decompression through the given
+	///		backend, on every thread.
+	///
+	/// \param	a_backend	The backend to use.
+	/// \return	`true` if the library was built with the backend, `false` otherwise, in which
+	///		case the current backend is left unchanged.
+	///
+	/// \remark	Incremental decompression, i.e. \ref tes4::file::open_stream, always uses zlib.
+	bool set_deflate_backend(deflate_backend a_backend) noexcept;
+
+#ifndef DOXYGEN
+	namespace detail
+	{
+		[[nodiscard]] auto get_codec_state(codec_context& a_context) -> codec_state&;
+	}
+#endif
+
+	/// \brief	Holds the state compression libraries keep between calls, so it can be reset,
+	///		rather than reallocated, for every file or chunk.
+	/// \details	Every thread keeps a context of its own, which is used whenever a context is
+	///		not given explicitly. Pass one in to control how long the state lives, e.g. to
+	///		release it once a batch of work is done.
+	/// \remark	A context must not be used by more than one thread at a time.
+	class codec_context final
+	{
+	public:
+		codec_context() noexcept;
+		codec_context(const codec_context&) = delete;
+		codec_context(codec_context&&) noexcept;
+		~codec_context() noexcept;
+		codec_context& operator=(const codec_context&) = delete;
+		codec_context& operator=(codec_context&&) noexcept;
+
+		/// \name Modifiers
+		/// @{
+
+		/// \brief	Releases all state held by the context.
+		void clear() noexcept;
+
+		/// @}
+
+	private:
+		friend auto detail::get_codec_state(codec_context& a_context) -> detail::codec_state&;
+
+		std::unique_ptr<detail::codec_state> _state;
+	};
+
+	/// \brief	Receives metrics from inside the library, e.g. to feed into telemetry.
+	/// \details	Install an observer with \ref set_observer. While none is installed, each
+	///		instrumentation point costs no more than checking for one.
+	/// \remark	Callbacks may be invoked from several threads at once, including the library's
+	///		own worker threads, so implementations must be thread safe.
+	class observer
+	{
+	public:
+		/// \brief	The stages of work which are timed as a whole.
+		enum class phase
+		{
+			/// \brief	Parsing an archive, i.e. `archive::read`.
+			read,
+
+			/// \brief	Writing an archive, i.e. `archive::write`.
+			write,
+
+			/// \brief	Hashing paths in bulk, i.e. `hashing::hash_file_many`.
+			hash
+		};
+
+		/// \brief	The ways bytes move between the library and its sources/sinks.
+		enum class io
+		{
+			/// \brief	Bytes mapped into memory from disk.
+			mapped,
+
+			/// \brief	Bytes copied out of a source into memory the library owns.
+			read,
+
+			/// \brief	Bytes written to a sink.
+			written
+		};
+
+		/// \brief	The codecs compression and decompression is reported for.
+		enum class codec
+		{
+			zlib,
+			lz4,
+			xmem
+		};
+
+		/// \brief	The direction data moved through a codec.
+		enum class operation
+		{
+			compress,
+			decompress
+		};
+
+		virtual ~observer() = default;
+
+		/// \brief	Called when a phase finishes, whether or not it succeeded.
+		virtual void on_phase(
+			[[maybe_unused]] phase a_phase,
+			[[maybe_unused]] std::chrono::nanoseconds a_elapsed) noexcept
+		{}
+
+		/// \brief	Called when bytes move between the library and a source/sink.
+		virtual void on_io(
+			[[maybe_unused]] io a_io,
+			[[maybe_unused]] std::size_t a_bytes) noexcept
+		{}
+
+		/// \brief	Called when a codec successfully compresses or decompresses a buffer.
+		///
+		/// \param	a_codec	The codec which was used.
+		/// \param	a_operation	Whether the buffer was compressed or decompressed.
+		/// \param	a_in	The size of the buffer given to the codec.
+		/// \param	a_out	The size of the buffer the codec produced.
+		/// \param	a_elapsed	The time spent in the codec.
+		virtual void on_codec(
+			[[maybe_unused]] codec a_codec,
+			[[maybe_unused]] operation a_operation,
+			[[maybe_unused]] std::size_t a_in,
+			[[maybe_unused]] std::size_t a_out,
+			[[maybe_unused]] std::chrono::nanoseconds a_elapsed) noexcept
+		{}
+
+		/// \brief	Called when the library allocates a buffer for file data, e.g. to hold the
+		///		result of compression.
+		virtual void on_allocation([[maybe_unused]] std::size_t a_bytes) noexcept {}
+
+		/// \brief	Called when a request to the xmem proxy completes a round trip.
+		virtual void on_xmem_round_trip([[maybe_unused]] std::chrono::nanoseconds a_elapsed) noexcept {}
+	};
+
+	/// \brief	Returns the installed observer, if any.
+	[[nodiscard]] auto get_observer() noexcept
+		-> observer*;
+
+	/// \brief	Installs an observer for every thread, replacing any installed before it.
+	///
+	/// \param	a_observer	The observer to install, or `nullptr` to stop observing. It must
+	///		outlive its installation, and any work started while it was installed.
+	void set_observer(observer* a_observer) noexcept;
+
+	/// \brief	Returns the memory resource which containers constructed on the calling thread
+	///		allocate from, i.e. that of the innermost \ref memory_scope, or
+	///		`std::pmr::get_default_resource()` outside of any.
+	[[nodiscard]] auto get_memory_resource() noexcept
+		-> std::pmr::memory_resource*;
+
+	/// \brief	Routes the allocations of archives, directories and files constructed on the
+	///		calling thread into the given memory resource, for as long as the scope lives.
+	///
+	/// \details	Directories and files inserted into a container are moved into the resource
+	///		of that container, so an archive read inside a scope lives entirely within its
+	///		resource, and can be freed in one shot along with it:
+	///
+	///	\code{.cpp}
+	///	std::pmr::monotonic_buffer_resource arena;
+	///	{
+	///		bsa::memory_scope scope{ arena };
+	///		bsa::tes4::archive bsa;
+	///		bsa.read(path);
+	///		// ...
+	///	}
+	///	\endcode
+	///
+	/// \remark	The resource is only ever used from the thread which installed it, so it need
+	///		not be thread safe, but it must outlive every container constructed in the scope.
+	/// \remark	Scopes nest, and must be destroyed in the reverse order of their construction.
+	class memory_scope final
+	{
+	public:
+		/// \name Constructors
+		/// @{
+
+		/// \param	a_resource	The resource to allocate from.
+		explicit memory_scope(std::pmr::memory_resource& a_resource) noexcept;
+
+		memory_scope(const memory_scope&) = delete;
+		memory_scope(memory_scope&&) = delete;
+
+		/// @}
+
+		/// \name Destructor
+		/// @{
+
+		/// \brief	Restores the resource which was in use before the scope.
+		~memory_scope() noexcept;
+
+		/// @}
+
+		/// \name Assignment
+		/// @{
+
+		memory_scope& operator=(const memory_scope&) = delete;
+		memory_scope& operator=(memory_scope&&) = delete;
+
+		/// @}
+
+	private:
+		std::pmr::memory_resource* _previous{ nullptr };
+	};
+
+	/// \brief	The results of verifying the integrity of an archive.
+	struct verify_report final
+	{
+		/// \brief	Describes a single entry which failed verification.
+		struct failure_t final
+		{
+			/// \brief	The path of the offending entry, or its hash when it has no name.
+			std::string path;
+
+			/// \brief	What was wrong with the entry.
+			std::string what;
+		};
+
+		/// \brief	Returns `true` if the archive passed every check, `false` otherwise.
+		[[nodiscard]] bool ok() const noexcept { return offsets && failures.empty(); }
+
+		/// \brief	The number of entries which were decompressed, or checked as is when they
+		///		were not compressed.
+		std::size_t entries{ 0 };
+
+		/// \brief	The total size of every entry once decompressed.
+		std::uint64_t bytes{ 0 };
+
+		/// \brief	Whether every offset within the archive would be valid when written.
+		bool offsets{ true };
+
+		/// \brief	Every entry which failed verification, in the order they are iterated.
+		std::vector<failure_t> failures;
+	};
+
+	/// \brief	The results of transcoding an archive from one compression format to another.
+	struct transcode_report final
+	{
+		/// \brief	The number of entries which were kept as is, either because they were not
+		///		compressed, or because the target format accepts their data byte-for-byte.
+		std::size_t passed_through{ 0 };
+
+		/// \brief	The number of entries which were decompressed and compressed again.
+		std::size_t transcoded{ 0 };
+
+		/// \brief	The total size of every entry which was passed through.
+		std::uint64_t passed_through_bytes{ 0 };
+
+		/// \brief	The total size of every entry which was transcoded, once transcoded.
+		std::uint64_t transcoded_bytes{ 0 };
+	};
+
+#ifndef DOXYGEN
+	namespace detail
+	{
+		// Returns a number never returned before, identifying the contents of an archive for
+		//	as long as they last.
+		[[nodiscard]] std::uint64_t next_generation() noexcept;
+	}
+#endif
+
+	/// \brief	A thread-safe, bounded cache of decompressed file contents, which evicts the
+	///		least recently used contents once it exceeds its memory budget.
+	///
+	/// \details	The cache is split into shards, each guarded by its own lock, so lookups for
+	///		different files rarely contend. Contents are handed out as shared, read-only buffers,
+	///		so hits never copy, and stay valid after they are evicted.
+	///
+	/// \remark	Contents are keyed only by the archive and the file they came from, so every
+	///		lookup for the same archive should decompress with the same parameters.
+	class content_cache final
+	{
+	public:
+		/// \name Member types
+		/// @{
+
+		/// \brief	Identifies a file within an archive.
+		struct key_type final
+		{
+			/// \brief	The archive the file belongs to.
+			const void* archive{ nullptr };
+
+			/// \brief	The generation of the contents of the archive, which changes whenever
+			///		it is cleared or read, so contents cached before are never served again.
+			std::uint64_t generation{ 0 };
+
+			/// \brief	The high bits of the hash of the file.
+			std::uint64_t hi{ 0 };
+
+			/// \brief	The low bits of the hash of the file.
+			std::uint64_t lo{ 0 };
+
+			[[nodiscard]] friend bool operator==(const key_type&, const key_type&) noexcept = default;
+		};
+
+		/// \brief	A shared, read-only handle to the contents of a file.
+		using contents_type = std::shared_ptr<const std::vector<std::byte>>;
+
+		/// \brief	Counts how the cache has been used.
+		struct stats_type final
+		{
+			/// \brief	The number of lookups which found their contents cached.
+			std::uint64_t hits{ 0 };
+
+			/// \brief	The number of lookups which did not.
+			std::uint64_t misses{ 0 };
+
+			/// \brief	The number of contents evicted to stay within the budget.
+			std::uint64_t evictions{ 0 };
+		};
+
+		/// @}
+
+		/// \name Constructors
+		/// @{
+
+		/// \param	a_budget	The maximum number of bytes of contents to keep cached.
+		/// \param	a_shards	The number of independently locked shards to split the cache
+		///		into. Each shard is given an equal share of the budget.
+		explicit content_cache(std::size_t a_budget, std::size_t a_shards = 16);
+
+		content_cache(const content_cache&) = delete;
+		content_cache(content_cache&&) = delete;
+
+		/// @}
+
+		/// \name Destructor
+		/// @{
+
+		~content_cache() noexcept;
+
+		/// @}
+
+		/// \name Assignment
+		/// @{
+
+		content_cache& operator=(const content_cache&) = delete;
+		content_cache& operator=(content_cache&&) = delete;
+
+		/// @}
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Returns the maximum number of bytes of contents kept cached.
+		[[nodiscard]] std::size_t budget() const noexcept { return _budget; }
+
+		/// \brief	Returns the number of bytes of contents currently cached.
+		[[nodiscard]] std::size_t size() const noexcept;
+
+		/// @}
+
+		/// \name Lookup
+		/// @{
+
+		/// \brief	Finds the cached contents of a file, marking them as recently used.
+		///
+		/// \param	a_key	The file to look up.
+		/// \return	The cached contents, or `nullptr` if they are not cached.
+		[[nodiscard]] contents_type find(const key_type& a_key) noexcept;
+
+		/// \brief	Finds the cached contents of a file, or loads and caches them on a miss.
+		///
+		/// \details	The contents are loaded outside of any lock, so concurrent misses for the
+		///		same file may each load it. Only the first to finish is cached.
+		///
+		/// \param	a_key	The file to look up.
+		/// \param	a_load	Invoked on a miss, returning the contents as a
+		///		`std::vector<std::byte>`.
+		/// \return	The contents of the file.
+		template <class Load>
+		[[nodiscard]] contents_type get_or_load(const key_type& a_key, Load&& a_load)
+		{
+			if (auto contents = this->find(a_key); contents) {
+				return contents;
+			}
+			return this->insert(a_key, std::forward<Load>(a_load)());
+		}
+
+		/// @}
+
+		/// \name Modifiers
+		/// @{
+
+		/// \brief	Evicts all contents from the cache.
+		void clear() noexcept;
+
+		/// \brief	Caches the contents of a file, evicting the least recently used contents to
+		///		stay within the budget.
+		///
+		/// \param	a_key	The file the contents belong to.
+		/// \param	a_contents	The contents of the file.
+		/// \return	The cached contents. If the file was already cached, then those contents are
+		///		kept instead. Contents too large for a shard are returned without being cached.
+		contents_type insert(const key_type& a_key, std::vector<std::byte> a_contents);
+
+		/// @}
+
+		/// \name Observers
+		/// @{
+
+		/// \brief	Returns how the cache has been used so far.
+		[[nodiscard]] stats_type stats() const noexcept;
+
+		/// @}
+
+	private:
+		struct shard_t;
+
+		[[nodiscard]] auto shard_for(const key_type& a_key) const noexcept
+			-> shard_t&;
+
+		std::unique_ptr<shard_t[]> _shards;
+		std::size_t _count{ 0 };
+		std::size_t _budget{ 0 };
+	};
+
 	/// \brief	The file format for a given archive.
 	enum class file_format
 	{
@@ -163,7 +693,8 @@ namespace bsa
 		/// \brief	Compresses the object.
 		///
 		/// \pre	The object must *not* be compressed.
-		/// \post	The object will be compressed.
+		/// \post	The object will be compressed, unless its \ref compression_policy decided
+		///		against it.
 		///
 		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
 		///		are encountered.
@@ -224,6 +755,16 @@ namespace bsa
 		static void decompress_into(
 			std::span<std::byte> a_out);
 
+		/// \brief	Opens a stream which decompresses the object incrementally, as it is read.
+		/// \details	If the object is not compressed, the stream reads its contents as is.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		///
+		/// \return	A stream over the decompressed contents of the object, which *must not*
+		///		outlive the object.
+		static void open_stream();
+
 		/// \brief	Reads the contents of the source.
 		///
 		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
@@ -278,6 +819,7 @@ namespace bsa::detail
                                                                                                      \
 		F(current_executable_directory_failure, "failed to locate the current executable directory") \
 		F(decompress_size_mismatch, "actual decompressed size does not match the expected size")     \
+		F(decompress_malformed_input, "compressed data is malformed")                                \
                                                                                                      \
 		F(xmem_unavailable, "support for the xmem proxy has not been enabled")                       \
 		F(xmem_version_mismatch, "the xmem proxy does not match the expected version")               \
@@ -338,10 +880,68 @@ namespace bsa::detail
 		}
 	}
 
+	// Paths this long (or longer) are normalized to ".".
+	inline constexpr std::size_t max_path = 260;
+
+	[[nodiscard]] constexpr char mapchar(char a_ch) noexcept
+	{
+		if (a_ch == '/') {
+			return '\\';
+		} else if ('A' <= a_ch && a_ch <= 'Z') {
+			return static_cast<char>(a_ch + ('a' - 'A'));
+		} else {
+			return a_ch;
+		}
+	}
+
+	// Applies `mapchar` to `[a_src, a_src + a_count)`, writing the results to `a_dst`. The two
+	//	ranges may be the same, but must not otherwise overlap.
+	void map_chars(const char* a_src, char* a_dst, std::size_t a_count) noexcept;
+
 	void normalize_path(std::string& a_path) noexcept;
 
+	// Normalizes `a_path` into `a_buffer`, without allocating. The result views either
+	//	`a_buffer` or a string literal.
+	[[nodiscard]] constexpr auto normalize_path(
+		std::string_view a_path,
+		std::span<char, max_path> a_buffer) noexcept
+		-> std::string_view
+	{
+		// slashes are the only characters which map to a backslash, so trimming before mapping
+		//	gives the same result as trimming after
+		const auto first = a_path.find_first_not_of("/\\");
+		if (first == std::string_view::npos) {
+			return ".";
+		}
+
+		const auto last = a_path.find_last_not_of("/\\");
+		const auto trimmed = a_path.substr(first, last - first + 1);
+		if (trimmed.size() >= max_path) {
+			return ".";
+		}
+
+		if (std::is_constant_evaluated()) {
+			std::ranges::transform(trimmed, a_buffer.begin(), mapchar);
+		} else {
+			map_chars(trimmed.data(), a_buffer.data(), trimmed.size());
+		}
+		return { a_buffer.data(), trimmed.size() };
+	}
+
 	[[nodiscard]] auto read_bstring(detail::istream_t& a_in) -> std::string_view;
 	[[nodiscard]] auto read_bzstring(detail::istream_t& a_in) -> std::string_view;
+	// Checks if the policy would skip compressing `a_data` outright.
+	[[nodiscard]] bool skip_compression(
+		std::span<const std::byte> a_data,
+		const compression_policy& a_policy) noexcept;
+
+	// Checks if the policy would keep the result of compressing `a_original` bytes down to
+	//	`a_compressed` bytes.
+	[[nodiscard]] bool keep_compression(
+		std::size_t a_original,
+		std::size_t a_compressed,
+		const compression_policy& a_policy) noexcept;
+
 	[[nodiscard]] auto read_wstring(detail::istream_t& a_in) -> std::string_view;
 	[[nodiscard]] auto read_zstring(detail::istream_t& a_in) -> std::string_view;
 
@@ -357,14 +957,60 @@ namespace bsa::detail
 	void write_wstring(detail::ostream_t& a_out, std::string_view a_string) noexcept;
 	void write_zstring(detail::ostream_t& a_out, std::string_view a_string) noexcept;
 
+	// Append-only storage for the names of keys, which retains the storage of names it did not
+	//	copy. Views it hands out stay valid for as long as the arena lives.
+	class string_arena final
+	{
+	public:
+		string_arena() noexcept = default;
+		string_arena(const string_arena&) = delete;
+		string_arena(string_arena&&) noexcept = default;
+		~string_arena() noexcept = default;
+		string_arena& operator=(const string_arena&) = delete;
+		string_arena& operator=(string_arena&&) noexcept = default;
+
+		// Copies the string into the arena, unless an identical string was copied before.
+		[[nodiscard]] auto intern(std::string_view a_string)
+			-> std::string_view;
+
+		// Keeps the given storage alive for as long as the arena lives.
+		void retain(std::shared_ptr<const void> a_storage);
+
+		// Drops the index used to find identical strings, once nothing more will be interned.
+		void seal() noexcept;
+
+	private:
+		static constexpr std::size_t block_size = std::size_t{ 1 } << 16;
+
+		std::vector<std::unique_ptr<char[]>> _blocks;
+		char* _cursor{ nullptr };
+		std::size_t _available{ 0 };
+		std::unordered_set<std::string_view> _index;
+		std::vector<std::shared_ptr<const void>> _retained;
+	};
+
+	// A range of bytes within a source.
+	struct extent_t final
+	{
+		std::size_t offset{ 0 };
+		std::size_t size{ 0 };
+	};
+
 	class istream_t final
 	{
 	public:
 		using stream_type = binary_io::span_istream;
-		using file_type = mmio::mapped_file_source;
+		// the backing storage of a stream, which may be a mapping or a buffer
+		using file_type = const void;
 
 		istream_t(std::filesystem::path a_path);
+		istream_t(std::filesystem::path a_path, access_profile a_profile);
+		istream_t(std::filesystem::path a_path, read_backend a_backend);
 		istream_t(std::span<const std::byte> a_bytes, copy_type a_copy) noexcept;
+		istream_t(
+			std::shared_ptr<file_type> a_file,
+			std::span<const std::byte> a_bytes,
+			copy_type a_copy) noexcept;
 
 		istream_t(const volatile istream_t&) = delete;
 		istream_t& operator=(const volatile istream_t&) = delete;
@@ -384,8 +1030,32 @@ namespace bsa::detail
 		[[nodiscard]] bool has_file() const noexcept { return _file != nullptr; }
 		[[nodiscard]] bool shallow_copy() const noexcept { return _copy == copy_type::shallow; }
 
+		// The file a sparse stream is read from on demand, if this is one. Nothing outside of
+		//	what has been fetched may be read from a sparse stream.
+		[[nodiscard]] auto sparse() const noexcept
+			-> const std::shared_ptr<const async_file>& { return _sparse; }
+
+		// Makes the given extents of a sparse stream resident. Does nothing for any other stream.
+		void fetch(extent_t a_extent) const;
+		void fetch(std::span<const extent_t> a_extents) const;
+		void fetch_all() const;
+
+		// Opens another stream over the same bytes, e.g. for another thread to read from.
+		[[nodiscard]] auto reopen() const noexcept -> istream_t;
+
 	private:
+		using source_type = std::pair<std::shared_ptr<file_type>, std::span<const std::byte>>;
+
+		explicit istream_t(source_type a_source) noexcept;
+
+		istream_t(
+			std::shared_ptr<file_type> a_file,
+			std::shared_ptr<const async_file> a_sparse,
+			std::span<const std::byte> a_bytes,
+			copy_type a_copy) noexcept;
+
 		std::shared_ptr<file_type> _file;
+		std::shared_ptr<const async_file> _sparse;
 		stream_type _stream;
 		copy_type _copy{ copy_type::deep };
 	};
@@ -397,6 +1067,43 @@ namespace bsa::detail
 		std::shared_ptr<istream_t::file_type> f;
 	};
 
+	// Bytes of a sparse stream, which are only read once they are first accessed.
+	struct deferred_bytes final
+	{
+		std::span<const std::byte> d;
+		std::shared_ptr<const async_file> f;
+	};
+
+	// Retains the backing storage of a stream, so that it can be reopened long after the
+	//	stream it was created from has been destroyed. Deep copied memory is copied up front.
+	class shared_source final
+	{
+	public:
+		shared_source() noexcept = default;
+		explicit shared_source(const istream_t& a_in);
+
+		shared_source(const shared_source&) = delete;
+		shared_source(shared_source&&) noexcept = default;
+
+		shared_source& operator=(const shared_source&) = delete;
+		shared_source& operator=(shared_source&&) noexcept = default;
+
+		[[nodiscard]] explicit operator bool() const noexcept { return !_bytes.empty(); }
+
+		[[nodiscard]] auto open() const noexcept
+			-> istream_t { return { _file, _bytes, _copy }; }
+
+		// The retained bytes, which live for as long as this does.
+		[[nodiscard]] auto bytes() const noexcept
+			-> std::span<const std::byte> { return _bytes; }
+
+	private:
+		std::shared_ptr<istream_t::file_type> _file;
+		std::vector<std::byte> _owned;
+		std::span<const std::byte> _bytes;
+		copy_type _copy{ copy_type::shallow };
+	};
+
 	class restore_point final
 	{
 	public:
@@ -491,6 +1198,8 @@ namespace bsa
 			compression_error(library::internal, detail::to_underlying(a_code))
 		{}
 
+		compression_error(const compression_error& a_error, std::string_view a_path);
+
 		const char* what() const noexcept override { return _what.c_str(); }
 #endif
 
@@ -521,6 +1230,22 @@ namespace bsa
 			_value(std::move(a_path))
 		{}
 
+		/// \param	a_path	The path to read from on the native filesystem.
+		/// \param	a_profile	How the archive will be accessed once it is read.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		read_source(std::filesystem::path a_path, access_profile a_profile) :
+			_value(std::move(a_path), a_profile)
+		{}
+
+		/// \param	a_path	The path to read from on the native filesystem.
+		/// \param	a_backend	How the archive is read from the filesystem.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		read_source(std::filesystem::path a_path, read_backend a_backend) :
+			_value(std::move(a_path), a_backend)
+		{}
+
 		/// \param	a_src	The source to read from.
 		///
 		/// \remarks	Defaults to a \ref copy_type::deep "deep" copy.
@@ -534,76 +1259,233 @@ namespace bsa
 			_value(a_src, a_copy)
 		{}
 
+		/// \param	a_owner	The owner of `a_src`, which is kept alive for as long as anything
+		///		read from `a_src` is.
+		/// \param	a_src	The source to read from.
+		///
+		/// \remarks	Nothing is copied: everything read aliases `a_src`, as if it were a
+		///		\ref copy_type::shallow "shallow" copy, except its lifetime is managed for you.
+		///		Use the aliasing constructor of `std::shared_ptr` to share ownership of a
+		///		buffer held by some other object, e.g. a `std::vector`.
+		read_source(std::shared_ptr<const void> a_owner, std::span<const std::byte> a_src) noexcept :
+			_value(std::move(a_owner), a_src, copy_type::shallow)
+		{}
+
+		/// \param	a_src	The buffer to read from, which is kept alive for as long as anything
+		///		read from it is.
+		/// \param	a_size	The size of `a_src`, in bytes.
+		///
+		/// \remarks	Nothing is copied.
+		read_source(std::shared_ptr<const std::byte[]> a_src, std::size_t a_size) noexcept :
+			read_source(a_src, std::span{ a_src.get(), a_size })
+		{}
+
 #ifndef DOXYGEN
 	private:
 		friend tes3::archive;
+		friend tes3::archive_view;
 		friend tes3::file;
 		friend tes4::archive;
 		friend tes4::file;
+		friend tes4::lazy_archive;
 		friend fo4::archive;
 		friend fo4::file;
+		friend fo4::lazy_archive;
+		friend fo4::patch;
 
 		using value_type = detail::istream_t;
 
-		[[nodiscard]] auto stream() noexcept -> value_type& { return _value; }
+		// Sparse sources are read in their entirety, for readers which may touch any of them.
+		[[nodiscard]] auto stream() -> value_type&
+		{
+			_value.fetch_all();
+			return _value;
+		}
+
+		// For readers which fetch exactly the parts of a sparse source they touch.
+		[[nodiscard]] auto sparse_stream() noexcept -> value_type& { return _value; }
 
 		value_type _value;
 #endif
 	};
 
-	/// \brief	An abstraction over the specific sink that will be written to.
-	class write_sink final
-	{
-	public:
-		/// \param a_path The path to write to on the native filesystem.
+	/// \brief	An abstraction over the specific sink that will be written to.
+	class write_sink final
+	{
+	public:
+		/// \param a_path The path to write to on the native filesystem.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		write_sink(std::filesystem::path a_path) :
+			_value(std::in_place_index<stream_value>, std::in_place_type<binary_io::file_ostream>, std::move(a_path))
+		{}
+
+		/// \param	a_dst	The stream to write the archive to.
+		write_sink(binary_io::any_ostream& a_dst) noexcept :
+			_value(std::in_place_index<stream_reference>, a_dst)
+		{}
+
+#ifndef DOXYGEN
+	private:
+		friend tes3::archive;
+		friend tes3::file;
+		friend tes4::archive;
+		friend tes4::file;
+		friend tes4::stream_writer;
+		friend fo4::archive;
+		friend fo4::file;
+		friend fo4::patch;
+		friend fo4::stream_writer;
+
+		using value_type = binary_io::any_ostream;
+
+		enum : std::size_t
+		{
+			stream_value,
+			stream_reference,
+
+			stream_count
+		};
+
+		[[nodiscard]] auto stream() noexcept -> value_type&
+		{
+			switch (_value.index()) {
+			case stream_value:
+				return *std::get_if<stream_value>(&_value);
+			case stream_reference:
+				return *std::get_if<stream_reference>(&_value);
+			default:
+				detail::declare_unreachable();
+			}
+		}
+
+		std::variant<
+			value_type,
+			std::reference_wrapper<value_type>>
+			_value;
+
+		static_assert(stream_count == std::variant_size_v<decltype(_value)>);
+#endif
+	};
+
+	/// \brief	Incrementally decompresses the data of a file, as it is read.
+	/// \details	Data is inflated directly into the buffers it is read into, so memory use
+	///		stays constant regardless of the size of the file, and the first bytes are
+	///		available without decompressing the rest of the file.
+	/// \remark	The stream views the compressed data of the file it was opened from, and so
+	///		*must not* outlive it.
+	class decompression_stream final :
+		public binary_io::istream_interface<decompression_stream>
+	{
+	public:
+		/// \name Constructors
+		/// @{
+
+		/// \brief	Constructs an empty stream.
+		decompression_stream() noexcept;
+		decompression_stream(const decompression_stream&) = delete;
+		decompression_stream(decompression_stream&&) noexcept;
+
+		/// @}
+
+		/// \name Destructor
+		/// @{
+
+		~decompression_stream() noexcept;
+
+		/// @}
+
+		/// \name Assignment
+		/// @{
+
+		decompression_stream& operator=(const decompression_stream&) = delete;
+		decompression_stream& operator=(decompression_stream&&) noexcept;
+
+		/// @}
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Checks if every byte of the stream has been read.
+		[[nodiscard]] bool eof() const noexcept { return _pos == _size; }
+
+		/// \brief	Returns the total number of bytes the stream will decompress.
+		[[nodiscard]] std::size_t size() const noexcept { return _size; }
+
+		/// @}
+
+		/// \name Reading
+		/// @{
+
+		/// \brief	Reads exactly `a_dst.size()` bytes from the stream.
+		///
+		/// \exception	binary_io::buffer_exhausted	Thrown when the stream ends before `a_dst`
+		///		is filled.
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		///
+		/// \param	a_dst	The buffer to read into.
+		void read_bytes(std::span<std::byte> a_dst);
+
+		/// \brief	Reads up to `a_dst.size()` bytes from the stream.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		///
+		/// \param	a_dst	The buffer to read into.
+		/// \return	The number of bytes read, which is less than `a_dst.size()` only when the
+		///		end of the stream is reached.
+		std::size_t read_some(std::span<std::byte> a_dst);
+
+		/// @}
+
+		/// \name Positioning
+		/// @{
+
+		/// \brief	Seeks to the given position in the stream.
+		/// \details	Compressed data can only be decompressed from front to back, so seeking
+		///		decompresses and discards everything up to the new position.
 		///
-		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
-		write_sink(std::filesystem::path a_path) :
-			_value(std::in_place_index<stream_value>, std::in_place_type<binary_io::file_ostream>, std::move(a_path))
-		{}
+		/// \exception	bsa::exception	Thrown when seeking backwards, or past the end of the
+		///		stream.
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		void seek_absolute(binary_io::streamoff a_pos);
 
-		/// \param	a_dst	The stream to write the archive to.
-		write_sink(binary_io::any_ostream& a_dst) noexcept :
-			_value(std::in_place_index<stream_reference>, a_dst)
-		{}
+		/// \copydoc seek_absolute
+		void seek_relative(binary_io::streamoff a_off) { this->seek_absolute(this->tell() + a_off); }
+
+		/// \brief	Returns the current position in the stream.
+		[[nodiscard]] binary_io::streamoff tell() const noexcept
+		{
+			return static_cast<binary_io::streamoff>(_pos);
+		}
+
+		/// @}
 
 #ifndef DOXYGEN
 	private:
-		friend tes3::archive;
-		friend tes3::file;
-		friend tes4::archive;
 		friend tes4::file;
-		friend fo4::archive;
-		friend fo4::file;
-
-		using value_type = binary_io::any_ostream;
+		friend fo4::chunk;
 
-		enum : std::size_t
+		enum class codec
 		{
-			stream_value,
-			stream_reference,
-
-			stream_count
+			none,
+			zlib,
+			lz4_frame,
+			lz4_block
 		};
 
-		[[nodiscard]] auto stream() noexcept -> value_type&
-		{
-			switch (_value.index()) {
-			case stream_value:
-				return *std::get_if<stream_value>(&_value);
-			case stream_reference:
-				return *std::get_if<stream_reference>(&_value);
-			default:
-				detail::declare_unreachable();
-			}
-		}
+		class source_t;
 
-		std::variant<
-			value_type,
-			std::reference_wrapper<value_type>>
-			_value;
+		decompression_stream(
+			codec a_codec,
+			std::span<const std::byte> a_in,
+			std::size_t a_size);
 
-		static_assert(stream_count == std::variant_size_v<decltype(_value)>);
+		std::unique_ptr<source_t> _source;
+		std::size_t _pos{ 0 };
+		std::size_t _size{ 0 };
 #endif
 	};
 }
@@ -614,6 +1496,79 @@ namespace bsa::concepts
 	template <class T>
 	concept stringable =
 		std::constructible_from<std::string, T>;
+
+	/// \brief	Defines a range of types that can be used to construct `std::string`
+	template <class T>
+	concept stringable_range =
+		std::ranges::input_range<T> &&
+		stringable<std::ranges::range_reference_t<T>>;
+}
+
+namespace bsa::detail
+{
+	// Times a phase for the installed observer. Without one, this costs a single lookup.
+	class observe_phase final
+	{
+	public:
+		explicit observe_phase(observer::phase a_phase) noexcept :
+			_observer(get_observer()),
+			_phase(a_phase)
+		{
+			if (_observer) {
+				_start = clock::now();
+			}
+		}
+
+		observe_phase(const observe_phase&) = delete;
+		observe_phase(observe_phase&&) = delete;
+
+		~observe_phase() noexcept
+		{
+			if (_observer) {
+				_observer->on_phase(_phase, clock::now() - _start);
+			}
+		}
+
+		observe_phase& operator=(const observe_phase&) = delete;
+		observe_phase& operator=(observe_phase&&) = delete;
+
+	private:
+		using clock = std::chrono::steady_clock;
+
+		observer* _observer{ nullptr };
+		observer::phase _phase;
+		clock::time_point _start;
+	};
+
+	// Reports bytes deep copied out of a source into a buffer of their own.
+	inline void observe_copy(std::size_t a_bytes) noexcept
+	{
+		if (const auto observer = get_observer(); observer) {
+			observer->on_allocation(a_bytes);
+			observer->on_io(observer::io::read, a_bytes);
+		}
+	}
+
+	template <class Hash, concepts::stringable_range Range, class Hasher>
+	[[nodiscard]] auto hash_many(Range&& a_paths, Hasher a_hasher)
+		-> std::vector<Hash>
+	{
+		const observe_phase phase{ observer::phase::hash };
+		std::vector<Hash> result;
+		if constexpr (std::ranges::sized_range<Range>) {
+			result.reserve(std::ranges::size(a_paths));
+		}
+
+		// every path is normalized in the same buffer, so the batch allocates at most once
+		//	per path that is longer than any before it
+		std::string buffer;
+		for (auto&& path : a_paths) {
+			buffer = std::forward<decltype(path)>(path);
+			result.push_back(a_hasher(buffer));
+		}
+
+		return result;
+	}
 }
 
 namespace bsa::components
@@ -639,7 +1594,7 @@ namespace bsa::components
 		[[nodiscard]] bool empty() const noexcept { return size() == 0; }
 
 		/// \brief	Returns the size of the underlying byte container.
-		[[nodiscard]] std::size_t size() const noexcept { return as_bytes().size(); }
+		[[nodiscard]] std::size_t size() const noexcept { return view().size(); }
 
 		/// @}
 
@@ -662,6 +1617,8 @@ namespace bsa::components
 		/// @{
 
 		/// \brief	Retrieves an immutable view into the underlying bytes.
+		/// \remark	The bytes of a file read through \ref read_backend::async are read from
+		///		disk here, the first time they are accessed.
 		std::span<const std::byte> as_bytes() const noexcept;
 
 		/// \brief	Retrieves an immutable pointer to the underlying bytes.
@@ -669,6 +1626,23 @@ namespace bsa::components
 
 		/// @}
 
+		/// \name Prefetching
+		/// @{
+
+		/// \brief	Asks the operating system to start paging in the underlying bytes, ahead of
+		///		reading them.
+		/// \copydetails bsa::prefetch
+		void prefetch() const noexcept { bsa::prefetch(view()); }
+
+		/// @}
+
+#ifndef DOXYGEN
+		// The file the bytes are still to be read from, and where in it they lie, unless they
+		//	are already resident.
+		[[nodiscard]] auto unread() const noexcept
+			-> std::optional<std::pair<const detail::async_file*, detail::extent_t>>;
+#endif
+
 	private:
 		friend compressed_byte_container;
 		friend byte_container;
@@ -678,16 +1652,21 @@ namespace bsa::components
 			data_view,
 			data_owner,
 			data_proxied,
+			data_deferred,
 
 			data_count
 		};
 
 		using data_proxy = detail::istream_proxy<std::span<const std::byte>>;
 
+		// the bytes, without reading them from disk if they are deferred
+		[[nodiscard]] auto view() const noexcept -> std::span<const std::byte>;
+
 		std::variant<
 			std::span<const std::byte>,
 			std::vector<std::byte>,
-			data_proxy>
+			data_proxy,
+			detail::deferred_bytes>
 			_data;
 
 		static_assert(data_count == std::variant_size_v<decltype(_data)>);
@@ -727,11 +1706,14 @@ namespace bsa::components
 			std::span<const std::byte> a_data,
 			const detail::istream_t& a_in) noexcept
 		{
-			if (a_in.has_file() && a_in.shallow_copy()) {
+			if (a_in.sparse()) {
+				detail::variant_emplace<data_deferred>(_data, a_data, a_in.sparse());
+			} else if (a_in.has_file() && a_in.shallow_copy()) {
 				detail::variant_emplace<data_proxied>(_data, a_data, a_in.file());
 			} else {
 				if (a_in.deep_copy()) {
 					_data.emplace<data_owner>(a_data.begin(), a_data.end());
+					detail::observe_copy(a_data.size());
 				} else {
 					_data.emplace<data_view>(a_data);
 				}
@@ -808,11 +1790,14 @@ namespace bsa::components
 			const detail::istream_t& a_in,
 			std::optional<std::size_t> a_decompressedSize = std::nullopt) noexcept
 		{
-			if (a_in.has_file() && a_in.shallow_copy()) {
+			if (a_in.sparse()) {
+				detail::variant_emplace<data_deferred>(_data, a_data, a_in.sparse());
+			} else if (a_in.has_file() && a_in.shallow_copy()) {
 				detail::variant_emplace<data_proxied>(_data, a_data, a_in.file());
 			} else {
 				if (a_in.deep_copy()) {
 					_data.emplace<data_owner>(a_data.begin(), a_data.end());
+					detail::observe_copy(a_data.size());
 				} else {
 					_data.emplace<data_view>(a_data);
 				}
@@ -830,27 +1815,36 @@ namespace bsa::components
 	///
 	/// \tparam	T	The `mapped_type`.
 	/// \tparam	RECURSE	Determines if indexing via `operator[]` is a recursive action.
+	///
+	/// \remark	When built with `BSA_FLAT_HASHMAP`, elements are stored contiguously in a
+	///		vector sorted by hash, instead of in a node-based tree. Lookups become a binary
+	///		search over a packed array of hashes, but inserting/erasing in the middle of the
+	///		container is linear in its size, and *all* iterators/references are invalidated
+	///		by any insertion/erasure.
 	template <class T, bool RECURSE>
 	class hashmap
 	{
-	private:
-		using container_type =
-			std::map<typename T::key, T>;
-
 	public:
 		/// \name Member types
 		/// @{
 
-#ifdef DOXYGEN
 		using key_type = typename T::key;
 		using mapped_type = T;
 		using value_type = std::pair<const key_type, mapped_type>;
+		using key_compare = std::less<key_type>;
+		using allocator_type = std::pmr::polymorphic_allocator<>;
+
+	private:
+#ifdef BSA_FLAT_HASHMAP
+		using container_type = std::pmr::vector<value_type>;
+		using hash_type = typename key_type::hash_type;
+
+		static_assert(std::is_nothrow_move_constructible_v<value_type>);
 #else
-		using key_type = typename container_type::key_type;
-		using mapped_type = typename container_type::mapped_type;
-		using value_type = typename container_type::value_type;
+		using container_type = std::pmr::map<key_type, mapped_type, key_compare>;
 #endif
-		using key_compare = typename container_type::key_compare;
+
+	public:
 		using iterator = typename container_type::iterator;
 		using const_iterator = typename container_type::const_iterator;
 
@@ -937,8 +1931,45 @@ namespace bsa::components
 		/// \name Assignment
 		/// @{
 
+#ifdef BSA_FLAT_HASHMAP
+		// the mapped keys are const, so the elements themselves can't be assigned
+		hashmap& operator=(const hashmap& a_rhs) noexcept
+		{
+			if (this != &a_rhs) {
+				_values.clear();
+				_values.reserve(a_rhs._values.size());
+				for (const auto& value : a_rhs._values) {
+					_values.emplace_back(value);
+				}
+				_hashes = a_rhs._hashes;
+			}
+			return *this;
+		}
+
+		// containers from different resources can't trade storage, so their elements are moved
+		hashmap& operator=(hashmap&& a_rhs) noexcept
+		{
+			if (this != &a_rhs) {
+				if (_values.get_allocator() == a_rhs._values.get_allocator()) {
+					_values.swap(a_rhs._values);
+					_hashes.swap(a_rhs._hashes);
+				} else {
+					_values.clear();
+					_values.reserve(a_rhs._values.size());
+					for (auto& value : a_rhs._values) {
+						_values.emplace_back(std::move(value));
+					}
+					_hashes = a_rhs._hashes;
+				}
+				a_rhs._values.clear();
+				a_rhs._hashes.clear();
+			}
+			return *this;
+		}
+#else
 		hashmap& operator=(const hashmap&) noexcept = default;
 		hashmap& operator=(hashmap&&) noexcept = default;
+#endif
 
 		/// @}
 
@@ -946,20 +1977,54 @@ namespace bsa::components
 		/// @{
 
 		/// \brief	Checks if the container is empty.
-		[[nodiscard]] bool empty() const noexcept { return _map.empty(); }
+		[[nodiscard]] bool empty() const noexcept { return _values.empty(); }
 
 		/// \brief	Returns the number of elements in the container.
-		[[nodiscard]] std::size_t size() const noexcept { return _map.size(); }
+		[[nodiscard]] std::size_t size() const noexcept { return _values.size(); }
 
 		/// @}
 
 		/// \name Constructors
 		/// @{
 
-		hashmap() noexcept = default;
-		hashmap(const hashmap&) noexcept = default;
+		/// \brief	Constructs an empty container, which allocates from \ref get_memory_resource.
+		hashmap() noexcept :
+			hashmap(allocator_type{ get_memory_resource() })
+		{}
+
+		/// \brief	Constructs an empty container, which allocates from the given allocator.
+		explicit hashmap(const allocator_type& a_alloc) noexcept :
+#ifdef BSA_FLAT_HASHMAP
+			_hashes(a_alloc),
+#endif
+			_values(a_alloc)
+		{}
+
+		/// \brief	Copies the given container, allocating from \ref get_memory_resource.
+		hashmap(const hashmap& a_rhs) noexcept :
+			hashmap(a_rhs, allocator_type{ get_memory_resource() })
+		{}
+
+		/// \brief	Copies the given container, allocating from the given allocator.
+		hashmap(const hashmap& a_rhs, const allocator_type& a_alloc) noexcept :
+#ifdef BSA_FLAT_HASHMAP
+			_hashes(a_rhs._hashes, a_alloc),
+#endif
+			_values(a_rhs._values, a_alloc)
+		{}
+
+		/// \brief	Takes the contents of the given container, along with its allocator.
 		hashmap(hashmap&&) noexcept = default;
 
+		/// \brief	Takes the contents of the given container, allocating from the given
+		///		allocator. The contents are moved element-wise if the allocators differ.
+		hashmap(hashmap&& a_rhs, const allocator_type& a_alloc) noexcept :
+#ifdef BSA_FLAT_HASHMAP
+			_hashes(std::move(a_rhs._hashes), a_alloc),
+#endif
+			_values(std::move(a_rhs._values), a_alloc)
+		{}
+
 		/// @}
 
 		/// \name Destructor
@@ -969,22 +2034,30 @@ namespace bsa::components
 
 		/// @}
 
+		/// \name Observers
+		/// @{
+
+		/// \brief	Returns the allocator the container allocates from.
+		[[nodiscard]] allocator_type get_allocator() const noexcept { return _values.get_allocator(); }
+
+		/// @}
+
 		/// \name Iterators
 		/// @{
 
 		/// \brief	Obtains an interator to the beginning of the container.
-		[[nodiscard]] iterator begin() noexcept { return _map.begin(); }
+		[[nodiscard]] iterator begin() noexcept { return _values.begin(); }
 		/// \copybrief begin()
-		[[nodiscard]] const_iterator begin() const noexcept { return _map.begin(); }
+		[[nodiscard]] const_iterator begin() const noexcept { return _values.begin(); }
 		/// \copybrief begin()
-		[[nodiscard]] const_iterator cbegin() const noexcept { return _map.cbegin(); }
+		[[nodiscard]] const_iterator cbegin() const noexcept { return _values.cbegin(); }
 
 		/// \brief	Obtains an iterator to the end of the container.
-		[[nodiscard]] iterator end() noexcept { return _map.end(); }
+		[[nodiscard]] iterator end() noexcept { return _values.end(); }
 		/// \copybrief end()
-		[[nodiscard]] const_iterator end() const noexcept { return _map.end(); }
+		[[nodiscard]] const_iterator end() const noexcept { return _values.end(); }
 		/// \copybrief end()
-		[[nodiscard]] const_iterator cend() const noexcept { return _map.cend(); }
+		[[nodiscard]] const_iterator cend() const noexcept { return _values.cend(); }
 
 		/// @}
 
@@ -995,22 +2068,78 @@ namespace bsa::components
 		///		proxy depends on the presence of the key within the container.
 		[[nodiscard]] index operator[](const key_type& a_key) noexcept
 		{
-			const auto it = _map.find(a_key);
-			return it != _map.end() ? index{ it->second } : index{};
+			const auto it = this->find(a_key);
+			return it != _values.end() ? index{ it->second } : index{};
 		}
 
 		/// \copybrief operator[]()
 		[[nodiscard]] const_index operator[](const key_type& a_key) const noexcept
 		{
-			const auto it = _map.find(a_key);
-			return it != _map.end() ? const_index{ it->second } : const_index{};
+			const auto it = this->find(a_key);
+			return it != _values.end() ? const_index{ it->second } : const_index{};
+		}
+
+		/// \copybrief operator[]()
+		/// \remark	The path is hashed directly, without constructing (or allocating) a key.
+		template <class String>
+		[[nodiscard]] index operator[](String&& a_path) noexcept  //
+			requires(std::convertible_to<String, std::string_view>)
+		{
+			return (*this)[key_type{ key_type::hash_of(a_path) }];
+		}
+
+		/// \copybrief operator[]()
+		/// \remark	The path is hashed directly, without constructing (or allocating) a key.
+		template <class String>
+		[[nodiscard]] const_index operator[](String&& a_path) const noexcept  //
+			requires(std::convertible_to<String, std::string_view>)
+		{
+			return (*this)[key_type{ key_type::hash_of(a_path) }];
 		}
 
 		/// \brief	Finds a `value_type` with the given key within the container.
-		[[nodiscard]] iterator find(const key_type& a_key) noexcept { return _map.find(a_key); }
+		[[nodiscard]] iterator find(const key_type& a_key) noexcept
+		{
+#ifdef BSA_FLAT_HASHMAP
+			const auto pos = this->lower_bound(a_key.hash());
+			return this->matches(pos, a_key.hash()) ?
+			           _values.begin() + static_cast<std::ptrdiff_t>(pos) :
+			           _values.end();
+#else
+			return _values.find(a_key);
+#endif
+		}
+
+		/// \copybrief find()
+		[[nodiscard]] const_iterator find(const key_type& a_key) const noexcept
+		{
+#ifdef BSA_FLAT_HASHMAP
+			const auto pos = this->lower_bound(a_key.hash());
+			return this->matches(pos, a_key.hash()) ?
+			           _values.begin() + static_cast<std::ptrdiff_t>(pos) :
+			           _values.end();
+#else
+			return _values.find(a_key);
+#endif
+		}
+
+		/// \copybrief find()
+		/// \remark	The path is hashed directly, without constructing (or allocating) a key.
+		template <class String>
+		[[nodiscard]] iterator find(String&& a_path) noexcept  //
+			requires(std::convertible_to<String, std::string_view>)
+		{
+			return this->find(key_type{ key_type::hash_of(a_path) });
+		}
 
 		/// \copybrief find()
-		[[nodiscard]] const_iterator find(const key_type& a_key) const noexcept { return _map.find(a_key); }
+		/// \remark	The path is hashed directly, without constructing (or allocating) a key.
+		template <class String>
+		[[nodiscard]] const_iterator find(String&& a_path) const noexcept  //
+			requires(std::convertible_to<String, std::string_view>)
+		{
+			return this->find(key_type{ key_type::hash_of(a_path) });
+		}
 
 		/// @}
 
@@ -1022,9 +2151,13 @@ namespace bsa::components
 		/// \return	Returns `true` if the element was successfully deleted, `false` otherwise.
 		bool erase(const key_type& a_key) noexcept
 		{
-			const auto it = _map.find(a_key);
-			if (it != _map.end()) {
-				_map.erase(it);
+			const auto it = this->find(a_key);
+			if (it != _values.end()) {
+#ifdef BSA_FLAT_HASHMAP
+				this->erase_at(static_cast<std::size_t>(it - _values.begin()));
+#else
+				_values.erase(it);
+#endif
 				return true;
 			} else {
 				return false;
@@ -1041,25 +2174,240 @@ namespace bsa::components
 			key_type a_key,
 			mapped_type a_value) noexcept
 		{
-			return _map.emplace(std::move(a_key), std::move(a_value));
+#ifdef BSA_FLAT_HASHMAP
+			const auto hash = a_key.hash();
+			const auto pos = this->lower_bound(hash);
+			if (this->matches(pos, hash)) {
+				return { _values.begin() + static_cast<std::ptrdiff_t>(pos), false };
+			}
+
+			this->emplace_at(pos, std::move(a_key), std::move(a_value));
+			_hashes.insert(_hashes.begin() + static_cast<std::ptrdiff_t>(pos), hash);
+			return { _values.begin() + static_cast<std::ptrdiff_t>(pos), true };
+#else
+			return _values.emplace(std::move(a_key), std::move(a_value));
+#endif
 		}
 
 		/// @}
 
 #ifndef DOXYGEN
 	protected:
-		void clear() noexcept { _map.clear(); }
+		template <class, bool>
+		friend class hashmap;
+
+		void clear() noexcept
+		{
+			_values.clear();
+#	ifdef BSA_FLAT_HASHMAP
+			_hashes.clear();
+#	endif
+		}
+
+		// Copies the name of every key which does not view its name into the arena, including
+		//	the keys of nested containers, without changing any key. The views are appended to
+		//	`a_names` in the order `repoint_keys` visits the keys.
+		void stage_keys(
+			detail::string_arena& a_arena,
+			std::vector<std::string_view>& a_names) const
+		{
+			for (const auto& [key, value] : _values) {
+				if (!key.viewed()) {
+					a_names.push_back(key.stage(a_arena));
+				}
+				if constexpr (RECURSE) {
+					value.stage_keys(a_arena, a_names);
+				}
+			}
+		}
+
+		// Repoints every key staged by `stage_keys` at the name it was staged into.
+		void repoint_keys(const std::string_view*& a_names) const noexcept
+		{
+			for (const auto& [key, value] : _values) {
+				if (!key.viewed()) {
+					key.repoint(*a_names++);
+				}
+				if constexpr (RECURSE) {
+					value.repoint_keys(a_names);
+				}
+			}
+		}
+
+		// Interns every key into a new arena, which takes over from the arena in `a_names`.
+		//	The old arena is kept alive only while some key may still view it, and none is made
+		//	when there is nothing to intern, so repeated calls never chain arenas together.
+		void intern_keys(std::shared_ptr<const detail::string_arena>& a_names) const
+		{
+			const auto [viewed, owned] = this->count_keys();
+			if (viewed == 0) {
+				a_names.reset();
+			}
+			if (owned == 0) {
+				return;
+			}
+
+			// every key is staged before any is repointed, so if staging throws, no key is left
+			//	viewing an arena which is about to be destroyed
+			detail::string_arena arena;
+			arena.retain(a_names);  // keys interned before ignore the new arena
+			std::vector<std::string_view> names;
+			names.reserve(owned);
+			this->stage_keys(arena, names);
+			arena.seal();
+			auto shared = std::make_shared<const detail::string_arena>(std::move(arena));
+
+			const std::string_view* name = names.data();
+			this->repoint_keys(name);
+			a_names = std::move(shared);
+		}
+
+		// Counts the keys which view a name held elsewhere, and the keys which hold their own.
+		[[nodiscard]] auto count_keys() const noexcept
+			-> std::pair<std::size_t, std::size_t>
+		{
+			std::pair<std::size_t, std::size_t> result;
+			for (const auto& [key, value] : _values) {
+				++(key.views_name() ? result.first : result.second);
+				if constexpr (RECURSE) {
+					const auto [viewed, owned] = value.count_keys();
+					result.first += viewed;
+					result.second += owned;
+				}
+			}
+			return result;
+		}
+
+		// Bulk loading, for use when reading archives:
+		//	1. bulk_insert every element, in any order.
+		//	2. bulk_finalize once all elements have been inserted.
+		// The container must not be searched in between, and all keys must be unique.
+
+		void bulk_reserve([[maybe_unused]] std::size_t a_count) noexcept
+		{
+#	ifdef BSA_FLAT_HASHMAP
+			_values.reserve(_values.size() + a_count);
+			_hashes.reserve(_hashes.size() + a_count);
+#	endif
+		}
+
+		value_type& bulk_insert(
+			key_type a_key,
+			mapped_type a_value) noexcept
+		{
+#	ifdef BSA_FLAT_HASHMAP
+			_hashes.push_back(a_key.hash());
+			return _values.emplace_back(std::move(a_key), std::move(a_value));
+#	else
+			return *_values.emplace_hint(
+				_values.end(),
+				std::move(a_key),
+				std::move(a_value));
+#	endif
+		}
+
+		void bulk_finalize() noexcept
+		{
+#	ifdef BSA_FLAT_HASHMAP
+			const auto unordered = std::adjacent_find(
+				_hashes.begin(),
+				_hashes.end(),
+				[](const hash_type& a_lhs, const hash_type& a_rhs) noexcept {
+					return !(a_lhs < a_rhs);
+				});
+			if (unordered == _hashes.end()) {
+				return;
+			}
+
+			std::vector<std::size_t> order(_values.size());
+			for (std::size_t i = 0; i < order.size(); ++i) {
+				order[i] = i;
+			}
+			std::stable_sort(
+				order.begin(),
+				order.end(),
+				[&](std::size_t a_lhs, std::size_t a_rhs) noexcept {
+					return _hashes[a_lhs] < _hashes[a_rhs];
+				});
+
+			// duplicates keep the first element inserted, same as insert
+			container_type values(_values.get_allocator());
+			std::pmr::vector<hash_type> hashes(_hashes.get_allocator());
+			values.reserve(_values.size());
+			hashes.reserve(_hashes.size());
+			for (const auto i : order) {
+				if (hashes.empty() || hashes.back() != _hashes[i]) {
+					hashes.push_back(_hashes[i]);
+					values.emplace_back(std::move(_values[i]));
+				}
+			}
+			_values.swap(values);
+			_hashes.swap(hashes);
+#	endif
+		}
 #endif
 
 	private:
-		container_type _map;
+#ifdef BSA_FLAT_HASHMAP
+		[[nodiscard]] std::size_t lower_bound(const hash_type& a_hash) const noexcept
+		{
+			const auto it = std::lower_bound(_hashes.begin(), _hashes.end(), a_hash);
+			return static_cast<std::size_t>(it - _hashes.begin());
+		}
+
+		[[nodiscard]] bool matches(
+			std::size_t a_pos,
+			const hash_type& a_hash) const noexcept
+		{
+			return a_pos < _hashes.size() && _hashes[a_pos] == a_hash;
+		}
+
+		// elements can't be assigned, so they are shuffled by replacing them in place
+
+		void emplace_at(
+			std::size_t a_pos,
+			key_type&& a_key,
+			mapped_type&& a_value) noexcept
+		{
+			if (_values.size() == _values.capacity()) {
+				_values.reserve(_values.size() * 2 + 1);
+			}
+
+			if (a_pos == _values.size()) {
+				_values.emplace_back(std::move(a_key), std::move(a_value));
+				return;
+			}
+
+			_values.emplace_back(std::move(_values.back()));
+			for (auto i = _values.size() - 2; i > a_pos; --i) {
+				std::destroy_at(&_values[i]);
+				std::construct_at(&_values[i], std::move(_values[i - 1]));
+			}
+			std::destroy_at(&_values[a_pos]);
+			std::construct_at(&_values[a_pos], std::move(a_key), std::move(a_value));
+		}
+
+		void erase_at(std::size_t a_pos) noexcept
+		{
+			for (auto i = a_pos; i + 1 < _values.size(); ++i) {
+				std::destroy_at(&_values[i]);
+				std::construct_at(&_values[i], std::move(_values[i + 1]));
+			}
+			_values.pop_back();
+			_hashes.erase(_hashes.begin() + static_cast<std::ptrdiff_t>(a_pos));
+		}
+
+		std::pmr::vector<hash_type> _hashes;
+#endif
+		container_type _values;
 	};
 
 	/// \brief	A generic key used to uniquely identify an object inside the virtual filesystem.
 	///
 	/// \tparam	Hash	The hash type used as the underlying key.
 	/// \tparam	Hasher	The function used to generate the hash.
-	template <class Hash, hasher_t<Hash> Hasher>
+	/// \tparam	ViewHasher	The function used to generate the hash without allocating.
+	template <class Hash, hasher_t<Hash> Hasher, view_hasher_t<Hash> ViewHasher>
 	class key final
 	{
 	public:
@@ -1152,6 +2500,13 @@ namespace bsa::components
 		/// \brief	Retrieve a reference to the underlying hash.
 		[[nodiscard]] const hash_type& hash() const noexcept { return _hash; }
 
+		/// \brief	Produces the hash a key constructed from `a_string` would have, without
+		///		allocating.
+		[[nodiscard]] static hash_type hash_of(std::string_view a_string) noexcept
+		{
+			return ViewHasher(a_string);
+		}
+
 		/// \brief	Retrieve the name that generated the underlying hash.
 		[[nodiscard]] std::string_view name() const noexcept
 		{
@@ -1171,9 +2526,14 @@ namespace bsa::components
 
 	private:
 #ifndef DOXYGEN
+		template <class, bool>
+		friend class hashmap;
+
 		friend fo4::archive;
+		friend fo4::lazy_archive;
 		friend tes3::archive;
 		friend tes4::archive;
+		friend tes4::lazy_archive;
 #endif
 
 		enum : std::size_t
@@ -1203,8 +2563,44 @@ namespace bsa::components
 			}
 		}
 
+		// Checks if the name views storage held elsewhere, such as the arena it was interned into.
+		[[nodiscard]] bool views_name() const noexcept
+		{
+			const auto name = std::get_if<name_view>(&_name);
+			return name && !name->empty();
+		}
+
+		// Checks if the name is a view, i.e. there is nothing for an arena to take over.
+		[[nodiscard]] bool viewed() const noexcept { return _name.index() == name_view; }
+
+		// Makes the arena hold the name, returning the view the key should be repointed at. The
+		//	key itself is left untouched, so nothing dangles if this throws.
+		[[nodiscard]] auto stage(detail::string_arena& a_arena) const
+			-> std::string_view
+		{
+			switch (_name.index()) {
+			case name_owner:
+				return a_arena.intern(*std::get_if<name_owner>(&_name));
+			case name_proxied:
+				{
+					const auto& [name, file] = *std::get_if<name_proxied>(&_name);
+					a_arena.retain(file);
+					return name;
+				}
+			default:
+				detail::declare_unreachable();
+			}
+		}
+
+		// Repoints the name at the view it was staged into, freeing whatever storage the key held
+		//	on its own. The name itself is unchanged, so neither is the key.
+		void repoint(std::string_view a_name) const noexcept
+		{
+			_name.emplace<name_view>(a_name);
+		}
+
 		hash_type _hash;
-		std::variant<
+		mutable std::variant<  // interning repoints the name, without changing it
 			std::string_view,
 			std::string,
 			name_proxy>
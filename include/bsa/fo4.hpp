@@ -1,14 +1,21 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <compare>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <memory_resource>
 #include <optional>
 #include <span>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -126,16 +133,121 @@ namespace bsa::fo4
 				-> detail::ostream_t&;
 #endif
 		};
+	}
+
+#ifndef DOXYGEN
+	namespace detail
+	{
+		// A table driven crc, for when the path is only known at runtime.
+		[[nodiscard]] auto crc32_sliced(std::string_view a_string) noexcept
+			-> std::uint32_t;
+
+		[[nodiscard]] constexpr auto crc32(std::string_view a_string) noexcept
+			-> std::uint32_t
+		{
+			if (std::is_constant_evaluated()) {
+				std::uint32_t result = 0;
+				for (const auto ch : a_string) {
+					result ^= std::uint32_t{ static_cast<unsigned char>(ch) };
+					for (std::size_t i = 0; i < 8; ++i) {
+						result = (result >> 1u) ^ (0xEDB88320u & (0u - (result & 1u)));
+					}
+				}
+				return result;
+			} else {
+				return crc32_sliced(a_string);
+			}
+		}
+
+		struct split_t
+		{
+			std::string_view parent;
+			std::string_view stem;
+			std::string_view extension;
+		};
+
+		[[nodiscard]] constexpr auto split_path(std::string_view a_path) noexcept
+			-> split_t
+		{
+			const auto find = [&](char a_ch) noexcept {
+				const auto pos = a_path.find_last_of(a_ch);
+				return pos != std::string_view::npos ?
+				           std::optional{ pos } :
+				           std::nullopt;
+			};
+
+			split_t result;
+			const auto pstem = find('\\');
+			const auto pextension = find('.');
+
+			if (pstem) {
+				result.parent = a_path.substr(0, *pstem);
+			}
+
+			if (pextension) {
+				result.extension = a_path.substr(*pextension + 1);  // don't include '.'
+			}
+
+			const auto first = pstem ? *pstem + 1 : 0;
+			const auto last = pextension ?
+			                      *pextension - first :
+			                      pextension.value_or(std::string_view::npos);
+			result.stem = a_path.substr(first, last);
+
+			return result;
+		}
+
+		// Hashes a path which has already been normalized.
+		[[nodiscard]] constexpr auto hash_normalized(std::string_view a_path) noexcept
+			-> hashing::hash
+		{
+			const auto pieces = split_path(a_path);
+
+			hashing::hash h;
+			h.directory = crc32(pieces.parent);
+			h.file = crc32(pieces.stem);
 
+			const auto len = std::min<std::size_t>(pieces.extension.length(), 4u);
+			for (std::size_t i = 0; i < len; ++i) {
+				h.extension |=
+					std::uint32_t{ static_cast<unsigned char>(pieces.extension[i]) }
+					<< i * 8u;
+			}
+
+			return h;
+		}
+	}
+#endif
+
+	namespace hashing
+	{
 		/// \copydoc bsa::tes3::hashing::hash_file_in_place()
 		[[nodiscard]] hash hash_file_in_place(std::string& a_path) noexcept;
 
+		/// \copydoc bsa::tes3::hashing::hash_file(std::string_view)
+		[[nodiscard]] constexpr hash hash_file(std::string_view a_path) noexcept
+		{
+			std::array<char, detail::max_path> buffer;
+			return detail::hash_normalized(detail::normalize_path(a_path, buffer));
+		}
+
 		/// \copydoc bsa::tes3::hashing::hash_file()
 		template <concepts::stringable String>
-		[[nodiscard]] hash hash_file(String&& a_path) noexcept
+		[[nodiscard]] constexpr hash hash_file(String&& a_path) noexcept
+		{
+			if constexpr (std::convertible_to<String, std::string_view>) {
+				return hash_file(std::string_view{ a_path });
+			} else {
+				std::string str(std::forward<String>(a_path));
+				return hash_file_in_place(str);
+			}
+		}
+
+		/// \copydoc bsa::tes3::hashing::hash_file_many()
+		template <concepts::stringable_range Range>
+		[[nodiscard]] std::vector<hash> hash_file_many(Range&& a_paths)
 		{
-			std::string str(std::forward<String>(a_path));
-			return hash_file_in_place(str);
+			return detail::hash_many<hash>(std::forward<Range>(a_paths), hash_file_in_place);
 		}
 	}
 
@@ -148,15 +260,20 @@ namespace bsa::fo4
 		friend file;
 		using super = components::compressed_byte_container;
 
-		[[nodiscard]] std::size_t compress_into_lz4(std::span<std::byte> a_out) const;
+		[[nodiscard]] std::size_t compress_into_lz4(
+			std::span<std::byte> a_out,
+			codec_context& a_context) const;
 		[[nodiscard]] std::size_t compress_into_zlib(
 			std::span<std::byte> a_out,
+			codec_context& a_context,
 			int a_level,
 			int a_windowBits,
 			int a_memLevel) const;
 
 		void decompress_into_lz4(std::span<std::byte> a_out) const;
-		void decompress_into_zlib(std::span<std::byte> a_out) const;
+		void decompress_into_zlib(
+			std::span<std::byte> a_out,
+			codec_context& a_context) const;
 
 	public:
 		/// \brief	Common parameters to configure how chunks are compressed.
@@ -193,6 +310,9 @@ namespace bsa::fo4
 
 			/// \brief	The level to compress the data at.
 			compression_level compression_level_{ compression_level::fo4 };
+
+			/// \brief	When to skip compressing the data.
+			compression_policy compression_policy_{};
 		};
 
 		/// \brief	Unique to \ref format::directx.
@@ -241,6 +361,14 @@ namespace bsa::fo4
 			std::span<std::byte> a_out,
 			const compression_params& a_params) const;
 
+		/// \copydoc compress_into(std::span<std::byte>, const compression_params&) const
+		///
+		/// \param	a_context	The context to reuse compression state from.
+		[[nodiscard]] std::size_t compress_into(
+			std::span<std::byte> a_out,
+			const compression_params& a_params,
+			codec_context& a_context) const;
+
 		/// @}
 
 		/// \name Decompression
@@ -258,6 +386,20 @@ namespace bsa::fo4
 			std::span<std::byte> a_out,
 			compression_format a_format) const;
 
+		/// \copydoc decompress_into(std::span<std::byte>, compression_format) const
+		///
+		/// \param	a_context	The context to reuse decompression state from.
+		void decompress_into(
+			std::span<std::byte> a_out,
+			compression_format a_format,
+			codec_context& a_context) const;
+
+		/// \copydoc bsa::doxygen_detail::open_stream
+		///
+		/// \param	a_format	The format the data is currently compressed in.
+		[[nodiscard]] auto open_stream(compression_format a_format) const
+			-> decompression_stream;
+
 		/// @}
 
 		/// \name Modifiers
@@ -277,7 +419,7 @@ namespace bsa::fo4
 	class file final
 	{
 	private:
-		using container_type = std::vector<chunk>;
+		using container_type = std::pmr::vector<chunk>;
 
 	public:
 		/// \brief	Common parameters to configure how files are read.
@@ -349,6 +491,9 @@ namespace bsa::fo4
 
 			/// \brief	The resulting compression of the file read.
 			compression_type compression_type_{ compression_type::decompressed };
+
+			/// \brief	When to skip compressing each chunk of the file.
+			compression_policy compression_policy_{};
 		};
 
 		/// \brief	Common parameters to configure how files are written.
@@ -428,9 +573,10 @@ namespace bsa::fo4
 #endif
 		using iterator = container_type::iterator;
 		using const_iterator = container_type::const_iterator;
+		using allocator_type = std::pmr::polymorphic_allocator<>;
 
 		/// \brief	The key used to indentify a file.
-		using key = components::key<hashing::hash, hashing::hash_file_in_place>;
+		using key = components::key<hashing::hash, hashing::hash_file_in_place, hashing::hash_file>;
 
 		/// @}
 
@@ -462,13 +608,48 @@ namespace bsa::fo4
 
 		/// @}
 
+		/// \name Observers
+		/// @{
+
+		/// \brief	Returns the allocator the file allocates its chunks from.
+		[[nodiscard]] allocator_type get_allocator() const noexcept { return _chunks.get_allocator(); }
+
+		/// @}
+
 		/// \name Constructors
 		/// @{
 
-		file() noexcept = default;
-		file(const file&) noexcept = default;
+		/// \brief	Constructs an empty file, which allocates from \ref get_memory_resource.
+		file() noexcept :
+			file(allocator_type{ get_memory_resource() })
+		{}
+
+		/// \brief	Constructs an empty file, which allocates from the given allocator.
+		explicit file(const allocator_type& a_alloc) noexcept :
+			_chunks(a_alloc)
+		{}
+
+		/// \brief	Copies the given file, allocating from \ref get_memory_resource.
+		file(const file& a_rhs) noexcept :
+			file(a_rhs, allocator_type{ get_memory_resource() })
+		{}
+
+		/// \brief	Copies the given file, allocating from the given allocator.
+		file(const file& a_rhs, const allocator_type& a_alloc) noexcept :
+			header(a_rhs.header),
+			_chunks(a_rhs._chunks, a_alloc)
+		{}
+
+		/// \brief	Takes the chunks of the given file, along with its allocator.
 		file(file&&) noexcept = default;
 
+		/// \brief	Takes the chunks of the given file, allocating from the given allocator.
+		///		The chunks are moved one at a time if the allocators differ.
+		file(file&& a_rhs, const allocator_type& a_alloc) noexcept :
+			header(a_rhs.header),
+			_chunks(std::move(a_rhs._chunks), a_alloc)
+		{}
+
 		/// @}
 
 		/// \name Destructors
@@ -554,6 +735,20 @@ namespace bsa::fo4
 
 		/// @}
 
+		/// \name Prefetching
+		/// @{
+
+		/// \brief	Asks the operating system to start paging in the data of every chunk, ahead
+		///		of reading them.
+		void prefetch() const noexcept
+		{
+			for (const auto& chunk : _chunks) {
+				chunk.prefetch();
+			}
+		}
+
+		/// @}
+
 		/// \name Reading
 		/// @{
 
@@ -576,6 +771,84 @@ namespace bsa::fo4
 			write_sink a_sink,
 			const write_params& a_params) const;
 
+		/// \brief	Writes the file into the given buffer, exactly as \ref write would write it.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		/// \exception	bsa::exception	Thrown when the dds header can not be encoded.
+		///
+		/// \pre	`a_out` *must* be exactly \ref written_size bytes long.
+		///
+		/// \param	a_out	The buffer to write the file into.
+		/// \param	a_params	Extra configuration options.
+		void write_into(
+			std::span<std::byte> a_out,
+			const write_params& a_params) const;
+
+		/// \brief	Returns the number of bytes \ref write would write.
+		///
+		/// \exception	bsa::exception	Thrown when the dds header can not be encoded.
+		///
+		/// \param	a_params	Extra configuration options.
+		[[nodiscard]] std::size_t written_size(const write_params& a_params) const;
+
+		/// \brief	Writes a dds containing only the given mips of the file, as if the first
+		///		requested mip were the top level of the texture.
+		/// \details	Only the chunks holding the requested mips are decompressed.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		/// \exception	bsa::exception	Thrown when the mips are out of bounds, or the dds header
+		///		can not be encoded.
+		///
+		/// \param	a_sink	The sink to write to.
+		/// \param	a_mips	The range of mips to write, inclusive.
+		/// \param	a_format	The format the chunks are compressed in.
+		void write_mips(
+			write_sink a_sink,
+			chunk::mips_t a_mips,
+			compression_format a_format) const;
+
+		/// @}
+
+		/// \name Partial reads
+		/// @{
+
+		/// \brief	Reads the pixels of the given mips of a \ref format::directx file.
+		/// \details	Only the chunks holding the requested mips are decompressed. Pixels are
+		///		laid out as a dds would lay them out: every mip in ascending order, for each
+		///		face of a cubemap.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		/// \exception	bsa::exception	Thrown when the mips are out of bounds, or the chunks of
+		///		the file do not match its header.
+		///
+		/// \param	a_mips	The range of mips to read, inclusive.
+		/// \param	a_format	The format the chunks are compressed in.
+		/// \return	The pixels of the requested mips.
+		[[nodiscard]] auto read_mips(
+			chunk::mips_t a_mips,
+			compression_format a_format) const
+			-> std::vector<std::byte>;
+
+		/// \brief	Reads a range of bytes from the file, exactly as \ref format::general would
+		///		write them.
+		/// \details	Only the chunks overlapping the range are decompressed.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		///
+		/// \param	a_offset	The offset of the first byte to read.
+		/// \param	a_out	The buffer to read into.
+		/// \param	a_format	The format the chunks are compressed in.
+		/// \return	The number of bytes read, which is less than `a_out.size()` only when the
+		///		range extends past the end of the file.
+		std::size_t read_range(
+			std::size_t a_offset,
+			std::span<std::byte> a_out,
+			compression_format a_format) const;
+
 		/// @}
 
 	private:
@@ -653,15 +926,69 @@ namespace bsa::fo4
 			bool strings{ true };
 		};
 
+		/// \name Compression
+		/// @{
+
+		/// \brief	Compresses every chunk in the archive which is not already compressed.
+		///
+		/// \details	Chunks are distributed across a pool of threads, but each one is compressed
+		///		exactly as \ref chunk::compress would compress it, so the results are identical to
+		///		compressing every chunk serially.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered. The explanation is prefixed with the path of the offending file.
+		///
+		/// \param	a_params	Extra configuration options.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		///
+		/// \remark	If a compression error is thrown, then the offending chunk is left unchanged,
+		///		though any other chunk may or may not have been compressed.
+		void compress_all(
+			const chunk::compression_params& a_params,
+			std::size_t a_threads = 0);
+
+		/// \brief	Converts every chunk from one compression format to another, e.g. before
+		///		writing the archive as a different version.
+		///
+		/// \details	Chunks already compressed with the target's format are passed through
+		///		byte-for-byte, since the version of an archive does not change how its chunks
+		///		are encoded. The rest are decompressed and compressed again across a pool of
+		///		threads.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered. The explanation is prefixed with the path of the offending file.
+		///
+		/// \param	a_from	The compression format the chunks are currently compressed with.
+		/// \param	a_to	The compression format to convert the chunks to.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		///
+		/// \return	A report of which chunks were passed through, and which were transcoded.
+		///
+		/// \remark	If a compression error is thrown, then the offending chunk is left unchanged,
+		///		though any other chunk may or may not have been transcoded.
+		auto transcode(
+			compression_format a_from,
+			const chunk::compression_params& a_to,
+			std::size_t a_threads = 0)
+			-> transcode_report;
+
+		/// @}
+
 		/// \name Modifiers
 		/// @{
 
-#ifdef DOXYGEN
 		/// \brief	Clears the contents of the archive.
-		void clear() noexcept;
-#else
-		using super::clear;
-#endif
+		void clear() noexcept
+		{
+			super::clear();
+			_names.reset();
+			_generation = detail::next_generation();
+		}
+
+		/// \copydoc bsa::tes3::archive::intern_names
+		void intern_names();
 
 		/// @}
 
@@ -673,11 +1000,100 @@ namespace bsa::fo4
 		/// \return	Meta info read from the archive.
 		meta_info read(read_source a_source);
 
+		/// \brief	Reads the given archive, decoding its records across a pool of threads.
+		///
+		/// \details	The file records and the string table are walked once up front, to find
+		///		where each entry begins, which only touches the few bytes that lay them out.
+		///		Every record, name, and key is then decoded in parallel, and merged into the
+		///		archive in order, so the result is identical to \ref read(read_source).
+		///
+		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
+		/// \exception	bsa::exception	Thrown when archive parsing errors are encountered.
+		///
+		/// \param	a_source	Where/how to read the given archive.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		/// \return	Meta info read from the archive.
+		///
+		/// \remark	This pays off for archives with many thousands of entries. Smaller archives
+		///		are read just as quickly by \ref read(read_source).
+		/// \remark	If any exception is thrown, the object is left in an unspecified state.
+		///		Use clear to return it to a valid state.
+		meta_info read(
+			read_source a_source,
+			std::size_t a_threads);
+
+		/// \brief	Reads a batch of files from disk across a pool of threads, and inserts
+		///		them into the archive.
+		///
+		/// \details	Each file is read, chunked, and compressed (if requested) exactly as
+		///		\ref file::read would, so the results are identical to reading every file
+		///		serially. Every stage of a single file runs on the same thread, so parsing one
+		///		texture overlaps with compressing the chunks of another.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		/// \exception	bsa::exception	Thrown when a file is malformed.
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered. The explanation is prefixed with the path of the offending file.
+		///
+		/// \param	a_files	The keys to insert each file at, paired with the path to read it from.
+		/// \param	a_params	Configuration options for reading each file.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		/// \return	The number of files inserted. Files whose key already exists in the archive
+		///		are not inserted.
+		///
+		/// \remark	If any exception is thrown, then the archive is left unchanged.
+		std::size_t read_files(
+			std::span<const std::pair<key_type, std::filesystem::path>> a_files,
+			const file::read_params& a_params,
+			std::size_t a_threads = 0);
+
+		/// @}
+
+		/// \name Verification
+		/// @{
+
+		/// \brief	Verifies the integrity of every chunk in the archive.
+		///
+		/// \details	Chunks are decompressed across a pool of threads into scratch buffers,
+		///		which are reused between chunks and freed before returning, so no decompressed
+		///		data is kept around. The hash of every named file is checked against its name,
+		///		and every size is checked to fit the fields it is written to.
+		///
+		/// \param	a_format	The compression format the chunks were compressed with.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		///
+		/// \return	A report of every check which failed.
+		[[nodiscard]] auto verify(
+			compression_format a_format,
+			std::size_t a_threads = 0) const
+			-> verify_report;
+
 		/// @}
 
 		/// \name Writing
 		/// @{
 
+		/// \brief	Extra configuration options for writing archives.
+		struct write_params final
+		{
+			/// \brief	Writes the data of chunks with identical contents only once, and points
+			///		each of their records at the shared copy.
+			bool deduplicate{ false };
+
+			/// \brief	The order to lay out the data of files in, e.g. the order in which they were
+			///		observed being accessed.
+			///
+			/// \details	Only the chunk data is reordered, since the records must stay sorted by
+			///		their hashes. Files are laid out in the order they first appear here, followed by
+			///		every file not listed, in the order of their records. The chunks of each file
+			///		stay together, in order. Entries which do not name a file in the archive are
+			///		ignored.
+			std::span<const key_type> data_order{};
+		};
+
 		/// \copydoc bsa::tes3::archive::write
 		///
 		/// \param	a_meta	Configuration options for how the archive is written.
@@ -685,32 +1101,662 @@ namespace bsa::fo4
 			write_sink a_sink,
 			const meta_info& a_meta) const;
 
+		/// \copydoc bsa::fo4::archive::write(write_sink, const meta_info&) const
+		///
+		/// \param	a_params	Extra configuration options.
+		void write(
+			write_sink a_sink,
+			const meta_info& a_meta,
+			const write_params& a_params) const;
+
+		/// \brief	Writes the archive to disk through a memory mapping.
+		///
+		/// \details	Every offset is known before any data is written, so the output file is
+		///		sized up front and mapped. The header and file records are written serially, then
+		///		the data of each chunk is copied into its own region of the mapping across a pool
+		///		of threads. The result is identical to \ref write.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		///
+		/// \param	a_path	The path to write the archive to.
+		/// \param	a_meta	Configuration options for how the archive is written.
+		/// \param	a_params	Extra configuration options.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		///
+		/// \remark	Chunks are written as they are, so compress them beforehand (e.g. with
+		///		\ref compress_all), since their compressed sizes decide where everything goes.
+		void write_mapped(
+			const std::filesystem::path& a_path,
+			const meta_info& a_meta,
+			const write_params& a_params,
+			std::size_t a_threads = 0) const;
+
+		/// @}
+
+		/// \name Extraction
+		/// @{
+
+		/// \copydoc bsa::tes4::archive::extract_all
+		void extract_all(
+			const std::filesystem::path& a_root,
+			const file::write_params& a_params,
+			std::size_t a_threads = 0) const;
+
+		/// @}
+
+		/// \name Caching
+		/// @{
+
+		/// \brief	Returns the contents of a file, exactly as \ref file::write would write them,
+		///		through a cache, decompressing them only when they are not already cached.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		/// \exception	bsa::exception	Thrown when the dds header can not be encoded.
+		///
+		/// \param	a_cache	The cache to look the contents up in.
+		/// \param	a_file	The key of the file.
+		/// \param	a_params	Configuration options for writing the file.
+		/// \return	The contents of the file, or `nullptr` if no such file exists.
+		///
+		/// \remark	Contents cached before the archive was last read or cleared are never
+		///		served again, but they do stay cached after a file is modified, so \ref
+		///		content_cache::clear "clear" the cache after changing any file.
+		[[nodiscard]] auto decompress_cached(
+			content_cache& a_cache,
+			const key_type& a_file,
+			const file::write_params& a_params) const
+			-> content_cache::contents_type;
+
 		/// @}
 
 	private:
-		[[nodiscard]] auto make_header(const meta_info& a_meta) const
+		friend lazy_archive;
+		friend patch;
+		friend stream_writer;
+
+		// Where the data of every chunk goes, indexed in the order of their records
+		struct layout_t final
+		{
+			std::vector<const chunk*> chunks;
+			std::vector<std::size_t> order;  // the chunks whose data is written, in the order it's written
+			std::vector<std::uint64_t> offsets;
+		};
+
+		[[nodiscard]] auto make_header(
+			const meta_info& a_meta,
+			std::span<const std::size_t> a_shared) const
 			-> std::pair<detail::header_t, std::uint64_t>;
 
-		void read_chunk(
+		[[nodiscard]] auto share_chunk_data() const
+			-> std::vector<std::size_t>;
+
+		[[nodiscard]] auto make_layout(
+			std::span<const std::size_t> a_shared,
+			std::uint64_t a_dataOffset,
+			std::span<const key_type> a_order) const
+			-> layout_t;
+
+		static void read_chunk(
 			chunk& a_chunk,
 			detail::istream_t& a_in,
 			format a_format);
 
-		void read_file(
+		static void read_file(
 			file& a_file,
 			detail::istream_t& a_in,
 			format a_format);
 
-		void write_chunk(
+		static void write_chunk(
 			const chunk& a_chunk,
 			detail::ostream_t& a_out,
 			format a_format,
-			std::uint64_t& a_dataOffset) const noexcept;
+			std::uint64_t& a_dataOffset) noexcept;
 
-		void write_file(
+		static void write_file(
 			const file& a_file,
 			detail::ostream_t& a_out,
 			format a_format,
-			std::uint64_t& a_dataOffset) const noexcept;
+			std::uint64_t& a_dataOffset) noexcept;
+
+		static void write_file_header(
+			const file& a_file,
+			detail::ostream_t& a_out,
+			format a_format) noexcept;
+
+		void write_records(
+			detail::ostream_t& a_out,
+			format a_format,
+			std::span<const std::uint64_t> a_offsets) const noexcept;
+
+		void write_strings(detail::ostream_t& a_out) const noexcept;
+
+		std::shared_ptr<const detail::string_arena> _names;
+		std::uint64_t _generation{ detail::next_generation() };  // identifies the contents for caching
+	};
+
+	/// \brief	A read-only index over a FO4 archive, which defers decoding files until they
+	///		are looked up.
+	///
+	/// \details	Reading a lazy archive parses only the header and the hash of each file
+	///		record, so opening one stays cheap no matter how many files the archive contains.
+	///		A file is decoded from the source the first time it is looked up, and is cached
+	///		from then on.
+	///
+	/// \remark	Lookups modify the cache, and so must be externally synchronized.
+	class lazy_archive final
+	{
+	public:
+		/// \name Member types
+		/// @{
+
+		using key_type = archive::key_type;
+		using mapped_type = archive::mapped_type;
+		using const_index = archive::const_index;
+		using meta_info = archive::meta_info;
+
+		/// @}
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Checks if the indexed archive contains no files.
+		[[nodiscard]] bool empty() const noexcept { return _records.empty(); }
+
+		/// \brief	Returns the number of files in the indexed archive.
+		[[nodiscard]] std::size_t size() const noexcept { return _records.size(); }
+
+		/// @}
+
+		/// \name Lookup
+		/// @{
+
+		/// \brief	Returns the files which have been decoded so far.
+		[[nodiscard]] const archive& cache() const noexcept { return _cache; }
+
+		/// \brief	Finds the file with the given key, decoding it from the source if it has
+		///		not been looked up before.
+		///
+		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
+		/// \exception	bsa::exception	Thrown when the file record is malformed.
+		///
+		/// \param	a_key	The key of the file to look up.
+		/// \return	A proxy to the decoded file, which is empty if no such file exists.
+		///
+		/// \remark	The string table is never read, so a decoded file takes its name from
+		///		`a_key`.
+		[[nodiscard]] const_index lookup(const key_type& a_key);
+
+		/// @}
+
+		/// \name Modifiers
+		/// @{
+
+		/// \brief	Releases the source, and clears the index and the cache.
+		void clear() noexcept;
+
+		/// @}
+
+		/// \name Reading
+		/// @{
+
+		/// \brief	Indexes the contents of the source.
+		///
+		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
+		/// \exception	bsa::exception	Thrown when the archive header or a file record
+		///		is malformed.
+		///
+		/// \param	a_source	The source to index. Files are read from it on demand, so
+		///		\ref copy_type::shallow "shallow" sources must outlive the lazy archive.
+		/// \return	Meta info read from the archive.
+		///
+		/// \remark	If any exception is thrown, the object is left in an unspecified state.
+		///		Use clear to return it to a valid state.
+		meta_info read(read_source a_source);
+
+		/// \brief	Indexes the archive at the given path, reusing a sidecar index if possible.
+		///
+		/// \details	If `a_cache` holds an index built from this archive in its current state
+		///		(as identified by its path, size, and last write time), then the index is loaded
+		///		from it and none of the archive's records are parsed. Otherwise, the archive is
+		///		indexed as usual, and a fresh sidecar is written to `a_cache`.
+		///
+		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
+		/// \exception	bsa::exception	Thrown when the archive header or a file record
+		///		is malformed.
+		/// \exception	std::system_error	Thrown when the sidecar could not be written.
+		///
+		/// \param	a_path	The path to the archive to index.
+		/// \param	a_cache	The path to the sidecar index.
+		/// \return	Meta info read from the archive.
+		///
+		/// \remark	Sidecars store their contents in native byte order and sizes, so they
+		///		should not be shared between machines.
+		/// \remark	If any exception is thrown, the object is left in an unspecified state.
+		///		Use clear to return it to a valid state.
+		meta_info read(
+			const std::filesystem::path& a_path,
+			const std::filesystem::path& a_cache);
+
+		/// @}
+
+	private:
+		struct record_t final
+		{
+			hashing::hash hash;
+			std::size_t offset{ 0 };
+		};
+
+		archive _cache;
+		std::vector<record_t> _records;
+		detail::shared_source _source;
+		format _format{ format::general };
+	};
+
+	/// \brief	Writes a FO4 archive without holding the contents of every file in memory.
+	///
+	/// \details	Only the key of each file and its chunk count are needed to lay out the
+	///		header and the file records. The contents of each file are then pulled from its
+	///		source one at a time as the file data is written, so peak memory usage is bounded
+	///		by the largest single file instead of the whole archive. The file records are
+	///		patched once the final size of each chunk is known, so the sink must be seekable.
+	class stream_writer final
+	{
+	public:
+		/// \name Member types
+		/// @{
+
+		using key_type = archive::key_type;
+		using meta_info = archive::meta_info;
+
+		/// \brief	Produces the contents of a file, as it is about to be written.
+		using source_type = std::function<file()>;
+
+		/// @}
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Checks if no files have been added to the writer.
+		[[nodiscard]] bool empty() const noexcept { return _files.empty(); }
+
+		/// \brief	Returns the number of files added to the writer.
+		[[nodiscard]] std::size_t size() const noexcept { return _files.size(); }
+
+		/// @}
+
+		/// \name Modifiers
+		/// @{
+
+		/// \brief	Removes every file.
+		void clear() noexcept { _files.clear(); }
+
+		/// \brief	Adds a file, whose contents will be pulled from `a_source` when they are
+		///		written.
+		///
+		/// \param	a_key	The key of the file.
+		/// \param	a_source	The source of the file's contents.
+		/// \param	a_chunks	The number of chunks the source produces, or `0` if it is not
+		///		known ahead of time. Sources with an unknown chunk count are invoked an extra
+		///		time while laying out the archive.
+		/// \return	`true` if the file was added, `false` if the file already exists.
+		bool insert(
+			key_type a_key,
+			source_type a_source,
+			std::size_t a_chunks = 0);
+
+		/// \brief	Adds a file, whose contents will be read from `a_path` when they are
+		///		written.
+		///
+		/// \param	a_key	The key of the file.
+		/// \param	a_path	The path to read the file's contents from.
+		/// \param	a_params	Configuration options for reading the file.
+		/// \return	`true` if the file was added, `false` if the file already exists.
+		bool insert(
+			key_type a_key,
+			std::filesystem::path a_path,
+			const file::read_params& a_params);
+
+		/// @}
+
+		/// \name Writing
+		/// @{
+
+		/// \brief	Writes the archive to the given sink, pulling each file from its source.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		/// \exception	binary_io::buffer_exhausted	Thrown when the output buffer is exhausted.
+		/// \exception	bsa::exception	Thrown when a source produces a different number of
+		///		chunks than it was laid out with.
+		///
+		/// \param	a_sink	The seekable sink to write the archive to.
+		/// \param	a_meta	Configuration options for how the archive is written.
+		///
+		/// \remark	Any exception thrown by a source is propagated, and leaves the sink in an
+		///		unspecified state.
+		void write(
+			write_sink a_sink,
+			const meta_info& a_meta) const;
+
+		/// @}
+
+	private:
+		struct entry_t final
+		{
+			source_type source;
+			std::size_t chunks{ 0 };
+		};
+
+		std::map<key_type, entry_t> _files;
+	};
+
+	/// \brief	Updates an archive on disk in place, without rewriting the whole archive.
+	///
+	/// \details	Only the file records of an archive reference its file data, so new and
+	///		replaced files are appended to the end of the archive, and the header, file records,
+	///		and string table are rewritten in front of and behind the existing data. The cost of
+	///		a commit is proportional to the changed data, not to the size of the archive.
+	///		Space held by erased or replaced files is left in place, and can be reclaimed by
+	///		\ref compact "compacting" the archive.
+	/// \remark	Changes are staged in memory, and are only applied to the archive on disk by
+	///		\ref commit. An interrupted commit leaves the archive in an unspecified state.
+	class updater final
+	{
+	public:
+		/// \name Member types
+		/// @{
+
+		using key_type = archive::key_type;
+		using meta_info = archive::meta_info;
+
+		/// @}
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Checks if the archive contains no files.
+		[[nodiscard]] bool empty() const noexcept { return this->size() == 0; }
+
+		/// \brief	Returns the number of files in the archive, including staged changes.
+		[[nodiscard]] std::size_t size() const noexcept { return _index.size(); }
+
+		/// \brief	Returns the number of bytes in the archive on disk which are no longer
+		///		referenced by any file.
+		[[nodiscard]] std::uint64_t dead_bytes() const noexcept { return _dead; }
+
+		/// @}
+
+		/// \name Lookup
+		/// @{
+
+		/// \brief	Checks if the archive contains the given file, including staged changes.
+		[[nodiscard]] bool contains(const key_type& a_key) const noexcept
+		{
+			return _index.contains(a_key.hash());
+		}
+
+		/// @}
+
+		/// \name Modifiers
+		/// @{
+
+		/// \brief	Discards every staged change, and closes the archive.
+		void clear() noexcept;
+
+		/// \brief	Stages a file to be added to the archive, replacing any file with the
+		///		same key.
+		///
+		/// \exception	bsa::exception	Thrown when the file has more chunks than an archive can
+		///		hold.
+		///
+		/// \param	a_key	The key of the file.
+		/// \param	a_file	The file to add. Its chunks are written as they are, so they *must*
+		///		already be compressed (or not) as the archive expects. Its contents are not
+		///		copied, so they *must* outlive the next \ref commit, and *must not* view the
+		///		archive being updated.
+		/// \return	`true` if the file was added, `false` if an existing file was replaced.
+		bool insert_or_assign(key_type a_key, file a_file);
+
+		/// \brief	Stages a file to be erased from the archive.
+		///
+		/// \param	a_key	The key of the file to erase.
+		/// \return	`true` if the file was erased, `false` if no such file exists.
+		bool erase(const key_type& a_key) noexcept;
+
+		/// @}
+
+		/// \name Reading
+		/// @{
+
+		/// \brief	Opens the archive at the given path for updating.
+		/// \details	Only the header, file records, and string table are read.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
+		/// \exception	bsa::exception	Thrown when the archive header or a file record
+		///		is malformed.
+		///
+		/// \param	a_path	The path to the archive to update.
+		/// \return	Meta info read from the archive.
+		///
+		/// \remark	If any exception is thrown, the object is left in an unspecified state.
+		///		Use clear to return it to a valid state.
+		meta_info open(std::filesystem::path a_path);
+
+		/// @}
+
+		/// \name Writing
+		/// @{
+
+		/// \brief	Applies every staged change to the archive on disk.
+		/// \details	File data is only ever moved when the file records grow into it, in which
+		///		case just the overlapped chunks are moved to the end of the archive.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		/// \exception	bsa::exception	Thrown when no archive is open, or the archive can not
+		///		be written to.
+		void commit();
+
+		/// \brief	Commits every staged change, and then rewrites the archive without any
+		///		\ref dead_bytes "dead bytes".
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		/// \exception	bsa::exception	Thrown when no archive is open, or the archive can not
+		///		be written to.
+		void compact();
+
+		/// @}
+
+	private:
+		struct chunk_t final
+		{
+			std::uint64_t offset{ 0 };
+			std::uint32_t compressed_size{ 0 };
+			std::uint32_t decompressed_size{ 0 };
+			chunk::mips_t mips;
+		};
+
+		struct entry_t final
+		{
+			hashing::hash hash;
+			std::string name;
+			file::header_t header;
+			std::vector<chunk_t> chunks;
+			std::optional<file> pending;
+			bool erased{ false };
+		};
+
+		[[nodiscard]] auto live_size() const noexcept -> std::uint64_t;
+		[[nodiscard]] auto records_size() const noexcept -> std::uint64_t;
+
+		std::filesystem::path _path;
+		meta_info _meta;
+		std::vector<entry_t> _entries;
+		std::map<hashing::hash, std::size_t> _index;
+		std::uint64_t _dead{ 0 };
+	};
+
+	/// \brief	The changes which turn one version of an archive into the next, which can be
+	///		shipped in place of the whole of the newer version.
+	///
+	/// \details	Files are compared by their keys, and then by their contents, so a patch holds
+	///		only the files which were added or replaced, exactly as they are stored in the newer
+	///		archive (i.e. still compressed), along with the keys of the files which were erased.
+	///		Alongside them is a manifest which lists every file of the newer archive with a
+	///		checksum of its contents, which is used to reject patches which were corrupted, or
+	///		which are applied to the wrong archive.
+	///
+	///	\code{.cpp}
+	///	// on the server
+	///	bsa::fo4::patch patch;
+	///	patch.diff(previous, current);
+	///	patch.write(path, meta);
+	///
+	///	// on the client
+	///	bsa::fo4::patch patch;
+	///	patch.read(path);
+	///	bsa::fo4::updater updater;
+	///	updater.open(archive);
+	///	patch.apply(updater);
+	///	updater.commit();
+	///	\endcode
+	class patch final
+	{
+	public:
+		/// \name Member types
+		/// @{
+
+		using key_type = archive::key_type;
+		using meta_info = archive::meta_info;
+
+		/// @}
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Checks if the patch changes nothing.
+		[[nodiscard]] bool empty() const noexcept { return _files.empty() && _erased.empty(); }
+
+		/// \brief	Returns the number of files in the archive once the patch is applied.
+		[[nodiscard]] std::size_t target_size() const noexcept { return _manifest.size(); }
+
+		/// @}
+
+		/// \name Observers
+		/// @{
+
+		/// \brief	Returns the files which are added or replaced by the patch.
+		[[nodiscard]] const archive& files() const noexcept { return _files; }
+
+		/// \brief	Returns the hashes of the files which are erased by the patch.
+		[[nodiscard]] std::span<const hashing::hash> erased() const noexcept { return _erased; }
+
+		/// @}
+
+		/// \name Modifiers
+		/// @{
+
+		/// \brief	Clears the contents of the patch.
+		void clear() noexcept;
+
+		/// \brief	Records the changes which turn one archive into another.
+		///
+		/// \details	Every file of `a_to` is checksummed for the manifest, and compared against
+		///		the file with the same key in `a_from`, across a pool of threads.
+		///
+		/// \param	a_from	The older version of the archive.
+		/// \param	a_to	The newer version of the archive.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		///
+		/// \remark	The files of the patch are copied from `a_to`, so they view its contents
+		///		just as any other copy of its files would.
+		void diff(
+			const archive& a_from,
+			const archive& a_to,
+			std::size_t a_threads = 0);
+
+		/// @}
+
+		/// \name Applying
+		/// @{
+
+		/// \brief	Applies the patch to an archive in memory.
+		///
+		/// \exception	bsa::exception	Thrown when the archive is not the one the patch was made
+		///		from, in which case the archive is left unchanged.
+		///
+		/// \param	a_archive	The archive to patch.
+		/// \param	a_threads	The maximum number of threads to use, to checksum the files which
+		///		the patch leaves untouched. `0` uses `std::thread::hardware_concurrency()`.
+		///
+		/// \remark	The files inserted into the archive view the contents of the patch, so
+		///		they must not outlive the source the patch was read from.
+		void apply(
+			archive& a_archive,
+			std::size_t a_threads = 0) const;
+
+		/// \brief	Stages the patch onto an archive on disk.
+		///
+		/// \details	Only the files of the patch are written once the updater commits, which
+		///		passes them through as they are, so the archive is only ever rewritten where it
+		///		changed. The files the patch leaves untouched are never read.
+		///
+		/// \exception	bsa::exception	Thrown when the archive does not contain the files which
+		///		the patch expects, in which case nothing is staged.
+		///
+		/// \param	a_updater	The updater to stage the patch onto. The meta info it was opened
+		///		with should match the meta info the patch was read with.
+		///
+		/// \remark	The patch must outlive the next \ref updater::commit.
+		void apply(updater& a_updater) const;
+
+		/// @}
+
+		/// \name Reading
+		/// @{
+
+		/// \brief	Reads a patch.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
+		/// \exception	bsa::exception	Thrown when the patch is malformed, or when the
+		///		checksum of a file does not match the manifest.
+		///
+		/// \param	a_source	Where/how to read the given patch.
+		/// \return	Meta info of the archive the patch is applied to.
+		///
+		/// \remark	If any exception is thrown, the object is left in an unspecified state.
+		///		Use clear to return it to a valid state.
+		meta_info read(read_source a_source);
+
+		/// @}
+
+		/// \name Writing
+		/// @{
+
+		/// \brief	Writes the patch.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		///
+		/// \param	a_sink	Where/how to write the patch.
+		/// \param	a_meta	Meta info of the archive the patch is applied to.
+		void write(
+			write_sink a_sink,
+			const meta_info& a_meta) const;
+
+		/// @}
+
+	private:
+		struct entry_t final
+		{
+			hashing::hash hash;
+			std::uint32_t checksum{ 0 };
+		};
+
+		archive _files;
+		std::vector<hashing::hash> _erased;
+		std::vector<entry_t> _manifest;  // every file of the newer archive, in the order of its records
 	};
 }
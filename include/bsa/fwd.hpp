@@ -7,8 +7,12 @@ namespace bsa
 #ifndef DOXYGEN
 	namespace detail
 	{
+		class async_file;
+		class codec_state;
 		class istream_t;
 		class restore_point;
+		class shared_source;
+		class string_arena;
 
 		template <class T>
 		struct istream_proxy;
@@ -27,7 +31,10 @@ namespace bsa
 		template <class Hash>
 		using hasher_t = Hash (*)(std::string&) noexcept;
 
-		template <class Hash, hasher_t<Hash>>
+		template <class Hash>
+		using view_hasher_t = Hash (*)(std::string_view) noexcept;
+
+		template <class Hash, hasher_t<Hash>, view_hasher_t<Hash>>
 		class key;
 	}
 
@@ -50,6 +57,10 @@ namespace bsa
 		class archive;
 		class chunk;
 		class file;
+		class lazy_archive;
+		class patch;
+		class stream_writer;
+		class updater;
 	}
 
 	namespace tes3
@@ -67,6 +78,7 @@ namespace bsa
 		}
 
 		class archive;
+		class archive_view;
 		class file;
 	}
 
@@ -87,15 +99,29 @@ namespace bsa
 		class archive;
 		class directory;
 		class file;
+		class lazy_archive;
+		class stream_writer;
 
 		enum class archive_flag : std::uint32_t;
 		enum class archive_type : std::uint16_t;
 		enum class version : std::uint32_t;
 	}
 
+	namespace vfs
+	{
+		class overlay;
+	}
+
+	class codec_context;
+	class content_cache;
 	class exception;
+	class observer;
+
+	struct transcode_report;
+	struct verify_report;
 
 	enum class copy_type;
 	enum class compression_type;
+	enum class deflate_backend;
 	enum class file_format;
 }
@@ -1,12 +1,18 @@
 #pragma once
 
+#include <array>
+#include <bit>
 #include <compare>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include <span>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include <binary_io/any_stream.hpp>
 
@@ -35,7 +41,7 @@ namespace bsa::tes3
 
 			[[nodiscard]] friend bool operator==(const hash&, const hash&) noexcept = default;
 
-			[[nodiscard]] friend std::strong_ordering operator<=>(
+			[[nodiscard]] friend constexpr std::strong_ordering operator<=>(
 				const hash& a_lhs,
 				const hash& a_rhs) noexcept
 			{
@@ -48,7 +54,7 @@ namespace bsa::tes3
 			/// @{
 
 			/// \brief	Obtains the numeric value of the hash used for comparisons.
-			[[nodiscard]] std::uint64_t numeric() const noexcept
+			[[nodiscard]] constexpr std::uint64_t numeric() const noexcept
 			{
 				return std::uint64_t{
 					std::uint64_t{ hi } << 0u * 8u |
@@ -70,19 +76,82 @@ namespace bsa::tes3
 				-> detail::ostream_t&;
 #endif
 		};
+	}
+
+#ifndef DOXYGEN
+	namespace detail
+	{
+		// Hashes a path which has already been normalized.
+		[[nodiscard]] constexpr auto hash_normalized(std::string_view a_path) noexcept
+			-> hashing::hash
+		{
+			hashing::hash h;
+
+			const std::size_t midpoint = a_path.length() / 2u;
+			std::size_t i = 0;
+			for (; midpoint - i >= 4; i += 4) {
+				// equivalent to 4 iterations of the loop below
+				h.lo ^= std::uint32_t{ static_cast<unsigned char>(a_path[i]) } |
+				        std::uint32_t{ static_cast<unsigned char>(a_path[i + 1]) } << 8u |
+				        std::uint32_t{ static_cast<unsigned char>(a_path[i + 2]) } << 16u |
+				        std::uint32_t{ static_cast<unsigned char>(a_path[i + 3]) } << 24u;
+			}
+			for (; i < midpoint; ++i) {
+				// rotate between first 4 bytes
+				h.lo ^= std::uint32_t{ static_cast<unsigned char>(a_path[i]) }
+				        << ((i % 4u) * 8u);
+			}
+
+			for (std::uint32_t rot = 0; i < a_path.length(); ++i) {
+				// rotate between last 4 bytes
+				rot = std::uint32_t{ static_cast<unsigned char>(a_path[i]) }
+				      << (((i - midpoint) % 4u) * 8u);
+				h.hi = std::rotr(h.hi ^ rot, static_cast<int>(rot));
+			}
+
+			return h;
+		}
+	}
+#endif
 
+	namespace hashing
+	{
 		/// \brief	Produces a hash using the given path.
 		/// \remark	The path is normalized in place. After the function returns,
 		///		the path contains the string that would be stored on disk.
 		[[nodiscard]] hash hash_file_in_place(std::string& a_path) noexcept;
 
+		/// \copybrief	hash_file_in_place()
+		/// \remark	The path is normalized into a buffer on the stack, so nothing is allocated.
+		/// \remark	Usable in constant expressions, so the hashes of paths known ahead of time
+		///		can be computed at compile time.
+		[[nodiscard]] constexpr hash hash_file(std::string_view a_path) noexcept
+		{
+			std::array<char, detail::max_path> buffer;
+			return detail::hash_normalized(detail::normalize_path(a_path, buffer));
+		}
+
 		/// \copybrief	hash_file_in_place()
 		/// \remark	See also \ref bsa::concepts::stringable.
 		template <concepts::stringable String>
-		[[nodiscard]] hash hash_file(String&& a_path) noexcept
+		[[nodiscard]] constexpr hash hash_file(String&& a_path) noexcept
+		{
+			if constexpr (std::convertible_to<String, std::string_view>) {
+				return hash_file(std::string_view{ a_path });
+			} else {
+				std::string str(std::forward<String>(a_path));
+				return hash_file_in_place(str);
+			}
+		}
+
+		/// \brief	Produces a hash for each path in the given range.
+		/// \remark	Equivalent to calling \ref hash_file() on each path, but reuses a single
+		///		buffer to normalize every path in the range.
+		/// \remark	See also \ref bsa::concepts::stringable_range.
+		template <concepts::stringable_range Range>
+		[[nodiscard]] std::vector<hash> hash_file_many(Range&& a_paths)
 		{
-			std::string str(std::forward<String>(a_path));
-			return hash_file_in_place(str);
+			return detail::hash_many<hash>(std::forward<Range>(a_paths), hash_file_in_place);
 		}
 	}
 
@@ -99,7 +168,7 @@ namespace bsa::tes3
 		/// @{
 
 		/// \brief	The key used to indentify a file.
-		using key = components::key<hashing::hash, hashing::hash_file_in_place>;
+		using key = components::key<hashing::hash, hashing::hash_file_in_place, hashing::hash_file>;
 
 		/// @}
 
@@ -147,12 +216,24 @@ namespace bsa::tes3
 		/// \name Modifiers
 		/// @{
 
-#ifdef DOXYGEN
 		/// \brief	Clears the contents of the archive.
-		void clear() noexcept;
-#else
-		using super::clear;
-#endif
+		void clear() noexcept
+		{
+			super::clear();
+			_names.reset();
+		}
+
+		/// \brief	Moves the names of every key into storage shared by the whole archive.
+		///
+		/// \details	Names which were read from a mapped archive already point into its
+		///		mapping, which the archive then retains once, rather than every key retaining it
+		///		on its own. Every other name is copied into a single pooled arena, which stores
+		///		identical names only once, and frees the allocation each key held.
+		///
+		/// \remark	Keys copied from the archive refer to its shared storage, so they must not
+		///		outlive the archive (or any copy of it). Keys inserted later are not interned until
+		///		this is called again.
+		void intern_names();
 
 		/// @}
 
@@ -203,5 +284,130 @@ namespace bsa::tes3
 		void write_file_names(detail::ostream_t& a_out) const noexcept;
 		void write_file_hashes(detail::ostream_t& a_out) const noexcept;
 		void write_file_data(detail::ostream_t& a_out) const noexcept;
+
+		std::shared_ptr<const detail::string_arena> _names;
+	};
+
+	/// \brief	A read-only view of a TES3 archive, which looks files up directly in its
+	///		on-disk hash table.
+	///
+	/// \details	Nothing is decoded when the archive is read: only the header is parsed, and
+	///		the bounds of its tables are checked. Each lookup then binary searches the sorted
+	///		hash table in place, and returns the contents of the file as a span of the source,
+	///		so nothing is allocated after the archive has been read.
+	///
+	/// \remark	Archives written by this library (and the vanilla game) sort their hash
+	///		tables. Files in an archive whose hash table is not sorted may not be found.
+	class archive_view final
+	{
+	public:
+		/// \name Member types
+		/// @{
+
+		using key_type = archive::key_type;
+
+		/// @}
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Checks if the viewed archive contains no files.
+		[[nodiscard]] bool empty() const noexcept { return _count == 0; }
+
+		/// \brief	Returns the number of files in the viewed archive.
+		[[nodiscard]] std::size_t size() const noexcept { return _count; }
+
+		/// @}
+
+		/// \name Lookup
+		/// @{
+
+		/// \brief	Checks if the viewed archive contains a file with the given hash.
+		[[nodiscard]] bool contains(const hashing::hash& a_hash) const noexcept
+		{
+			return this->search(a_hash).has_value();
+		}
+
+		/// \copybrief contains()
+		[[nodiscard]] bool contains(const key_type& a_key) const noexcept
+		{
+			return this->contains(a_key.hash());
+		}
+
+		/// \copybrief contains()
+		/// \remark	The path is hashed directly, without constructing (or allocating) a key.
+		template <class String>
+		[[nodiscard]] bool contains(String&& a_path) const noexcept  //
+			requires(std::convertible_to<String, std::string_view>)
+		{
+			return this->contains(key_type::hash_of(a_path));
+		}
+
+		/// \brief	Finds the contents of the file with the given hash.
+		///
+		/// \exception	bsa::exception	Thrown when the contents of the file lie outside of the
+		///		archive.
+		///
+		/// \param	a_hash	The hash of the file to look up.
+		/// \return	A view of the contents of the file, or nothing if no such file exists.
+		///
+		/// \remark	The view aliases the source, so it must not outlive it (or, if the
+		///		source was a file, the archive view).
+		[[nodiscard]] auto find(const hashing::hash& a_hash) const
+			-> std::optional<std::span<const std::byte>>;
+
+		/// \copydoc find()
+		[[nodiscard]] auto find(const key_type& a_key) const
+			-> std::optional<std::span<const std::byte>>
+		{
+			return this->find(a_key.hash());
+		}
+
+		/// \copydoc find()
+		/// \remark	The path is hashed directly, without constructing (or allocating) a key.
+		template <class String>
+		[[nodiscard]] auto find(String&& a_path) const
+			-> std::optional<std::span<const std::byte>>  //
+			requires(std::convertible_to<String, std::string_view>)
+		{
+			return this->find(key_type::hash_of(a_path));
+		}
+
+		/// @}
+
+		/// \name Modifiers
+		/// @{
+
+		/// \brief	Releases the source, and forgets the viewed archive.
+		void clear() noexcept;
+
+		/// @}
+
+		/// \name Reading
+		/// @{
+
+		/// \brief	Views the archive held by the source.
+		///
+		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
+		/// \exception	bsa::exception	Thrown when archive parsing errors are encountered.
+		///
+		/// \param	a_source	The source to view. Files are never copied out of it, so
+		///		\ref copy_type::shallow "shallow" sources must outlive the archive view, and
+		///		\ref copy_type::deep "deep" sources are copied once, up front.
+		///
+		/// \remark	If any exception is thrown, the object is left in an unspecified state.
+		///		Use clear to return it to a valid state.
+		void read(read_source a_source);
+
+		/// @}
+
+	private:
+		[[nodiscard]] auto search(const hashing::hash& a_hash) const noexcept
+			-> std::optional<std::size_t>;
+
+		detail::shared_source _source;
+		std::size_t _count{ 0 };
+		std::size_t _hashes{ 0 };
+		std::size_t _data{ 0 };
 	};
 }
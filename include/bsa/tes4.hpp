@@ -1,9 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <compare>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
 #include <optional>
 #include <span>
 #include <string>
@@ -152,7 +158,7 @@ namespace bsa::tes4
 
 			[[nodiscard]] friend bool operator==(const hash&, const hash&) noexcept = default;
 
-			[[nodiscard]] friend std::strong_ordering operator<=>(
+			[[nodiscard]] friend constexpr std::strong_ordering operator<=>(
 				const hash& a_lhs,
 				const hash& a_rhs) noexcept
 			{
@@ -165,7 +171,7 @@ namespace bsa::tes4
 			/// @{
 
 			/// \copybrief bsa::tes3::hashing::hash
-			[[nodiscard]] std::uint64_t numeric() const noexcept
+			[[nodiscard]] constexpr std::uint64_t numeric() const noexcept
 			{
 				return std::uint64_t{
 					std::uint64_t{ last } << 0u * 8u |
@@ -182,6 +188,7 @@ namespace bsa::tes4
 #ifndef DOXYGEN
 			friend tes4::archive;
 			friend tes4::directory;
+			friend tes4::lazy_archive;
 #endif
 
 			void read(
@@ -192,27 +199,173 @@ namespace bsa::tes4
 				detail::ostream_t& a_out,
 				std::endian a_endian) const noexcept;
 		};
+	}
+
+#ifndef DOXYGEN
+	namespace detail
+	{
+		[[nodiscard]] constexpr auto crc32(std::string_view a_string) noexcept
+			-> std::uint32_t
+		{
+			constexpr auto constant = std::uint32_t{ 0x1003Fu };
+			constexpr auto constant2 = constant * constant;
+			constexpr auto constant3 = constant2 * constant;
+			constexpr auto constant4 = constant3 * constant;
+
+			// unrolled by 4, which breaks up the serial dependency on `crc`:
+			//	crc' = crc * k^4 + c0 * k^3 + c1 * k^2 + c2 * k + c3 (mod 2^32)
+			const auto byte = [&](std::size_t a_idx) noexcept {
+				return std::uint32_t{ static_cast<std::uint8_t>(a_string[a_idx]) };
+			};
+
+			std::uint32_t crc = 0;
+			std::size_t i = 0;
+			for (; a_string.size() - i >= 4; i += 4) {
+				crc = crc * constant4 +
+				      byte(i) * constant3 +
+				      byte(i + 1) * constant2 +
+				      byte(i + 2) * constant +
+				      byte(i + 3);
+			}
+			for (; i < a_string.size(); ++i) {
+				crc = byte(i) + crc * constant;
+			}
+			return crc;
+		}
 
+		// Hashes a directory which has already been normalized.
+		[[nodiscard]] constexpr auto hash_directory_normalized(std::string_view a_path) noexcept
+			-> hashing::hash
+		{
+			hashing::hash h;
+
+			switch (std::min<std::size_t>(a_path.size(), 3)) {
+			case 3:
+				h.last2 = static_cast<std::uint8_t>(*(a_path.end() - 2));
+				[[fallthrough]];
+			case 2:
+			case 1:
+				h.last = static_cast<std::uint8_t>(a_path.back());
+				h.first = static_cast<std::uint8_t>(a_path.front());
+				[[fallthrough]];
+			default:
+				break;
+			}
+
+			h.length = static_cast<std::uint8_t>(a_path.size());
+			if (h.length > 3) {
+				// skip first and last two chars -> already processed
+				h.crc = crc32(a_path.substr(1, a_path.size() - 3));
+			}
+
+			return h;
+		}
+
+		// Hashes a file which has already been normalized, and stripped of its parent path.
+		[[nodiscard]] constexpr auto hash_file_normalized(std::string_view a_path) noexcept
+			-> hashing::hash
+		{
+			const std::array lut{
+				make_four_cc(""sv),
+				make_four_cc(".nif"sv),
+				make_four_cc(".kf"sv),
+				make_four_cc(".dds"sv),
+				make_four_cc(".wav"sv),
+				make_four_cc(".adp"sv),
+			};
+
+			const auto split = a_path.find_last_of('.');
+			const auto stem = a_path.substr(0, split);
+			const auto extension =
+				split != std::string_view::npos ?
+					a_path.substr(split) :
+					std::string_view{};
+
+			if (!stem.empty() &&
+				stem.length() < max_path &&
+				extension.length() < 16) {
+				// the stem is already normalized, and has no slashes left to trim
+				auto h = hash_directory_normalized(stem);
+				h.crc += crc32(extension);
+
+				const auto it = std::find(
+					lut.begin(),
+					lut.end(),
+					make_four_cc(extension));
+				if (it != lut.end()) {
+					const auto i = static_cast<std::uint8_t>(it - lut.begin());
+					h.first += 32u * (i & 0xFCu);
+					h.last += (i & 0xFEu) << 6u;
+					h.last2 += i << 7u;
+				}
+
+				return h;
+			} else {
+				return {};
+			}
+		}
+	}
+#endif
+
+	namespace hashing
+	{
 		/// \copydoc bsa::tes3::hashing::hash_file_in_place()
 		[[nodiscard]] hash hash_directory_in_place(std::string& a_path) noexcept;
 
+		/// \copydoc bsa::tes3::hashing::hash_file(std::string_view)
+		[[nodiscard]] constexpr hash hash_directory(std::string_view a_path) noexcept
+		{
+			std::array<char, detail::max_path> buffer;
+			return detail::hash_directory_normalized(detail::normalize_path(a_path, buffer));
+		}
+
 		/// \copydoc bsa::tes3::hashing::hash_file()
 		template <concepts::stringable String>
-		[[nodiscard]] hash hash_directory(String&& a_path) noexcept
+		[[nodiscard]] constexpr hash hash_directory(String&& a_path) noexcept
 		{
-			std::string str(std::forward<String>(a_path));
-			return hash_directory_in_place(str);
+			if constexpr (std::convertible_to<String, std::string_view>) {
+				return hash_directory(std::string_view{ a_path });
+			} else {
+				std::string str(std::forward<String>(a_path));
+				return hash_directory_in_place(str);
+			}
+		}
+
+		/// \copydoc bsa::tes3::hashing::hash_file_many()
+		template <concepts::stringable_range Range>
+		[[nodiscard]] std::vector<hash> hash_directory_many(Range&& a_paths)
+		{
+			return detail::hash_many<hash>(std::forward<Range>(a_paths), hash_directory_in_place);
 		}
 
 		/// \copydoc bsa::tes3::hashing::hash_file_in_place()
 		[[nodiscard]] hash hash_file_in_place(std::string& a_path) noexcept;
 
+		/// \copydoc bsa::tes3::hashing::hash_file(std::string_view)
+		[[nodiscard]] constexpr hash hash_file(std::string_view a_path) noexcept
+		{
+			std::array<char, detail::max_path> buffer;
+			const auto path = detail::normalize_path(a_path, buffer);
+			return detail::hash_file_normalized(path.substr(path.find_last_of('\\') + 1));
+		}
+
 		/// \copydoc bsa::tes3::hashing::hash_file()
 		template <concepts::stringable String>
-		[[nodiscard]] hash hash_file(String&& a_path) noexcept
+		[[nodiscard]] constexpr hash hash_file(String&& a_path) noexcept
+		{
+			if constexpr (std::convertible_to<String, std::string_view>) {
+				return hash_file(std::string_view{ a_path });
+			} else {
+				std::string str(std::forward<String>(a_path));
+				return hash_file_in_place(str);
+			}
+		}
+
+		/// \copydoc bsa::tes3::hashing::hash_file_many()
+		template <concepts::stringable_range Range>
+		[[nodiscard]] std::vector<hash> hash_file_many(Range&& a_paths)
 		{
-			std::string str(std::forward<String>(a_path));
-			return hash_file_in_place(str);
+			return detail::hash_many<hash>(std::forward<Range>(a_paths), hash_file_in_place);
 		}
 	}
 
@@ -222,6 +375,8 @@ namespace bsa::tes4
 	{
 	private:
 		friend archive;
+		friend lazy_archive;
+		friend stream_writer;
 		using super = components::compressed_byte_container;
 
 	public:
@@ -257,6 +412,11 @@ namespace bsa::tes4
 
 			/// \brief	The codec to use.
 			compression_codec compression_codec_{ compression_codec::normal };
+
+			/// \brief	When to skip compressing the file.
+			/// \remark	Data which would not shrink enough is only abandoned when compressing
+			///		with \ref compression_codec::normal.
+			compression_policy compression_policy_{};
 		};
 
 		/// \brief	Common parameters to configure how files are read.
@@ -298,6 +458,9 @@ namespace bsa::tes4
 
 			/// \brief	The resulting compression of the file read.
 			compression_type compression_type_{ compression_type::decompressed };
+
+			/// \copydoc compression_params::compression_policy_
+			compression_policy compression_policy_{};
 		};
 
 		/// \brief	Common parameters to configure how files are written.
@@ -338,7 +501,7 @@ namespace bsa::tes4
 		/// @{
 
 		/// \brief	The key used to indentify a file.
-		using key = components::key<hashing::hash, hashing::hash_file_in_place>;
+		using key = components::key<hashing::hash, hashing::hash_file_in_place, hashing::hash_file>;
 
 		/// @}
 
@@ -362,6 +525,14 @@ namespace bsa::tes4
 			std::span<std::byte> a_out,
 			const compression_params& a_params) const;
 
+		/// \copydoc compress_into(std::span<std::byte>, const compression_params&) const
+		///
+		/// \param	a_context	The context to reuse compression state from.
+		[[nodiscard]] std::size_t compress_into(
+			std::span<std::byte> a_out,
+			const compression_params& a_params,
+			codec_context& a_context) const;
+
 		/// @}
 
 		/// \name Decompression
@@ -379,6 +550,23 @@ namespace bsa::tes4
 			std::span<std::byte> a_out,
 			const compression_params& a_params) const;
 
+		/// \copydoc decompress_into(std::span<std::byte>, const compression_params&) const
+		///
+		/// \param	a_context	The context to reuse decompression state from.
+		void decompress_into(
+			std::span<std::byte> a_out,
+			const compression_params& a_params,
+			codec_context& a_context) const;
+
+		/// \copydoc bsa::doxygen_detail::open_stream
+		///
+		/// \exception	bsa::exception	Thrown when the file is compressed with xmem, which can
+		///		not be streamed.
+		///
+		/// \param	a_params	Extra configuration options.
+		[[nodiscard]] auto open_stream(const compression_params& a_params) const
+			-> decompression_stream;
+
 		/// @}
 
 		/// \name Modifiers
@@ -428,13 +616,13 @@ namespace bsa::tes4
 
 		[[nodiscard]] auto compress_bound_xmem() const -> std::size_t;
 
-		[[nodiscard]] auto compress_into_lz4(std::span<std::byte> a_out) const -> std::size_t;
+		[[nodiscard]] auto compress_into_lz4(std::span<std::byte> a_out, codec_context& a_context) const -> std::size_t;
 		[[nodiscard]] auto compress_into_xmem(std::span<std::byte> a_out) const -> std::size_t;
-		[[nodiscard]] auto compress_into_zlib(std::span<std::byte> a_out) const -> std::size_t;
+		[[nodiscard]] auto compress_into_zlib(std::span<std::byte> a_out, codec_context& a_context) const -> std::size_t;
 
-		void decompress_into_lz4(std::span<std::byte> a_out) const;
+		void decompress_into_lz4(std::span<std::byte> a_out, codec_context& a_context) const;
 		void decompress_into_xmem(std::span<std::byte> a_out) const;
-		void decompress_into_zlib(std::span<std::byte> a_out) const;
+		void decompress_into_zlib(std::span<std::byte> a_out, codec_context& a_context) const;
 	};
 
 	/// \brief	Represents a directory within the TES4 virtual filesystem.
@@ -450,7 +638,35 @@ namespace bsa::tes4
 		/// @{
 
 		/// \brief	The key used to indentify a directory.
-		using key = components::key<hashing::hash, hashing::hash_directory_in_place>;
+		using key = components::key<hashing::hash, hashing::hash_directory_in_place, hashing::hash_directory>;
+
+		/// @}
+
+		/// \name Constructors
+		/// @{
+
+		directory() noexcept = default;
+		directory(const directory&) noexcept = default;
+		directory(directory&&) noexcept = default;
+
+#ifdef DOXYGEN
+		/// \brief	Constructs an empty directory, which allocates from the given allocator.
+		explicit directory(const allocator_type& a_alloc) noexcept;
+		/// \brief	Copies the given directory, allocating from the given allocator.
+		directory(const directory& a_rhs, const allocator_type& a_alloc) noexcept;
+		/// \brief	Takes the files of the given directory, allocating from the given allocator.
+		directory(directory&& a_rhs, const allocator_type& a_alloc) noexcept;
+#else
+		using super::super;
+#endif
+
+		/// @}
+
+		/// \name Assignment
+		/// @{
+
+		directory& operator=(const directory&) noexcept = default;
+		directory& operator=(directory&&) noexcept = default;
 
 		/// @}
 
@@ -535,6 +751,55 @@ namespace bsa::tes4
 
 		/// @}
 
+		/// \name Compression
+		/// @{
+
+		/// \brief	Compresses every file in the archive which is not already compressed.
+		///
+		/// \details	Files are distributed across a pool of threads, but each one is compressed
+		///		exactly as \ref file::compress would compress it, so the results are identical to
+		///		compressing every file serially.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered. The explanation is prefixed with the path of the offending file.
+		///
+		/// \param	a_params	Extra configuration options.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		///
+		/// \remark	If a compression error is thrown, then the offending file is left unchanged,
+		///		though any other file may or may not have been compressed.
+		void compress_all(
+			const file::compression_params& a_params,
+			std::size_t a_threads = 0);
+
+		/// \brief	Converts every file from one compression format to another, e.g. before
+		///		writing the archive as a different version.
+		///
+		/// \details	Files whose data the target format accepts as is are passed through
+		///		byte-for-byte, which is every file when both formats use the same codec. The rest
+		///		are decompressed and compressed again across a pool of threads.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered. The explanation is prefixed with the path of the offending file.
+		///
+		/// \param	a_from	The compression format the files are currently compressed with.
+		/// \param	a_to	The compression format to convert the files to.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		///
+		/// \return	A report of which files were passed through, and which were transcoded.
+		///
+		/// \remark	If a compression error is thrown, then the offending file is left unchanged,
+		///		though any other file may or may not have been transcoded.
+		auto transcode(
+			const file::compression_params& a_from,
+			const file::compression_params& a_to,
+			std::size_t a_threads = 0)
+			-> transcode_report;
+
+		/// @}
+
 		/// \name Modifiers
 		/// @{
 
@@ -542,10 +807,15 @@ namespace bsa::tes4
 		void clear() noexcept
 		{
 			super::clear();
+			_names.reset();
+			_generation = detail::next_generation();
 			_flags = archive_flag::none;
 			_types = archive_type::none;
 		}
 
+		/// \copydoc bsa::tes3::archive::intern_names
+		void intern_names();
+
 		/// @}
 
 		/// \name Reading
@@ -566,11 +836,127 @@ namespace bsa::tes4
 		/// \param	a_version	The version format to check for.
 		[[nodiscard]] bool verify_offsets(version a_version) const noexcept;
 
+		/// \brief	Verifies the integrity of every file in the archive.
+		///
+		/// \details	Files are decompressed across a pool of threads into scratch buffers,
+		///		which are reused between files and freed before returning, so no decompressed
+		///		data is kept around. The hash of every named directory and file is checked
+		///		against its name, and the offsets are checked as by \ref verify_offsets.
+		///
+		/// \param	a_params	Configuration options for decompressing each file.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		///
+		/// \return	A report of every check which failed.
+		[[nodiscard]] auto verify(
+			const file::compression_params& a_params,
+			std::size_t a_threads = 0) const
+			-> verify_report;
+
+		/// @}
+
+		/// \name Planning
+		/// @{
+
+		/// \brief	The largest offset the data of a file can be written at.
+		static constexpr std::uint64_t max_offset = (std::numeric_limits<std::int32_t>::max)();
+
+		/// \brief	A prediction of how large an archive will be once its files are compressed.
+		struct size_estimate final
+		{
+			/// \brief	Checks if the data of every file is predicted to fit within
+			///		\ref max_offset.
+			[[nodiscard]] bool fits() const noexcept { return last_offset <= max_offset; }
+
+			/// \brief	The predicted offset of the data of the last file.
+			std::uint64_t last_offset{ 0 };
+
+			/// \brief	The predicted size of the whole archive.
+			std::uint64_t size{ 0 };
+
+			/// \brief	The number of files which were compressed to sample compression ratios.
+			std::size_t sampled{ 0 };
+		};
+
+		/// \brief	Predicts the size of the archive, as if it were written after a call to
+		///		\ref compress_all, without compressing every file.
+		///
+		/// \details	Files which are already compressed are counted as they are. The rest are
+		///		grouped by their extension, since files of a type tend to compress alike, and a
+		///		handful from each group are compressed across a pool of threads. The rest of each
+		///		group is assumed to compress at the same ratio as its samples.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		///
+		/// \param	a_params	The configuration options files will be compressed with.
+		/// \param	a_samples	The maximum number of files to compress from each group.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		/// \return	The predicted size of the archive.
+		///
+		/// \remark	The prediction is only as good as the samples are representative, so leave
+		///		some headroom, and check \ref verify_offsets once the files are compressed.
+		[[nodiscard]] auto estimate_size(
+			const file::compression_params& a_params,
+			std::size_t a_samples = 8,
+			std::size_t a_threads = 0) const
+			-> size_estimate;
+
+		/// \brief	Splits the archive into as few archives as are predicted to fit within the
+		///		given offset, once their files are compressed.
+		///
+		/// \details	Sizes are predicted as by \ref estimate_size, and files are handed out to
+		///		each archive in order, so each archive holds a contiguous run of directories. Every
+		///		archive keeps the flags and types of this one.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		///
+		/// \param	a_params	The configuration options files will be compressed with.
+		/// \param	a_limit	The largest offset the data of a file is allowed to be written at.
+		/// \param	a_samples	The maximum number of files to compress from each group.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		/// \return	The archives the files were split into, which is a single archive when
+		///		everything already fits.
+		///
+		/// \remark	Files are moved out of this archive, which is left empty.
+		/// \remark	A single file which is too large to fit on its own still gets an archive of
+		///		its own.
+		[[nodiscard]] auto split(
+			const file::compression_params& a_params,
+			std::uint64_t a_limit = max_offset,
+			std::size_t a_samples = 8,
+			std::size_t a_threads = 0)
+			-> std::vector<archive>;
+
 		/// @}
 
 		/// \name Writing
 		/// @{
 
+		/// \brief	Extra configuration options for writing archives.
+		struct write_params final
+		{
+			/// \brief	Writes the data of files with identical contents only once, and points
+			///		each of their entries at the shared copy.
+			///
+			/// \remark	Ignored when writing an archive with
+			///		\ref archive_flag::embedded_file_names "embedded file names", since every
+			///		file's data is then prefixed with its own name.
+			bool deduplicate{ false };
+
+			/// \brief	The order to lay out the data of files in, e.g. the order in which they were
+			///		observed being accessed.
+			///
+			/// \details	Only the file data is reordered, since the records must stay sorted by
+			///		their hashes. Files are laid out in the order they first appear here, followed by
+			///		every file not listed, in the order of their records. Entries which do not name
+			///		a file in the archive are ignored.
+			std::span<const std::pair<key_type, directory::key_type>> data_order{};
+		};
+
 		/// \copydoc bsa::tes3::archive::write
 		///
 		/// \param	a_version	The version format to write the archive in.
@@ -578,15 +964,114 @@ namespace bsa::tes4
 			write_sink a_sink,
 			version a_version) const;
 
+		/// \copydoc bsa::tes4::archive::write(write_sink, version) const
+		///
+		/// \param	a_params	Extra configuration options.
+		void write(
+			write_sink a_sink,
+			version a_version,
+			const write_params& a_params) const;
+
+		/// \brief	Writes the archive to disk through a memory mapping.
+		///
+		/// \details	Every offset is known before any data is written, so the output file is
+		///		sized up front and mapped. The header and file records are written serially, then
+		///		the data of each file is copied into its own region of the mapping across a pool of
+		///		threads. The result is identical to \ref write.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		///
+		/// \param	a_path	The path to write the archive to.
+		/// \param	a_version	The version format to write the archive in.
+		/// \param	a_params	Extra configuration options.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		///
+		/// \remark	Files are written as they are, so compress them beforehand (e.g. with
+		///		\ref compress_all), since their compressed sizes decide where everything goes.
+		void write_mapped(
+			const std::filesystem::path& a_path,
+			version a_version,
+			const write_params& a_params,
+			std::size_t a_threads = 0) const;
+
+		/// @}
+
+		/// \name Extraction
+		/// @{
+
+		/// \brief	Writes every file in the archive to disk, under the given directory.
+		///
+		/// \details	Files are distributed across a pool of threads. Each one is decompressed
+		///		straight into a memory mapped output file, so extraction makes no intermediate
+		///		copies. Files without names are written under their hashes. Files which are still
+		///		to be read through \ref bsa::read_backend::async are instead read into a pool of
+		///		buffers, and decompressed as soon as each one arrives.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		/// \exception	bsa::exception	Thrown when the path of a file would escape `a_root`.
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered. The explanation is prefixed with the path of the offending file.
+		///
+		/// \param	a_root	The directory to extract the archive into.
+		/// \param	a_params	Configuration options for decompressing each file.
+		/// \param	a_threads	The maximum number of threads to use. `0` uses
+		///		`std::thread::hardware_concurrency()`.
+		///
+		/// \remark	Every path is validated before anything is written. If any other exception
+		///		is thrown, then files may have been partially extracted.
+		void extract_all(
+			const std::filesystem::path& a_root,
+			const file::write_params& a_params,
+			std::size_t a_threads = 0) const;
+
+		/// @}
+
+		/// \name Caching
+		/// @{
+
+		/// \brief	Returns the decompressed contents of a file through a cache, decompressing
+		///		them only when they are not already cached.
+		///
+		/// \exception	bsa::compression_error	Thrown when any backend compression library errors
+		///		are encountered.
+		///
+		/// \param	a_cache	The cache to look the contents up in.
+		/// \param	a_directory	The key of the directory containing the file.
+		/// \param	a_file	The key of the file.
+		/// \param	a_params	Configuration options for decompressing the file.
+		/// \return	The contents of the file, or `nullptr` if no such file exists.
+		///
+		/// \remark	Contents cached before the archive was last read or cleared are never
+		///		served again, but they do stay cached after a file is modified, so \ref
+		///		content_cache::clear "clear" the cache after changing any file.
+		[[nodiscard]] auto decompress_cached(
+			content_cache& a_cache,
+			const key_type& a_directory,
+			const directory::key_type& a_file,
+			const file::compression_params& a_params) const
+			-> content_cache::contents_type;
+
 		/// @}
 
 	private:
+		friend lazy_archive;
+		friend stream_writer;
+
 		using intermediate_t =
 			std::vector<
 				std::pair<
 					const value_type*,
 					std::vector<const mapped_type::value_type*>>>;
 
+		// Where the data of every file goes, indexed in the order of their records
+		struct layout_t final
+		{
+			std::vector<std::pair<const key_type*, const mapped_type::value_type*>> files;
+			std::vector<std::size_t> order;  // the files whose data is written, in the order it's written
+			std::vector<std::uint32_t> offsets;
+		};
+
 		struct xbox_sort_t;
 
 		[[nodiscard]] auto make_header(version a_version) const noexcept -> detail::header_t;
@@ -598,18 +1083,40 @@ namespace bsa::tes4
 			std::size_t a_count,
 			std::size_t& a_namesOffset) -> std::optional<std::string_view>;
 
-		void read_file_data(
+		static void read_file_data(
 			file& a_file,
 			detail::istream_t& a_in,
 			const detail::header_t& a_header,
 			std::size_t a_size);
 
+		// Fetches the start of the data of every file from a sparse stream, in a single batch,
+		//	since it is read along with its record: its embedded name, and its decompressed size.
+		static void fetch_file_prefixes(
+			detail::istream_t& a_in,
+			const detail::header_t& a_header);
+
 		void read_directory(
 			detail::istream_t& a_in,
 			const detail::header_t& a_header,
 			std::size_t& a_filesOffset,
 			std::size_t& a_namesOffset);
 
+		// Predicts the size of the data of every file once compressed (including its
+		//	decompressed size, but not its embedded name), in the order they are iterated.
+		[[nodiscard]] auto predict_file_sizes(
+			const file::compression_params& a_params,
+			std::size_t a_samples,
+			std::size_t a_threads,
+			std::size_t& a_sampled) const
+			-> std::vector<std::uint64_t>;
+
+		[[nodiscard]] static auto make_file_size(
+			const key_type& a_directory,
+			const directory::key_type& a_key,
+			const file& a_file,
+			const detail::header_t& a_header) noexcept
+			-> std::uint32_t;
+
 		[[nodiscard]] auto sort_for_write(bool a_xbox) const noexcept -> intermediate_t;
 
 		[[nodiscard]] auto test_flag(archive_flag a_flag) const noexcept
@@ -623,15 +1130,32 @@ namespace bsa::tes4
 			detail::ostream_t& a_out,
 			const detail::header_t& a_header) const noexcept;
 
-		void write_file_data(
+		[[nodiscard]] static auto share_file_data(const intermediate_t& a_intermediate)
+			-> std::vector<std::size_t>;
+
+		[[nodiscard]] static auto make_layout(
 			const intermediate_t& a_intermediate,
+			const detail::header_t& a_header,
+			std::span<const std::size_t> a_shared,
+			std::span<const std::pair<key_type, directory::key_type>> a_order) -> layout_t;
+
+		static void write_file_data(
+			const layout_t& a_layout,
 			detail::ostream_t& a_out,
-			const detail::header_t& a_header) const noexcept;
+			const detail::header_t& a_header) noexcept;
+
+		static void write_file_data(
+			std::span<const std::byte> a_dirname,
+			const directory::key_type& a_key,
+			const file& a_file,
+			detail::ostream_t& a_out,
+			const detail::header_t& a_header) noexcept;
 
 		void write_file_entries(
 			const intermediate_t& a_intermediate,
 			detail::ostream_t& a_out,
-			const detail::header_t& a_header) const noexcept;
+			const detail::header_t& a_header,
+			std::span<const std::uint32_t> a_offsets) const;
 
 		void write_file_names(
 			const intermediate_t& a_intermediate,
@@ -639,5 +1163,259 @@ namespace bsa::tes4
 
 		archive_flag _flags{ archive_flag::none };
 		archive_type _types{ archive_type::none };
+		std::shared_ptr<const detail::string_arena> _names;
+		std::uint64_t _generation{ detail::next_generation() };  // identifies the contents for caching
+	};
+
+	/// \brief	A read-only index over a TES4 archive, which defers decoding files until they
+	///		are looked up.
+	///
+	/// \details	Reading a lazy archive parses only the header and the directory records, so
+	///		opening one stays cheap no matter how many files the archive contains. A file is
+	///		decoded from the source the first time it is looked up, and is cached from
+	///		then on.
+	///
+	/// \remark	Lookups modify the cache, and so must be externally synchronized.
+	class lazy_archive final
+	{
+	public:
+		/// \name Member types
+		/// @{
+
+		using key_type = archive::key_type;
+		using mapped_type = archive::mapped_type;
+		using const_index = directory::const_index;
+
+		/// @}
+
+		/// \name Archive flags
+		/// @{
+
+		/// \brief	Retrieves the archive flags of the indexed archive.
+		[[nodiscard]] archive_flag archive_flags() const noexcept { return _flags; }
+
+		/// @}
+
+		/// \name Archive types
+		/// @{
+
+		/// \brief	Retrieves the archive types of the indexed archive.
+		[[nodiscard]] archive_type archive_types() const noexcept { return _types; }
+
+		/// @}
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Checks if the indexed archive contains no directories.
+		[[nodiscard]] bool empty() const noexcept { return _records.empty(); }
+
+		/// \brief	Returns the number of directories in the indexed archive.
+		[[nodiscard]] std::size_t size() const noexcept { return _records.size(); }
+
+		/// @}
+
+		/// \name Lookup
+		/// @{
+
+		/// \brief	Returns the files which have been decoded so far.
+		[[nodiscard]] const archive& cache() const noexcept { return _cache; }
+
+		/// \brief	Finds the file with the given keys, decoding it from the source if it has
+		///		not been looked up before.
+		///
+		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
+		///
+		/// \param	a_directory	The key of the directory containing the file.
+		/// \param	a_file	The key of the file to look up.
+		/// \return	A proxy to the decoded file, which is empty if no such file exists.
+		///
+		/// \remark	The file string table is never read, so a decoded file takes its name
+		///		from `a_file`, falling back to its embedded name (if any).
+		[[nodiscard]] const_index lookup(
+			const key_type& a_directory,
+			const directory::key_type& a_file);
+
+		/// @}
+
+		/// \name Modifiers
+		/// @{
+
+		/// \brief	Releases the source, and clears the index, the cache, and the flags/types.
+		void clear() noexcept;
+
+		/// @}
+
+		/// \name Reading
+		/// @{
+
+		/// \brief	Indexes the contents of the source.
+		///
+		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
+		/// \exception	bsa::exception	Thrown when the archive header is malformed.
+		///
+		/// \param	a_source	The source to index. Files are read from it on demand, so
+		///		\ref copy_type::shallow "shallow" sources must outlive the lazy archive.
+		/// \return	The version of the archive that was read.
+		///
+		/// \remark	If any exception is thrown, the object is left in an unspecified state.
+		///		Use clear to return it to a valid state.
+		version read(read_source a_source);
+
+		/// \brief	Indexes the archive at the given path, reusing a sidecar index if possible.
+		///
+		/// \details	If `a_cache` holds an index built from this archive in its current state
+		///		(as identified by its path, size, and last write time), then the index is loaded
+		///		from it and none of the archive's records are parsed. Otherwise, the archive is
+		///		indexed as usual, and a fresh sidecar is written to `a_cache`.
+		///
+		/// \exception	binary_io::buffer_exhausted	Thrown when reads index out of bounds.
+		/// \exception	bsa::exception	Thrown when the archive header is malformed.
+		/// \exception	std::system_error	Thrown when the sidecar could not be written.
+		///
+		/// \param	a_path	The path to the archive to index.
+		/// \param	a_cache	The path to the sidecar index.
+		/// \return	The version of the archive that was read.
+		///
+		/// \remark	Sidecars store their contents in native byte order and sizes, so they
+		///		should not be shared between machines.
+		/// \remark	If any exception is thrown, the object is left in an unspecified state.
+		///		Use clear to return it to a valid state.
+		version read(
+			const std::filesystem::path& a_path,
+			const std::filesystem::path& a_cache);
+
+		/// @}
+
+	private:
+		struct record_t final
+		{
+			hashing::hash hash;
+			std::size_t count{ 0 };
+			std::size_t name{ 0 };
+			std::size_t files{ 0 };
+		};
+
+		archive _cache;
+		std::vector<record_t> _records;
+		detail::shared_source _source;
+		archive_flag _flags{ archive_flag::none };
+		archive_type _types{ archive_type::none };
+	};
+
+	/// \brief	Writes a TES4 archive without holding the contents of every file in memory.
+	///
+	/// \details	Only the keys of each file are collected up front, which is enough to lay
+	///		out the header and the directory/file records. The contents of each file are then
+	///		pulled from its source one at a time as the file data is written, so peak memory
+	///		usage is bounded by the largest single file instead of the whole archive. The file
+	///		records are patched once the final size of each file is known, so the sink must be
+	///		seekable.
+	class stream_writer final
+	{
+	public:
+		/// \name Member types
+		/// @{
+
+		using key_type = archive::key_type;
+
+		/// \brief	Produces the contents of a file, as it is about to be written.
+		using source_type = std::function<file()>;
+
+		/// @}
+
+		/// \name Archive flags
+		/// @{
+
+		/// \copydoc bsa::tes4::archive::archive_flags() const
+		[[nodiscard]] archive_flag archive_flags() const noexcept { return _layout.archive_flags(); }
+		/// \copydoc bsa::tes4::archive::archive_flags(archive_flag)
+		void archive_flags(archive_flag a_flags) noexcept { _layout.archive_flags(a_flags); }
+
+		/// @}
+
+		/// \name Archive types
+		/// @{
+
+		/// \copydoc bsa::tes4::archive::archive_types() const
+		[[nodiscard]] archive_type archive_types() const noexcept { return _layout.archive_types(); }
+		/// \copydoc bsa::tes4::archive::archive_types(archive_type)
+		void archive_types(archive_type a_types) noexcept { _layout.archive_types(a_types); }
+
+		/// @}
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Checks if no files have been added to the writer.
+		[[nodiscard]] bool empty() const noexcept { return _sources.empty(); }
+
+		/// \brief	Returns the number of files added to the writer.
+		[[nodiscard]] std::size_t size() const noexcept { return _sources.size(); }
+
+		/// @}
+
+		/// \name Modifiers
+		/// @{
+
+		/// \brief	Removes every file, and clears the flags and types.
+		void clear() noexcept
+		{
+			_layout.clear();
+			_sources.clear();
+		}
+
+		/// \brief	Adds a file, whose contents will be pulled from `a_source` when they are
+		///		written.
+		///
+		/// \param	a_directory	The key of the directory to add the file to.
+		/// \param	a_file	The key of the file.
+		/// \param	a_source	The source of the file's contents.
+		/// \return	`true` if the file was added, `false` if the file already exists.
+		bool insert(
+			key_type a_directory,
+			directory::key_type a_file,
+			source_type a_source);
+
+		/// \brief	Adds a file, whose contents will be read from `a_path` when they are
+		///		written.
+		///
+		/// \param	a_directory	The key of the directory to add the file to.
+		/// \param	a_file	The key of the file.
+		/// \param	a_path	The path to read the file's contents from.
+		/// \param	a_params	Configuration options for reading the file.
+		/// \return	`true` if the file was added, `false` if the file already exists.
+		bool insert(
+			key_type a_directory,
+			directory::key_type a_file,
+			std::filesystem::path a_path,
+			const file::read_params& a_params);
+
+		/// @}
+
+		/// \name Writing
+		/// @{
+
+		/// \brief	Writes the archive to the given sink, pulling each file from its source.
+		///
+		/// \exception	std::system_error	Thrown when filesystem errors are encountered.
+		/// \exception	binary_io::buffer_exhausted	Thrown when the output buffer is exhausted.
+		/// \exception	bsa::exception	Thrown when the file data exceeds the offsets
+		///		addressable by the format.
+		///
+		/// \param	a_sink	The seekable sink to write the archive to.
+		/// \param	a_version	The version format to write the archive in.
+		///
+		/// \remark	Any exception thrown by a source is propagated, and leaves the sink in an
+		///		unspecified state.
+		void write(
+			write_sink a_sink,
+			version a_version) const;
+
+		/// @}
+
+	private:
+		archive _layout;
+		std::map<std::pair<hashing::hash, hashing::hash>, source_type> _sources;
 	};
 }
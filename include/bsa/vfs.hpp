@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "bsa/detail/common.hpp"
+#include "bsa/fo4.hpp"
+#include "bsa/tes3.hpp"
+#include "bsa/tes4.hpp"
+
+namespace bsa::vfs
+{
+	/// \brief	Uniquely identifies an archive mounted within an \ref overlay.
+	/// \remark	Ids are handed out in ascending order, and are never reused.
+	using archive_id = std::size_t;
+
+	/// \brief	A reference to a file within an archive mounted in an \ref overlay.
+	struct file_ref final
+	{
+	public:
+		using file_type = std::variant<
+			const tes3::file*,
+			const tes4::file*,
+			const fo4::file*>;
+
+		/// \brief	The archive the file was found in.
+		archive_id archive{ 0 };
+
+		/// \brief	The file itself, whose type is determined by the format of the archive.
+		file_type file;
+	};
+
+	/// \brief	Resolves paths against many archives at once, as the games do when
+	///		mounting archives in load order.
+	/// \details	Every mounted archive contributes its files to a single index, which
+	///		is kept sorted by hash. Resolving a path is a single lookup per archive format,
+	///		regardless of how many archives are mounted. When several archives contain
+	///		the same file, the archive mounted last takes priority.
+	class overlay final
+	{
+	public:
+		/// \brief	An archive mounted within the overlay, alongside the information needed
+		///		to read its files.
+		struct mounted_archive final
+		{
+		public:
+			using archive_type = std::variant<
+				tes3::archive,
+				tes4::archive,
+				fo4::archive>;
+
+			/// \brief	The archive itself.
+			archive_type archive;
+
+			/// \brief	The version a tes4 archive was read with, which its files must be
+			///		decompressed with.
+			tes4::version tes4_version{ tes4::version::tes4 };
+
+			/// \brief	The info an fo4 archive was read with, which its files must be
+			///		written with.
+			fo4::archive::meta_info fo4_meta{};
+		};
+
+		/// \name Capacity
+		/// @{
+
+		/// \brief	Checks if the overlay has no archives mounted.
+		[[nodiscard]] bool empty() const noexcept { return _archives.empty(); }
+
+		/// \brief	Returns the number of archives mounted within the overlay.
+		[[nodiscard]] std::size_t size() const noexcept { return _archives.size(); }
+
+		/// @}
+
+		/// \name Lookup
+		/// @{
+
+		/// \brief	Fetches the archive mounted with the given id.
+		///
+		/// \param	a_archive	The id returned when the archive was mounted.
+		/// \return	The mounted archive, if it is still mounted.
+		[[nodiscard]] auto archive(archive_id a_archive) const noexcept
+			-> const mounted_archive*;
+
+		/// \brief	Checks if any mounted archive contains the given path.
+		[[nodiscard]] bool contains(std::string_view a_path) const noexcept
+		{
+			return this->find(a_path).has_value();
+		}
+
+		/// \brief	Resolves the given path against every mounted archive.
+		///
+		/// \param	a_path	The path to resolve, e.g. `"textures/clutter/bucket.dds"`.
+		/// \return	The file from the highest priority archive containing the path,
+		///		if any archive contains it.
+		[[nodiscard]] auto find(std::string_view a_path) const noexcept
+			-> std::optional<file_ref>;
+
+		/// @}
+
+		/// \name Modifiers
+		/// @{
+
+		/// \brief	Unmounts every archive.
+		void clear() noexcept;
+
+		/// \brief	Reads the archive at the given path and mounts it above every other
+		///		archive in the overlay.
+		///
+		/// \exception	bsa::exception	Thrown when the file is not an archive, or archive
+		///		parsing errors are encountered.
+		///
+		/// \param	a_path	The path to the archive on disk.
+		/// \return	The id of the newly mounted archive.
+		archive_id mount(std::filesystem::path a_path);
+
+		/// \brief	Mounts the given archive above every other archive in the overlay.
+		///
+		/// \param	a_archive	The archive to mount.
+		/// \return	The id of the newly mounted archive.
+		archive_id mount(tes3::archive a_archive);
+
+		/// \copydoc mount(tes3::archive)
+		///
+		/// \param	a_version	The version the archive was read with.
+		archive_id mount(tes4::archive a_archive, tes4::version a_version);
+
+		/// \copydoc mount(tes3::archive)
+		///
+		/// \param	a_meta	The info the archive was read with.
+		archive_id mount(fo4::archive a_archive, const fo4::archive::meta_info& a_meta);
+
+		/// \brief	Unmounts the given archive, so paths resolve as if it was never mounted.
+		///
+		/// \param	a_archive	The id returned when the archive was mounted.
+		/// \return	`true` if the archive was mounted, `false` otherwise.
+		bool unmount(archive_id a_archive) noexcept;
+
+		/// @}
+
+	private:
+		template <class Key, class File>
+		class index_t final
+		{
+		public:
+			struct entry_t final
+			{
+				Key key;
+				archive_id archive{ 0 };
+				const File* file{ nullptr };
+			};
+
+			void insert(std::vector<entry_t> a_entries);
+			void erase(archive_id a_archive) noexcept;
+			void clear() noexcept { _entries.clear(); }
+			[[nodiscard]] bool empty() const noexcept { return _entries.empty(); }
+			[[nodiscard]] auto find(const Key& a_key) const noexcept -> const entry_t*;
+
+		private:
+			// sorted by key, then by descending archive id, so the first match for a key
+			//	always belongs to the highest priority archive
+			std::vector<entry_t> _entries;
+		};
+
+		using tes3_index = index_t<tes3::hashing::hash, tes3::file>;
+		using tes4_index = index_t<std::pair<tes4::hashing::hash, tes4::hashing::hash>, tes4::file>;
+		using fo4_index = index_t<fo4::hashing::hash, fo4::file>;
+
+		archive_id do_mount(mounted_archive a_archive);
+
+		std::map<archive_id, mounted_archive> _archives;
+		tes3_index _tes3;
+		tes4_index _tes4;
+		fo4_index _fo4;
+		archive_id _next{ 0 };
+	};
+}
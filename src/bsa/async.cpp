@@ -0,0 +1,40 @@
+#include "bsa/async.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "bsa/detail/extract.hpp"
+
+namespace bsa::async
+{
+	auto extraction::step_t::operator()() const
+		-> std::optional<std::filesystem::path>
+	{
+		return self->extract_next();
+	}
+
+	auto extraction::extract_next()
+		-> std::optional<std::filesystem::path>
+	{
+		if (!_prepared) {
+			std::vector<std::filesystem::path> paths;
+			paths.reserve(_jobs.size());
+			for (const auto& job : _jobs) {
+				paths.push_back(job.path);
+			}
+			detail::create_parent_directories(paths);
+			_prepared = true;
+		}
+
+		if (this->done()) {
+			return std::nullopt;
+		}
+
+		// advance first, so that a file which fails to extract doesn't wedge the extraction
+		auto& job = _jobs[_next++];
+		job.write(job.path);
+		return std::move(job.path);
+	}
+}
@@ -0,0 +1,1002 @@
+#include "bsa/detail/async_read.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <stop_token>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if BSA_OS_WINDOWS
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <Windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+
+#	if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#		define BSA_HAS_IO_URING 1
+#		include <cstring>
+
+#		include <linux/io_uring.h>
+#		include <sched.h>
+#		include <sys/syscall.h>
+#		include <sys/uio.h>
+#	endif
+#endif
+
+#include "bsa/detail/observe.hpp"
+#include "bsa/detail/parallel.hpp"
+
+namespace bsa::detail
+{
+	namespace
+	{
+		// large enough to amortize each request, small enough to keep many in flight
+		constexpr std::size_t block_size = std::size_t{ 1 } << 20;
+		constexpr std::size_t queue_depth = 32;
+
+		// the granularity residency is tracked at, which need not match the system's pages
+		constexpr std::size_t page_size = std::size_t{ 1 } << 12;
+
+		static_assert(block_size % page_size == 0);
+
+		[[noreturn]] void throw_system_error(int a_code, const char* a_what)
+		{
+			throw std::system_error(a_code, std::system_category(), a_what);
+		}
+
+		// A read of `size` bytes at `offset` in the file, into `dst`.
+		struct read_t final
+		{
+			std::byte* dst{ nullptr };
+			std::size_t offset{ 0 };
+			std::size_t size{ 0 };
+		};
+
+		// Every queue below keeps reads in flight in slots, and hands back the slot of each read
+		//	once it has been read in full. Short reads are reissued for whatever remains of them.
+		// Whatever is still in flight when a queue is destroyed is cancelled and waited on first,
+		//	since the kernel would otherwise go on writing into its buffer (and the requests here)
+		//	after they are freed.
+
+#if BSA_OS_WINDOWS
+		class handle_t final
+		{
+		public:
+			explicit handle_t(::HANDLE a_handle) noexcept :
+				_handle(a_handle)
+			{}
+
+			handle_t(const handle_t&) = delete;
+			handle_t(handle_t&&) = delete;
+
+			~handle_t() noexcept
+			{
+				if (_handle != nullptr && _handle != INVALID_HANDLE_VALUE) {
+					::CloseHandle(_handle);
+				}
+			}
+
+			handle_t& operator=(const handle_t&) = delete;
+			handle_t& operator=(handle_t&&) = delete;
+
+			[[nodiscard]] auto get() const noexcept -> ::HANDLE { return _handle; }
+
+			[[nodiscard]] auto release() noexcept -> ::HANDLE { return std::exchange(_handle, nullptr); }
+
+		private:
+			::HANDLE _handle{ nullptr };
+		};
+
+		// Retires overlapped reads in the order they were issued.
+		class overlapped_queue final
+		{
+		public:
+			explicit overlapped_queue(::HANDLE a_file) :
+				_file(a_file)
+			{
+				for (std::size_t i = 0; i < queue_depth; ++i) {
+					_free.push_back(queue_depth - 1 - i);
+				}
+			}
+
+			overlapped_queue(const overlapped_queue&) = delete;
+			overlapped_queue(overlapped_queue&&) = delete;
+
+			~overlapped_queue() noexcept
+			{
+				for (const auto slot : _active) {
+					auto& request = _requests[slot];
+					::CancelIoEx(_file, &request.overlapped);
+					::DWORD read = 0;
+					(void)::GetOverlappedResult(_file, &request.overlapped, &read, TRUE);
+				}
+
+				for (const auto& request : _requests) {
+					if (request.overlapped.hEvent != nullptr) {
+						::CloseHandle(request.overlapped.hEvent);
+					}
+				}
+			}
+
+			overlapped_queue& operator=(const overlapped_queue&) = delete;
+			overlapped_queue& operator=(overlapped_queue&&) = delete;
+
+			[[nodiscard]] bool full() const noexcept { return _free.empty(); }
+			[[nodiscard]] bool idle() const noexcept { return _active.empty(); }
+
+			auto submit(const read_t& a_read)
+				-> std::size_t
+			{
+				assert(!this->full());
+				const auto slot = _free.back();
+				_requests[slot].read = a_read;
+				if (const auto code = this->issue(slot); code != 0) {
+					throw_system_error(code, "failed to read file");
+				}
+
+				_free.pop_back();
+				_active.push_back(slot);
+				return slot;
+			}
+
+			[[nodiscard]] auto wait()
+				-> std::size_t
+			{
+				while (true) {
+					assert(!this->idle());
+					const auto slot = _active.front();
+					_active.pop_front();
+
+					auto& request = _requests[slot];
+					::DWORD read = 0;
+					if (!::GetOverlappedResult(_file, &request.overlapped, &read, TRUE)) {
+						_free.push_back(slot);
+						throw_system_error(static_cast<int>(::GetLastError()), "failed to read file");
+					} else if (read == 0) {
+						_free.push_back(slot);
+						throw_system_error(static_cast<int>(ERROR_HANDLE_EOF), "file was truncated while reading");
+					}
+
+					request.read.dst += read;
+					request.read.offset += read;
+					request.read.size -= read;
+					if (request.read.size == 0) {
+						_free.push_back(slot);
+						return slot;
+					} else if (const auto code = this->issue(slot); code != 0) {
+						_free.push_back(slot);
+						throw_system_error(code, "failed to read file");
+					}
+					_active.push_back(slot);
+				}
+			}
+
+		private:
+			struct request_t final
+			{
+				::OVERLAPPED overlapped{};
+				read_t read;
+			};
+
+			// returns 0, or the error which kept the read from being issued
+			[[nodiscard]] auto issue(std::size_t a_slot) noexcept
+				-> int
+			{
+				auto& [overlapped, read] = _requests[a_slot];
+				auto event = overlapped.hEvent;
+				if (event == nullptr) {
+					event = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+					if (event == nullptr) {
+						return static_cast<int>(::GetLastError());
+					}
+				}
+
+				overlapped = {};
+				overlapped.hEvent = event;
+				overlapped.Offset = static_cast<::DWORD>(read.offset);
+				overlapped.OffsetHigh = static_cast<::DWORD>(static_cast<std::uint64_t>(read.offset) >> 32u);
+				if (!::ReadFile(
+						_file,
+						read.dst,
+						static_cast<::DWORD>(read.size),
+						nullptr,
+						&overlapped) &&
+					::GetLastError() != ERROR_IO_PENDING) {
+					return static_cast<int>(::GetLastError());
+				}
+				return 0;
+			}
+
+			::HANDLE _file{ nullptr };
+			std::array<request_t, queue_depth> _requests;
+			std::vector<std::size_t> _free;
+			std::deque<std::size_t> _active;  // in the order they were issued
+		};
+#else
+		class fd_t final
+		{
+		public:
+			explicit fd_t(int a_fd) noexcept :
+				_fd(a_fd)
+			{}
+
+			fd_t(const fd_t&) = delete;
+			fd_t(fd_t&&) = delete;
+
+			~fd_t() noexcept
+			{
+				if (_fd >= 0) {
+					::close(_fd);
+				}
+			}
+
+			fd_t& operator=(const fd_t&) = delete;
+			fd_t& operator=(fd_t&&) = delete;
+
+			[[nodiscard]] int get() const noexcept { return _fd; }
+
+			[[nodiscard]] int release() noexcept { return std::exchange(_fd, -1); }
+
+		private:
+			int _fd{ -1 };
+		};
+
+		// Reads synchronously as each read is submitted, so only one is ever "in flight".
+		class blocking_queue final
+		{
+		public:
+			explicit blocking_queue(int a_fd) noexcept :
+				_fd(a_fd)
+			{}
+
+			[[nodiscard]] bool full() const noexcept { return _done; }
+			[[nodiscard]] bool idle() const noexcept { return !_done; }
+
+			auto submit(const read_t& a_read)
+				-> std::size_t
+			{
+				assert(!this->full());
+				auto [dst, offset, size] = a_read;
+				while (size > 0) {
+					const auto read = ::pread(_fd, dst, size, static_cast<::off_t>(offset));
+					if (read < 0) {
+						if (errno == EINTR) {
+							continue;
+						}
+						throw_system_error(errno, "failed to read file");
+					} else if (read == 0) {
+						throw_system_error(EIO, "file was truncated while reading");
+					}
+
+					dst += read;
+					offset += static_cast<std::size_t>(read);
+					size -= static_cast<std::size_t>(read);
+				}
+
+				_done = true;
+				return 0;
+			}
+
+			[[nodiscard]] auto wait() noexcept
+				-> std::size_t
+			{
+				assert(!this->idle());
+				_done = false;
+				return 0;
+			}
+
+		private:
+			int _fd{ -1 };
+			bool _done{ false };
+		};
+
+#	if BSA_HAS_IO_URING
+		// A minimal io_uring, driven directly through its system calls, since the reads issued
+		//	here don't warrant a dependency on liburing.
+		class ring_queue final
+		{
+		public:
+			explicit ring_queue(int a_file) :
+				_file(a_file)
+			{
+				for (std::size_t i = 0; i < queue_depth; ++i) {
+					_free.push_back(queue_depth - 1 - i);
+				}
+
+				::io_uring_params params{};
+				const auto fd = static_cast<int>(::syscall(__NR_io_uring_setup, static_cast<unsigned>(queue_depth), &params));
+				if (fd < 0) {
+					return;
+				}
+				_fd = fd;
+
+				_sqsize = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+				_cqsize = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+				const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+				if (single) {
+					_sqsize = _cqsize = (std::max)(_sqsize, _cqsize);
+				}
+
+				_sq = map(_sqsize, IORING_OFF_SQ_RING);
+				_cq = single ? _sq : map(_cqsize, IORING_OFF_CQ_RING);
+				_sqes = static_cast<::io_uring_sqe*>(map(params.sq_entries * sizeof(::io_uring_sqe), IORING_OFF_SQES));
+				_sqecount = params.sq_entries;
+				if (!_sq || !_cq || !_sqes) {
+					return;
+				}
+
+				const auto sq = static_cast<std::byte*>(_sq);
+				_sqhead = reinterpret_cast<std::uint32_t*>(sq + params.sq_off.head);
+				_sqtail = reinterpret_cast<std::uint32_t*>(sq + params.sq_off.tail);
+				_sqmask = *reinterpret_cast<std::uint32_t*>(sq + params.sq_off.ring_mask);
+				_sqarray = reinterpret_cast<std::uint32_t*>(sq + params.sq_off.array);
+
+				const auto cq = static_cast<std::byte*>(_cq);
+				_cqhead = reinterpret_cast<std::uint32_t*>(cq + params.cq_off.head);
+				_cqtail = reinterpret_cast<std::uint32_t*>(cq + params.cq_off.tail);
+				_cqmask = *reinterpret_cast<std::uint32_t*>(cq + params.cq_off.ring_mask);
+				_cqes = reinterpret_cast<::io_uring_cqe*>(cq + params.cq_off.cqes);
+				_ready = true;
+			}
+
+			ring_queue(const ring_queue&) = delete;
+			ring_queue(ring_queue&&) = delete;
+
+			~ring_queue() noexcept
+			{
+				if (_ready) {
+					this->drain();
+				}
+
+				if (_sqes) {
+					::munmap(_sqes, _sqecount * sizeof(::io_uring_sqe));
+				}
+				if (_cq && _cq != _sq) {
+					::munmap(_cq, _cqsize);
+				}
+				if (_sq) {
+					::munmap(_sq, _sqsize);
+				}
+				if (_fd >= 0) {
+					::close(_fd);
+				}
+			}
+
+			ring_queue& operator=(const ring_queue&) = delete;
+			ring_queue& operator=(ring_queue&&) = delete;
+
+			[[nodiscard]] explicit operator bool() const noexcept { return _ready; }
+
+			[[nodiscard]] bool full() const noexcept { return _free.empty(); }
+			[[nodiscard]] bool idle() const noexcept { return _free.size() == queue_depth; }
+
+			// Reads are only queued here, and are submitted in a batch by the next wait.
+			auto submit(const read_t& a_read) noexcept
+				-> std::size_t
+			{
+				assert(!this->full());
+				const auto slot = _free.back();
+				_free.pop_back();
+				auto& request = _requests[slot];
+				request.iov = { a_read.dst, a_read.size };
+				request.offset = a_read.offset;
+				this->issue(slot);
+				++_inflight;
+				return slot;
+			}
+
+			[[nodiscard]] auto wait()
+				-> std::size_t
+			{
+				while (_done.empty()) {
+					if (const auto code = this->enter(1); code != 0) {
+						throw_system_error(code, "failed to submit reads");
+					}
+
+					int error = 0;
+					const char* what = nullptr;
+					this->reap([&](std::size_t a_slot, std::int32_t a_result) noexcept {
+						auto& request = _requests[a_slot];
+						if (a_result == -EINTR || a_result == -EAGAIN) {
+							this->issue(a_slot);
+						} else if (a_result <= 0) {
+							this->retire(a_slot);
+							_free.push_back(a_slot);
+							if (error == 0) {
+								error = a_result < 0 ? -a_result : EIO;
+								what = a_result < 0 ? "failed to read file" : "file was truncated while reading";
+							}
+						} else {
+							const auto read = static_cast<std::size_t>(a_result);
+							request.iov.iov_base = static_cast<std::byte*>(request.iov.iov_base) + read;
+							request.iov.iov_len -= read;
+							request.offset += read;
+							if (request.iov.iov_len > 0) {
+								this->issue(a_slot);
+							} else {
+								this->retire(a_slot);
+								_done.push_back(a_slot);
+							}
+						}
+					});
+
+					if (error != 0) {
+						throw_system_error(error, what);
+					}
+				}
+
+				const auto slot = _done.front();
+				_done.pop_front();
+				_free.push_back(slot);
+				return slot;
+			}
+
+		private:
+			struct request_t final
+			{
+				::iovec iov{};
+				std::size_t offset{ 0 };
+				bool active{ false };
+			};
+
+			// the user data of cancellations, which never names a request
+			static constexpr auto cancel_tag = (std::numeric_limits<std::uint64_t>::max)();
+
+			[[nodiscard]] auto map(std::size_t a_size, std::uint64_t a_offset) noexcept
+				-> void*
+			{
+				const auto result = ::mmap(
+					nullptr,
+					a_size,
+					PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE,
+					_fd,
+					static_cast<::off_t>(a_offset));
+				return result != MAP_FAILED ? result : nullptr;
+			}
+
+			void queue(std::uint8_t a_opcode, std::uint64_t a_addr, std::uint64_t a_userData) noexcept
+			{
+				const auto tail = std::atomic_ref(*_sqtail).load(std::memory_order_relaxed);
+				const auto idx = tail & _sqmask;
+				auto& sqe = _sqes[idx];
+				std::memset(&sqe, 0, sizeof(sqe));
+				sqe.opcode = a_opcode;
+				sqe.addr = a_addr;
+				sqe.user_data = a_userData;
+				if (a_opcode == IORING_OP_READV) {
+					const auto& request = _requests[static_cast<std::size_t>(a_userData)];
+					sqe.fd = _file;
+					sqe.len = 1;
+					sqe.off = request.offset;
+				} else {
+					sqe.fd = -1;
+				}
+				_sqarray[idx] = idx;
+				std::atomic_ref(*_sqtail).store(tail + 1, std::memory_order_release);
+				++_pending;
+			}
+
+			void issue(std::size_t a_slot) noexcept
+			{
+				_requests[a_slot].active = true;
+				this->queue(IORING_OP_READV, reinterpret_cast<std::uint64_t>(&_requests[a_slot].iov), a_slot);
+			}
+
+			void retire(std::size_t a_slot) noexcept
+			{
+				_requests[a_slot].active = false;
+				--_inflight;
+			}
+
+			// returns 0, or the errno of a failure which retrying will not fix
+			[[nodiscard]] auto enter(unsigned a_wait) noexcept
+				-> int
+			{
+				const auto entered = ::syscall(
+					__NR_io_uring_enter,
+					_fd,
+					static_cast<unsigned>(_pending),
+					a_wait,
+					a_wait > 0 ? IORING_ENTER_GETEVENTS : 0u,
+					nullptr,
+					std::size_t{ 0 });
+				if (entered < 0) {
+					return errno == EINTR || errno == EAGAIN || errno == EBUSY ? 0 : errno;
+				}
+				_pending -= (std::min)(_pending, static_cast<std::size_t>(entered));
+				return 0;
+			}
+
+			template <class F>
+			void reap(F&& a_complete) noexcept
+			{
+				auto head = std::atomic_ref(*_cqhead).load(std::memory_order_relaxed);
+				const auto tail = std::atomic_ref(*_cqtail).load(std::memory_order_acquire);
+				for (; head != tail; ++head) {
+					const auto& cqe = _cqes[head & _cqmask];
+					if (cqe.user_data != cancel_tag) {
+						a_complete(static_cast<std::size_t>(cqe.user_data), cqe.res);
+					}
+				}
+				std::atomic_ref(*_cqhead).store(head, std::memory_order_release);
+			}
+
+			void drain() noexcept
+			{
+				if (_inflight == 0) {
+					return;
+				}
+
+				// flush whatever is queued first, so the queue has room to cancel every read
+				auto code = 0;
+				while (_pending > 0 && code == 0) {
+					code = this->enter(0);
+				}
+
+				std::size_t stuck = 0;  // reads which were never submitted, and so will never run
+				if (code == 0) {
+					for (std::size_t i = 0; i < _requests.size(); ++i) {
+						if (_requests[i].active) {
+							this->queue(IORING_OP_ASYNC_CANCEL, i, cancel_tag);
+						}
+					}
+				} else {
+					stuck = std::atomic_ref(*_sqtail).load(std::memory_order_relaxed) -
+					        std::atomic_ref(*_sqhead).load(std::memory_order_acquire);
+				}
+
+				while (_inflight > stuck) {
+					if (code == 0) {
+						code = this->enter(1);
+					}
+					if (code != 0) {
+						::sched_yield();  // completions are still posted without entering the ring
+					}
+					this->reap([&](std::size_t a_slot, std::int32_t) noexcept { this->retire(a_slot); });
+				}
+			}
+
+			int _file{ -1 };
+			std::array<request_t, queue_depth> _requests;
+			std::vector<std::size_t> _free;
+			std::deque<std::size_t> _done;  // read in full, but not yet handed back
+			std::size_t _inflight{ 0 };     // reads the kernel may still write into
+			std::size_t _pending{ 0 };      // queued, but not yet submitted
+
+			int _fd{ -1 };
+			bool _ready{ false };
+			void* _sq{ nullptr };
+			void* _cq{ nullptr };
+			std::size_t _sqsize{ 0 };
+			std::size_t _cqsize{ 0 };
+			::io_uring_sqe* _sqes{ nullptr };
+			std::size_t _sqecount{ 0 };
+			std::uint32_t* _sqhead{ nullptr };
+			std::uint32_t* _sqtail{ nullptr };
+			std::uint32_t _sqmask{ 0 };
+			std::uint32_t* _sqarray{ nullptr };
+			std::uint32_t* _cqhead{ nullptr };
+			std::uint32_t* _cqtail{ nullptr };
+			std::uint32_t _cqmask{ 0 };
+			::io_uring_cqe* _cqes{ nullptr };
+		};
+#	endif
+#endif
+
+		// Hands `a_func` the deepest queue the system supports. A lone read gains nothing from
+		//	a queue, so it is issued directly wherever that is cheaper.
+		template <class File, class F>
+		void with_queue(
+			File a_file,
+			[[maybe_unused]] std::size_t a_reads,
+			F&& a_func)
+		{
+#if BSA_OS_WINDOWS
+			overlapped_queue queue{ a_file };
+			a_func(queue);
+#else
+#	if BSA_HAS_IO_URING
+			if (a_reads > 1) {
+				if (ring_queue ring{ a_file }; ring) {
+					a_func(ring);
+					return;
+				}
+			}
+#	endif
+			blocking_queue queue{ a_file };
+			a_func(queue);
+#endif
+		}
+	}
+
+	async_file::async_file(const std::filesystem::path& a_path)
+	{
+#if BSA_OS_WINDOWS
+		handle_t file{ ::CreateFileW(
+			a_path.c_str(),
+			GENERIC_READ,
+			FILE_SHARE_READ,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_FLAG_OVERLAPPED,
+			nullptr) };
+		if (file.get() == INVALID_HANDLE_VALUE) {
+			throw_system_error(static_cast<int>(::GetLastError()), "failed to open file");
+		}
+
+		::LARGE_INTEGER size{};
+		if (!::GetFileSizeEx(file.get(), &size)) {
+			throw_system_error(static_cast<int>(::GetLastError()), "failed to query file size");
+		}
+
+		_size = static_cast<std::size_t>(size.QuadPart);
+		_resident = std::make_unique<std::atomic_bool[]>((_size + page_size - 1) / page_size);
+		if (_size > 0) {
+			// pages are only committed as they are fetched
+			const auto image = ::VirtualAlloc(nullptr, _size, MEM_RESERVE, PAGE_READWRITE);
+			if (image == nullptr) {
+				throw_system_error(static_cast<int>(::GetLastError()), "failed to reserve memory");
+			}
+			_image = static_cast<std::byte*>(image);
+		}
+		_handle = file.release();
+#else
+		fd_t file{ ::open(a_path.c_str(), O_RDONLY | O_CLOEXEC) };
+		if (file.get() < 0) {
+			throw_system_error(errno, "failed to open file");
+		}
+
+		struct ::stat info = {};
+		if (::fstat(file.get(), &info) != 0) {
+			throw_system_error(errno, "failed to query file size");
+		}
+
+		_size = static_cast<std::size_t>(info.st_size);
+		_resident = std::make_unique<std::atomic_bool[]>((_size + page_size - 1) / page_size);
+		if (_size > 0) {
+			// anonymous memory is only backed as it is written to, i.e. as pages are fetched
+			auto flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#	ifdef MAP_NORESERVE
+			flags |= MAP_NORESERVE;
+#	endif
+			const auto image = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, flags, -1, 0);
+			if (image == MAP_FAILED) {
+				throw_system_error(errno, "failed to reserve memory");
+			}
+			_image = static_cast<std::byte*>(image);
+		}
+		_fd = file.release();
+#endif
+	}
+
+	async_file::~async_file() noexcept
+	{
+#if BSA_OS_WINDOWS
+		if (_image) {
+			::VirtualFree(_image, 0, MEM_RELEASE);
+		}
+		if (_handle) {
+			::CloseHandle(_handle);
+		}
+#else
+		if (_image) {
+			::munmap(_image, _size);
+		}
+		if (_fd >= 0) {
+			::close(_fd);
+		}
+#endif
+	}
+
+	void async_file::fetch(std::span<const extent_t> a_extents) const
+	{
+		if (std::ranges::all_of(a_extents, [&](extent_t a_extent) { return this->resident(a_extent); })) {
+			return;
+		}
+
+		const std::lock_guard l{ _lock };
+		std::vector<std::size_t> missing;
+		for (const auto extent : a_extents) {
+			const auto [first, last] = this->pages_of(extent);
+			for (auto i = first; i < last; ++i) {
+				if (!_resident[i].load(std::memory_order_relaxed)) {
+					missing.push_back(i);
+				}
+			}
+		}
+
+		std::ranges::sort(missing);
+		const auto [first, last] = std::ranges::unique(missing);
+		missing.erase(first, last);
+
+		// coalesce runs of missing pages into reads of up to a block each
+		std::vector<read_t> reads;
+		std::size_t total = 0;
+		for (std::size_t i = 0; i < missing.size();) {
+			auto j = i + 1;
+			while (j < missing.size() &&
+				   missing[j] == missing[j - 1] + 1 &&
+				   (j - i) * page_size < block_size) {
+				++j;
+			}
+
+			const auto offset = missing[i] * page_size;
+			const auto size = (std::min)((j - i) * page_size, _size - offset);
+#if BSA_OS_WINDOWS
+			if (::VirtualAlloc(_image + offset, size, MEM_COMMIT, PAGE_READWRITE) == nullptr) {
+				throw_system_error(static_cast<int>(::GetLastError()), "failed to commit memory");
+			}
+#endif
+			reads.push_back({ _image + offset, offset, size });
+			total += size;
+			i = j;
+		}
+
+#if BSA_OS_WINDOWS
+		const auto file = static_cast<::HANDLE>(_handle);
+#else
+		const auto file = _fd;
+#endif
+		with_queue(file, reads.size(), [&](auto& a_queue) {
+			std::array<std::size_t, queue_depth> issued{};  // the read in each slot
+			std::size_t next = 0;
+			while (next < reads.size() || !a_queue.idle()) {
+				while (next < reads.size() && !a_queue.full()) {
+					issued[a_queue.submit(reads[next])] = next;
+					++next;
+				}
+
+				const auto& read = reads[issued[a_queue.wait()]];
+				const auto [begin, end] = this->pages_of({ read.offset, read.size });
+				for (auto i = begin; i < end; ++i) {
+					_resident[i].store(true, std::memory_order_release);
+				}
+			}
+		});
+
+		observe_io(observer::io::read, total);
+	}
+
+	bool async_file::resident(extent_t a_extent) const noexcept
+	{
+		const auto [first, last] = this->pages_of(a_extent);
+		for (auto i = first; i < last; ++i) {
+			if (!_resident[i].load(std::memory_order_acquire)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void async_file::read_each(
+		std::span<const extent_t> a_extents,
+		std::size_t a_threads,
+		const std::function<void(std::size_t, std::span<const std::byte>)>& a_func) const
+	{
+		if (a_extents.empty()) {
+			return;
+		}
+
+		// read in the order the extents are laid out in, so the file is swept through once
+		std::vector<std::size_t> order(a_extents.size());
+		std::iota(order.begin(), order.end(), std::size_t{ 0 });
+		std::ranges::stable_sort(order, {}, [&](std::size_t a_idx) { return a_extents[a_idx].offset; });
+
+		struct buffer_t final
+		{
+			std::unique_ptr<std::byte[]> data;
+			std::size_t capacity{ 0 };
+			std::size_t size{ 0 };
+			std::size_t extent{ 0 };
+			std::size_t pending{ 0 };  // reads into the buffer still in flight
+		};
+
+		// enough buffers to keep the queue full while every worker holds one of its own. Their
+		//	memory is bounded by a budget rather than a count, so that an extent larger than a
+		//	buffer can still be read into one while nothing else is in flight
+		const auto threads = resolve_thread_count(a_threads, a_extents.size());
+		std::vector<buffer_t> buffers(queue_depth + threads);
+		const auto budget = buffers.size() * block_size;
+
+		std::mutex lock;
+		std::condition_variable freed;
+		std::condition_variable_any filled;
+		std::vector<std::size_t> idle(buffers.size());  // buffers which can be read into
+		std::iota(idle.begin(), idle.end(), std::size_t{ 0 });
+		std::deque<std::size_t> ready;  // buffers which have been read into
+		std::size_t used = 0;           // bytes held by buffers which aren't idle
+		std::size_t total = 0;
+		std::atomic_bool failed = false;
+		std::size_t errorIdx = (std::numeric_limits<std::size_t>::max)();
+		std::exception_ptr error;
+
+		const auto process = [&](std::size_t a_buffer) noexcept {
+			auto& buffer = buffers[a_buffer];
+			if (!failed.load(std::memory_order_relaxed)) {
+				try {
+					a_func(buffer.extent, { buffer.data.get(), buffer.size });
+				} catch (...) {
+					const std::lock_guard l{ lock };
+					if (buffer.extent < errorIdx) {
+						errorIdx = buffer.extent;
+						error = std::current_exception();
+					}
+					failed.store(true, std::memory_order_relaxed);
+				}
+			}
+
+			const std::lock_guard l{ lock };
+			used -= buffer.size;
+			if (buffer.capacity > block_size) {
+				buffer.data.reset();  // oversized extents don't get to keep their memory
+				buffer.capacity = 0;
+			}
+			idle.push_back(a_buffer);
+			freed.notify_one();
+		};
+
+		{
+			std::vector<std::jthread> workers;
+			if (threads > 1) {
+				workers.reserve(threads - 1);
+				for (std::size_t i = 1; i < threads; ++i) {
+					workers.emplace_back([&](std::stop_token a_stop) {
+						while (true) {
+							std::size_t buffer = 0;
+							{
+								std::unique_lock l{ lock };
+								if (!filled.wait(l, a_stop, [&]() { return !ready.empty(); })) {
+									return;
+								}
+								buffer = ready.front();
+								ready.pop_front();
+							}
+							process(buffer);
+						}
+					});
+				}
+			}
+
+			const auto dispatch = [&](std::size_t a_buffer) {
+				if (workers.empty()) {
+					process(a_buffer);
+				} else {
+					{
+						const std::lock_guard l{ lock };
+						ready.push_back(a_buffer);
+					}
+					filled.notify_one();
+				}
+			};
+
+#if BSA_OS_WINDOWS
+			const auto file = static_cast<::HANDLE>(_handle);
+#else
+			const auto file = _fd;
+#endif
+			try {
+				with_queue(file, a_extents.size() + 1, [&](auto& a_queue) {
+					std::array<std::size_t, queue_depth> issued{};  // the buffer each slot reads into
+					std::size_t next = 0;                           // the next extent to read, in `order`
+					constexpr auto none = (std::numeric_limits<std::size_t>::max)();
+					auto current = none;     // a buffer whose extent is still being submitted
+					std::size_t cursor = 0;  // how much of that extent has been submitted
+
+					// whether the next extent can be given a buffer, as long as `lock` is held
+					const auto available = [&]() noexcept {
+						const auto size = a_extents[order[next]].size;
+						return !idle.empty() && (used == 0 || used + size <= budget);
+					};
+
+					while (!failed.load(std::memory_order_relaxed)) {
+						while (!a_queue.full()) {
+							if (current == none) {
+								if (next == order.size()) {
+									break;
+								}
+
+								std::size_t idx = 0;
+								{
+									const std::lock_guard l{ lock };
+									if (!available()) {
+										break;
+									}
+									idx = idle.back();
+									idle.pop_back();
+									used += a_extents[order[next]].size;
+								}
+
+								auto& buffer = buffers[idx];
+								buffer.extent = order[next++];
+								buffer.size = a_extents[buffer.extent].size;
+								buffer.pending = 0;
+								if (buffer.size > buffer.capacity) {
+									buffer.capacity = (std::max)(buffer.size, block_size);
+									buffer.data = std::make_unique_for_overwrite<std::byte[]>(buffer.capacity);
+								}
+
+								if (buffer.size == 0) {
+									dispatch(idx);
+									continue;
+								}
+								current = idx;
+								cursor = 0;
+							}
+
+							auto& buffer = buffers[current];
+							const auto offset = a_extents[buffer.extent].offset + cursor;
+							const auto size = (std::min)(block_size, buffer.size - cursor);
+							issued[a_queue.submit({ buffer.data.get() + cursor, offset, size })] = current;
+							++buffer.pending;
+							cursor += size;
+							if (cursor == buffer.size) {
+								current = none;
+							}
+						}
+
+						if (a_queue.idle()) {
+							if (next == order.size() && current == none) {
+								break;
+							}
+
+							// nothing is in flight, because every buffer is still being processed
+							std::unique_lock l{ lock };
+							freed.wait(l, [&]() { return failed.load(std::memory_order_relaxed) || available(); });
+							continue;
+						}
+
+						const auto idx = issued[a_queue.wait()];
+						if (auto& buffer = buffers[idx]; --buffer.pending == 0 && current != idx) {
+							total += buffer.size;
+							dispatch(idx);
+						}
+					}
+				});
+			} catch (...) {
+				failed.store(true, std::memory_order_relaxed);
+				throw;
+			}
+
+			std::unique_lock l{ lock };
+			freed.wait(l, [&]() { return failed.load(std::memory_order_relaxed) || idle.size() == buffers.size(); });
+		}
+
+		observe_io(observer::io::read, total);
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	auto async_file::pages_of(extent_t a_extent) const noexcept
+		-> std::pair<std::size_t, std::size_t>
+	{
+		const auto first = (std::min)(a_extent.offset, _size);
+		const auto last = first + (std::min)(a_extent.size, _size - first);
+		if (first == last) {
+			return { 0, 0 };
+		}
+		return { first / page_size, (last + page_size - 1) / page_size };
+	}
+}
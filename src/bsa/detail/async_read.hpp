@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include "bsa/detail/common.hpp"
+#include "bsa/detail/parallel.hpp"
+
+namespace bsa::detail
+{
+	// A file which is read on demand, through a deep queue of positional reads which are all in
+	//	flight at once: io_uring on linux, and overlapped io on windows. Falls back to plain
+	//	blocking reads wherever neither is available (e.g. when io_uring is filtered out by a
+	//	sandbox).
+	// The file is presented as an image of its bytes. Address space for the image is reserved
+	//	up front, but nothing is read into it until it is fetched, so parsing an archive only
+	//	costs as much memory as the parts of it which are touched. Nothing outside of what has
+	//	been fetched may be accessed.
+	class async_file final
+	{
+	public:
+		// Throws std::system_error when the file can not be opened.
+		explicit async_file(const std::filesystem::path& a_path);
+
+		async_file(const async_file&) = delete;
+		async_file(async_file&&) = delete;
+
+		~async_file() noexcept;
+
+		async_file& operator=(const async_file&) = delete;
+		async_file& operator=(async_file&&) = delete;
+
+		[[nodiscard]] auto bytes() const noexcept
+			-> std::span<const std::byte> { return { _image, _size }; }
+
+		// Makes the given extents of the image resident, reading every page of them which is not
+		//	already in a single batch. Extents are clamped to the end of the file.
+		// Throws std::system_error when the file can not be read.
+		void fetch(std::span<const extent_t> a_extents) const;
+		void fetch(extent_t a_extent) const { this->fetch({ &a_extent, 1 }); }
+
+		[[nodiscard]] bool resident(extent_t a_extent) const noexcept;
+
+		// Reads each extent through the queue into a fixed pool of buffers, bypassing the image,
+		//	and hands it to `a_func(i, bytes)` on a pool of workers as soon as its read completes,
+		//	so extents are processed while the reads after them are still in flight. The bytes only
+		//	live for the duration of the call.
+		// Extents are read in the order they are laid out in, and once anything fails, no new
+		//	reads are started. Read errors are rethrown as std::system_error. Otherwise the
+		//	exception from the lowest failing index is rethrown, as with parallel_for.
+		void read_each(
+			std::span<const extent_t> a_extents,
+			std::size_t a_threads,
+			const std::function<void(std::size_t, std::span<const std::byte>)>& a_func) const;
+
+	private:
+		[[nodiscard]] auto pages_of(extent_t a_extent) const noexcept
+			-> std::pair<std::size_t, std::size_t>;
+
+#if BSA_OS_WINDOWS
+		void* _handle{ nullptr };
+#else
+		int _fd{ -1 };
+#endif
+		std::byte* _image{ nullptr };
+		std::size_t _size{ 0 };
+		std::unique_ptr<std::atomic_bool[]> _resident;
+		mutable std::mutex _lock;  // serializes fetches, so no page is read twice
+	};
+
+	// Runs every job in `[0, a_count)`. Jobs whose bytes are still to be read, as reported by
+	//	`a_unread(i)`, are streamed through the queue of the file they are read from, and handed
+	//	to `a_streamed(i, bytes)` as soon as they arrive. Everything else is handed to
+	//	`a_resident(i)` across a pool of workers.
+	template <class Unread, class Streamed, class Resident>
+	void for_each_streamed(
+		std::size_t a_count,
+		std::size_t a_threads,
+		Unread&& a_unread,
+		Streamed&& a_streamed,
+		Resident&& a_resident)
+	{
+		std::vector<std::size_t> resident;
+		std::vector<std::tuple<const async_file*, extent_t, std::size_t>> streamed;
+		for (std::size_t i = 0; i < a_count; ++i) {
+			if (const auto unread = a_unread(i); unread) {
+				streamed.emplace_back(unread->first, unread->second, i);
+			} else {
+				resident.push_back(i);
+			}
+		}
+
+		// an archive can hold files from several sources, which are each read through their own queue
+		std::ranges::stable_sort(streamed, {}, [](const auto& a_job) { return std::get<0>(a_job); });
+		std::vector<extent_t> extents;
+		std::vector<std::size_t> jobs;
+		for (auto first = streamed.begin(); first != streamed.end();) {
+			const auto file = std::get<0>(*first);
+			extents.clear();
+			jobs.clear();
+			for (; first != streamed.end() && std::get<0>(*first) == file; ++first) {
+				extents.push_back(std::get<1>(*first));
+				jobs.push_back(std::get<2>(*first));
+			}
+
+			file->read_each(
+				extents,
+				a_threads,
+				[&](std::size_t a_idx, std::span<const std::byte> a_bytes) {
+					a_streamed(jobs[a_idx], a_bytes);
+				});
+		}
+
+		parallel_for(
+			resident.size(),
+			a_threads,
+			[&](std::size_t a_idx) {
+				a_resident(resident[a_idx]);
+			});
+	}
+}
@@ -0,0 +1,184 @@
+#include "bsa/detail/codec_context.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include <lz4frame.h>
+#include <lz4hc.h>
+#include <zlib.h>
+
+namespace bsa::detail
+{
+	codec_state::~codec_state() noexcept
+	{
+		if (_deflater_params) {
+			::deflateEnd(&_deflater);
+		}
+
+		if (_inflater_live) {
+			::inflateEnd(&_inflater);
+		}
+	}
+
+	auto codec_state::deflater(int a_level, int a_windowBits, int a_memLevel)
+		-> ::z_stream&
+	{
+		const deflate_params_t params{
+			.level = a_level,
+			.window_bits = a_windowBits,
+			.mem_level = a_memLevel,
+		};
+
+		if (_deflater_params == params) {
+			if (const auto result = ::deflateReset(&_deflater); result != Z_OK) {
+				throw bsa::compression_error(bsa::compression_error::library::zlib, result);
+			}
+			return _deflater;
+		}
+
+		if (_deflater_params) {
+			::deflateEnd(&_deflater);
+			_deflater_params.reset();
+		}
+
+		_deflater = {};
+		if (const auto result = deflateInit2(
+				&_deflater,
+				a_level,
+				Z_DEFLATED,
+				a_windowBits,
+				a_memLevel,
+				Z_DEFAULT_STRATEGY);
+			result != Z_OK) {
+			throw bsa::compression_error(bsa::compression_error::library::zlib, result);
+		}
+
+		_deflater_params = params;
+		return _deflater;
+	}
+
+	auto codec_state::inflater()
+		-> ::z_stream&
+	{
+		if (_inflater_live) {
+			if (const auto result = ::inflateReset(&_inflater); result != Z_OK) {
+				throw bsa::compression_error(bsa::compression_error::library::zlib, result);
+			}
+			return _inflater;
+		}
+
+		_inflater = {};
+		if (const auto result = inflateInit(&_inflater); result != Z_OK) {
+			throw bsa::compression_error(bsa::compression_error::library::zlib, result);
+		}
+
+		_inflater_live = true;
+		return _inflater;
+	}
+
+	auto codec_state::lz4f_compressor()
+		-> ::LZ4F_cctx&
+	{
+		if (!_lz4f_compressor) {
+			::LZ4F_cctx* pcctx = nullptr;
+			if (const auto result = ::LZ4F_createCompressionContext(&pcctx, LZ4F_VERSION);
+				::LZ4F_isError(result)) {
+				throw bsa::compression_error(bsa::compression_error::library::lz4, result);
+			}
+			_lz4f_compressor.reset(pcctx);
+		}
+
+		return *_lz4f_compressor;
+	}
+
+	auto codec_state::lz4f_decompressor()
+		-> ::LZ4F_dctx&
+	{
+		if (_lz4f_decompressor) {
+			::LZ4F_resetDecompressionContext(_lz4f_decompressor.get());
+		} else {
+			::LZ4F_dctx* pdctx = nullptr;
+			if (const auto result = ::LZ4F_createDecompressionContext(&pdctx, LZ4F_VERSION);
+				::LZ4F_isError(result)) {
+				throw bsa::compression_error(bsa::compression_error::library::lz4, result);
+			}
+			_lz4f_decompressor.reset(pdctx);
+		}
+
+		return *_lz4f_decompressor;
+	}
+
+	auto codec_state::lz4hc_state()
+		-> void*
+	{
+		if (!_lz4hc_state) {
+			_lz4hc_state = std::make_unique_for_overwrite<std::byte[]>(
+				static_cast<std::size_t>(::LZ4_sizeofStateHC()));
+		}
+
+		return _lz4hc_state.get();
+	}
+
+#ifdef BSA_DEFLATE_LIBDEFLATE
+	// libdeflate's failures to allocate are reported as zlib's, so errors read the same
+	//	regardless of the backend
+
+	auto codec_state::libdeflate_compressor(int a_level)
+		-> ::libdeflate_compressor&
+	{
+		if (!_libdeflate_compressor || _libdeflate_level != a_level) {
+			_libdeflate_compressor.reset(::libdeflate_alloc_compressor(a_level));
+			_libdeflate_level = a_level;
+			if (!_libdeflate_compressor) {
+				throw bsa::compression_error(bsa::compression_error::library::zlib, Z_MEM_ERROR);
+			}
+		}
+
+		return *_libdeflate_compressor;
+	}
+
+	auto codec_state::libdeflate_decompressor()
+		-> ::libdeflate_decompressor&
+	{
+		if (!_libdeflate_decompressor) {
+			_libdeflate_decompressor.reset(::libdeflate_alloc_decompressor());
+			if (!_libdeflate_decompressor) {
+				throw bsa::compression_error(bsa::compression_error::library::zlib, Z_MEM_ERROR);
+			}
+		}
+
+		return *_libdeflate_decompressor;
+	}
+#endif
+
+	auto get_codec_state(codec_context& a_context)
+		-> codec_state&
+	{
+		if (!a_context._state) {
+			a_context._state = std::make_unique<codec_state>();
+		}
+
+		return *a_context._state;
+	}
+
+	auto local_codec_context() noexcept
+		-> codec_context&
+	{
+		thread_local codec_context context;
+		return context;
+	}
+}
+
+namespace bsa
+{
+	codec_context::codec_context() noexcept = default;
+	codec_context::codec_context(codec_context&&) noexcept = default;
+	codec_context::~codec_context() noexcept = default;
+	codec_context& codec_context::operator=(codec_context&&) noexcept = default;
+
+	void codec_context::clear() noexcept
+	{
+		_state.reset();
+	}
+}
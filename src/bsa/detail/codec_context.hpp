@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+#include <lz4frame.h>
+#include <zlib.h>
+
+#ifdef BSA_DEFLATE_LIBDEFLATE
+#	include <libdeflate.h>
+#endif
+
+#include "bsa/detail/common.hpp"
+
+namespace bsa::detail
+{
+	// Every piece of state is created on first use, then reset, rather than recreated, on
+	//	every use after. The state never moves once created, since zlib's streams are checked
+	//	against their own address.
+	class codec_state final
+	{
+	public:
+		codec_state() noexcept = default;
+		codec_state(const codec_state&) = delete;
+		codec_state(codec_state&&) = delete;
+		~codec_state() noexcept;
+		codec_state& operator=(const codec_state&) = delete;
+		codec_state& operator=(codec_state&&) = delete;
+
+		// a deflate stream, ready to compress a new stream with the given parameters
+		[[nodiscard]] auto deflater(int a_level, int a_windowBits, int a_memLevel)
+			-> ::z_stream&;
+
+		// an inflate stream, ready to decompress a new stream
+		[[nodiscard]] auto inflater()
+			-> ::z_stream&;
+
+		[[nodiscard]] auto lz4f_compressor()
+			-> ::LZ4F_cctx&;
+
+		// an lz4 frame decompressor, ready to decompress a new frame
+		[[nodiscard]] auto lz4f_decompressor()
+			-> ::LZ4F_dctx&;
+
+		// scratch space for `LZ4_compress_HC_extStateHC`
+		[[nodiscard]] auto lz4hc_state()
+			-> void*;
+
+#ifdef BSA_DEFLATE_LIBDEFLATE
+		[[nodiscard]] auto libdeflate_compressor(int a_level)
+			-> ::libdeflate_compressor&;
+
+		[[nodiscard]] auto libdeflate_decompressor()
+			-> ::libdeflate_decompressor&;
+#endif
+
+	private:
+		struct deflate_params_t final
+		{
+			int level{ 0 };
+			int window_bits{ 0 };
+			int mem_level{ 0 };
+
+			[[nodiscard]] friend bool operator==(const deflate_params_t&, const deflate_params_t&) noexcept = default;
+		};
+
+		::z_stream _deflater{};
+		std::optional<deflate_params_t> _deflater_params;
+		::z_stream _inflater{};
+		bool _inflater_live{ false };
+		std::unique_ptr<::LZ4F_cctx, decltype(&::LZ4F_freeCompressionContext)> _lz4f_compressor{
+			nullptr,
+			::LZ4F_freeCompressionContext
+		};
+		std::unique_ptr<::LZ4F_dctx, decltype(&::LZ4F_freeDecompressionContext)> _lz4f_decompressor{
+			nullptr,
+			::LZ4F_freeDecompressionContext
+		};
+		std::unique_ptr<std::byte[]> _lz4hc_state;
+#ifdef BSA_DEFLATE_LIBDEFLATE
+		std::unique_ptr<::libdeflate_compressor, decltype(&::libdeflate_free_compressor)> _libdeflate_compressor{
+			nullptr,
+			::libdeflate_free_compressor
+		};
+		int _libdeflate_level{ 0 };
+		std::unique_ptr<::libdeflate_decompressor, decltype(&::libdeflate_free_decompressor)> _libdeflate_decompressor{
+			nullptr,
+			::libdeflate_free_decompressor
+		};
+#endif
+	};
+
+	// The context used whenever one is not given explicitly.
+	[[nodiscard]] auto local_codec_context() noexcept
+		-> codec_context&;
+}
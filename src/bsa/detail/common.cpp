@@ -1,29 +1,80 @@
 #include "bsa/detail/common.hpp"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <limits>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
 #include <span>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <variant>
 
 #include <lz4frame.h>
 #include <zlib.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define BSA_SIMD_SSE2 1
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#	define BSA_SIMD_NEON 1
+#	include <arm_neon.h>
+#endif
+
+#if BSA_OS_WINDOWS
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <Windows.h>
+#else
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
+
 #ifdef BSA_SUPPORT_XMEM
 #	include "bsa/xmem/xmem.hpp"
 #endif
 
+#include "bsa/detail/async_read.hpp"
+#include "bsa/detail/observe.hpp"
+
 namespace bsa
 {
 	namespace
 	{
+		constinit std::atomic<observer*> installed_observer{ nullptr };
+		constinit thread_local std::pmr::memory_resource* scoped_resource{ nullptr };
+
+#if !BSA_OS_WINDOWS
+		// madvise only accepts page aligned addresses, so the range is widened to the pages
+		//	it touches
+		void advise(std::span<const std::byte> a_bytes, int a_advice) noexcept
+		{
+			if (a_bytes.empty()) {
+				return;
+			}
+
+			static const auto page = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+			const auto first = reinterpret_cast<std::uintptr_t>(a_bytes.data()) & ~(page - 1);
+			const auto last = reinterpret_cast<std::uintptr_t>(a_bytes.data()) + a_bytes.size();
+			// a hint the kernel rejects is no worse than one it ignores
+			[[maybe_unused]] const auto result =
+				::madvise(reinterpret_cast<void*>(first), last - first, a_advice);
+		}
+#endif
+
 		[[nodiscard]] auto guess_file_format(detail::istream_t& a_in)
 			-> std::optional<file_format>
 		{
@@ -40,6 +91,49 @@ namespace bsa
 		}
 	}
 
+	auto get_observer() noexcept
+		-> observer*
+	{
+		return installed_observer.load(std::memory_order_acquire);
+	}
+
+	void set_observer(observer* a_observer) noexcept
+	{
+		installed_observer.store(a_observer, std::memory_order_release);
+	}
+
+	auto get_memory_resource() noexcept
+		-> std::pmr::memory_resource*
+	{
+		return scoped_resource ? scoped_resource : std::pmr::get_default_resource();
+	}
+
+	memory_scope::memory_scope(std::pmr::memory_resource& a_resource) noexcept :
+		_previous(scoped_resource)
+	{
+		scoped_resource = &a_resource;
+	}
+
+	memory_scope::~memory_scope() noexcept
+	{
+		scoped_resource = _previous;
+	}
+
+	void prefetch(std::span<const std::byte> a_bytes) noexcept
+	{
+#if BSA_OS_WINDOWS
+		if (!a_bytes.empty()) {
+			::WIN32_MEMORY_RANGE_ENTRY range{
+				const_cast<std::byte*>(a_bytes.data()),
+				a_bytes.size()
+			};
+			::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+		}
+#else
+		advise(a_bytes, MADV_WILLNEED);
+#endif
+	}
+
 	auto guess_file_format(std::filesystem::path a_path)
 		-> std::optional<file_format>
 	{
@@ -59,43 +153,78 @@ namespace bsa::detail
 {
 	namespace
 	{
-		[[nodiscard]] char mapchar(char a_ch) noexcept
+		[[nodiscard]] auto open_source(std::filesystem::path a_path, read_backend a_backend)
+			-> std::pair<std::shared_ptr<const void>, std::span<const std::byte>>
 		{
-			constexpr auto lut = []() noexcept {
-				std::array<char, (std::numeric_limits<unsigned char>::max)() + 1> map{};
-				for (std::size_t i = 0; i < map.size(); ++i) {
-					map[i] = static_cast<char>(i);
-				}
-
-				map[static_cast<std::size_t>('/')] = '\\';
-
-				constexpr auto offset = char{ 'a' - 'A' };
-				for (std::size_t i = 'A'; i <= 'Z'; ++i) {
-					map[i] = static_cast<char>(i) + offset;
-				}
+			if (a_backend == read_backend::async) {
+				auto file = std::make_shared<const async_file>(a_path);
+				const auto bytes = file->bytes();
+				return { std::move(file), bytes };
+			} else {
+				auto file = std::make_shared<const mmio::mapped_file_source>(std::move(a_path));
+				const std::span bytes{ file->data(), file->size() };
+				observe_io(observer::io::mapped, bytes.size());
+				return { std::move(file), bytes };
+			}
+		}
 
-				return map;
-			}();
+		// Where the given bytes lie within the source they view.
+		[[nodiscard]] auto extent_of(
+			std::span<const std::byte> a_source,
+			std::span<const std::byte> a_bytes) noexcept
+			-> extent_t
+		{
+			return {
+				static_cast<std::size_t>(a_bytes.data() - a_source.data()),
+				a_bytes.size()
+			};
+		}
+	}
 
-			return lut[static_cast<unsigned char>(a_ch)];
+	void map_chars(const char* a_src, char* a_dst, std::size_t a_count) noexcept
+	{
+		const auto last = a_src + a_count;
+#if defined(BSA_SIMD_SSE2)
+		for (; last - a_src >= 16; a_src += 16, a_dst += 16) {
+			auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_src));
+			// bytes >= 0x80 compare as negative, so they are never considered uppercase
+			const auto upper = _mm_and_si128(
+				_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)),
+				_mm_cmplt_epi8(chars, _mm_set1_epi8('Z' + 1)));
+			chars = _mm_add_epi8(chars, _mm_and_si128(upper, _mm_set1_epi8('a' - 'A')));
+			const auto slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+			chars = _mm_or_si128(
+				_mm_andnot_si128(slash, chars),
+				_mm_and_si128(slash, _mm_set1_epi8('\\')));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(a_dst), chars);
+		}
+#elif defined(BSA_SIMD_NEON)
+		for (; last - a_src >= 16; a_src += 16, a_dst += 16) {
+			auto chars = vld1q_u8(reinterpret_cast<const std::uint8_t*>(a_src));
+			const auto upper = vandq_u8(
+				vcgeq_u8(chars, vdupq_n_u8('A')),
+				vcleq_u8(chars, vdupq_n_u8('Z')));
+			chars = vaddq_u8(chars, vandq_u8(upper, vdupq_n_u8('a' - 'A')));
+			chars = vbslq_u8(vceqq_u8(chars, vdupq_n_u8('/')), vdupq_n_u8('\\'), chars);
+			vst1q_u8(reinterpret_cast<std::uint8_t*>(a_dst), chars);
+		}
+#endif
+		for (; a_src != last; ++a_src, ++a_dst) {
+			*a_dst = mapchar(*a_src);
 		}
 	}
 
 	void normalize_path(std::string& a_path) noexcept
 	{
-		for (auto& c : a_path) {
-			c = mapchar(c);
-		}
+		map_chars(a_path.data(), a_path.data(), a_path.size());
 
 		while (!a_path.empty() && a_path.back() == '\\') {
 			a_path.pop_back();
 		}
 
-		while (!a_path.empty() && a_path.front() == '\\') {
-			a_path.erase(a_path.begin());
-		}
+		a_path.erase(0, a_path.find_first_not_of('\\'));
 
-		if (a_path.empty() || a_path.size() >= 260) {
+		if (a_path.empty() || a_path.size() >= max_path) {
 			a_path = '.';
 		}
 	}
@@ -120,6 +249,56 @@ namespace bsa::detail
 		};
 	}
 
+	bool skip_compression(
+		std::span<const std::byte> a_data,
+		const compression_policy& a_policy) noexcept
+	{
+		if (!a_policy.max_entropy || a_data.empty()) {
+			return false;
+		}
+
+		// sample a handful of windows spread across the data, so large files cost no more to
+		//	probe than small ones
+		constexpr std::size_t windows = 4;
+		constexpr std::size_t window_size = 1u << 14;
+		std::array<std::size_t, 256> histogram{};
+		std::size_t total = 0;
+		const auto sample = [&](std::span<const std::byte> a_window) noexcept {
+			for (const auto byte : a_window) {
+				++histogram[std::to_integer<std::size_t>(byte)];
+			}
+			total += a_window.size();
+		};
+
+		if (a_data.size() <= windows * window_size) {
+			sample(a_data);
+		} else {
+			const auto stride = (a_data.size() - window_size) / (windows - 1);
+			for (std::size_t i = 0; i < windows; ++i) {
+				sample(a_data.subspan(i * stride, window_size));
+			}
+		}
+
+		double entropy = 0.0;
+		for (const auto count : histogram) {
+			if (count != 0) {
+				const auto p = static_cast<double>(count) / static_cast<double>(total);
+				entropy -= p * std::log2(p);
+			}
+		}
+
+		return entropy > *a_policy.max_entropy;
+	}
+
+	bool keep_compression(
+		std::size_t a_original,
+		std::size_t a_compressed,
+		const compression_policy& a_policy) noexcept
+	{
+		return !a_policy.max_ratio ||
+		       static_cast<double>(a_compressed) <= static_cast<double>(a_original) * *a_policy.max_ratio;
+	}
+
 	auto read_wstring(detail::istream_t& a_in)
 		-> std::string_view
 	{
@@ -165,19 +344,169 @@ namespace bsa::detail
 	}
 
 	istream_t::istream_t(std::filesystem::path a_path) :
-		_file(std::make_shared<file_type>(std::move(a_path))),
-		_stream({ _file->data(), _file->size() }),
-		_copy(copy_type::shallow)
+		istream_t(std::move(a_path), read_backend::mapped)
+	{}
+
+	istream_t::istream_t(std::filesystem::path a_path, access_profile a_profile) :
+		istream_t(std::move(a_path))
 	{
-		_stream.endian(std::endian::little);
+		const auto bytes = _stream.rdbuf();
+		switch (a_profile) {
+		case access_profile::normal:
+			break;
+#if BSA_OS_WINDOWS
+		// windows has no equivalent hints for an existing mapping
+		case access_profile::sequential:
+		case access_profile::random:
+		case access_profile::huge_pages:
+			break;
+		case access_profile::prefault:
+			bsa::prefetch(bytes);
+			break;
+#else
+		case access_profile::sequential:
+			advise(bytes, MADV_SEQUENTIAL);
+			break;
+		case access_profile::random:
+			advise(bytes, MADV_RANDOM);
+			break;
+		case access_profile::prefault:
+#	ifdef MADV_POPULATE_READ
+			advise(bytes, MADV_POPULATE_READ);
+#	else
+			advise(bytes, MADV_WILLNEED);
+#	endif
+			break;
+		case access_profile::huge_pages:
+#	ifdef MADV_HUGEPAGE
+			advise(bytes, MADV_HUGEPAGE);
+#	endif
+			break;
+#endif
+		default:
+			declare_unreachable();
+		}
+	}
+
+	istream_t::istream_t(std::filesystem::path a_path, read_backend a_backend) :
+		istream_t(open_source(std::move(a_path), a_backend))
+	{
+		if (a_backend == read_backend::async) {
+			_sparse = std::static_pointer_cast<const async_file>(_file);
+		}
 	}
 
+	istream_t::istream_t(source_type a_source) noexcept :
+		istream_t(std::move(a_source.first), a_source.second, copy_type::shallow)
+	{}
+
 	istream_t::istream_t(std::span<const std::byte> a_bytes, copy_type a_copy) noexcept :
 		_stream(a_bytes),
 		_copy(a_copy)
 	{
 		_stream.endian(std::endian::little);
 	}
+
+	istream_t::istream_t(
+		std::shared_ptr<file_type> a_file,
+		std::span<const std::byte> a_bytes,
+		copy_type a_copy) noexcept :
+		_file(std::move(a_file)),
+		_stream(a_bytes),
+		_copy(a_copy)
+	{
+		_stream.endian(std::endian::little);
+	}
+
+	istream_t::istream_t(
+		std::shared_ptr<file_type> a_file,
+		std::shared_ptr<const async_file> a_sparse,
+		std::span<const std::byte> a_bytes,
+		copy_type a_copy) noexcept :
+		_file(std::move(a_file)),
+		_sparse(std::move(a_sparse)),
+		_stream(a_bytes),
+		_copy(a_copy)
+	{
+		_stream.endian(std::endian::little);
+	}
+
+	void istream_t::fetch(extent_t a_extent) const
+	{
+		if (_sparse) {
+			_sparse->fetch(a_extent);
+		}
+	}
+
+	void istream_t::fetch(std::span<const extent_t> a_extents) const
+	{
+		if (_sparse) {
+			_sparse->fetch(a_extents);
+		}
+	}
+
+	void istream_t::fetch_all() const
+	{
+		this->fetch({ 0, _stream.rdbuf().size() });
+	}
+
+	auto istream_t::reopen() const noexcept
+		-> istream_t
+	{
+		return { _file, _sparse, _stream.rdbuf(), _copy };
+	}
+
+	auto string_arena::intern(std::string_view a_string)
+		-> std::string_view
+	{
+		if (const auto it = _index.find(a_string); it != _index.end()) {
+			return *it;
+		}
+
+		char* dst = nullptr;
+		if (a_string.size() > block_size / 4) {
+			// oversized strings get a block to themselves, so the current block isn't wasted
+			dst = _blocks.emplace_back(std::make_unique_for_overwrite<char[]>(a_string.size())).get();
+		} else {
+			if (a_string.size() > _available) {
+				_cursor = _blocks.emplace_back(std::make_unique_for_overwrite<char[]>(block_size)).get();
+				_available = block_size;
+			}
+			dst = _cursor;
+			_cursor += a_string.size();
+			_available -= a_string.size();
+		}
+
+		std::ranges::copy(a_string, dst);
+		const std::string_view result{ dst, a_string.size() };
+		_index.insert(result);
+		return result;
+	}
+
+	void string_arena::retain(std::shared_ptr<const void> a_storage)
+	{
+		if (a_storage && (_retained.empty() || _retained.back() != a_storage)) {
+			_retained.push_back(std::move(a_storage));
+		}
+	}
+
+	void string_arena::seal() noexcept
+	{
+		_index = {};
+	}
+
+	shared_source::shared_source(const istream_t& a_in) :
+		_file(a_in.file()),
+		_bytes(a_in->rdbuf()),
+		_copy(a_in.deep_copy() ? copy_type::deep : copy_type::shallow)
+	{
+		a_in.fetch_all();  // reopened streams are no longer sparse
+		if (!_file && a_in.deep_copy()) {
+			_owned.assign(_bytes.begin(), _bytes.end());
+			_bytes = { _owned.data(), _owned.size() };
+			observe_copy(_owned.size());
+		}
+	}
 }
 
 namespace bsa
@@ -208,12 +537,524 @@ namespace bsa
 			detail::declare_unreachable();
 		}
 	}
+
+	compression_error::compression_error(
+		const compression_error& a_error,
+		std::string_view a_path) :
+		_lib(a_error._lib)
+	{
+		_what.reserve(a_path.size() + 2 + a_error._what.size());
+		_what.append(a_path);
+		_what.append(": "sv);
+		_what.append(a_error._what);
+	}
+
+	namespace detail
+	{
+		std::uint64_t next_generation() noexcept
+		{
+			static std::atomic_uint64_t generation{ 0 };
+			return generation.fetch_add(1, std::memory_order_relaxed) + 1;
+		}
+	}
+
+	struct content_cache::shard_t final
+	{
+		struct key_hash final
+		{
+			[[nodiscard]] std::size_t operator()(const key_type& a_key) const noexcept
+			{
+				return std::hash<std::uint64_t>{}(
+					a_key.hi ^
+					std::rotl(a_key.lo, 21) ^
+					std::rotl(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(a_key.archive)), 42) ^
+					std::rotl(a_key.generation, 10));
+			}
+		};
+
+		using entry_type = std::pair<key_type, contents_type>;
+		using list_type = std::list<entry_type>;
+
+		mutable std::mutex lock;
+		list_type recency;  // most recently used first
+		std::unordered_map<key_type, list_type::iterator, key_hash> index;
+		std::size_t size{ 0 };
+		std::size_t budget{ 0 };
+		stats_type stats;
+	};
+
+	content_cache::content_cache(std::size_t a_budget, std::size_t a_shards) :
+		_shards(std::make_unique<shard_t[]>((std::max)(a_shards, std::size_t{ 1 }))),
+		_count((std::max)(a_shards, std::size_t{ 1 })),
+		_budget(a_budget)
+	{
+		for (std::size_t i = 0; i < _count; ++i) {
+			_shards[i].budget = _budget / _count;
+		}
+	}
+
+	content_cache::~content_cache() noexcept = default;
+
+	auto content_cache::size() const noexcept
+		-> std::size_t
+	{
+		std::size_t result = 0;
+		for (std::size_t i = 0; i < _count; ++i) {
+			const std::lock_guard l{ _shards[i].lock };
+			result += _shards[i].size;
+		}
+		return result;
+	}
+
+	auto content_cache::find(const key_type& a_key) noexcept
+		-> contents_type
+	{
+		auto& shard = this->shard_for(a_key);
+		const std::lock_guard l{ shard.lock };
+		const auto it = shard.index.find(a_key);
+		if (it == shard.index.end()) {
+			++shard.stats.misses;
+			return nullptr;
+		}
+
+		++shard.stats.hits;
+		shard.recency.splice(shard.recency.begin(), shard.recency, it->second);
+		return it->second->second;
+	}
+
+	void content_cache::clear() noexcept
+	{
+		for (std::size_t i = 0; i < _count; ++i) {
+			auto& shard = _shards[i];
+			const std::lock_guard l{ shard.lock };
+			shard.index.clear();
+			shard.recency.clear();
+			shard.size = 0;
+		}
+	}
+
+	auto content_cache::insert(const key_type& a_key, std::vector<std::byte> a_contents)
+		-> contents_type
+	{
+		const auto bytes = a_contents.size();
+		auto contents = std::make_shared<const std::vector<std::byte>>(std::move(a_contents));
+		auto& shard = this->shard_for(a_key);
+		if (bytes > shard.budget) {
+			return contents;
+		}
+
+		const std::lock_guard l{ shard.lock };
+		if (const auto it = shard.index.find(a_key); it != shard.index.end()) {
+			shard.recency.splice(shard.recency.begin(), shard.recency, it->second);
+			return it->second->second;
+		}
+
+		while (shard.size + bytes > shard.budget) {
+			const auto& [key, evicted] = shard.recency.back();
+			shard.size -= evicted->size();
+			shard.index.erase(key);
+			shard.recency.pop_back();
+			++shard.stats.evictions;
+		}
+
+		shard.recency.emplace_front(a_key, contents);
+		try {
+			shard.index.emplace(a_key, shard.recency.begin());
+		} catch (...) {
+			shard.recency.pop_front();
+			throw;
+		}
+		shard.size += bytes;
+		return contents;
+	}
+
+	auto content_cache::stats() const noexcept
+		-> stats_type
+	{
+		stats_type result;
+		for (std::size_t i = 0; i < _count; ++i) {
+			const std::lock_guard l{ _shards[i].lock };
+			const auto& stats = _shards[i].stats;
+			result.hits += stats.hits;
+			result.misses += stats.misses;
+			result.evictions += stats.evictions;
+		}
+		return result;
+	}
+
+	auto content_cache::shard_for(const key_type& a_key) const noexcept
+		-> shard_t&
+	{
+		// the index of each shard hashes the same keys, so the shard is picked from the high bits
+		const auto hash = static_cast<std::uint64_t>(shard_t::key_hash{}(a_key)) * 0x9E3779B97F4A7C15u;
+		return _shards[static_cast<std::size_t>(hash >> 32u) % _count];
+	}
+
+	namespace detail
+	{
+		namespace
+		{
+			class passthrough_source final
+			{
+			public:
+				passthrough_source(std::span<const std::byte> a_in) noexcept :
+					_in(a_in)
+				{}
+
+				[[nodiscard]] std::size_t read_some(std::span<std::byte> a_dst) noexcept
+				{
+					const auto size = (std::min)(a_dst.size(), _in.size());
+					std::memcpy(a_dst.data(), _in.data(), size);
+					_in = _in.subspan(size);
+					return size;
+				}
+
+			private:
+				std::span<const std::byte> _in;
+			};
+
+			class zlib_source final
+			{
+			public:
+				zlib_source(std::span<const std::byte> a_in) :
+					_stream(std::make_unique<::z_stream>())
+				{
+					_stream->next_in = reinterpret_cast<::Bytef*>(const_cast<std::byte*>(a_in.data()));
+					_stream->avail_in = static_cast<::uInt>(a_in.size());
+					if (const auto result = ::inflateInit(_stream.get()); result != Z_OK) {
+						throw bsa::compression_error(bsa::compression_error::library::zlib, result);
+					}
+				}
+
+				zlib_source(zlib_source&&) noexcept = default;
+				zlib_source& operator=(zlib_source&&) noexcept = default;
+
+				~zlib_source() noexcept
+				{
+					if (_stream) {
+						::inflateEnd(_stream.get());
+					}
+				}
+
+				[[nodiscard]] std::size_t read_some(std::span<std::byte> a_dst)
+				{
+					if (_finished) {
+						return 0;
+					}
+
+					a_dst = a_dst.first((std::min<std::size_t>)(a_dst.size(), (std::numeric_limits<::uInt>::max)()));
+					_stream->next_out = reinterpret_cast<::Bytef*>(a_dst.data());
+					_stream->avail_out = static_cast<::uInt>(a_dst.size());
+					const auto result = ::inflate(_stream.get(), Z_NO_FLUSH);
+					if (result == Z_STREAM_END) {
+						_finished = true;
+					} else if (result != Z_OK) {
+						throw bsa::compression_error(bsa::compression_error::library::zlib, result);
+					}
+
+					return a_dst.size() - _stream->avail_out;
+				}
+
+			private:
+				// zlib streams are self referential, so they must stay put
+				std::unique_ptr<::z_stream> _stream;
+				bool _finished{ false };
+			};
+
+			class lz4_frame_source final
+			{
+			public:
+				lz4_frame_source(std::span<const std::byte> a_in) :
+					_in(a_in)
+				{
+					::LZ4F_dctx* pdctx = nullptr;
+					if (const auto result = ::LZ4F_createDecompressionContext(&pdctx, LZ4F_VERSION);
+						::LZ4F_isError(result)) {
+						throw bsa::compression_error(bsa::compression_error::library::lz4, result);
+					}
+					_dctx.reset(pdctx);
+				}
+
+				[[nodiscard]] std::size_t read_some(std::span<std::byte> a_dst)
+				{
+					std::size_t read = 0;
+					while (!_finished && read < a_dst.size()) {
+						auto insz = _in.size();
+						auto outsz = a_dst.size() - read;
+						const auto result = ::LZ4F_decompress(
+							_dctx.get(),
+							a_dst.data() + read,
+							&outsz,
+							_in.data(),
+							&insz,
+							nullptr);
+						if (::LZ4F_isError(result)) {
+							throw bsa::compression_error(bsa::compression_error::library::lz4, result);
+						}
+
+						_in = _in.subspan(insz);
+						read += outsz;
+						if (result == 0) {
+							_finished = true;
+						} else if (insz == 0 && outsz == 0) {
+							break;
+						}
+					}
+
+					return read;
+				}
+
+			private:
+				struct deleter_t final
+				{
+					void operator()(::LZ4F_dctx* a_dctx) const noexcept { ::LZ4F_freeDecompressionContext(a_dctx); }
+				};
+
+				std::unique_ptr<::LZ4F_dctx, deleter_t> _dctx;
+				std::span<const std::byte> _in;
+				bool _finished{ false };
+			};
+
+			// The lz4 block format has no streaming api, so sequences are decoded by hand. Matches
+			//	can reach at most 64KiB back, so that much history is all we need to keep around.
+			class lz4_block_source final
+			{
+			public:
+				lz4_block_source(std::span<const std::byte> a_in) :
+					_in(a_in),
+					_history(history_size)
+				{}
+
+				[[nodiscard]] std::size_t read_some(std::span<std::byte> a_dst)
+				{
+					std::size_t read = 0;
+					while (read < a_dst.size()) {
+						const auto out = a_dst.subspan(read);
+						if (_literals > 0) {
+							const auto size = (std::min)(_literals, out.size());
+							if (size > _in.size()) {
+								throw bsa::compression_error(error_code::decompress_malformed_input);
+							}
+							std::memcpy(out.data(), _in.data(), size);
+							_in = _in.subspan(size);
+							this->remember(out.first(size));
+							_literals -= size;
+							read += size;
+							if (_literals == 0 && !_in.empty()) {
+								this->begin_match();
+							}
+						} else if (_match > 0) {
+							// copying at most `_offset` bytes at a time keeps the source and
+							//	destination from overlapping
+							const auto size = (std::min)({ _match, out.size(), _offset });
+							const auto first = (_written - _offset) % history_size;
+							const auto head = (std::min)(size, history_size - first);
+							std::memcpy(out.data(), _history.data() + first, head);
+							std::memcpy(out.data() + head, _history.data(), size - head);
+							this->remember(out.first(size));
+							_match -= size;
+							read += size;
+						} else if (!_in.empty()) {
+							this->begin_sequence();
+						} else {
+							break;
+						}
+					}
+
+					return read;
+				}
+
+			private:
+				static constexpr std::size_t history_size = 1u << 16;
+
+				[[nodiscard]] std::uint8_t next()
+				{
+					if (_in.empty()) {
+						throw bsa::compression_error(error_code::decompress_malformed_input);
+					}
+					const auto result = std::to_integer<std::uint8_t>(_in.front());
+					_in = _in.subspan(1);
+					return result;
+				}
+
+				[[nodiscard]] std::size_t next_length(std::size_t a_length)
+				{
+					if (a_length == 15) {
+						std::uint8_t extra = 0;
+						do {
+							extra = this->next();
+							a_length += extra;
+						} while (extra == 255);
+					}
+					return a_length;
+				}
+
+				void begin_sequence()
+				{
+					const auto token = this->next();
+					_pending = token & 0xFu;
+					_literals = this->next_length(token >> 4u);
+					if (_literals == 0) {
+						this->begin_match();
+					}
+				}
+
+				void begin_match()
+				{
+					const auto lo = this->next();
+					const auto hi = this->next();
+					_offset = static_cast<std::size_t>(lo | (hi << 8u));
+					_match = this->next_length(_pending) + 4;
+					if (_offset == 0 || _offset > (std::min)(_written, history_size - 1)) {
+						throw bsa::compression_error(error_code::decompress_malformed_input);
+					}
+				}
+
+				void remember(std::span<const std::byte> a_bytes) noexcept
+				{
+					const auto total = a_bytes.size();
+					if (total > history_size) {
+						a_bytes = a_bytes.last(history_size);
+					}
+
+					const auto first = (_written + total - a_bytes.size()) % history_size;
+					const auto head = (std::min)(a_bytes.size(), history_size - first);
+					std::memcpy(_history.data() + first, a_bytes.data(), head);
+					std::memcpy(_history.data(), a_bytes.data() + head, a_bytes.size() - head);
+					_written += total;
+				}
+
+				std::span<const std::byte> _in;
+				std::vector<std::byte> _history;
+				std::size_t _written{ 0 };
+				std::size_t _literals{ 0 };
+				std::size_t _match{ 0 };
+				std::size_t _offset{ 0 };
+				std::size_t _pending{ 0 };
+			};
+		}
+	}
+
+	class decompression_stream::source_t final
+	{
+	public:
+		template <class T>
+		source_t(std::in_place_type_t<T> a_type, std::span<const std::byte> a_in) :
+			_impl(a_type, a_in)
+		{}
+
+		[[nodiscard]] std::size_t read_some(std::span<std::byte> a_dst)
+		{
+			return std::visit(
+				[&](auto& a_impl) {
+					return a_impl.read_some(a_dst);
+				},
+				_impl);
+		}
+
+	private:
+		std::variant<
+			detail::passthrough_source,
+			detail::zlib_source,
+			detail::lz4_frame_source,
+			detail::lz4_block_source>
+			_impl;
+	};
+
+	decompression_stream::decompression_stream() noexcept = default;
+	decompression_stream::decompression_stream(decompression_stream&&) noexcept = default;
+	decompression_stream::~decompression_stream() noexcept = default;
+	decompression_stream& decompression_stream::operator=(decompression_stream&&) noexcept = default;
+
+	decompression_stream::decompression_stream(
+		codec a_codec,
+		std::span<const std::byte> a_in,
+		std::size_t a_size) :
+		_size(a_size)
+	{
+		switch (a_codec) {
+		case codec::none:
+			_source = std::make_unique<source_t>(std::in_place_type<detail::passthrough_source>, a_in);
+			break;
+		case codec::zlib:
+			_source = std::make_unique<source_t>(std::in_place_type<detail::zlib_source>, a_in);
+			break;
+		case codec::lz4_frame:
+			_source = std::make_unique<source_t>(std::in_place_type<detail::lz4_frame_source>, a_in);
+			break;
+		case codec::lz4_block:
+			_source = std::make_unique<source_t>(std::in_place_type<detail::lz4_block_source>, a_in);
+			break;
+		default:
+			detail::declare_unreachable();
+		}
+	}
+
+	void decompression_stream::read_bytes(std::span<std::byte> a_dst)
+	{
+		if (this->read_some(a_dst) != a_dst.size()) {
+			throw binary_io::buffer_exhausted();
+		}
+	}
+
+	std::size_t decompression_stream::read_some(std::span<std::byte> a_dst)
+	{
+		a_dst = a_dst.first((std::min)(a_dst.size(), _size - _pos));
+		std::size_t read = 0;
+		while (read < a_dst.size()) {
+			const auto size = _source->read_some(a_dst.subspan(read));
+			if (size == 0) {
+				throw bsa::compression_error(detail::error_code::decompress_size_mismatch);
+			}
+			read += size;
+		}
+
+		_pos += read;
+		return read;
+	}
+
+	void decompression_stream::seek_absolute(binary_io::streamoff a_pos)
+	{
+		if (a_pos < this->tell()) {
+			throw bsa::exception("decompression streams can not seek backwards");
+		} else if (static_cast<std::size_t>(a_pos) > _size) {
+			throw bsa::exception("decompression streams can not seek past the end");
+		}
+
+		std::array<std::byte, 1u << 12> discard;
+		while (_pos < static_cast<std::size_t>(a_pos)) {
+			const auto size = (std::min)(discard.size(), static_cast<std::size_t>(a_pos) - _pos);
+			this->read_bytes(std::span{ discard }.first(size));
+		}
+	}
 }
 
 namespace bsa::components
 {
 	auto basic_byte_container::as_bytes() const noexcept
 		-> std::span<const std::byte>
+	{
+		if (const auto deferred = std::get_if<data_deferred>(&_data); deferred) {
+			// like a page fault on a mapping, failing to read the bytes in is fatal
+			deferred->f->fetch(detail::extent_of(deferred->f->bytes(), deferred->d));
+		}
+		return this->view();
+	}
+
+	auto basic_byte_container::unread() const noexcept
+		-> std::optional<std::pair<const detail::async_file*, detail::extent_t>>
+	{
+		if (const auto deferred = std::get_if<data_deferred>(&_data); deferred) {
+			const auto extent = detail::extent_of(deferred->f->bytes(), deferred->d);
+			if (!deferred->f->resident(extent)) {
+				return std::make_pair(deferred->f.get(), extent);
+			}
+		}
+		return std::nullopt;
+	}
+
+	auto basic_byte_container::view() const noexcept
+		-> std::span<const std::byte>
 	{
 		switch (_data.index()) {
 		case data_view:
@@ -228,6 +1069,8 @@ namespace bsa::components
 			}
 		case data_proxied:
 			return std::get_if<data_proxied>(&_data)->d;
+		case data_deferred:
+			return std::get_if<data_deferred>(&_data)->d;
 		default:
 			detail::declare_unreachable();
 		}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace bsa::detail
+{
+	[[nodiscard]] constexpr auto mix_hash(std::uint64_t a_value) noexcept
+		-> std::uint64_t
+	{
+		a_value ^= a_value >> 33u;
+		a_value *= 0xFF51AFD7ED558CCD;
+		a_value ^= a_value >> 33u;
+		a_value *= 0xC4CEB9FE1A85EC53;
+		a_value ^= a_value >> 33u;
+		return a_value;
+	}
+
+	// A fast, non-cryptographic hash of a blob, which consumes 8 bytes at a time.
+	// Hashes are only compared in memory, so they need not be stable across platforms.
+	[[nodiscard]] inline auto content_hash(std::span<const std::byte> a_bytes) noexcept
+		-> std::uint64_t
+	{
+		constexpr std::uint64_t k = 0x9E3779B97F4A7C15;
+
+		std::uint64_t result = a_bytes.size() * k;
+		std::size_t i = 0;
+		for (; i + sizeof(std::uint64_t) <= a_bytes.size(); i += sizeof(std::uint64_t)) {
+			std::uint64_t word = 0;
+			std::memcpy(&word, a_bytes.data() + i, sizeof(word));
+			result = (result ^ mix_hash(word)) * k;
+		}
+
+		if (i < a_bytes.size()) {
+			std::uint64_t word = 0;
+			std::memcpy(&word, a_bytes.data() + i, a_bytes.size() - i);
+			result = (result ^ mix_hash(word)) * k;
+		}
+
+		return mix_hash(result);
+	}
+
+	// Checks if two compressed byte containers would be written out identically.
+	template <class T>
+	[[nodiscard]] bool same_contents(
+		const T& a_lhs,
+		const T& a_rhs) noexcept
+	{
+		if (a_lhs.compressed() != a_rhs.compressed() ||
+			(a_lhs.compressed() && a_lhs.decompressed_size() != a_rhs.decompressed_size())) {
+			return false;
+		}
+
+		const auto lhs = a_lhs.as_bytes();
+		const auto rhs = a_rhs.as_bytes();
+		return lhs.size() == rhs.size() &&
+		       (lhs.data() == rhs.data() || std::equal(lhs.begin(), lhs.end(), rhs.begin()));
+	}
+
+	// Maps every blob in `[0, a_count)` to the first blob with identical contents, which may be
+	//	itself. Blobs are bucketed by `a_hash`, and then verified with `a_equal`, so hash
+	//	collisions never share data.
+	template <class Hash, class Equal>
+	[[nodiscard]] auto share_duplicates(
+		std::size_t a_count,
+		Hash&& a_hash,
+		Equal&& a_equal)
+		-> std::vector<std::size_t>
+	{
+		std::vector<std::size_t> result(a_count);
+		std::unordered_multimap<std::uint64_t, std::size_t> seen;
+		seen.reserve(a_count);
+
+		for (std::size_t i = 0; i < a_count; ++i) {
+			result[i] = i;
+			const auto hash = a_hash(i);
+			for (auto [first, last] = seen.equal_range(hash); first != last; ++first) {
+				if (a_equal(first->second, i)) {
+					result[i] = first->second;
+					break;
+				}
+			}
+
+			if (result[i] == i) {
+				seen.emplace(hash, i);
+			}
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,276 @@
+#include "bsa/detail/deflate.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <span>
+
+#include <zlib.h>
+
+#ifdef BSA_DEFLATE_LIBDEFLATE
+#	include <libdeflate.h>
+#endif
+
+#include "bsa/detail/codec_context.hpp"
+
+namespace bsa::detail::deflate
+{
+	namespace
+	{
+		constexpr auto build_backend =
+#if defined(BSA_DEFLATE_LIBDEFLATE)
+			deflate_backend::libdeflate;
+#elif defined(BSA_DEFLATE_ZLIB_NG)
+			deflate_backend::zlib_ng;
+#else
+			deflate_backend::zlib;
+#endif
+
+		constinit std::atomic<deflate_backend> selected_backend{ build_backend };
+
+		namespace zlib
+		{
+			[[nodiscard]] auto compress_bound(std::size_t a_size) noexcept
+				-> std::size_t
+			{
+				return ::compressBound(static_cast<::uLong>(a_size));
+			}
+
+			[[nodiscard]] auto compress(
+				codec_state& a_state,
+				std::span<std::byte> a_out,
+				std::span<const std::byte> a_in,
+				int a_level,
+				int a_windowBits,
+				int a_memLevel)
+				-> std::size_t
+			{
+				auto& stream = a_state.deflater(a_level, a_windowBits, a_memLevel);
+				stream.next_out = reinterpret_cast<::Bytef*>(a_out.data());
+				stream.avail_out = 0;
+				stream.next_in = (z_const ::Bytef*)a_in.data();
+				stream.avail_in = 0;
+
+				auto insz = a_in.size_bytes();
+				auto outsz = a_out.size_bytes();
+				int error = Z_OK;
+				do {
+					if (stream.avail_out == 0) {
+						stream.avail_out = static_cast<::uInt>(
+							std::min<std::size_t>((std::numeric_limits<::uInt>::max)(), outsz));
+						outsz -= stream.avail_out;
+					}
+
+					if (stream.avail_in == 0) {
+						stream.avail_in = static_cast<::uInt>(
+							std::min<std::size_t>((std::numeric_limits<::uInt>::max)(), insz));
+						insz -= stream.avail_in;
+					}
+
+					error = ::deflate(&stream, insz > 0 ? Z_NO_FLUSH : Z_FINISH);
+				} while (error == Z_OK);
+
+				if (error != Z_STREAM_END) {
+					throw bsa::compression_error(bsa::compression_error::library::zlib, error);
+				}
+
+				return static_cast<std::size_t>(stream.total_out);
+			}
+
+			// equivalent to `::uncompress`, except the stream is reused
+			[[nodiscard]] auto decompress(
+				codec_state& a_state,
+				std::span<std::byte> a_out,
+				std::span<const std::byte> a_in)
+				-> std::size_t
+			{
+				auto& stream = a_state.inflater();
+				stream.next_out = reinterpret_cast<::Bytef*>(a_out.data());
+				stream.avail_out = 0;
+				stream.next_in = (z_const ::Bytef*)a_in.data();
+				stream.avail_in = 0;
+
+				auto insz = a_in.size_bytes();
+				auto outsz = a_out.size_bytes();
+				int error = Z_OK;
+				do {
+					if (stream.avail_out == 0) {
+						stream.avail_out = static_cast<::uInt>(
+							std::min<std::size_t>((std::numeric_limits<::uInt>::max)(), outsz));
+						outsz -= stream.avail_out;
+					}
+
+					if (stream.avail_in == 0) {
+						stream.avail_in = static_cast<::uInt>(
+							std::min<std::size_t>((std::numeric_limits<::uInt>::max)(), insz));
+						insz -= stream.avail_in;
+					}
+
+					error = ::inflate(&stream, Z_NO_FLUSH);
+				} while (error == Z_OK);
+
+				switch (error) {
+				case Z_STREAM_END:
+					return static_cast<std::size_t>(stream.total_out);
+				case Z_NEED_DICT:
+					throw bsa::compression_error(bsa::compression_error::library::zlib, Z_DATA_ERROR);
+				case Z_BUF_ERROR:
+					// running out of input before the end of the stream means it was truncated
+					throw bsa::compression_error(
+						bsa::compression_error::library::zlib,
+						outsz + stream.avail_out > 0 ? Z_DATA_ERROR : Z_BUF_ERROR);
+				default:
+					throw bsa::compression_error(bsa::compression_error::library::zlib, error);
+				}
+			}
+		}
+
+#ifdef BSA_DEFLATE_LIBDEFLATE
+		// libdeflate has its own result codes, which are reported as their zlib equivalents, so
+		//	errors read the same regardless of the backend
+		namespace libdeflate
+		{
+			[[nodiscard]] auto compress_bound(std::size_t a_size) noexcept
+				-> std::size_t
+			{
+				return ::libdeflate_zlib_compress_bound(nullptr, a_size);
+			}
+
+			[[nodiscard]] auto compress(
+				codec_state& a_state,
+				std::span<std::byte> a_out,
+				std::span<const std::byte> a_in,
+				int a_level)
+				-> std::size_t
+			{
+				// libdeflate's levels extend past zlib's, but agree with them where they overlap
+				const auto level = a_level == Z_DEFAULT_COMPRESSION ? 6 : a_level;
+				const auto result = ::libdeflate_zlib_compress(
+					&a_state.libdeflate_compressor(level),
+					a_in.data(),
+					a_in.size_bytes(),
+					a_out.data(),
+					a_out.size_bytes());
+				if (result == 0) {
+					throw bsa::compression_error(bsa::compression_error::library::zlib, Z_BUF_ERROR);
+				}
+
+				return result;
+			}
+
+			[[nodiscard]] auto decompress(
+				codec_state& a_state,
+				std::span<std::byte> a_out,
+				std::span<const std::byte> a_in)
+				-> std::size_t
+			{
+				std::size_t outsz = 0;
+				const auto result = ::libdeflate_zlib_decompress(
+					&a_state.libdeflate_decompressor(),
+					a_in.data(),
+					a_in.size_bytes(),
+					a_out.data(),
+					a_out.size_bytes(),
+					&outsz);
+				switch (result) {
+				case LIBDEFLATE_SUCCESS:
+					return outsz;
+				case LIBDEFLATE_INSUFFICIENT_SPACE:
+					throw bsa::compression_error(bsa::compression_error::library::zlib, Z_BUF_ERROR);
+				default:
+					throw bsa::compression_error(bsa::compression_error::library::zlib, Z_DATA_ERROR);
+				}
+			}
+		}
+#endif
+	}
+
+	auto compress_bound(std::size_t a_size) noexcept
+		-> std::size_t
+	{
+		auto result = zlib::compress_bound(a_size);
+#if defined(BSA_DEFLATE_LIBDEFLATE)
+		result = std::max(result, libdeflate::compress_bound(a_size));
+#elif defined(BSA_DEFLATE_ZLIB_NG)
+		result = std::max(result, zlib_ng::compress_bound(a_size));
+#endif
+		return result;
+	}
+
+	auto compress(
+		codec_context& a_context,
+		std::span<std::byte> a_out,
+		std::span<const std::byte> a_in,
+		int a_level,
+		int a_windowBits,
+		int a_memLevel)
+		-> std::size_t
+	{
+		auto& state = get_codec_state(a_context);
+		switch (selected_backend.load(std::memory_order_relaxed)) {
+#if defined(BSA_DEFLATE_LIBDEFLATE)
+		case deflate_backend::libdeflate:
+			// libdeflate always compresses with a 32KiB window, and ignores zlib's memory
+			//	tuning, since it only changes how much zlib can keep track of at once
+			if (a_windowBits == default_window_bits) {
+				return libdeflate::compress(state, a_out, a_in, a_level);
+			}
+			break;
+#elif defined(BSA_DEFLATE_ZLIB_NG)
+		case deflate_backend::zlib_ng:
+			return zlib_ng::compress(a_out, a_in, a_level, a_windowBits, a_memLevel);
+#endif
+		default:
+			break;
+		}
+
+		return zlib::compress(state, a_out, a_in, a_level, a_windowBits, a_memLevel);
+	}
+
+	auto decompress(
+		codec_context& a_context,
+		std::span<std::byte> a_out,
+		std::span<const std::byte> a_in)
+		-> std::size_t
+	{
+		auto& state = get_codec_state(a_context);
+		switch (selected_backend.load(std::memory_order_relaxed)) {
+#if defined(BSA_DEFLATE_LIBDEFLATE)
+		case deflate_backend::libdeflate:
+			return libdeflate::decompress(state, a_out, a_in);
+#elif defined(BSA_DEFLATE_ZLIB_NG)
+		case deflate_backend::zlib_ng:
+			return zlib_ng::decompress(a_out, a_in);
+#endif
+		default:
+			return zlib::decompress(state, a_out, a_in);
+		}
+	}
+}
+
+namespace bsa
+{
+	bool deflate_backend_available(deflate_backend a_backend) noexcept
+	{
+		return a_backend == deflate_backend::zlib ||
+		       a_backend == detail::deflate::build_backend;
+	}
+
+	auto get_deflate_backend() noexcept
+		-> deflate_backend
+	{
+		return detail::deflate::selected_backend.load(std::memory_order_relaxed);
+	}
+
+	bool set_deflate_backend(deflate_backend a_backend) noexcept
+	{
+		if (!deflate_backend_available(a_backend)) {
+			return false;
+		}
+
+		detail::deflate::selected_backend.store(a_backend, std::memory_order_relaxed);
+		return true;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+#include "bsa/detail/common.hpp"
+
+namespace bsa::detail::deflate
+{
+	// the parameters `::compress` uses
+	inline constexpr int default_level = -1;
+	inline constexpr int default_window_bits = 15;
+	inline constexpr int default_mem_level = 8;
+
+	// An upper bound on the size of a zlib stream compressed from `a_size` bytes, which holds
+	//	for every backend, since the selected backend may change between sizing and compressing.
+	[[nodiscard]] auto compress_bound(std::size_t a_size) noexcept
+		-> std::size_t;
+
+	// Compresses `a_in` into a zlib stream using the selected backend, and returns the size of
+	//	the stream. Backends which can not honour `a_windowBits` fall back to zlib, since a
+	//	stream referencing further back than the window requested may be rejected by the games.
+	[[nodiscard]] auto compress(
+		codec_context& a_context,
+		std::span<std::byte> a_out,
+		std::span<const std::byte> a_in,
+		int a_level = default_level,
+		int a_windowBits = default_window_bits,
+		int a_memLevel = default_mem_level)
+		-> std::size_t;
+
+	// Decompresses the zlib stream `a_in` using the selected backend, and returns the number
+	//	of bytes written to `a_out`.
+	[[nodiscard]] auto decompress(
+		codec_context& a_context,
+		std::span<std::byte> a_out,
+		std::span<const std::byte> a_in)
+		-> std::size_t;
+
+#ifdef BSA_DEFLATE_ZLIB_NG
+	// zlib-ng's native api can not share a translation unit with zlib's, so it lives in its own
+	namespace zlib_ng
+	{
+		[[nodiscard]] auto compress_bound(std::size_t a_size) noexcept
+			-> std::size_t;
+
+		[[nodiscard]] auto compress(
+			std::span<std::byte> a_out,
+			std::span<const std::byte> a_in,
+			int a_level,
+			int a_windowBits,
+			int a_memLevel)
+			-> std::size_t;
+
+		[[nodiscard]] auto decompress(
+			std::span<std::byte> a_out,
+			std::span<const std::byte> a_in)
+			-> std::size_t;
+	}
+#endif
+}
@@ -0,0 +1,94 @@
+#ifdef BSA_DEFLATE_ZLIB_NG
+
+#	include "bsa/detail/deflate.hpp"
+
+#	include <algorithm>
+#	include <cstddef>
+#	include <cstdint>
+#	include <limits>
+#	include <span>
+
+#	include <zlib-ng.h>
+
+namespace bsa::detail::deflate::zlib_ng
+{
+	auto compress_bound(std::size_t a_size) noexcept
+		-> std::size_t
+	{
+		return ::zng_compressBound(a_size);
+	}
+
+	auto compress(
+		std::span<std::byte> a_out,
+		std::span<const std::byte> a_in,
+		int a_level,
+		int a_windowBits,
+		int a_memLevel)
+		-> std::size_t
+	{
+		::zng_stream stream = {};
+		if (const auto result = ::zng_deflateInit2(
+				&stream,
+				a_level,
+				Z_DEFLATED,
+				a_windowBits,
+				a_memLevel,
+				Z_DEFAULT_STRATEGY);
+			result != Z_OK) {
+			throw bsa::compression_error(bsa::compression_error::library::zlib, result);
+		}
+
+		stream.next_out = reinterpret_cast<std::uint8_t*>(a_out.data());
+		stream.avail_out = 0;
+		stream.next_in = reinterpret_cast<const std::uint8_t*>(a_in.data());
+		stream.avail_in = 0;
+
+		auto insz = a_in.size_bytes();
+		auto outsz = a_out.size_bytes();
+		int error = Z_OK;
+		do {
+			if (stream.avail_out == 0) {
+				stream.avail_out = static_cast<std::uint32_t>(
+					std::min<std::size_t>((std::numeric_limits<std::uint32_t>::max)(), outsz));
+				outsz -= stream.avail_out;
+			}
+
+			if (stream.avail_in == 0) {
+				stream.avail_in = static_cast<std::uint32_t>(
+					std::min<std::size_t>((std::numeric_limits<std::uint32_t>::max)(), insz));
+				insz -= stream.avail_in;
+			}
+
+			error = ::zng_deflate(&stream, insz > 0 ? Z_NO_FLUSH : Z_FINISH);
+		} while (error == Z_OK);
+
+		const auto finalsz = static_cast<std::size_t>(stream.total_out);
+		::zng_deflateEnd(&stream);
+
+		if (error != Z_STREAM_END) {
+			throw bsa::compression_error(bsa::compression_error::library::zlib, error);
+		}
+
+		return finalsz;
+	}
+
+	auto decompress(
+		std::span<std::byte> a_out,
+		std::span<const std::byte> a_in)
+		-> std::size_t
+	{
+		auto outsz = a_out.size_bytes();
+		const auto result = ::zng_uncompress(
+			reinterpret_cast<std::uint8_t*>(a_out.data()),
+			&outsz,
+			reinterpret_cast<const std::uint8_t*>(a_in.data()),
+			a_in.size_bytes());
+		if (result != Z_OK) {
+			throw bsa::compression_error(bsa::compression_error::library::zlib, result);
+		}
+
+		return outsz;
+	}
+}
+
+#endif
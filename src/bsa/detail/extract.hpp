@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <binary_io/file_stream.hpp>
+#include <mmio/mmio.hpp>
+
+#include "bsa/detail/common.hpp"
+
+namespace bsa::detail
+{
+	// Resolves a virtual path from an archive against the extraction root.
+	// Archives are untrusted input, so components which would climb out of the root (`..`, drive
+	//	letters, absolute paths) are rejected instead of being resolved.
+	[[nodiscard]] inline auto make_extract_path(
+		const std::filesystem::path& a_root,
+		std::string_view a_path)
+		-> std::filesystem::path
+	{
+		auto result = a_root;
+		while (!a_path.empty()) {
+			const auto pos = a_path.find_first_of("\\/"sv);
+			const auto part = a_path.substr(0, pos);
+			a_path = pos != std::string_view::npos ? a_path.substr(pos + 1) : ""sv;
+
+			if (part.empty() || part == "."sv) {
+				continue;
+			}
+
+			const std::filesystem::path component{ part };
+			if (part == ".."sv || component.has_root_path()) {
+				throw bsa::exception("archive path escapes the extraction directory");
+			}
+
+			result /= component;
+		}
+
+		if (result == a_root) {
+			throw bsa::exception("archive path is empty");
+		}
+
+		return result;
+	}
+
+	// Creates the parent directory of every path serially, so that extraction threads never
+	//	race to create the same directory.
+	inline void create_parent_directories(std::span<const std::filesystem::path> a_paths)
+	{
+		std::vector<std::filesystem::path> parents;
+		parents.reserve(a_paths.size());
+		for (const auto& path : a_paths) {
+			parents.push_back(path.parent_path());
+		}
+
+		std::sort(parents.begin(), parents.end());
+		parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+		for (const auto& parent : parents) {
+			std::filesystem::create_directories(parent);
+		}
+	}
+
+	// Maps a file of `a_size` bytes at `a_path`, and lets `a_write` fill it in place.
+	template <class F>
+	void extract_file(
+		const std::filesystem::path& a_path,
+		std::size_t a_size,
+		F&& a_write)
+	{
+		if (a_size == 0) {
+			// empty files can't be mapped
+			binary_io::file_ostream{ a_path };
+			return;
+		}
+
+		mmio::mapped_file_sink out;
+		if (!out.open(a_path, a_size)) {
+			throw std::system_error(
+				std::make_error_code(std::errc::io_error),
+				"failed to map output file");
+		}
+
+		std::forward<F>(a_write)(std::span<std::byte>{ out.data(), out.size() });
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <binary_io/file_stream.hpp>
+#include <mmio/mmio.hpp>
+
+namespace bsa::detail::index_cache
+{
+	// A sidecar index is laid out as:
+	//	header_t | Info | archive path (utf-8) | Record[header_t::records]
+	// Every field is stored in native byte order with native sizes, so a sidecar is only
+	//	valid on the machine (or at least the abi) which wrote it. The header records
+	//	enough about the layout to reject sidecars from anywhere else.
+	struct header_t final
+	{
+		std::uint32_t magic{ 0 };
+		std::uint32_t layout{ 0 };
+		std::uint32_t info_size{ 0 };
+		std::uint32_t record_size{ 0 };
+		std::uint64_t archive_size{ 0 };
+		std::int64_t archive_time{ 0 };
+		std::uint64_t path_size{ 0 };
+		std::uint64_t records{ 0 };
+	};
+
+	// bump whenever the layout of the header, or any info/record type, changes
+	inline constexpr std::uint32_t layout_version = 1;
+	inline constexpr std::uint32_t magic =
+		std::endian::native == std::endian::little ? 0x58444942u : 0x42494458u;  // "BIDX"
+
+	// Identifies the state of an archive on disk: if either of these change, the archive
+	//	must be parsed again.
+	[[nodiscard]] inline auto stamp(const std::filesystem::path& a_archive)
+		-> std::pair<std::uint64_t, std::int64_t>
+	{
+		return {
+			static_cast<std::uint64_t>(std::filesystem::file_size(a_archive)),
+			static_cast<std::int64_t>(std::filesystem::last_write_time(a_archive).time_since_epoch().count())
+		};
+	}
+
+	[[nodiscard]] inline auto path_key(const std::filesystem::path& a_archive)
+		-> std::string
+	{
+		std::error_code ec;
+		auto path = std::filesystem::weakly_canonical(a_archive, ec);
+		if (ec) {
+			path = std::filesystem::absolute(a_archive);
+		}
+
+		const auto u8 = path.u8string();
+		return { reinterpret_cast<const char*>(u8.data()), u8.size() };
+	}
+
+	// Loads the records stored in `a_cache`, if it is a valid sidecar for `a_archive` in its
+	//	current state. The records are copied out of the mapping in a single pass.
+	template <class Info, class Record>
+	[[nodiscard]] auto load(
+		const std::filesystem::path& a_cache,
+		const std::filesystem::path& a_archive,
+		Info& a_info)
+		-> std::optional<std::vector<Record>>
+	{
+		static_assert(std::is_trivially_copyable_v<Info>);
+		static_assert(std::is_trivially_copyable_v<Record>);
+
+		std::error_code ec;
+		if (!std::filesystem::is_regular_file(a_cache, ec)) {
+			return std::nullopt;
+		}
+
+		mmio::mapped_file_source in;
+		if (!in.open(a_cache) || in.size() < sizeof(header_t)) {
+			return std::nullopt;
+		}
+
+		const std::span bytes{ in.data(), in.size() };
+		header_t header;
+		std::memcpy(&header, bytes.data(), sizeof(header));
+
+		const auto [size, time] = stamp(a_archive);
+		const auto path = path_key(a_archive);
+		if (header.magic != magic ||
+			header.layout != layout_version ||
+			header.info_size != sizeof(Info) ||
+			header.record_size != sizeof(Record) ||
+			header.archive_size != size ||
+			header.archive_time != time ||
+			header.path_size != path.size()) {
+			return std::nullopt;
+		}
+
+		const auto rest = bytes.subspan(sizeof(header_t));
+		if (rest.size() < sizeof(Info) + path.size() ||
+			(rest.size() - sizeof(Info) - path.size()) / sizeof(Record) != header.records ||
+			(rest.size() - sizeof(Info) - path.size()) % sizeof(Record) != 0) {
+			return std::nullopt;
+		}
+
+		if (std::memcmp(rest.data() + sizeof(Info), path.data(), path.size()) != 0) {
+			return std::nullopt;
+		}
+
+		std::memcpy(&a_info, rest.data(), sizeof(Info));
+		std::vector<Record> records(static_cast<std::size_t>(header.records));
+		std::memcpy(
+			records.data(),
+			rest.data() + sizeof(Info) + path.size(),
+			records.size() * sizeof(Record));
+		return records;
+	}
+
+	// Writes a sidecar for `a_archive` in its current state to `a_cache`.
+	template <class Info, class Record>
+	void store(
+		const std::filesystem::path& a_cache,
+		const std::filesystem::path& a_archive,
+		const Info& a_info,
+		std::span<const Record> a_records)
+	{
+		static_assert(std::is_trivially_copyable_v<Info>);
+		static_assert(std::is_trivially_copyable_v<Record>);
+
+		const auto [size, time] = stamp(a_archive);
+		const auto path = path_key(a_archive);
+		const header_t header{
+			.magic = magic,
+			.layout = layout_version,
+			.info_size = sizeof(Info),
+			.record_size = sizeof(Record),
+			.archive_size = size,
+			.archive_time = time,
+			.path_size = path.size(),
+			.records = a_records.size(),
+		};
+
+		const auto as_bytes = [](const auto& a_value) noexcept {
+			return std::as_bytes(std::span{ &a_value, 1 });
+		};
+
+		binary_io::file_ostream out{ a_cache };
+		out.write_bytes(as_bytes(header));
+		out.write_bytes(as_bytes(a_info));
+		out.write_bytes(std::as_bytes(std::span{ path }));
+		out.write_bytes(std::as_bytes(a_records));
+	}
+}
@@ -0,0 +1,1213 @@
+#include "bsa/detail/lzx.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace bsa::detail::lzx
+{
+	namespace
+	{
+		namespace constants
+		{
+			constexpr std::size_t window_bits = 17;
+			constexpr std::size_t window_size = std::size_t{ 1 } << window_bits;
+			constexpr std::size_t frame_size = 0x8000;
+
+			constexpr std::size_t min_match = 2;
+			constexpr std::size_t max_match = 257;
+			constexpr std::size_t num_chars = 256;
+			constexpr std::size_t num_primary_lengths = 7;
+			constexpr std::size_t num_secondary_lengths = 249;
+			constexpr std::size_t position_slots = window_bits * 2;
+
+			constexpr std::size_t pretree_symbols = 20;
+			constexpr std::size_t aligned_symbols = 8;
+			constexpr std::size_t main_symbols = num_chars + position_slots * 8;
+			constexpr std::size_t length_symbols = num_secondary_lengths;
+			constexpr std::size_t max_code_length = 16;
+
+			// runs of code lengths may spill past the end of a table
+			constexpr std::size_t length_table_safety = 64;
+
+			// e8 translation is only ever applied to the first 32768 frames
+			constexpr std::size_t max_translated_frames = 32768;
+		}
+
+		enum class block_type : std::uint32_t
+		{
+			invalid,
+			verbatim,
+			aligned,
+			uncompressed
+		};
+
+		struct slot_t
+		{
+			std::uint32_t base{ 0 };
+			std::uint8_t extra_bits{ 0 };
+		};
+
+		// the offsets of matches are coded as a slot, plus some number of extra bits
+		constexpr auto slots = []() noexcept {
+			std::array<slot_t, constants::position_slots> result{};
+			std::uint32_t base = 0;
+			for (std::size_t i = 0; i < result.size(); ++i) {
+				const auto extra = i < 4 ? 0 : (std::min<std::size_t>)(i / 2 - 1, 17);
+				result[i].base = base;
+				result[i].extra_bits = static_cast<std::uint8_t>(extra);
+				base += std::uint32_t{ 1 } << extra;
+			}
+			return result;
+		}();
+
+		[[noreturn]] void throw_malformed()
+		{
+			throw bsa::compression_error(error_code::decompress_malformed_input);
+		}
+
+		[[nodiscard]] auto read_be16(std::span<const std::byte> a_in, std::size_t a_pos) noexcept
+			-> std::size_t
+		{
+			return std::size_t{ static_cast<std::uint8_t>(a_in[a_pos]) } << 8u |
+			       std::size_t{ static_cast<std::uint8_t>(a_in[a_pos + 1]) };
+		}
+
+		[[nodiscard]] auto read_le32(std::span<const std::byte> a_in, std::size_t a_pos) noexcept
+			-> std::uint32_t
+		{
+			return std::uint32_t{ static_cast<std::uint8_t>(a_in[a_pos]) } |
+			       std::uint32_t{ static_cast<std::uint8_t>(a_in[a_pos + 1]) } << 8u |
+			       std::uint32_t{ static_cast<std::uint8_t>(a_in[a_pos + 2]) } << 16u |
+			       std::uint32_t{ static_cast<std::uint8_t>(a_in[a_pos + 3]) } << 24u;
+		}
+
+		void write_le32(std::span<std::byte> a_out, std::size_t a_pos, std::uint32_t a_value) noexcept
+		{
+			for (std::size_t i = 0; i < 4; ++i) {
+				a_out[a_pos + i] = static_cast<std::byte>(a_value >> (i * 8u));
+			}
+		}
+
+		// Reads the bitstream of a single frame: 16 bit little endian words, from the most
+		//	significant bit down. Reading past the end of the frame yields zeroes.
+		class bit_reader final
+		{
+		public:
+			void reset(std::span<const std::byte> a_in) noexcept
+			{
+				_in = a_in;
+				_pos = 0;
+				_buf = 0;
+				_bits = 0;
+			}
+
+			[[nodiscard]] auto peek(std::size_t a_count) noexcept
+				-> std::uint32_t
+			{
+				assert(a_count > 0 && a_count <= 32);
+				this->fill(a_count);
+				return static_cast<std::uint32_t>(_buf >> (64 - a_count));
+			}
+
+			void skip(std::size_t a_count) noexcept
+			{
+				assert(a_count <= _bits);
+				_buf <<= a_count;
+				_bits -= a_count;
+			}
+
+			[[nodiscard]] auto read(std::size_t a_count) noexcept
+				-> std::uint32_t
+			{
+				if (a_count == 0) {
+					return 0;
+				}
+
+				const auto result = this->peek(a_count);
+				this->skip(a_count);
+				return result;
+			}
+
+			// Realigns the stream so that it can be read a byte at a time. The remainder of a
+			//	partially read word is discarded, or a whole word of padding, if none is.
+			void align() noexcept
+			{
+				const auto words = _bits / 16;
+				if (_bits % 16 != 0) {
+					_pos -= words * 2;
+				} else if (words > 0) {
+					_pos -= (words - 1) * 2;
+				} else {
+					_pos += 2;
+				}
+				_buf = 0;
+				_bits = 0;
+			}
+
+			[[nodiscard]] auto read_bytes(std::size_t a_count)
+				-> std::span<const std::byte>
+			{
+				assert(_bits == 0);
+				if (_pos > _in.size() || _in.size() - _pos < a_count) {
+					throw_malformed();
+				}
+
+				const auto result = _in.subspan(_pos, a_count);
+				_pos += a_count;
+				return result;
+			}
+
+		private:
+			void fill(std::size_t a_count) noexcept
+			{
+				while (_bits < a_count) {
+					std::uint64_t word = 0;
+					if (_pos < _in.size() && _in.size() - _pos >= 2) {
+						word = std::uint64_t{ static_cast<std::uint8_t>(_in[_pos]) } |
+						       std::uint64_t{ static_cast<std::uint8_t>(_in[_pos + 1]) } << 8u;
+					}
+					_pos += 2;
+					_buf |= word << (48 - _bits);
+					_bits += 16;
+				}
+			}
+
+			std::span<const std::byte> _in;
+			std::size_t _pos{ 0 };
+			std::uint64_t _buf{ 0 };
+			std::size_t _bits{ 0 };
+		};
+
+		// A canonical huffman code. Codes up to `TABLE_BITS` long are decoded with a single
+		//	lookup, and longer codes are found by walking the codes of each length in turn.
+		template <std::size_t SYMBOLS, std::size_t TABLE_BITS>
+		class huffman_decoder final
+		{
+		public:
+			void build(std::span<const std::uint8_t> a_lengths)
+			{
+				assert(a_lengths.size() >= SYMBOLS);
+
+				_count.fill(0);
+				for (std::size_t i = 0; i < SYMBOLS; ++i) {
+					++_count[a_lengths[i]];
+				}
+				_count[0] = 0;
+
+				std::int32_t left = 1;
+				for (std::size_t len = 1; len <= constants::max_code_length; ++len) {
+					left = left * 2 - static_cast<std::int32_t>(_count[len]);
+					if (left < 0) {
+						throw_malformed();  // oversubscribed
+					}
+				}
+
+				std::array<std::uint16_t, constants::max_code_length + 1> next{};
+				std::array<std::uint16_t, constants::max_code_length + 1> index{};
+				for (std::size_t len = 1; len <= constants::max_code_length; ++len) {
+					_first[len] = static_cast<std::uint16_t>((_first[len - 1] + _count[len - 1]) << 1u);
+					_offset[len] = static_cast<std::uint16_t>(_offset[len - 1] + _count[len - 1]);
+					next[len] = _first[len];
+					index[len] = _offset[len];
+				}
+
+				_fast.fill(0);
+				for (std::size_t i = 0; i < SYMBOLS; ++i) {
+					const std::size_t len = a_lengths[i];
+					if (len == 0) {
+						continue;
+					}
+
+					_sorted[index[len]++] = static_cast<std::uint16_t>(i);
+					const std::size_t code = next[len]++;
+					if (len <= TABLE_BITS) {
+						const auto first = code << (TABLE_BITS - len);
+						const auto last = (code + 1) << (TABLE_BITS - len);
+						std::fill(
+							_fast.begin() + static_cast<std::ptrdiff_t>(first),
+							_fast.begin() + static_cast<std::ptrdiff_t>(last),
+							static_cast<std::uint16_t>(i << 5u | len));
+					}
+				}
+			}
+
+			[[nodiscard]] auto decode(bit_reader& a_in) const
+				-> std::size_t
+			{
+				const auto bits = a_in.peek(constants::max_code_length);
+				if (const auto entry = _fast[bits >> (constants::max_code_length - TABLE_BITS)];
+					entry != 0) {
+					a_in.skip(entry & 0x1Fu);
+					return entry >> 5u;
+				}
+
+				for (std::size_t len = TABLE_BITS + 1; len <= constants::max_code_length; ++len) {
+					const auto code = bits >> (constants::max_code_length - len);
+					const auto idx = code - _first[len];
+					if (code >= _first[len] && idx < _count[len]) {
+						a_in.skip(len);
+						return _sorted[_offset[len] + idx];
+					}
+				}
+
+				throw_malformed();
+			}
+
+		private:
+			std::array<std::uint16_t, std::size_t{ 1 } << TABLE_BITS> _fast{};
+			std::array<std::uint16_t, constants::max_code_length + 1> _count{};
+			std::array<std::uint16_t, constants::max_code_length + 1> _first{};
+			std::array<std::uint16_t, constants::max_code_length + 1> _offset{};
+			std::array<std::uint16_t, SYMBOLS> _sorted{};
+		};
+
+		// The state of an lzx stream, which carries over from one frame to the next. The output
+		//	doubles as the window, since a whole file is always decompressed at once.
+		class decoder final
+		{
+		public:
+			[[nodiscard]] bool translating() const noexcept { return _translate && _intel_size != 0; }
+			[[nodiscard]] auto intel_size() const noexcept -> std::uint32_t { return _intel_size; }
+
+			void read_stream_header(bit_reader& a_in) noexcept
+			{
+				if (a_in.read(1) != 0) {
+					const auto hi = a_in.read(16);
+					const auto lo = a_in.read(16);
+					_intel_size = hi << 16u | lo;
+				}
+			}
+
+			// Decodes the frame `[a_pos, a_last)` into `a_out`. Matches may run past the end of
+			//	the frame, in which case `a_pos` is left past `a_last`.
+			void decode_frame(
+				bit_reader& a_in,
+				std::span<std::byte> a_out,
+				std::size_t& a_pos,
+				std::size_t a_last)
+			{
+				while (a_pos < a_last) {
+					if (_remaining == 0) {
+						this->read_block_header(a_in);
+					}
+
+					const auto start = a_pos;
+					const auto run = (std::min)(_remaining, a_last - a_pos);
+					switch (_type) {
+					case block_type::verbatim:
+						this->decode_symbols<false>(a_in, a_out, a_pos, start + run);
+						break;
+					case block_type::aligned:
+						this->decode_symbols<true>(a_in, a_out, a_pos, start + run);
+						break;
+					case block_type::uncompressed:
+						{
+							const auto bytes = a_in.read_bytes(run);
+							std::memcpy(a_out.data() + a_pos, bytes.data(), run);
+							a_pos += run;
+						}
+						break;
+					default:
+						detail::declare_unreachable();
+					}
+
+					const auto done = a_pos - start;
+					if (done > _remaining) {
+						throw_malformed();  // a match ran past the end of its block
+					}
+					_remaining -= done;
+				}
+
+				_translate = _translate || _intel_started;
+			}
+
+		private:
+			void read_block_header(bit_reader& a_in)
+			{
+				if (_type == block_type::uncompressed && (_length & 1u) != 0) {
+					(void)a_in.read_bytes(1);  // uncompressed blocks are padded to a word
+				}
+
+				_type = static_cast<block_type>(a_in.read(3));
+				const auto hi = a_in.read(16);
+				const auto lo = a_in.read(8);
+				_length = hi << 8u | lo;
+				_remaining = _length;
+
+				switch (_type) {
+				case block_type::aligned:
+					{
+						std::array<std::uint8_t, constants::aligned_symbols> lengths{};
+						for (auto& len : lengths) {
+							len = static_cast<std::uint8_t>(a_in.read(3));
+						}
+						_aligned.build(lengths);
+					}
+					[[fallthrough]];
+				case block_type::verbatim:
+					this->read_lengths(a_in, _main_lengths, 0, constants::num_chars);
+					this->read_lengths(a_in, _main_lengths, constants::num_chars, constants::main_symbols);
+					_main.build(_main_lengths);
+					if (_main_lengths[0xE8] != 0) {
+						_intel_started = true;
+					}
+					this->read_lengths(a_in, _length_lengths, 0, constants::length_symbols);
+					_lengths.build(_length_lengths);
+					break;
+				case block_type::uncompressed:
+					{
+						_intel_started = true;
+						a_in.align();
+						const auto r = a_in.read_bytes(12);
+						for (std::size_t i = 0; i < _r.size(); ++i) {
+							_r[i] = read_le32(r, i * 4);
+						}
+					}
+					break;
+				default:
+					throw_malformed();
+				}
+			}
+
+			// Code lengths are sent as deltas from the lengths of the previous block, which are
+			//	themselves huffman coded by a pretree.
+			template <std::size_t N>
+			void read_lengths(
+				bit_reader& a_in,
+				std::array<std::uint8_t, N>& a_lengths,
+				std::size_t a_first,
+				std::size_t a_last)
+			{
+				std::array<std::uint8_t, constants::pretree_symbols> pre{};
+				for (auto& len : pre) {
+					len = static_cast<std::uint8_t>(a_in.read(4));
+				}
+				_pretree.build(pre);
+
+				const auto delta = [](std::size_t a_from, std::size_t a_by) noexcept {
+					return static_cast<std::uint8_t>((a_from + 17 - a_by) % 17);
+				};
+
+				for (std::size_t i = a_first; i < a_last;) {
+					std::size_t count = 1;
+					std::uint8_t len = 0;
+					switch (const auto sym = _pretree.decode(a_in); sym) {
+					case 17:
+						count = a_in.read(4) + 4;
+						break;
+					case 18:
+						count = a_in.read(5) + 20;
+						break;
+					case 19:
+						count = a_in.read(1) + 4;
+						len = delta(a_lengths[i], _pretree.decode(a_in));
+						break;
+					default:
+						len = delta(a_lengths[i], sym);
+						break;
+					}
+
+					if (count > N - i) {
+						throw_malformed();
+					}
+					std::fill_n(a_lengths.begin() + static_cast<std::ptrdiff_t>(i), count, len);
+					i += count;
+				}
+			}
+
+			template <bool ALIGNED>
+			void decode_symbols(
+				bit_reader& a_in,
+				std::span<std::byte> a_out,
+				std::size_t& a_pos,
+				std::size_t a_last)
+			{
+				while (a_pos < a_last) {
+					const auto sym = _main.decode(a_in);
+					if (sym < constants::num_chars) {
+						a_out[a_pos++] = static_cast<std::byte>(sym);
+						continue;
+					}
+
+					const auto header = sym - constants::num_chars;
+					auto length = header % 8;
+					if (length == constants::num_primary_lengths) {
+						length += _lengths.decode(a_in);
+					}
+					length += constants::min_match;
+
+					const auto slot = header / 8;
+					std::uint32_t offset = 0;
+					if (slot > 2) {
+						const auto [base, extra] = slots[slot];
+						offset = base - 2;
+						if (ALIGNED && extra >= 3) {
+							offset += a_in.read(extra - 3u) << 3u;
+							offset += static_cast<std::uint32_t>(_aligned.decode(a_in));
+						} else {
+							offset += a_in.read(extra);
+						}
+						_r[2] = _r[1];
+						_r[1] = _r[0];
+						_r[0] = offset;
+					} else {
+						offset = _r[slot];
+						std::swap(_r[0], _r[slot]);
+					}
+
+					if (offset == 0 || offset > a_pos || length > a_out.size() - a_pos) {
+						throw_malformed();
+					}
+
+					const auto dst = a_out.data() + a_pos;
+					const auto src = dst - offset;
+					if (offset >= length) {
+						std::memcpy(dst, src, length);
+					} else {
+						for (std::size_t i = 0; i < length; ++i) {
+							dst[i] = src[i];
+						}
+					}
+					a_pos += length;
+				}
+			}
+
+			huffman_decoder<constants::pretree_symbols, 6> _pretree;
+			huffman_decoder<constants::aligned_symbols, 7> _aligned;
+			huffman_decoder<constants::main_symbols, 10> _main;
+			huffman_decoder<constants::length_symbols, 10> _lengths;
+			std::array<std::uint8_t, constants::main_symbols + constants::length_table_safety> _main_lengths{};
+			std::array<std::uint8_t, constants::length_symbols + constants::length_table_safety> _length_lengths{};
+			std::array<std::uint32_t, 3> _r{ 1, 1, 1 };
+			block_type _type{ block_type::invalid };
+			std::size_t _length{ 0 };
+			std::size_t _remaining{ 0 };
+			std::uint32_t _intel_size{ 0 };
+			bool _intel_started{ false };
+			bool _translate{ false };
+		};
+
+		// Undoes the translation of x86 call instructions (opcode e8) from relative addresses to
+		//	absolute ones, which the compressor applies to improve the odds of a match.
+		void translate_e8(
+			std::span<std::byte> a_frame,
+			std::size_t a_offset,
+			std::uint32_t a_size) noexcept
+		{
+			if (a_frame.size() <= 10) {
+				return;
+			}
+
+			const auto size = static_cast<std::int64_t>(a_size);
+			auto pos = static_cast<std::int64_t>(a_offset);
+			for (std::size_t i = 0; i < a_frame.size() - 10;) {
+				if (a_frame[i++] != std::byte{ 0xE8 }) {
+					++pos;
+					continue;
+				}
+
+				const auto absolute = static_cast<std::int64_t>(
+					static_cast<std::int32_t>(read_le32(a_frame, i)));
+				if (absolute >= -pos && absolute < size) {
+					const auto relative = absolute >= 0 ? absolute - pos : absolute + size;
+					write_le32(a_frame, i, static_cast<std::uint32_t>(relative));
+				}
+				i += 4;
+				pos += 5;
+			}
+		}
+
+		struct frame_t
+		{
+			std::size_t output{ 0 };
+			std::span<const std::byte> input;
+		};
+
+		// Walks the frames of an xmem stream, stopping at the terminating frame.
+		class frame_reader final
+		{
+		public:
+			explicit frame_reader(std::span<const std::byte> a_in) noexcept :
+				_in(a_in)
+			{}
+
+			[[nodiscard]] auto next()
+				-> std::optional<frame_t>
+			{
+				if (_pos >= _in.size()) {
+					return std::nullopt;
+				}
+
+				frame_t frame{ constants::frame_size, {} };
+				std::size_t size = 0;
+				if (_in[_pos] == std::byte{ 0xFF }) {
+					if (_in.size() - _pos < 5) {
+						throw_malformed();
+					}
+					frame.output = read_be16(_in, _pos + 1);
+					size = read_be16(_in, _pos + 3);
+					_pos += 5;
+				} else {
+					if (_in.size() - _pos < 2) {
+						throw_malformed();
+					}
+					size = read_be16(_in, _pos);
+					_pos += 2;
+				}
+
+				if (size == 0 || frame.output == 0) {
+					_pos = _in.size();
+					return std::nullopt;
+				}
+
+				if (_in.size() - _pos < size) {
+					throw_malformed();
+				}
+				frame.input = _in.subspan(_pos, size);
+				_pos += size;
+				return frame;
+			}
+
+		private:
+			std::span<const std::byte> _in;
+			std::size_t _pos{ 0 };
+		};
+
+		// Writes the bitstream of a single frame, in the layout `bit_reader` expects. Running out
+		//	of room is recorded, rather than treated as an error, so the caller can fall back to
+		//	a cheaper block.
+		class bit_writer final
+		{
+		public:
+			explicit bit_writer(std::span<std::byte> a_out) noexcept :
+				_out(a_out)
+			{}
+
+			[[nodiscard]] bool overflowed() const noexcept { return _overflowed; }
+			[[nodiscard]] auto size() const noexcept -> std::size_t { return _pos; }
+
+			void write(std::uint32_t a_bits, std::size_t a_count) noexcept
+			{
+				assert(a_count <= 32);
+				assert(a_count == 32 || (a_bits >> a_count) == 0);
+				_buf = _buf << a_count | a_bits;
+				_bits += a_count;
+				while (_bits >= 16) {
+					_bits -= 16;
+					this->put(static_cast<std::uint16_t>(_buf >> _bits));
+				}
+				_buf &= (std::uint64_t{ 1 } << _bits) - 1;
+			}
+
+			// The counterpart to `bit_reader::align`: an aligned stream still gets a whole
+			//	word of padding.
+			void align() noexcept { this->write(0, 16 - _bits); }
+
+			void flush() noexcept
+			{
+				if (_bits != 0) {
+					this->write(0, 16 - _bits);
+				}
+			}
+
+			void write_bytes(std::span<const std::byte> a_bytes) noexcept
+			{
+				assert(_bits == 0);
+				if (_overflowed || _out.size() - _pos < a_bytes.size()) {
+					_overflowed = true;
+					return;
+				}
+
+				std::memcpy(_out.data() + _pos, a_bytes.data(), a_bytes.size());
+				_pos += a_bytes.size();
+			}
+
+		private:
+			void put(std::uint16_t a_word) noexcept
+			{
+				if (_overflowed || _out.size() - _pos < 2) {
+					_overflowed = true;
+					return;
+				}
+
+				_out[_pos++] = static_cast<std::byte>(a_word & 0xFFu);
+				_out[_pos++] = static_cast<std::byte>(a_word >> 8u);
+			}
+
+			std::span<std::byte> _out;
+			std::size_t _pos{ 0 };
+			std::uint64_t _buf{ 0 };
+			std::size_t _bits{ 0 };
+			bool _overflowed{ false };
+		};
+
+		// Assigns each symbol a code length of at most `a_limit`, by building a huffman tree and
+		//	flattening the frequencies until it is shallow enough. At least two symbols are
+		//	always given a code, since a tree with fewer is not complete.
+		void build_lengths(
+			std::span<std::uint32_t> a_freqs,
+			std::span<std::uint8_t> a_lengths,
+			std::size_t a_limit)
+		{
+			assert(a_freqs.size() == a_lengths.size());
+			assert(a_freqs.size() >= 2);
+
+			std::vector<std::uint16_t> leaves;
+			for (std::size_t i = 0; i < a_freqs.size(); ++i) {
+				if (a_freqs[i] != 0) {
+					leaves.push_back(static_cast<std::uint16_t>(i));
+				}
+			}
+			for (std::size_t i = 0; leaves.size() < 2; ++i) {
+				if (a_freqs[i] == 0) {
+					a_freqs[i] = 1;
+					leaves.push_back(static_cast<std::uint16_t>(i));
+				}
+			}
+
+			const auto n = leaves.size();
+			std::vector<std::uint32_t> weight(n * 2 - 1);
+			std::vector<std::uint32_t> parent(n * 2 - 1);
+			std::vector<std::uint8_t> depth(n * 2 - 1);
+			for (;;) {
+				std::ranges::sort(leaves, [&](std::uint16_t a_lhs, std::uint16_t a_rhs) noexcept {
+					return a_freqs[a_lhs] < a_freqs[a_rhs];
+				});
+
+				// the leaves are sorted, and internal nodes are created in order of weight, so
+				//	the two lightest nodes are always at the front of one queue or the other
+				for (std::size_t i = 0; i < n; ++i) {
+					weight[i] = a_freqs[leaves[i]];
+				}
+				std::size_t leaf = 0;
+				std::size_t internal = n;
+				const auto take = [&](std::size_t a_next) noexcept {
+					if (leaf < n && (internal == a_next || weight[leaf] <= weight[internal])) {
+						return leaf++;
+					} else {
+						return internal++;
+					}
+				};
+				for (std::size_t next = n; next < weight.size(); ++next) {
+					const auto lhs = take(next);
+					const auto rhs = take(next);
+					weight[next] = weight[lhs] + weight[rhs];
+					parent[lhs] = static_cast<std::uint32_t>(next);
+					parent[rhs] = static_cast<std::uint32_t>(next);
+				}
+
+				depth.back() = 0;
+				for (std::size_t i = weight.size() - 1; i-- > 0;) {
+					depth[i] = static_cast<std::uint8_t>(depth[parent[i]] + 1);
+				}
+
+				if (*std::max_element(depth.begin(), depth.begin() + static_cast<std::ptrdiff_t>(n)) <= a_limit) {
+					break;
+				}
+
+				for (const auto sym : leaves) {
+					a_freqs[sym] = (a_freqs[sym] + 1) / 2;
+				}
+			}
+
+			std::ranges::fill(a_lengths, std::uint8_t{ 0 });
+			for (std::size_t i = 0; i < n; ++i) {
+				a_lengths[leaves[i]] = depth[i];
+			}
+		}
+
+		// Assigns canonical codes to the given lengths, in the same order as `huffman_decoder`.
+		void build_codes(
+			std::span<const std::uint8_t> a_lengths,
+			std::span<std::uint16_t> a_codes) noexcept
+		{
+			std::array<std::uint16_t, constants::max_code_length + 1> count{};
+			for (const auto len : a_lengths) {
+				++count[len];
+			}
+			count[0] = 0;
+
+			std::array<std::uint16_t, constants::max_code_length + 1> next{};
+			for (std::size_t len = 1; len <= constants::max_code_length; ++len) {
+				next[len] = static_cast<std::uint16_t>((next[len - 1] + count[len - 1]) << 1u);
+			}
+
+			for (std::size_t i = 0; i < a_lengths.size(); ++i) {
+				if (a_lengths[i] != 0) {
+					a_codes[i] = next[a_lengths[i]]++;
+				}
+			}
+		}
+
+		struct match_t
+		{
+			std::size_t length{ 0 };
+			std::uint32_t offset{ 0 };
+		};
+
+		struct token_t
+		{
+			std::uint16_t main{ 0 };
+			std::uint16_t length{ 0 };
+			std::uint32_t extra{ 0 };
+		};
+
+		// The encoding side of `decoder`: a greedy match finder with one step of lazy
+		//	evaluation, which emits a single verbatim block per frame. The input doubles as the
+		//	window, since a whole file is always compressed at once.
+		class encoder final
+		{
+		public:
+			explicit encoder(std::span<const std::byte> a_in) :
+				_in(a_in),
+				_hash_bits(std::clamp<std::size_t>(std::bit_width(a_in.size()), 8, max_hash_bits)),
+				_head(std::size_t{ 1 } << _hash_bits),
+				_prev((std::min)(a_in.size(), constants::window_size))
+			{}
+
+			// Encodes the frame `[a_first, a_last)` of the input into `a_out`, and returns the
+			//	size of the encoded frame.
+			[[nodiscard]] auto encode_frame(
+				std::span<std::byte> a_out,
+				std::size_t a_first,
+				std::size_t a_last)
+				-> std::size_t
+			{
+				this->tokenize(a_first, a_last);
+
+				const auto size = a_last - a_first;
+				const auto uncompressed = 4 + 12 + size + (size & 1u);
+				assert(a_out.size() >= uncompressed);
+
+				if (const auto verbatim = this->write_verbatim(a_out.first(uncompressed - 1), size);
+					verbatim) {
+					return *verbatim;
+				}
+
+				bit_writer out{ a_out };
+				this->write_stream_header(out);
+				out.write(detail::to_underlying(block_type::uncompressed), 3);
+				out.write(static_cast<std::uint32_t>(size >> 8u), 16);
+				out.write(static_cast<std::uint32_t>(size & 0xFFu), 8);
+				out.align();
+				std::array<std::byte, 12> r{};
+				for (std::size_t i = 0; i < _r.size(); ++i) {
+					write_le32(r, i * 4, _r[i]);
+				}
+				out.write_bytes(r);
+				out.write_bytes(_in.subspan(a_first, size));
+				if ((size & 1u) != 0) {
+					out.write_bytes(std::array{ std::byte{ 0 } });
+				}
+
+				assert(!out.overflowed());
+				_started = true;
+				return out.size();
+			}
+
+		private:
+			static constexpr std::size_t max_hash_bits = 15;
+			static constexpr std::size_t max_chain = 48;
+			static constexpr std::size_t nice_match = 128;
+			static constexpr std::size_t min_explicit_match = 3;
+			static constexpr std::size_t max_offset = constants::window_size - 3;
+
+			[[nodiscard]] auto hash(std::size_t a_pos) const noexcept
+				-> std::size_t
+			{
+				const auto value =
+					std::uint32_t{ static_cast<std::uint8_t>(_in[a_pos]) } |
+					std::uint32_t{ static_cast<std::uint8_t>(_in[a_pos + 1]) } << 8u |
+					std::uint32_t{ static_cast<std::uint8_t>(_in[a_pos + 2]) } << 16u;
+				return (value * 0x9E3779B1u) >> (32 - _hash_bits);
+			}
+
+			// chain entries are stored off by one, so that 0 means "none"
+			void insert(std::size_t a_pos) noexcept
+			{
+				if (_in.size() - a_pos < 3) {
+					return;
+				}
+
+				auto& head = _head[this->hash(a_pos)];
+				_prev[a_pos % _prev.size()] = head;
+				head = static_cast<std::uint32_t>(a_pos + 1);
+			}
+
+			[[nodiscard]] auto match_length(
+				std::size_t a_pos,
+				std::size_t a_from,
+				std::size_t a_limit) const noexcept
+				-> std::size_t
+			{
+				std::size_t len = 0;
+				while (len < a_limit && _in[a_from + len] == _in[a_pos + len]) {
+					++len;
+				}
+				return len;
+			}
+
+			[[nodiscard]] auto find(
+				std::size_t a_pos,
+				std::size_t a_last) const noexcept
+				-> match_t
+			{
+				const auto limit = (std::min)(constants::max_match, a_last - a_pos);
+				if (limit < constants::min_match) {
+					return {};
+				}
+
+				// repeated offsets are much cheaper to code, so they win ties
+				match_t best;
+				for (const auto offset : _r) {
+					if (offset <= a_pos) {
+						const auto len = this->match_length(a_pos, a_pos - offset, limit);
+						if (len > best.length) {
+							best = { len, offset };
+						}
+					}
+				}
+
+				if (best.length < limit && _in.size() - a_pos >= 3) {
+					auto candidate = _head[this->hash(a_pos)];
+					for (std::size_t chain = 0; candidate != 0 && chain < max_chain; ++chain) {
+						const auto from = std::size_t{ candidate } - 1;
+						if (from >= a_pos || a_pos - from > max_offset) {
+							break;
+						}
+
+						if (_in[from + best.length] == _in[a_pos + best.length]) {
+							const auto len = this->match_length(a_pos, from, limit);
+							if (len > best.length && len >= min_explicit_match) {
+								best = { len, static_cast<std::uint32_t>(a_pos - from) };
+								if (len >= (std::min)(limit, nice_match)) {
+									break;
+								}
+							}
+						}
+
+						candidate = _prev[from % _prev.size()];
+					}
+				}
+
+				return best;
+			}
+
+			void tokenize(std::size_t a_first, std::size_t a_last)
+			{
+				_tokens.clear();
+				const auto literal = [&](std::size_t a_pos) {
+					_tokens.push_back({ static_cast<std::uint16_t>(_in[a_pos]), 0, 0 });
+				};
+
+				auto pos = a_first;
+				auto match = this->find(pos, a_last);
+				this->insert(pos);
+				while (pos < a_last) {
+					if (match.length >= constants::min_match && pos + 1 < a_last) {
+						const auto next = this->find(pos + 1, a_last);
+						this->insert(pos + 1);
+						if (next.length > match.length) {
+							literal(pos++);
+							match = next;
+							continue;
+						}
+
+						this->emit(match);
+						for (auto i = pos + 2; i < pos + match.length; ++i) {
+							this->insert(i);
+						}
+						pos += match.length;
+					} else {
+						literal(pos++);
+					}
+
+					if (pos < a_last) {
+						match = this->find(pos, a_last);
+						this->insert(pos);
+					}
+				}
+			}
+
+			void emit(const match_t& a_match)
+			{
+				std::size_t slot = 0;
+				std::uint32_t extra = 0;
+				if (a_match.offset == _r[0]) {
+					slot = 0;
+				} else if (a_match.offset == _r[1]) {
+					slot = 1;
+					std::swap(_r[0], _r[1]);
+				} else if (a_match.offset == _r[2]) {
+					slot = 2;
+					std::swap(_r[0], _r[2]);
+				} else {
+					const auto formatted = a_match.offset + 2;
+					const auto it = std::ranges::upper_bound(
+						slots,
+						formatted,
+						std::less<>{},
+						&slot_t::base);
+					slot = static_cast<std::size_t>(it - slots.begin()) - 1;
+					extra = formatted - slots[slot].base;
+					_r[2] = _r[1];
+					_r[1] = _r[0];
+					_r[0] = a_match.offset;
+				}
+
+				const auto header = a_match.length - constants::min_match;
+				const auto primary = (std::min)(header, constants::num_primary_lengths);
+				_tokens.push_back({
+					static_cast<std::uint16_t>(constants::num_chars + slot * 8 + primary),
+					static_cast<std::uint16_t>(header - primary),
+					extra,
+				});
+			}
+
+			void write_stream_header(bit_writer& a_out) noexcept
+			{
+				if (!_started) {
+					a_out.write(0, 1);  // e8 translation is never applied
+				}
+			}
+
+			// Returns the size of the block, or nothing if it does not fit in `a_out`.
+			[[nodiscard]] auto write_verbatim(
+				std::span<std::byte> a_out,
+				std::size_t a_size)
+				-> std::optional<std::size_t>
+			{
+				std::array<std::uint32_t, constants::main_symbols> main_freqs{};
+				std::array<std::uint32_t, constants::length_symbols> length_freqs{};
+				for (const auto& token : _tokens) {
+					++main_freqs[token.main];
+					if (token.main >= constants::num_chars &&
+						(token.main - constants::num_chars) % 8 == constants::num_primary_lengths) {
+						++length_freqs[token.length];
+					}
+				}
+
+				std::array<std::uint8_t, constants::main_symbols> main_lengths{};
+				std::array<std::uint8_t, constants::length_symbols> length_lengths{};
+				build_lengths(main_freqs, main_lengths, constants::max_code_length);
+				build_lengths(length_freqs, length_lengths, constants::max_code_length);
+
+				bit_writer out{ a_out };
+				this->write_stream_header(out);
+				out.write(detail::to_underlying(block_type::verbatim), 3);
+				out.write(static_cast<std::uint32_t>(a_size >> 8u), 16);
+				out.write(static_cast<std::uint32_t>(a_size & 0xFFu), 8);
+				write_lengths(out, _main_lengths, main_lengths, 0, constants::num_chars);
+				write_lengths(out, _main_lengths, main_lengths, constants::num_chars, constants::main_symbols);
+				write_lengths(out, _length_lengths, length_lengths, 0, constants::length_symbols);
+
+				std::array<std::uint16_t, constants::main_symbols> main_codes{};
+				std::array<std::uint16_t, constants::length_symbols> length_codes{};
+				build_codes(main_lengths, main_codes);
+				build_codes(length_lengths, length_codes);
+
+				for (const auto& token : _tokens) {
+					out.write(main_codes[token.main], main_lengths[token.main]);
+					if (token.main < constants::num_chars) {
+						continue;
+					}
+
+					const auto header = token.main - constants::num_chars;
+					if (header % 8 == constants::num_primary_lengths) {
+						out.write(length_codes[token.length], length_lengths[token.length]);
+					}
+					if (const auto slot = header / 8; slot > 2) {
+						out.write(token.extra, slots[slot].extra_bits);
+					}
+				}
+				out.flush();
+
+				if (out.overflowed()) {
+					return std::nullopt;
+				}
+
+				_started = true;
+				std::ranges::copy(main_lengths, _main_lengths.begin());
+				std::ranges::copy(length_lengths, _length_lengths.begin());
+				return out.size();
+			}
+
+			// The counterpart to `decoder::read_lengths`.
+			template <std::size_t N, std::size_t M>
+			static void write_lengths(
+				bit_writer& a_out,
+				const std::array<std::uint8_t, N>& a_previous,
+				const std::array<std::uint8_t, M>& a_lengths,
+				std::size_t a_first,
+				std::size_t a_last)
+			{
+				struct code_t
+				{
+					std::uint8_t symbol{ 0 };
+					std::uint8_t extra{ 0 };
+					std::uint8_t extra_bits{ 0 };
+				};
+
+				std::vector<code_t> codes;
+				for (std::size_t i = a_first; i < a_last;) {
+					std::size_t run = 0;
+					while (i + run < a_last && a_lengths[i + run] == 0 && run < 51) {
+						++run;
+					}
+
+					if (run >= 20) {
+						codes.push_back({ 18, static_cast<std::uint8_t>(run - 20), 5 });
+						i += run;
+					} else if (run >= 4) {
+						codes.push_back({ 17, static_cast<std::uint8_t>(run - 4), 4 });
+						i += run;
+					} else {
+						const auto delta = (a_previous[i] + 17 - a_lengths[i]) % 17;
+						codes.push_back({ static_cast<std::uint8_t>(delta), 0, 0 });
+						++i;
+					}
+				}
+
+				std::array<std::uint32_t, constants::pretree_symbols> freqs{};
+				for (const auto& code : codes) {
+					++freqs[code.symbol];
+				}
+				std::array<std::uint8_t, constants::pretree_symbols> lengths{};
+				build_lengths(freqs, lengths, 15);  // pretree lengths are sent in 4 bits
+				std::array<std::uint16_t, constants::pretree_symbols> pre{};
+				build_codes(lengths, pre);
+
+				for (const auto len : lengths) {
+					a_out.write(len, 4);
+				}
+				for (const auto& code : codes) {
+					a_out.write(pre[code.symbol], lengths[code.symbol]);
+					a_out.write(code.extra, code.extra_bits);
+				}
+			}
+
+			std::span<const std::byte> _in;
+			std::size_t _hash_bits{ 0 };
+			std::vector<std::uint32_t> _head;
+			std::vector<std::uint32_t> _prev;
+			std::vector<token_t> _tokens;
+			std::array<std::uint8_t, constants::main_symbols> _main_lengths{};
+			std::array<std::uint8_t, constants::length_symbols> _length_lengths{};
+			std::array<std::uint32_t, 3> _r{ 1, 1, 1 };
+			bool _started{ false };
+		};
+
+		// the 5 bytes xcompress ends every stream with
+		constexpr std::size_t trailer_size = 5;
+	}
+
+	auto compress_bound(std::size_t a_size) noexcept
+		-> std::size_t
+	{
+		// every frame falls back to an uncompressed block: 5 bytes of frame header, 4 of block
+		//	header, 12 of repeated offsets, and a byte of padding
+		const auto frames = (a_size + constants::frame_size - 1) / constants::frame_size;
+		return a_size + frames * (5 + 4 + 12 + 1) + trailer_size;
+	}
+
+	auto compress(
+		std::span<std::byte> a_out,
+		std::span<const std::byte> a_in)
+		-> std::size_t
+	{
+		assert(a_out.size() >= compress_bound(a_in.size()));
+
+		encoder state{ a_in };
+		std::size_t pos = 0;
+		for (std::size_t first = 0; first < a_in.size(); first += constants::frame_size) {
+			const auto last = (std::min)(first + constants::frame_size, a_in.size());
+			const auto output = last - first;
+			const auto header = output == constants::frame_size ? 2 : 5;
+			const auto size = state.encode_frame(a_out.subspan(pos + header), first, last);
+			assert(size <= 0xFFFF);
+
+			const auto put_be16 = [&](std::size_t a_at, std::size_t a_value) noexcept {
+				a_out[a_at] = static_cast<std::byte>(a_value >> 8u);
+				a_out[a_at + 1] = static_cast<std::byte>(a_value & 0xFFu);
+			};
+			if (header == 2) {
+				put_be16(pos, size);
+			} else {
+				a_out[pos] = std::byte{ 0xFF };
+				put_be16(pos + 1, output);
+				put_be16(pos + 3, size);
+			}
+			pos += header + size;
+		}
+
+		std::fill_n(a_out.begin() + static_cast<std::ptrdiff_t>(pos), trailer_size, std::byte{ 0 });
+		return pos + trailer_size;
+	}
+
+	auto decompress(
+		std::span<std::byte> a_out,
+		std::span<const std::byte> a_in)
+		-> std::size_t
+	{
+		decoder state;
+		bit_reader in;
+		frame_reader frames{ a_in };
+
+		std::size_t pos = 0;
+		std::size_t last = 0;
+		std::size_t translated = 0;
+		for (bool first = true;; first = false) {
+			const auto frame = frames.next();
+			if (!frame) {
+				break;
+			}
+
+			if (frame->output > a_out.size() - last) {
+				throw bsa::compression_error(error_code::decompress_size_mismatch);
+			}
+
+			in.reset(frame->input);
+			if (first) {
+				state.read_stream_header(in);
+			}
+			last += frame->output;
+			state.decode_frame(in, a_out, pos, last);
+			if (!state.translating()) {
+				++translated;
+			}
+		}
+
+		if (pos != last) {
+			throw_malformed();  // a match ran past the end of the stream
+		}
+
+		// the translation is undone once everything is decoded, since later frames may match
+		//	against the untranslated output
+		if (state.translating()) {
+			frame_reader again{ a_in };
+			std::size_t offset = 0;
+			for (std::size_t i = 0; i < constants::max_translated_frames; ++i) {
+				const auto frame = again.next();
+				if (!frame) {
+					break;
+				}
+				if (i >= translated) {
+					translate_e8(a_out.subspan(offset, frame->output), offset, state.intel_size());
+				}
+				offset += frame->output;
+			}
+		}
+
+		return last;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+#include "bsa/detail/common.hpp"
+
+namespace bsa::detail::lzx
+{
+	// The xmem codec is lzx (as found in cab files), using a 128 KiB window. The bitstream is
+	//	split into frames of (at most) 32 KiB of output, and each frame is prefixed with the
+	//	size of its compressed data, as well as the size of its output, if it isn't 32 KiB.
+	// The stream ends with a frame whose compressed size is 0.
+
+	// An upper bound on the size of an xmem stream compressed from `a_size` bytes.
+	[[nodiscard]] auto compress_bound(std::size_t a_size) noexcept
+		-> std::size_t;
+
+	// Compresses `a_in` into an xmem stream, and returns the size of the stream.
+	// The stream is not byte for byte identical to what xcompress would produce, but any lzx
+	//	decoder (including xcompress) will decode it.
+	[[nodiscard]] auto compress(
+		std::span<std::byte> a_out,
+		std::span<const std::byte> a_in)
+		-> std::size_t;
+
+	// Decompresses the xmem stream `a_in`, and returns the number of bytes written to `a_out`.
+	// Throws `bsa::compression_error` when the stream is malformed, or does not fit in `a_out`.
+	[[nodiscard]] auto decompress(
+		std::span<std::byte> a_out,
+		std::span<const std::byte> a_in)
+		-> std::size_t;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+#include "bsa/detail/common.hpp"
+
+namespace bsa::detail
+{
+	inline void observe_io(observer::io a_io, std::size_t a_bytes) noexcept
+	{
+		if (const auto observer = get_observer(); observer) {
+			observer->on_io(a_io, a_bytes);
+		}
+	}
+
+	inline void observe_allocation(std::size_t a_bytes) noexcept
+	{
+		if (const auto observer = get_observer(); observer) {
+			observer->on_allocation(a_bytes);
+		}
+	}
+
+	// Times a trip through a codec. Only trips which `finish` are reported, so failures do not
+	//	skew the byte counts.
+	class observe_codec final
+	{
+	public:
+		observe_codec(observer::codec a_codec, observer::operation a_operation) noexcept :
+			_observer(get_observer()),
+			_codec(a_codec),
+			_operation(a_operation)
+		{
+			if (_observer) {
+				_start = clock::now();
+			}
+		}
+
+		observe_codec(const observe_codec&) = delete;
+		observe_codec(observe_codec&&) = delete;
+		~observe_codec() noexcept = default;
+		observe_codec& operator=(const observe_codec&) = delete;
+		observe_codec& operator=(observe_codec&&) = delete;
+
+		void finish(std::size_t a_in, std::size_t a_out) noexcept
+		{
+			if (_observer) {
+				_observer->on_codec(_codec, _operation, a_in, a_out, clock::now() - _start);
+			}
+		}
+
+	private:
+		using clock = std::chrono::steady_clock;
+
+		observer* _observer{ nullptr };
+		observer::codec _codec;
+		observer::operation _operation;
+		clock::time_point _start;
+	};
+
+	// Times a request to the xmem proxy, from sending it to receiving its response.
+	class observe_xmem final
+	{
+	public:
+		observe_xmem() noexcept :
+			_observer(get_observer())
+		{
+			if (_observer) {
+				_start = clock::now();
+			}
+		}
+
+		observe_xmem(const observe_xmem&) = delete;
+		observe_xmem(observe_xmem&&) = delete;
+
+		~observe_xmem() noexcept
+		{
+			if (_observer) {
+				_observer->on_xmem_round_trip(clock::now() - _start);
+			}
+		}
+
+		observe_xmem& operator=(const observe_xmem&) = delete;
+		observe_xmem& operator=(observe_xmem&&) = delete;
+
+	private:
+		using clock = std::chrono::steady_clock;
+
+		observer* _observer{ nullptr };
+		clock::time_point _start;
+	};
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bsa::detail
+{
+	[[nodiscard]] inline auto resolve_thread_count(
+		std::size_t a_threads,
+		std::size_t a_jobs) noexcept
+		-> std::size_t
+	{
+		if (a_threads == 0) {
+			a_threads = std::thread::hardware_concurrency();
+		}
+
+		return std::clamp<std::size_t>(
+			a_threads,
+			1,
+			(std::max<std::size_t>)(a_jobs, 1));
+	}
+
+	// Invokes `a_func(i)` for every `i` in `[0, a_count)` across a pool of workers.
+	// Jobs are handed out in ascending order, and once any job throws, no new jobs are started.
+	// The exception from the lowest failing index is rethrown on the calling thread, which
+	//	matches what a serial loop would have thrown.
+	template <class F>
+	void parallel_for(
+		std::size_t a_count,
+		std::size_t a_threads,
+		F&& a_func)
+	{
+		const auto threads = resolve_thread_count(a_threads, a_count);
+		if (threads == 1) {
+			for (std::size_t i = 0; i < a_count; ++i) {
+				a_func(i);
+			}
+			return;
+		}
+
+		std::atomic_size_t next = 0;
+		std::atomic_bool failed = false;
+		std::mutex lock;
+		std::size_t errorIdx = (std::numeric_limits<std::size_t>::max)();
+		std::exception_ptr error;
+
+		const auto work = [&]() noexcept {
+			while (!failed.load(std::memory_order_relaxed)) {
+				const auto i = next.fetch_add(1, std::memory_order_relaxed);
+				if (i >= a_count) {
+					break;
+				}
+
+				try {
+					a_func(i);
+				} catch (...) {
+					const std::lock_guard l{ lock };
+					if (i < errorIdx) {
+						errorIdx = i;
+						error = std::current_exception();
+					}
+					failed.store(true, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		{
+			std::vector<std::jthread> workers;
+			workers.reserve(threads - 1);
+			for (std::size_t i = 1; i < threads; ++i) {
+				workers.emplace_back(work);
+			}
+			work();
+		}
+
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bsa/detail/common.hpp"
+#include "bsa/detail/parallel.hpp"
+
+namespace bsa::detail
+{
+	// Lends out buffers to decompress into. Buffers are returned once each entry is checked, so
+	//	there are only ever as many as there are workers, and every one is freed with the pool.
+	class scratch_pool final
+	{
+	public:
+		class lease final
+		{
+		public:
+			lease(scratch_pool& a_pool, std::vector<std::byte> a_buffer) noexcept :
+				_pool(a_pool),
+				_buffer(std::move(a_buffer))
+			{}
+
+			lease(const lease&) = delete;
+			lease(lease&&) = delete;
+			~lease() noexcept { _pool.release(std::move(_buffer)); }
+			lease& operator=(const lease&) = delete;
+			lease& operator=(lease&&) = delete;
+
+			[[nodiscard]] auto get(std::size_t a_size)
+				-> std::span<std::byte>
+			{
+				if (_buffer.size() < a_size) {
+					_buffer.resize(a_size);
+				}
+				return { _buffer.data(), a_size };
+			}
+
+		private:
+			scratch_pool& _pool;
+			std::vector<std::byte> _buffer;
+		};
+
+		[[nodiscard]] auto acquire() noexcept
+			-> lease
+		{
+			const std::lock_guard l{ _lock };
+			if (_idle.empty()) {
+				return { *this, {} };
+			}
+
+			auto buffer = std::move(_idle.back());
+			_idle.pop_back();
+			return { *this, std::move(buffer) };
+		}
+
+	private:
+		void release(std::vector<std::byte> a_buffer) noexcept
+		{
+			const std::lock_guard l{ _lock };
+			try {
+				_idle.push_back(std::move(a_buffer));
+			} catch (...) {
+				// a buffer which can't be pooled is simply freed
+			}
+		}
+
+		std::mutex _lock;
+		std::vector<std::vector<std::byte>> _idle;
+	};
+
+	// Invokes `a_check(i, lease)` for every entry across a pool of workers, which returns the
+	//	decompressed size of the entry, or throws a `bsa::exception` describing why it is invalid.
+	// Failures are recorded in `a_report` under `a_describe(i)`, in index order.
+	template <class Check, class Describe>
+	void verify_entries(
+		verify_report& a_report,
+		std::size_t a_count,
+		std::size_t a_threads,
+		Check&& a_check,
+		Describe&& a_describe)
+	{
+		scratch_pool pool;
+		std::vector<std::optional<std::string>> errors(a_count);
+		std::atomic_uint64_t bytes = 0;
+		parallel_for(
+			a_count,
+			a_threads,
+			[&](std::size_t a_idx) {
+				auto lease = pool.acquire();
+				try {
+					bytes.fetch_add(a_check(a_idx, lease), std::memory_order_relaxed);
+				} catch (const bsa::exception& a_err) {
+					errors[a_idx].emplace(a_err.what());
+				}
+			});
+
+		a_report.entries += a_count;
+		a_report.bytes += bytes.load(std::memory_order_relaxed);
+		for (std::size_t i = 0; i < a_count; ++i) {
+			if (errors[i]) {
+				a_report.failures.push_back({ a_describe(i), std::move(*errors[i]) });
+			}
+		}
+	}
+}
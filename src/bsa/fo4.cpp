@@ -2,24 +2,43 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
+#include <charconv>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <limits>
 #include <optional>
 #include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include <binary_io/any_stream.hpp>
 #include <binary_io/file_stream.hpp>
+#include <binary_io/memory_stream.hpp>
+#include <binary_io/span_stream.hpp>
 #include <lz4.h>
 #include <lz4hc.h>
 #include <zlib.h>
 
 #include <DirectXTex.h>
 
+#include "bsa/async.hpp"
+#include "bsa/detail/async_read.hpp"
+#include "bsa/detail/codec_context.hpp"
+#include "bsa/detail/deduplicate.hpp"
+#include "bsa/detail/deflate.hpp"
+#include "bsa/detail/extract.hpp"
+#include "bsa/detail/index_cache.hpp"
+#include "bsa/detail/observe.hpp"
+#include "bsa/detail/parallel.hpp"
+#include "bsa/detail/verify.hpp"
+
 namespace bsa::fo4
 {
 	namespace detail
@@ -29,6 +48,9 @@ namespace bsa::fo4
 			namespace
 			{
 				constexpr auto btdx = make_four_cc("BTDX"sv);
+				constexpr auto bpat = make_four_cc("BPAT"sv);
+
+				constexpr std::uint32_t patch_version = 1;
 
 				constexpr std::size_t chunk_header_size_gnrl = 0x10;
 				constexpr std::size_t chunk_header_size_dx10 = 0x18;
@@ -38,6 +60,8 @@ namespace bsa::fo4
 
 				constexpr std::size_t chunk_sentinel = 0xBAADF00D;
 
+				constexpr std::size_t file_hash_size = 0xC;
+
 				constexpr std::uint32_t compression_lz4 = 3;
 			}
 		}
@@ -103,6 +127,473 @@ namespace bsa::fo4
 				return slice;
 			}
 
+			struct dds_layout_t final
+			{
+				DirectX::TexMetadata meta;
+				std::vector<DirectX::Image> images;
+			};
+
+			[[nodiscard]] auto legacy_dds_format(
+				std::uint32_t a_flags,
+				std::uint32_t a_fourCC,
+				std::uint32_t a_bitCount,
+				std::array<std::uint32_t, 4> a_masks) noexcept
+				-> ::DXGI_FORMAT
+			{
+				constexpr std::uint32_t ddpf_alphapixels = 0x1;
+				constexpr std::uint32_t ddpf_fourcc = 0x4;
+				constexpr std::uint32_t ddpf_rgb = 0x40;
+
+				if ((a_flags & ddpf_fourcc) != 0) {
+					switch (a_fourCC) {
+					case make_four_cc("DXT1"sv):
+						return DXGI_FORMAT_BC1_UNORM;
+					case make_four_cc("DXT3"sv):
+						return DXGI_FORMAT_BC2_UNORM;
+					case make_four_cc("DXT5"sv):
+						return DXGI_FORMAT_BC3_UNORM;
+					case make_four_cc("ATI1"sv):
+					case make_four_cc("BC4U"sv):
+						return DXGI_FORMAT_BC4_UNORM;
+					case make_four_cc("BC4S"sv):
+						return DXGI_FORMAT_BC4_SNORM;
+					case make_four_cc("ATI2"sv):
+					case make_four_cc("BC5U"sv):
+						return DXGI_FORMAT_BC5_UNORM;
+					case make_four_cc("BC5S"sv):
+						return DXGI_FORMAT_BC5_SNORM;
+					default:
+						return DXGI_FORMAT_UNKNOWN;
+					}
+				} else if ((a_flags & ddpf_rgb) != 0 && a_bitCount == 32) {
+					constexpr std::array<std::uint32_t, 4> rgba{ 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000 };
+					constexpr std::array<std::uint32_t, 4> bgra{ 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 };
+					constexpr std::array<std::uint32_t, 4> bgrx{ 0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000 };
+					const bool alpha = (a_flags & ddpf_alphapixels) != 0;
+					if (alpha && a_masks == rgba) {
+						return DXGI_FORMAT_R8G8B8A8_UNORM;
+					} else if (alpha && a_masks == bgra) {
+						return DXGI_FORMAT_B8G8R8A8_UNORM;
+					} else if (!alpha && a_masks == bgrx) {
+						return DXGI_FORMAT_B8G8R8X8_UNORM;
+					}
+				}
+
+				return DXGI_FORMAT_UNKNOWN;
+			}
+
+			// Parses the layout of a dds file, without decoding it. The images point directly into
+			//	`a_in`, so no copies are made.
+			// Only 2d textures and cubemaps, whose pixels can be used as is, are understood. Anything
+			//	else (volumes, arrays, legacy formats which need conversion, etc.) returns nothing,
+			//	and should be left to dxtex.
+			[[nodiscard]] auto parse_dds_layout(std::span<const std::byte> a_in)
+				-> std::optional<dds_layout_t>
+			{
+				constexpr std::size_t header_size = 4 + 124;
+				constexpr std::size_t header10_size = 20;
+				constexpr std::uint32_t caps2_cubemap = 0x200;
+				constexpr std::uint32_t caps2_cubemap_allfaces = 0xFC00;
+				constexpr std::uint32_t caps2_volume = 0x200000;
+
+				if (a_in.size() < header_size) {
+					return std::nullopt;
+				}
+
+				binary_io::span_istream in{ a_in };
+				const auto [magic, size, flags, height, width, pitch, depth, mipCount] =
+					in.read<
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t>();
+				in.seek_relative(11 * 4);  // skip reserved
+				const auto [pfSize, pfFlags, pfFourCC, pfBitCount, pfR, pfG, pfB, pfA] =
+					in.read<
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t,
+						std::uint32_t>();
+				const auto [caps, caps2] = in.read<std::uint32_t, std::uint32_t>();
+				in.seek_absolute(header_size);
+
+				if (magic != make_four_cc("DDS "sv) || size != 124 || pfSize != 32 ||
+					width == 0 || height == 0) {
+					return std::nullopt;
+				}
+
+				DirectX::TexMetadata meta{
+					.width = width,
+					.height = height,
+					.depth = 1,
+					.arraySize = 1,
+					.mipLevels = (std::max<std::size_t>)(mipCount, 1),
+					.miscFlags = 0,
+					.miscFlags2 = 0,
+					.format = DXGI_FORMAT_UNKNOWN,
+					.dimension = DirectX::TEX_DIMENSION_TEXTURE2D,
+				};
+
+				if ((pfFlags & 0x4) != 0 && pfFourCC == make_four_cc("DX10"sv)) {
+					if (a_in.size() < header_size + header10_size) {
+						return std::nullopt;
+					}
+
+					const auto [format, dimension, miscFlag, arraySize] =
+						in.read<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t>();
+					in.seek_absolute(header_size + header10_size);
+					if (dimension != DirectX::TEX_DIMENSION_TEXTURE2D || arraySize != 1 ||
+						(miscFlag & ~std::uint32_t{ DirectX::TEX_MISC_TEXTURECUBE }) != 0) {
+						return std::nullopt;
+					}
+
+					meta.format = static_cast<::DXGI_FORMAT>(format);
+					meta.miscFlags = miscFlag;
+				} else {
+					if ((caps2 & caps2_volume) != 0) {
+						return std::nullopt;
+					} else if ((caps2 & caps2_cubemap) != 0) {
+						if ((caps2 & caps2_cubemap_allfaces) != caps2_cubemap_allfaces) {
+							return std::nullopt;
+						}
+						meta.miscFlags = DirectX::TEX_MISC_TEXTURECUBE;
+					}
+
+					meta.format = legacy_dds_format(pfFlags, pfFourCC, pfBitCount, { pfR, pfG, pfB, pfA });
+				}
+
+				if (meta.format == DXGI_FORMAT_UNKNOWN || DirectX::BitsPerPixel(meta.format) == 0 ||
+					meta.mipLevels > static_cast<std::size_t>(std::bit_width((std::max)(meta.width, meta.height)))) {
+					return std::nullopt;
+				}
+
+				if (meta.IsCubemap()) {
+					meta.arraySize = 6;
+				}
+
+				dds_layout_t result;
+				result.meta = meta;
+				result.images.reserve(meta.arraySize * meta.mipLevels);
+				auto pos = static_cast<std::size_t>(in.tell());
+				for (std::size_t item = 0; item < meta.arraySize; ++item) {
+					std::size_t w = meta.width;
+					std::size_t h = meta.height;
+					for (std::size_t level = 0; level < meta.mipLevels; ++level) {
+						std::size_t rowPitch = 0;
+						std::size_t slicePitch = 0;
+						if (FAILED(DirectX::ComputePitch(meta.format, w, h, rowPitch, slicePitch)) ||
+							slicePitch > a_in.size() - pos) {
+							return std::nullopt;
+						}
+
+						result.images.push_back({
+							.width = w,
+							.height = h,
+							.format = meta.format,
+							.rowPitch = rowPitch,
+							.slicePitch = slicePitch,
+							// the pixels are never written to
+							.pixels = reinterpret_cast<std::uint8_t*>(
+								const_cast<std::byte*>(a_in.data() + pos)),
+						});
+
+						pos += slicePitch;
+						w = (std::max<std::size_t>)(w / 2, 1);
+						h = (std::max<std::size_t>)(h / 2, 1);
+					}
+				}
+
+				return result;
+			}
+
+			// Predicts how many chunks a dds is split into when read as a file, from its layout
+			//	alone. Returns `0` when only decoding the dds with dxtex can tell.
+			[[nodiscard]] auto predict_directx_chunks(
+				std::span<const std::byte> a_in,
+				std::size_t a_chunkWidth,
+				std::size_t a_chunkHeight)
+				-> std::size_t
+			{
+				const auto layout = parse_dds_layout(a_in);
+				if (!layout || layout->images.empty()) {
+					return 0;
+				} else if (layout->meta.IsCubemap()) {  // cubemaps are never chunked
+					return 1;
+				} else {
+					return chunk<4>(
+						layout->images,
+						directx_mip_chunk_maximum(layout->meta.format, a_chunkWidth, a_chunkHeight))
+					    .size();
+				}
+			}
+
+			// An encoded dds header. The magic, the header, and the dx10 extension are at most 148
+			//	bytes long, so the header is stored inline and never allocates.
+			class dds_header_t final
+			{
+			public:
+				static constexpr std::size_t max_size = 4 + 124 + 20;
+
+				[[nodiscard]] auto as_bytes() const noexcept
+					-> std::span<const std::byte> { return std::span{ _bytes }.first(_size); }
+
+				[[nodiscard]] auto buffer() noexcept
+					-> std::span<std::byte, max_size> { return _bytes; }
+
+				void resize(std::size_t a_size) noexcept
+				{
+					assert(a_size <= max_size);
+					_size = a_size;
+				}
+
+				void write(std::uint32_t a_value) noexcept
+				{
+					assert(_size + 4 <= max_size);
+					for (std::size_t i = 0; i < 4; ++i) {
+						_bytes[_size++] = static_cast<std::byte>((a_value >> i * 8u) & 0xFFu);
+					}
+				}
+
+			private:
+				std::array<std::byte, max_size> _bytes{};
+				std::size_t _size{ 0 };
+			};
+
+			// Encodes the dds header of the formats textures are commonly stored in directly,
+			//	producing exactly what DirectXTex would. Returns nothing for any other format.
+			[[nodiscard]] auto encode_dds_header_fast(const DirectX::TexMetadata& a_meta) noexcept
+				-> std::optional<dds_header_t>
+			{
+				struct pixel_format_t final
+				{
+					std::uint32_t flags{ 0 };
+					std::uint32_t fourCC{ 0 };
+					std::uint32_t bitCount{ 0 };
+					std::array<std::uint32_t, 4> masks{};
+				};
+
+				constexpr std::uint32_t fourcc = 0x4;
+				constexpr std::uint32_t rgb = 0x40;
+				constexpr std::uint32_t rgba = 0x41;
+				const auto compressed = [](std::string_view a_cc) noexcept {
+					return pixel_format_t{ fourcc, make_four_cc(a_cc) };
+				};
+
+				// block size for block compressed formats, bytes per pixel otherwise
+				std::size_t blockSize = 0;
+				bool blockCompressed = true;
+				std::optional<pixel_format_t> legacy;
+				switch (a_meta.format) {
+				case DXGI_FORMAT_BC1_UNORM:
+					legacy = compressed("DXT1"sv);
+					[[fallthrough]];
+				case DXGI_FORMAT_BC1_UNORM_SRGB:
+					blockSize = 8;
+					break;
+				case DXGI_FORMAT_BC4_UNORM:
+					legacy = compressed("BC4U"sv);
+					blockSize = 8;
+					break;
+				case DXGI_FORMAT_BC4_SNORM:
+					legacy = compressed("BC4S"sv);
+					blockSize = 8;
+					break;
+				case DXGI_FORMAT_BC2_UNORM:
+					legacy = compressed("DXT3"sv);
+					blockSize = 16;
+					break;
+				case DXGI_FORMAT_BC3_UNORM:
+					legacy = compressed("DXT5"sv);
+					blockSize = 16;
+					break;
+				case DXGI_FORMAT_BC5_UNORM:
+					legacy = compressed("BC5U"sv);
+					blockSize = 16;
+					break;
+				case DXGI_FORMAT_BC5_SNORM:
+					legacy = compressed("BC5S"sv);
+					blockSize = 16;
+					break;
+				case DXGI_FORMAT_BC2_UNORM_SRGB:
+				case DXGI_FORMAT_BC3_UNORM_SRGB:
+				case DXGI_FORMAT_BC6H_UF16:
+				case DXGI_FORMAT_BC6H_SF16:
+				case DXGI_FORMAT_BC7_UNORM:
+				case DXGI_FORMAT_BC7_UNORM_SRGB:
+					blockSize = 16;
+					break;
+				case DXGI_FORMAT_R8G8B8A8_UNORM:
+					legacy = pixel_format_t{ rgba, 0, 32, { 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000 } };
+					[[fallthrough]];
+				case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+				case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+					blockSize = 4;
+					blockCompressed = false;
+					break;
+				case DXGI_FORMAT_B8G8R8A8_UNORM:
+					legacy = pixel_format_t{ rgba, 0, 32, { 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 } };
+					blockSize = 4;
+					blockCompressed = false;
+					break;
+				case DXGI_FORMAT_B8G8R8X8_UNORM:
+					legacy = pixel_format_t{ rgb, 0, 32, { 0x00FF0000, 0x0000FF00, 0x000000FF, 0x00000000 } };
+					blockSize = 4;
+					blockCompressed = false;
+					break;
+				default:
+					return std::nullopt;
+				}
+
+				const auto pitch = [&]() noexcept -> std::size_t {
+					if (blockCompressed) {
+						const auto blocksWide = (std::max<std::size_t>)((a_meta.width + 3) / 4, 1);
+						const auto blocksHigh = (std::max<std::size_t>)((a_meta.height + 3) / 4, 1);
+						return blocksWide * blocksHigh * blockSize;
+					} else {
+						return a_meta.width * blockSize;
+					}
+				}();
+				if (pitch > (std::numeric_limits<std::uint32_t>::max)()) {
+					return std::nullopt;
+				}
+
+				const bool isCubemap = a_meta.IsCubemap();
+				const auto format = legacy.value_or(compressed("DX10"sv));
+
+				std::uint32_t flags = 0x1007;  // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
+				std::uint32_t caps = 0x1000;   // DDSCAPS_TEXTURE
+				if (a_meta.mipLevels > 0) {
+					flags |= 0x20000;  // DDSD_MIPMAPCOUNT
+					if (a_meta.mipLevels > 1) {
+						caps |= 0x400008;  // DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+					}
+				}
+				flags |= blockCompressed ? 0x80000 : 0x8;  // DDSD_LINEARSIZE : DDSD_PITCH
+				if (isCubemap) {
+					caps |= 0x8;  // DDSCAPS_COMPLEX
+				}
+
+				dds_header_t result;
+				result.write(make_four_cc("DDS "sv));
+				result.write(124);
+				result.write(flags);
+				result.write(static_cast<std::uint32_t>(a_meta.height));
+				result.write(static_cast<std::uint32_t>(a_meta.width));
+				result.write(static_cast<std::uint32_t>(pitch));
+				result.write(1);  // depth
+				result.write(static_cast<std::uint32_t>(a_meta.mipLevels));
+				for (std::size_t i = 0; i < 11; ++i) {
+					result.write(0);  // reserved
+				}
+
+				result.write(32);
+				result.write(format.flags);
+				result.write(format.fourCC);
+				result.write(format.bitCount);
+				for (const auto mask : format.masks) {
+					result.write(mask);
+				}
+
+				result.write(caps);
+				result.write(isCubemap ? 0xFE00 : 0);  // DDSCAPS2_CUBEMAP_ALLFACES
+				result.write(0);
+				result.write(0);
+				result.write(0);  // reserved
+
+				if (!legacy) {
+					result.write(static_cast<std::uint32_t>(a_meta.format));
+					result.write(static_cast<std::uint32_t>(a_meta.dimension));
+					result.write(isCubemap ? std::uint32_t{ DirectX::TEX_MISC_TEXTURECUBE } : 0u);
+					result.write(static_cast<std::uint32_t>(isCubemap ? a_meta.arraySize / 6u : a_meta.arraySize));
+					result.write(a_meta.miscFlags2);
+				}
+
+				return result;
+			}
+
+			// Encodes a dds header for the mips [a_first, a_first + a_count) of the file, where
+			//	`a_first` becomes the top level of the texture. DirectXTex is only consulted for
+			//	formats the fast path does not know.
+			[[nodiscard]] auto encode_dds_header(
+				const file& a_file,
+				std::size_t a_first,
+				std::size_t a_count)
+				-> dds_header_t
+			{
+				const bool isCubemap = (a_file.header.flags & 1u) != 0;
+				const DirectX::TexMetadata meta{
+					.width = (std::max<std::size_t>)(a_file.header.width >> a_first, 1),
+					.height = (std::max<std::size_t>)(a_file.header.height >> a_first, 1),
+					.depth = 1,
+					.arraySize = isCubemap ? 6u : 1u,
+					.mipLevels = a_count,
+					.miscFlags = isCubemap ? std::uint32_t{ DirectX::TEX_MISC_FLAG::TEX_MISC_TEXTURECUBE } : 0u,
+					.miscFlags2 = 0,
+					.format = static_cast<::DXGI_FORMAT>(a_file.header.format),
+					.dimension = DirectX::TEX_DIMENSION_TEXTURE2D,
+				};
+
+				if (auto result = encode_dds_header_fast(meta); result) {
+					return *result;
+				}
+
+				dds_header_t result;
+				std::size_t required = 0;
+				if (const auto hr = DirectX::EncodeDDSHeader(
+						meta,
+						DirectX::DDS_FLAGS::DDS_FLAGS_NONE,
+						result.buffer().data(),
+						result.buffer().size(),
+						required);
+					FAILED(hr)) {
+					throw bsa::exception("failed to encode dds header");
+				}
+
+				result.resize(required);
+				return result;
+			}
+
+			[[nodiscard]] auto encode_dds_header(const file& a_file)
+				-> dds_header_t
+			{
+				return encode_dds_header(a_file, 0, a_file.header.mip_count);
+			}
+
+			// Computes the offset of every mip within a single face of a directx file, relative to
+			//	the top level. The last offset is the size of the face.
+			[[nodiscard]] auto mip_offsets(const file& a_file)
+				-> std::vector<std::size_t>
+			{
+				const auto format = static_cast<::DXGI_FORMAT>(a_file.header.format);
+				std::vector<std::size_t> result;
+				result.reserve(a_file.header.mip_count + 1u);
+				result.push_back(0);
+
+				std::size_t w = a_file.header.width;
+				std::size_t h = a_file.header.height;
+				for (std::size_t level = 0; level < a_file.header.mip_count; ++level) {
+					std::size_t rowPitch = 0;
+					std::size_t slicePitch = 0;
+					if (FAILED(DirectX::ComputePitch(format, w, h, rowPitch, slicePitch))) {
+						throw bsa::exception("failed to compute the size of a mip");
+					}
+
+					result.push_back(result.back() + slicePitch);
+					w = (std::max<std::size_t>)(w / 2, 1);
+					h = (std::max<std::size_t>)(h / 2, 1);
+				}
+
+				return result;
+			}
+
 			[[nodiscard]] auto sizeof_header(version a_version) noexcept
 				-> std::size_t
 			{
@@ -119,6 +610,167 @@ namespace bsa::fo4
 					detail::declare_unreachable();
 				}
 			}
+
+			void append_hex(std::string& a_path, std::uint32_t a_value)
+			{
+				std::array<char, 2 + sizeof(std::uint32_t) * 2> buf{ '0', 'x' };
+				const auto [last, ec] = std::to_chars(
+					buf.data() + 2,
+					buf.data() + buf.size(),
+					a_value,
+					16);
+				assert(ec == std::errc());
+				a_path.append(buf.data(), last);
+			}
+
+			// the parts of the header a lazy archive keeps, as stored in its sidecar index
+			struct cache_info_t final
+			{
+				std::uint32_t format{ 0 };
+				std::uint32_t version{ 0 };
+				std::uint32_t compression_format{ 0 };
+				std::uint32_t strings{ 0 };
+			};
+
+			[[nodiscard]] auto make_path(const archive::key_type& a_key)
+				-> std::string
+			{
+				if (const auto name = a_key.name(); !name.empty()) {
+					return std::string(name);
+				}
+
+				const auto& hash = a_key.hash();
+				std::string result;
+				append_hex(result, hash.directory);
+				result += '\\';
+				append_hex(result, hash.file);
+				result += '.';
+				append_hex(result, hash.extension);
+				return result;
+			}
+
+			// Fetches the record at `a_pos` from a sparse stream. Records are fetched a window at a
+			//	time, since where they end isn't known until every one of them has been read.
+			void fetch_record(
+				detail::istream_t& a_in,
+				std::size_t a_pos,
+				std::size_t& a_fetched)
+			{
+				// the largest record possible: a texture with every chunk it can have
+				constexpr auto largest =
+					constants::chunk_header_size_dx10 +
+					0xFF * constants::chunk_size_dx10;
+				constexpr std::size_t window = std::size_t{ 1 } << 20;
+
+				if (a_pos + largest > a_fetched) {
+					a_in.fetch({ a_pos, window });
+					a_fetched = a_pos + window;
+				}
+			}
+
+			// Where the chunks of a file lie while they are all still to be read, as long as they
+			//	are laid out back to back in the same file.
+			[[nodiscard]] auto unread(const file& a_file) noexcept
+				-> std::optional<std::pair<const async_file*, extent_t>>
+			{
+				std::optional<std::pair<const async_file*, extent_t>> result;
+				for (const auto& chunk : a_file) {
+					const auto next = chunk.unread();
+					if (!next) {
+						return std::nullopt;
+					} else if (!result) {
+						result = next;
+					} else if (next->first != result->first ||
+							   next->second.offset != result->second.offset + result->second.size) {
+						return std::nullopt;
+					} else {
+						result->second.size += next->second.size;
+					}
+				}
+				return result;
+			}
+
+			void extract_entry(
+				const std::filesystem::path& a_path,
+				const archive::key_type& a_key,
+				const file& a_file,
+				const file::write_params& a_params)
+			{
+				try {
+					extract_file(
+						a_path,
+						a_file.written_size(a_params),
+						[&](std::span<std::byte> a_out) {
+							a_file.write_into(a_out, a_params);
+						});
+				} catch (const bsa::compression_error& a_err) {
+					throw bsa::compression_error(a_err, make_path(a_key));
+				}
+			}
+
+			[[nodiscard]] auto codec_of(compression_format a_format) noexcept
+				-> observer::codec
+			{
+				return a_format == compression_format::lz4 ?
+				           observer::codec::lz4 :
+				           observer::codec::zlib;
+			}
+
+			// A checksum of everything which is written for a file. Fields are fed in little endian
+			//	order, so checksums can be shared between machines.
+			[[nodiscard]] auto checksum(const file& a_file) noexcept
+				-> std::uint32_t
+			{
+				auto result = ::crc32(0, nullptr, 0);
+				const auto update = [&](std::span<const std::byte> a_bytes) noexcept {
+					// crc32 only accepts so many bytes at once
+					while (!a_bytes.empty()) {
+						const auto size = (std::min<std::size_t>)(a_bytes.size(), (std::numeric_limits<uInt>::max)());
+						result = ::crc32(result, reinterpret_cast<const Bytef*>(a_bytes.data()), static_cast<uInt>(size));
+						a_bytes = a_bytes.subspan(size);
+					}
+				};
+				const auto update_int = [&](std::uint32_t a_value) noexcept {
+					const std::array bytes{
+						static_cast<std::byte>(a_value),
+						static_cast<std::byte>(a_value >> 8u),
+						static_cast<std::byte>(a_value >> 16u),
+						static_cast<std::byte>(a_value >> 24u),
+					};
+					update(bytes);
+				};
+
+				const auto& header = a_file.header;
+				update_int(std::uint32_t{ header.height } | std::uint32_t{ header.width } << 16u);
+				update_int(
+					std::uint32_t{ header.mip_count } |
+					std::uint32_t{ header.format } << 8u |
+					std::uint32_t{ header.flags } << 16u |
+					std::uint32_t{ header.tile_mode } << 24u);
+				for (const auto& chunk : a_file) {
+					update_int(chunk.compressed() ? static_cast<std::uint32_t>(chunk.decompressed_size()) : 0u);
+					update_int(std::uint32_t{ chunk.mips.first } | std::uint32_t{ chunk.mips.last } << 16u);
+					update(chunk.as_bytes());
+				}
+
+				return static_cast<std::uint32_t>(result);
+			}
+
+			// Checks if two files would be written out identically.
+			[[nodiscard]] bool same_file(
+				const file& a_lhs,
+				const file& a_rhs) noexcept
+			{
+				return a_lhs.header == a_rhs.header &&
+				       std::equal(
+						   a_lhs.begin(),
+						   a_lhs.end(),
+						   a_rhs.begin(),
+						   a_rhs.end(),
+						   [](const fo4::chunk& a_l, const fo4::chunk& a_r) noexcept {
+							   return a_l.mips == a_r.mips && same_contents(a_l, a_r);
+						   });
+			}
 		}
 
 		class header_t final
@@ -242,94 +894,84 @@ namespace bsa::fo4
 		};
 	}
 
-	namespace hashing
+	namespace detail
 	{
-		namespace
+		auto crc32_sliced(std::string_view a_string) noexcept
+			-> std::uint32_t
 		{
-			struct split_t
-			{
-				std::string_view parent;
-				std::string_view stem;
-				std::string_view extension;
+			static constexpr std::array<std::uint32_t, 256> lut = {
+				0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
+				0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
+				0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+				0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
+				0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172, 0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
+				0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+				0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
+				0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924, 0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
+				0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+				0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
+				0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E, 0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
+				0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+				0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
+				0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0, 0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
+				0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+				0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
+				0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A, 0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
+				0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+				0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
+				0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC, 0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
+				0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+				0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
+				0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236, 0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
+				0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+				0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
+				0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38, 0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
+				0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+				0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
+				0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2, 0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
+				0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+				0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
+				0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 			};
 
-			[[nodiscard]] auto split_path(std::string_view a_path) noexcept
-				-> split_t
-			{
-				const auto find = [&](char a_ch) noexcept {
-					const auto pos = a_path.find_last_of(a_ch);
-					return pos != std::string_view::npos ?
-					           std::optional{ pos } :
-					           std::nullopt;
-				};
-
-				split_t result;
-				const auto pstem = find('\\');
-				const auto pextension = find('.');
-
-				if (pstem) {
-					result.parent = a_path.substr(0, *pstem);
-				}
-
-				if (pextension) {
-					result.extension = a_path.substr(*pextension + 1);  // don't include '.'
+			// slicing-by-4 tables, where `tables[n][i]` is the crc of byte `i` followed by `n` zero bytes
+			static constexpr auto tables = [](const std::array<std::uint32_t, 256>& a_lut) noexcept {
+				std::array<std::array<std::uint32_t, 256>, 4> result{};
+				result[0] = a_lut;
+				for (std::size_t n = 1; n < result.size(); ++n) {
+					for (std::size_t i = 0; i < 256; ++i) {
+						const auto prev = result[n - 1][i];
+						result[n][i] = (prev >> 8u) ^ a_lut[prev & 0xFFu];
+					}
 				}
-
-				const auto first = pstem ? *pstem + 1 : 0;
-				const auto last = pextension ?
-				                      *pextension - first :
-				                      pextension.value_or(std::string_view::npos);
-				result.stem = a_path.substr(first, last);
-
 				return result;
-			}
+			}(lut);
 
-			[[nodiscard]] auto crc32(std::string_view a_string) noexcept
-				-> std::uint32_t
-			{
-				constexpr std::array<std::uint32_t, 256> lut = {
-					0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
-					0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
-					0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
-					0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
-					0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172, 0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
-					0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
-					0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
-					0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924, 0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
-					0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
-					0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
-					0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E, 0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
-					0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
-					0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
-					0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0, 0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
-					0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
-					0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
-					0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A, 0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
-					0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
-					0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
-					0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC, 0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
-					0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
-					0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
-					0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236, 0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
-					0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
-					0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
-					0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38, 0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
-					0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
-					0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
-					0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2, 0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
-					0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
-					0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
-					0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
-				};
+			const auto byte = [&](std::size_t a_idx) noexcept {
+				return std::uint32_t{ static_cast<unsigned char>(a_string[a_idx]) };
+			};
 
-				std::uint32_t result = 0;
-				for (const auto c : a_string) {
-					result = (result >> 8u) ^ lut[(result ^ static_cast<unsigned char>(c)) & 0xFFu];
-				}
-				return result;
+			std::uint32_t result = 0;
+			std::size_t i = 0;
+			for (; a_string.size() - i >= 4; i += 4) {
+				result ^= byte(i) |
+				          byte(i + 1) << 8u |
+				          byte(i + 2) << 16u |
+				          byte(i + 3) << 24u;
+				result = tables[3][result & 0xFFu] ^
+				         tables[2][(result >> 8u) & 0xFFu] ^
+				         tables[1][(result >> 16u) & 0xFFu] ^
+				         tables[0][result >> 24u];
+			}
+			for (; i < a_string.size(); ++i) {
+				result = (result >> 8u) ^ lut[(result ^ byte(i)) & 0xFFu];
 			}
+			return result;
 		}
+	}
 
+	namespace hashing
+	{
 		auto operator>>(
 			detail::istream_t& a_in,
 			hash& a_hash)
@@ -351,30 +993,20 @@ namespace bsa::fo4
 		hash hash_file_in_place(std::string& a_path) noexcept
 		{
 			detail::normalize_path(a_path);
-			const auto pieces = split_path(a_path);
-
-			hash h;
-			h.directory = crc32(pieces.parent);
-			h.file = crc32(pieces.stem);
-
-			const auto len = std::min<std::size_t>(pieces.extension.length(), 4u);
-			for (std::size_t i = 0; i < len; ++i) {
-				h.extension |=
-					std::uint32_t{ static_cast<unsigned char>(pieces.extension[i]) }
-					<< i * 8u;
-			}
-
-			return h;
+			return detail::hash_normalized(a_path);
 		}
 	}
 
-	std::size_t chunk::compress_into_lz4(std::span<std::byte> a_out) const
+	std::size_t chunk::compress_into_lz4(
+		std::span<std::byte> a_out,
+		codec_context& a_context) const
 	{
 		assert(!this->compressed());
 		assert(a_out.size_bytes() >= this->compress_bound(compression_format::lz4));
 
 		const auto in = this->as_bytes();
-		const auto result = ::LZ4_compress_HC(
+		const auto result = ::LZ4_compress_HC_extStateHC(
+			detail::get_codec_state(a_context).lz4hc_state(),
 			reinterpret_cast<const char*>(in.data()),
 			reinterpret_cast<char*>(a_out.data()),
 			static_cast<int>(in.size_bytes()),
@@ -389,6 +1021,7 @@ namespace bsa::fo4
 
 	std::size_t chunk::compress_into_zlib(
 		std::span<std::byte> a_out,
+		codec_context& a_context,
 		int a_level,
 		int a_windowBits,
 		int a_memLevel) const
@@ -396,52 +1029,13 @@ namespace bsa::fo4
 		assert(!this->compressed());
 		assert(a_out.size_bytes() >= this->compress_bound(compression_format::zip));
 
-		::z_stream stream = {};
-		if (const auto result = deflateInit2(
-				&stream,
-				a_level,
-				Z_DEFLATED,
-				a_windowBits,
-				a_memLevel,
-				Z_DEFAULT_STRATEGY);
-			result != Z_OK) {
-			throw bsa::compression_error(bsa::compression_error::library::zlib, result);
-		}
-
-		const auto in = this->as_bytes();
-
-		stream.next_out = reinterpret_cast<::Bytef*>(a_out.data());
-		stream.avail_out = 0;
-		stream.next_in = (z_const ::Bytef*)in.data();
-		stream.avail_in = 0;
-
-		auto insz = in.size_bytes();
-		auto outsz = a_out.size_bytes();
-		int error = Z_OK;
-		do {
-			if (stream.avail_out == 0) {
-				stream.avail_out = static_cast<::uInt>(
-					std::min<std::size_t>((std::numeric_limits<::uInt>::max)(), outsz));
-				outsz -= stream.avail_out;
-			}
-
-			if (stream.avail_in == 0) {
-				stream.avail_in = static_cast<::uInt>(
-					std::min<std::size_t>((std::numeric_limits<::uInt>::max)(), insz));
-				insz -= stream.avail_in;
-			}
-
-			error = ::deflate(&stream, insz > 0 ? Z_NO_FLUSH : Z_FINISH);
-		} while (error == Z_OK);
-
-		const auto finalsz = stream.total_out;
-		::deflateEnd(&stream);
-
-		if (error != Z_STREAM_END) {
-			throw bsa::compression_error(bsa::compression_error::library::zlib, error);
-		}
-
-		return finalsz;
+		return detail::deflate::compress(
+			a_context,
+			a_out,
+			this->as_bytes(),
+			a_level,
+			a_windowBits,
+			a_memLevel);
 	}
 
 	void chunk::decompress_into_lz4(std::span<std::byte> a_out) const
@@ -466,25 +1060,34 @@ namespace bsa::fo4
 		}
 	}
 
-	void chunk::decompress_into_zlib(std::span<std::byte> a_out) const
+	void chunk::decompress_into_zlib(
+		std::span<std::byte> a_out,
+		codec_context& a_context) const
 	{
 		assert(this->compressed());
 		assert(a_out.size_bytes() >= this->decompressed_size());
 
-		const auto in = this->as_bytes();
-		auto outsz = static_cast<::uLong>(a_out.size_bytes());
+		const auto outsz = detail::deflate::decompress(a_context, a_out, this->as_bytes());
+		if (outsz != this->decompressed_size()) {
+			throw bsa::compression_error(detail::error_code::decompress_size_mismatch);
+		}
+	}
 
-		const auto result = ::uncompress(
-			reinterpret_cast<::Byte*>(a_out.data()),
-			&outsz,
-			reinterpret_cast<const ::Byte*>(in.data()),
-			static_cast<::uLong>(in.size_bytes()));
-		if (result != Z_OK) {
-			throw bsa::compression_error(bsa::compression_error::library::zlib, result);
+	auto chunk::open_stream(compression_format a_format) const
+		-> decompression_stream
+	{
+		using codec = decompression_stream::codec;
+		if (!this->compressed()) {
+			return { codec::none, this->as_bytes(), this->size() };
 		}
 
-		if (outsz != this->decompressed_size()) {
-			throw bsa::compression_error(detail::error_code::decompress_size_mismatch);
+		switch (a_format) {
+		case compression_format::zip:
+			return { codec::zlib, this->as_bytes(), this->decompressed_size() };
+		case compression_format::lz4:
+			return { codec::lz4_block, this->as_bytes(), this->decompressed_size() };
+		default:
+			detail::declare_unreachable();
 		}
 	}
 
@@ -508,10 +1111,19 @@ namespace bsa::fo4
 
 	void chunk::compress(const compression_params& a_params)
 	{
+		if (detail::skip_compression(this->as_bytes(), a_params.compression_policy_)) {
+			return;
+		}
+
 		std::vector<std::byte> out;
 		out.resize(this->compress_bound(a_params.compression_format_));
+		detail::observe_allocation(out.size());
 
 		const auto outsz = this->compress_into({ out.data(), out.size() }, a_params);
+		if (!detail::keep_compression(this->size(), outsz, a_params.compression_policy_)) {
+			return;
+		}
+
 		out.resize(outsz);
 		out.shrink_to_fit();
 		this->set_data(std::move(out), this->size());
@@ -525,7 +1137,7 @@ namespace bsa::fo4
 		assert(!this->compressed());
 		switch (a_format) {
 		case compression_format::zip:
-			return ::compressBound(static_cast<::uLong>(this->size()));
+			return detail::deflate::compress_bound(this->size());
 		case compression_format::lz4:
 			return ::LZ4_compressBound(static_cast<int>(this->size()));
 		default:
@@ -538,29 +1150,47 @@ namespace bsa::fo4
 		const compression_params& a_params) const
 		-> std::size_t
 	{
-		switch (a_params.compression_format_) {
-		case compression_format::zip:
-			switch (a_params.compression_level_) {
-			case compression_level::fo4:
-				return this->compress_into_zlib(a_out, Z_DEFAULT_COMPRESSION, MAX_WBITS, 8);
-			case compression_level::fo4_xbox:
-				return this->compress_into_zlib(a_out, Z_BEST_COMPRESSION, 12, 8);
-			case compression_level::sf:
-				return this->compress_into_zlib(a_out, Z_BEST_COMPRESSION, MAX_WBITS, MAX_MEM_LEVEL);
+		return this->compress_into(a_out, a_params, detail::local_codec_context());
+	}
+
+	auto chunk::compress_into(
+		std::span<std::byte> a_out,
+		const compression_params& a_params,
+		codec_context& a_context) const
+		-> std::size_t
+	{
+		detail::observe_codec observe{
+			detail::codec_of(a_params.compression_format_),
+			observer::operation::compress
+		};
+		const auto outsz = [&]() {
+			switch (a_params.compression_format_) {
+			case compression_format::zip:
+				switch (a_params.compression_level_) {
+				case compression_level::fo4:
+					return this->compress_into_zlib(a_out, a_context, Z_DEFAULT_COMPRESSION, MAX_WBITS, 8);
+				case compression_level::fo4_xbox:
+					return this->compress_into_zlib(a_out, a_context, Z_BEST_COMPRESSION, 12, 8);
+				case compression_level::sf:
+					return this->compress_into_zlib(a_out, a_context, Z_BEST_COMPRESSION, MAX_WBITS, MAX_MEM_LEVEL);
+				default:
+					detail::declare_unreachable();
+				}
+			case compression_format::lz4:
+				return this->compress_into_lz4(a_out, a_context);
 			default:
 				detail::declare_unreachable();
 			}
-		case compression_format::lz4:
-			return this->compress_into_lz4(a_out);
-		default:
-			detail::declare_unreachable();
-		}
+		}();
+		observe.finish(this->size(), outsz);
+		return outsz;
 	}
 
 	void chunk::decompress(compression_format a_format)
 	{
 		std::vector<std::byte> out;
 		out.resize(this->decompressed_size());
+		detail::observe_allocation(out.size());
 		this->decompress_into({ out.data(), out.size() }, a_format);
 		this->set_data(std::move(out));
 
@@ -571,9 +1201,21 @@ namespace bsa::fo4
 		std::span<std::byte> a_out,
 		compression_format a_format) const
 	{
+		this->decompress_into(a_out, a_format, detail::local_codec_context());
+	}
+
+	void chunk::decompress_into(
+		std::span<std::byte> a_out,
+		compression_format a_format,
+		codec_context& a_context) const
+	{
+		detail::observe_codec observe{
+			detail::codec_of(a_format),
+			observer::operation::decompress
+		};
 		switch (a_format) {
 		case compression_format::zip:
-			this->decompress_into_zlib(a_out);
+			this->decompress_into_zlib(a_out, a_context);
 			break;
 		case compression_format::lz4:
 			this->decompress_into_lz4(a_out);
@@ -581,6 +1223,7 @@ namespace bsa::fo4
 		default:
 			detail::declare_unreachable();
 		}
+		observe.finish(this->size(), this->decompressed_size());
 	}
 
 	auto operator>>(
@@ -647,60 +1290,239 @@ namespace bsa::fo4
 		}
 	}
 
-	void file::read_directx(
-		detail::istream_t& a_in,
-		const read_params& a_params)
+	void file::write_into(
+		std::span<std::byte> a_out,
+		const write_params& a_params) const
 	{
-		DirectX::ScratchImage scratch;
-		const auto in = a_in->rdbuf();
-		if (const auto result = DirectX::LoadFromDDSMemory(
-				in.data(),
-				in.size_bytes(),
-				DirectX::DDS_FLAGS::DDS_FLAGS_NONE,
-				nullptr,
-				scratch);
-			FAILED(result)) {
-			throw bsa::exception("failed to load dds from memory");
-		}
-
-		this->clear();
-		this->reserve(4u);
-
-		auto& meta = scratch.GetMetadata();
-		this->header.height = static_cast<std::uint16_t>(meta.height);
-		this->header.width = static_cast<std::uint16_t>(meta.width);
-		this->header.mip_count = static_cast<std::uint8_t>(meta.mipLevels);
-		this->header.format = static_cast<std::uint8_t>(meta.format);
-		this->header.flags = meta.IsCubemap() ? 1u : 0u;
-		this->header.tile_mode = 8u;
+		assert(a_out.size() == this->written_size(a_params));
 
-		const std::span images{ scratch.GetImages(), scratch.GetImageCount() };
-		const auto addChunk = [&](std::span<const DirectX::Image> a_splice) {
-			assert(!a_splice.empty());
+		if (a_params.format_ == format::directx) {
+			const auto header = detail::encode_dds_header(*this).as_bytes();
+			std::memcpy(a_out.data(), header.data(), header.size());
+			a_out = a_out.subspan(header.size());
+		}
 
-			std::vector<std::byte> bytes;
-			for (const auto& image : a_splice) {
-				// dxtex always allocates internally, so we're forced to allocate,
-				//	even for mmapped files
-				const auto pixels = reinterpret_cast<std::byte*>(image.pixels);
-				bytes.insert(bytes.end(), pixels, pixels + image.slicePitch);
+		for (const auto& chunk : *this) {
+			if (chunk.compressed()) {
+				const auto size = chunk.decompressed_size();
+				chunk.decompress_into(a_out.first(size), a_params.compression_format_);
+				a_out = a_out.subspan(size);
+			} else {
+				const auto bytes = chunk.as_bytes();
+				std::memcpy(a_out.data(), bytes.data(), bytes.size());
+				a_out = a_out.subspan(bytes.size());
 			}
+		}
+	}
+
+	auto file::written_size(const write_params& a_params) const
+		-> std::size_t
+	{
+		std::size_t result =
+			a_params.format_ == format::directx ?
+				detail::encode_dds_header(*this).as_bytes().size() :
+				0;
+		for (const auto& chunk : *this) {
+			result += chunk.compressed() ? chunk.decompressed_size() : chunk.size();
+		}
+		return result;
+	}
+
+	void file::write_mips(
+		write_sink a_sink,
+		chunk::mips_t a_mips,
+		compression_format a_format) const
+	{
+		const auto pixels = this->read_mips(a_mips, a_format);
+		const auto header = detail::encode_dds_header(
+			*this,
+			a_mips.first,
+			a_mips.last - a_mips.first + 1u);
+
+		auto& out = a_sink.stream();
+		out.write_bytes(header.as_bytes());
+		out.write_bytes(pixels);
+	}
+
+	auto file::read_mips(
+		chunk::mips_t a_mips,
+		compression_format a_format) const
+		-> std::vector<std::byte>
+	{
+		if (a_mips.first > a_mips.last || a_mips.last >= this->header.mip_count) {
+			throw bsa::exception("mip range is out of bounds");
+		}
+
+		const auto offsets = detail::mip_offsets(*this);
+		const std::size_t faces = (this->header.flags & 1u) != 0 ? 6 : 1;
+		const auto sizeof_mips = [&](chunk::mips_t a_range) noexcept {
+			return offsets[a_range.last + 1u] - offsets[a_range.first];
+		};
+
+		// every chunk holds each face of its mips, so decompress each overlapping chunk once
+		struct source_t final
+		{
+			chunk::mips_t mips;
+			std::span<const std::byte> bytes;
+		};
+
+		std::vector<std::vector<std::byte>> buffers;
+		buffers.reserve(this->size());
+		std::vector<source_t> sources;
+		for (const auto& chunk : *this) {
+			if (chunk.mips.last < a_mips.first || chunk.mips.first > a_mips.last) {
+				continue;
+			} else if (chunk.mips.first > chunk.mips.last || chunk.mips.last >= this->header.mip_count) {
+				throw bsa::exception("chunk mips are out of bounds");
+			}
+
+			const auto expected = faces * sizeof_mips(chunk.mips);
+			if (chunk.compressed()) {
+				if (chunk.decompressed_size() != expected) {
+					throw bsa::exception("chunk size does not match its mips");
+				}
+				auto& buffer = buffers.emplace_back(expected);
+				chunk.decompress_into(buffer, a_format);
+				sources.push_back({ chunk.mips, buffer });
+			} else {
+				if (chunk.size() != expected) {
+					throw bsa::exception("chunk size does not match its mips");
+				}
+				sources.push_back({ chunk.mips, chunk.as_bytes() });
+			}
+		}
+
+		std::vector<std::byte> result;
+		result.reserve(faces * sizeof_mips(a_mips));
+		for (std::size_t face = 0; face < faces; ++face) {
+			for (std::size_t level = a_mips.first; level <= a_mips.last; ++level) {
+				const auto source = std::find_if(
+					sources.begin(),
+					sources.end(),
+					[&](const source_t& a_source) noexcept {
+						return a_source.mips.first <= level && level <= a_source.mips.last;
+					});
+				if (source == sources.end()) {
+					throw bsa::exception("file is missing a mip");
+				}
+
+				const auto offset =
+					face * sizeof_mips(source->mips) +
+					(offsets[level] - offsets[source->mips.first]);
+				const auto bytes = source->bytes.subspan(offset, offsets[level + 1] - offsets[level]);
+				result.insert(result.end(), bytes.begin(), bytes.end());
+			}
+		}
+
+		return result;
+	}
+
+	std::size_t file::read_range(
+		std::size_t a_offset,
+		std::span<std::byte> a_out,
+		compression_format a_format) const
+	{
+		std::size_t read = 0;
+		std::size_t pos = 0;
+		std::vector<std::byte> buffer;
+		for (const auto& chunk : *this) {
+			if (read == a_out.size()) {
+				break;
+			}
+
+			const auto size = chunk.compressed() ? chunk.decompressed_size() : chunk.size();
+			if (a_offset + read < pos + size) {
+				const auto start = a_offset + read - pos;
+				const auto out = a_out.subspan(read, (std::min)(size - start, a_out.size() - read));
+				if (!chunk.compressed()) {
+					std::memcpy(out.data(), chunk.as_bytes().data() + start, out.size());
+				} else if (out.size() == size) {
+					chunk.decompress_into(out, a_format);
+				} else {
+					buffer.resize(size);
+					chunk.decompress_into(buffer, a_format);
+					std::memcpy(out.data(), buffer.data() + start, out.size());
+				}
+				read += out.size();
+			}
+			pos += size;
+		}
+
+		return read;
+	}
+
+	void file::read_directx(
+		detail::istream_t& a_in,
+		const read_params& a_params)
+	{
+		const auto in = a_in->rdbuf();
+		auto layout = detail::parse_dds_layout(in);
+		DirectX::ScratchImage scratch;
+		if (!layout) {
+			if (const auto result = DirectX::LoadFromDDSMemory(
+					in.data(),
+					in.size_bytes(),
+					DirectX::DDS_FLAGS::DDS_FLAGS_NONE,
+					nullptr,
+					scratch);
+				FAILED(result)) {
+				throw bsa::exception("failed to load dds from memory");
+			}
+		}
+
+		this->clear();
+		this->reserve(4u);
+
+		const auto& meta = layout ? layout->meta : scratch.GetMetadata();
+		this->header.height = static_cast<std::uint16_t>(meta.height);
+		this->header.width = static_cast<std::uint16_t>(meta.width);
+		this->header.mip_count = static_cast<std::uint8_t>(meta.mipLevels);
+		this->header.format = static_cast<std::uint8_t>(meta.format);
+		this->header.flags = meta.IsCubemap() ? 1u : 0u;
+		this->header.tile_mode = 8u;
+
+		const auto images =
+			layout ?
+				std::span<const DirectX::Image>{ layout->images } :
+				std::span<const DirectX::Image>{ scratch.GetImages(), scratch.GetImageCount() };
+		const auto addChunk = [&](std::span<const DirectX::Image> a_splice) {
+			assert(!a_splice.empty());
 
 			const auto mipIdx = [&](const DirectX::Image& a_image) noexcept {
 				return static_cast<std::uint16_t>(
 					(std::min<std::size_t>)(  //
-						&a_image - scratch.GetImages(),
+						&a_image - images.data(),
 						this->header.mip_count - 1u));
 			};
 
 			auto& chunk = this->emplace_back();
 			chunk.mips.first = mipIdx(a_splice.front());
 			chunk.mips.last = mipIdx(a_splice.back());
-			chunk.set_data(std::move(bytes));
+			if (layout) {
+				// mips within a splice are contiguous in the source, so we can slice them out
+				//	directly
+				const auto first = reinterpret_cast<const std::byte*>(a_splice.front().pixels);
+				const auto last = reinterpret_cast<const std::byte*>(a_splice.back().pixels) +
+				                  a_splice.back().slicePitch;
+				chunk.set_data(
+					{ first, static_cast<std::size_t>(last - first) },
+					a_in);
+			} else {
+				std::vector<std::byte> bytes;
+				for (const auto& image : a_splice) {
+					// dxtex always allocates internally, so we're forced to allocate,
+					//	even for mmapped files
+					const auto pixels = reinterpret_cast<std::byte*>(image.pixels);
+					bytes.insert(bytes.end(), pixels, pixels + image.slicePitch);
+				}
+				chunk.set_data(std::move(bytes));
+			}
+
 			if (a_params.compression_type_ == compression_type::compressed) {
 				chunk.compress({
 					.compression_format_ = a_params.compression_format_,
 					.compression_level_ = a_params.compression_level_,
+					.compression_policy_ = a_params.compression_policy_,
 				});
 			}
 		};
@@ -730,6 +1552,7 @@ namespace bsa::fo4
 			chunk.compress({
 				.compression_format_ = a_params.compression_format_,
 				.compression_level_ = a_params.compression_level_,
+				.compression_policy_ = a_params.compression_policy_,
 			});
 		}
 	}
@@ -738,57 +1561,33 @@ namespace bsa::fo4
 		detail::ostream_t& a_out,
 		compression_format a_format) const
 	{
-		const bool isCubemap = (this->header.flags & 1u) != 0;
-		const DirectX::TexMetadata meta{
-			.width = this->header.width,
-			.height = this->header.height,
-			.depth = 1,
-			.arraySize = isCubemap ? 6u : 1u,
-			.mipLevels = this->header.mip_count,
-			.miscFlags = isCubemap ? std::uint32_t{ DirectX::TEX_MISC_FLAG::TEX_MISC_TEXTURECUBE } : 0u,
-			.miscFlags2 = 0,
-			.format = static_cast<::DXGI_FORMAT>(this->header.format),
-			.dimension = DirectX::TEX_DIMENSION_TEXTURE2D,
-		};
-
-		std::size_t required = 0;
-		if (const auto result = DirectX::EncodeDDSHeader(meta, DirectX::DDS_FLAGS_NONE, nullptr, 0, required);
-			FAILED(result)) {
-			throw bsa::exception("failed to encode dds header");
-		}
-
-		DirectX::Blob blob;
-		blob.Initialize(required);
-
-		if (const auto result = DirectX::EncodeDDSHeader(
-				meta,
-				DirectX::DDS_FLAGS::DDS_FLAGS_NONE,
-				blob.GetBufferPointer(),
-				blob.GetBufferSize(),
-				required);
-			FAILED(result)) {
-			throw bsa::exception("failed to encode dds header");
-		}
-
-		a_out.write_bytes({ //
-			reinterpret_cast<const std::byte*>(blob.GetBufferPointer()),
-			blob.GetBufferSize() });
-		std::vector<std::byte> buffer;
-		for (const auto& chunk : *this) {
-			if (chunk.compressed()) {
-				buffer.resize(chunk.decompressed_size());
-				chunk.decompress_into(buffer, a_format);
-				a_out.write_bytes(buffer);
-			} else {
-				a_out.write_bytes(chunk.as_bytes());
-			}
-		}
+		a_out.write_bytes(detail::encode_dds_header(*this).as_bytes());
+		this->write_general(a_out, a_format);
 	}
 
 	void file::write_general(
 		detail::ostream_t& a_out,
 		compression_format a_format) const
 	{
+		// memory sinks are decompressed into directly, rather than through a scratch buffer
+		if (const auto memory = a_out.get_if<binary_io::memory_ostream>(); memory) {
+			auto& bytes = memory->rdbuf();
+			for (const auto& chunk : *this) {
+				const auto pos = static_cast<std::size_t>(memory->tell());
+				if (chunk.compressed()) {
+					const auto size = chunk.decompressed_size();
+					if (bytes.size() < pos + size) {
+						bytes.resize(pos + size);
+					}
+					chunk.decompress_into(std::span{ bytes }.subspan(pos, size), a_format);
+					memory->seek_absolute(static_cast<binary_io::streamoff>(pos + size));
+				} else {
+					memory->write_bytes(chunk.as_bytes());
+				}
+			}
+			return;
+		}
+
 		std::vector<std::byte> buffer;
 		for (const auto& chunk : *this) {
 			if (chunk.compressed()) {
@@ -801,20 +1600,34 @@ namespace bsa::fo4
 		}
 	}
 
+	void archive::intern_names()
+	{
+		this->intern_keys(_names);
+	}
+
 	auto archive::read(read_source a_source)
 		-> meta_info
 	{
-		auto& in = a_source.stream();
+		const detail::observe_phase phase{ observer::phase::read };
+		auto& in = a_source.sparse_stream();
+		std::size_t fetched = 0;
 		const auto header = [&]() {
+			detail::fetch_record(in, 0, fetched);  // the header is fetched with the first window
 			detail::header_t result;
 			in >> result;
 			return result;
 		}();
 
 		this->clear();
+		if (const auto strings = header.string_table_offset(); strings != 0) {
+			in.fetch({ static_cast<std::size_t>(strings), in->rdbuf().size() });
+		}
+
+		this->bulk_reserve(header.file_count());
 		for (std::size_t i = 0, strpos = header.string_table_offset();
 			 i < header.file_count();
 			 ++i) {
+			detail::fetch_record(in, static_cast<std::size_t>(in->tell()), fetched);
 			hashing::hash hash;
 			in >> hash;
 
@@ -830,179 +1643,700 @@ namespace bsa::fo4
 				}
 			}();
 
-			[[maybe_unused]] const auto [it, success] =
-				this->insert(
-					key_type{ hash, name, in },
-					mapped_type{});
-			assert(success);
-
-			this->read_file(it->second, in, header.archive_format());
+			auto& value = this->bulk_insert(
+				key_type{ hash, name, in },
+				mapped_type{});
+			this->read_file(value.second, in, header.archive_format());
 		}
+		this->bulk_finalize();
 
 		return header.make_meta();
 	}
 
-	void archive::write(
-		write_sink a_sink,
-		const meta_info& a_meta) const
+	auto archive::read(
+		read_source a_source,
+		std::size_t a_threads)
+		-> meta_info
 	{
-		auto& out = a_sink.stream();
-
-		auto [header, dataOffset] = make_header(a_meta);
-		out << header;
-
-		for (const auto& [key, file] : *this) {
-			out << key.hash();
-			this->write_file(file, out, a_meta.format_, dataOffset);
-		}
-
-		for (const auto& file : *this) {
-			for (const auto& chunk : file.second) {
-				out.write_bytes(chunk.as_bytes());
-			}
-		}
+		const detail::observe_phase phase{ observer::phase::read };
+		auto& in = a_source.sparse_stream();
+		std::size_t fetched = 0;
+		const auto header = [&]() {
+			detail::fetch_record(in, 0, fetched);  // the header is fetched with the first window
+			detail::header_t result;
+			in >> result;
+			return result;
+		}();
 
-		if (a_meta.strings) {
-			for ([[maybe_unused]] const auto& [key, file] : *this) {
-				detail::write_wstring(out, key.name());
-			}
+		this->clear();
+		if (const auto strings = header.string_table_offset(); strings != 0) {
+			in.fetch({ static_cast<std::size_t>(strings), in->rdbuf().size() });
 		}
-	}
 
-	auto archive::make_header(const meta_info& a_meta) const
-		-> std::pair<detail::header_t, std::uint64_t>
-	{
-		const auto inspect = [&](auto a_gnrl, auto a_dx10) noexcept {
-			switch (a_meta.format_) {
+		const auto archiveFormat = header.archive_format();
+		const auto [headerSize, chunkSize] = [&]() {
+			switch (archiveFormat) {
 			case format::general:
-				return a_gnrl();
+				return std::make_pair(
+					detail::constants::chunk_header_size_gnrl,
+					detail::constants::chunk_size_gnrl);
 			case format::directx:
-				return a_dx10();
+				return std::make_pair(
+					detail::constants::chunk_header_size_dx10,
+					detail::constants::chunk_size_dx10);
 			default:
 				detail::declare_unreachable();
 			}
+		}();
+
+		// walk the records and the string table once, reading only what lays them out
+		struct entry_t final
+		{
+			std::size_t record{ 0 };
+			std::size_t name{ 0 };
 		};
 
-		std::uint64_t dataOffset =
-			detail::sizeof_header(a_meta.version_) +
-			inspect(
-				[]() noexcept { return detail::constants::chunk_header_size_gnrl; },
-				[]() noexcept { return detail::constants::chunk_header_size_dx10; }) *
-				this->size();
-		std::uint64_t dataSize = 0;
-		for ([[maybe_unused]] const auto& [key, file] : *this) {
-			dataOffset +=
-				inspect(
-					[]() noexcept { return detail::constants::chunk_size_gnrl; },
-					[]() noexcept { return detail::constants::chunk_size_dx10; }) *
-				file.size();
-			for (const auto& chunk : file) {
-				dataSize += chunk.size();
+		const auto count = header.file_count();
+		const bool strings = header.string_table_offset() != 0;
+		std::vector<entry_t> entries(count);
+		for (std::size_t i = 0,
+						 pos = static_cast<std::size_t>(in->tell()),
+						 strpos = header.string_table_offset();
+			 i < count;
+			 ++i) {
+			entries[i].record = pos;
+			detail::fetch_record(in, pos, fetched);
+			in->seek_absolute(pos + detail::constants::file_hash_size + 1u);  // skip mod index
+			const auto [chunks, hdrsz] = in->read<std::uint8_t, std::uint16_t>();
+			if (hdrsz != headerSize) {
+				throw exception("invalid chunk header size");
 			}
-		}
+			pos += hdrsz + chunks * chunkSize;
 
-		return {
-			detail::header_t{
-				a_meta,
-				this->size(),
-				a_meta.strings ? dataOffset + dataSize : 0u },
-			dataOffset
-		};
-	}
+			if (strings) {
+				entries[i].name = strpos;
+				in->seek_absolute(strpos);
+				const auto [length] = in->read<std::uint16_t>();
+				strpos += 2u + length;
+			}
+		}
 
-	void archive::read_chunk(
-		chunk& a_chunk,
-		detail::istream_t& a_in,
-		format a_format)
-	{
-		const auto [dataFileOffset, compressedSize, decompressedSize] =
-			a_in->read<std::uint64_t, std::uint32_t, std::uint32_t>();
+		// group entries into batches, so workers aren't contending over every single one
+		const auto threads = detail::resolve_thread_count(a_threads, count);
+		const auto batch = (std::max<std::size_t>)(count / (threads * 8u), 1);
+		std::vector<std::optional<std::pair<key_type, mapped_type>>> decoded(count);
+		detail::parallel_for(
+			(count + batch - 1) / batch,
+			threads,
+			[&](std::size_t a_batch) {
+				auto local = in.reopen();
+
+				const auto last = (std::min)(count, (a_batch + 1) * batch);
+				for (std::size_t i = a_batch * batch; i < last; ++i) {
+					local->seek_absolute(entries[i].record);
+					hashing::hash hash;
+					local >> hash;
+
+					const auto name = [&]() {
+						if (strings) {
+							const detail::restore_point _{ local };
+							local->seek_absolute(entries[i].name);
+							return detail::read_wstring(local);
+						} else {
+							return ""sv;
+						}
+					}();
+
+					auto& value = decoded[i].emplace(
+						key_type{ hash, name, local },
+						mapped_type{});
+					read_file(value.second, local, archiveFormat);
+				}
+			});
 
-		std::size_t size = 0;
-		std::optional<std::size_t> decompsz;
-		if (compressedSize != 0) {
-			decompsz = decompressedSize;
-			size = compressedSize;
-		} else {
-			size = decompressedSize;
+		this->bulk_reserve(count);
+		for (auto& value : decoded) {
+			this->bulk_insert(std::move(value->first), std::move(value->second));
 		}
+		this->bulk_finalize();
 
-		if (a_format == format::directx) {
-			a_in >> a_chunk.mips;
-		}
+		return header.make_meta();
+	}
 
-		const auto [sentinel] = a_in->read<std::uint32_t>();
-		if (sentinel != detail::constants::chunk_sentinel) {
-			throw exception("invalid chunk sentinel");
+	void archive::compress_all(
+		const chunk::compression_params& a_params,
+		std::size_t a_threads)
+	{
+		std::vector<std::pair<const key_type*, chunk*>> jobs;
+		for (auto& [key, file] : *this) {
+			for (auto& chunk : file) {
+				if (!chunk.compressed()) {
+					jobs.emplace_back(&key, &chunk);
+				}
+			}
 		}
 
-		const detail::restore_point _{ a_in };
-		a_in->seek_absolute(dataFileOffset);
-		a_chunk.set_data(
-			a_in->read_bytes(size),
-			a_in,
-			decompsz);
+		detail::parallel_for(
+			jobs.size(),
+			a_threads,
+			[&](std::size_t a_idx) {
+				const auto& [key, chunk] = jobs[a_idx];
+				try {
+					chunk->compress(a_params);
+				} catch (const bsa::compression_error& a_err) {
+					throw bsa::compression_error(a_err, detail::make_path(*key));
+				}
+			});
 	}
 
-	void archive::read_file(
-		file& a_file,
-		detail::istream_t& a_in,
-		format a_format)
+	auto archive::transcode(
+		compression_format a_from,
+		const chunk::compression_params& a_to,
+		std::size_t a_threads)
+		-> transcode_report
 	{
-		a_in->seek_relative(1u);  // skip mod index
-		const auto [count, hdrsz] = a_in->read<std::uint8_t, std::uint16_t>();
-
-		switch (a_format) {
-		case format::general:
-			if (hdrsz != detail::constants::chunk_header_size_gnrl) {
-				throw exception("invalid chunk header size");
-			}
-			break;
-		case format::directx:
-			if (hdrsz != detail::constants::chunk_header_size_dx10) {
-				throw exception("invalid chunk header size");
+		transcode_report report;
+		std::vector<std::pair<const key_type*, chunk*>> jobs;
+		const bool passthrough = a_from == a_to.compression_format_;
+		for (auto& [key, file] : *this) {
+			for (auto& chunk : file) {
+				if (passthrough || !chunk.compressed()) {
+					++report.passed_through;
+					report.passed_through_bytes += chunk.size();
+				} else {
+					jobs.emplace_back(&key, &chunk);
+				}
 			}
-			a_in >> a_file.header;
-			break;
-		default:
-			detail::declare_unreachable();
 		}
 
-		a_file.reserve(count);
-		for (std::size_t i = 0; i < count; ++i) {
-			this->read_chunk(
-				a_file.emplace_back(),
-				a_in,
-				a_format);
+		detail::parallel_for(
+			jobs.size(),
+			a_threads,
+			[&](std::size_t a_idx) {
+				const auto& [key, chunk] = jobs[a_idx];
+				try {
+					// work on a copy, so a failure leaves the original as it was
+					auto transcoded = *chunk;
+					transcoded.decompress(a_from);
+					transcoded.compress(a_to);
+					*chunk = std::move(transcoded);
+				} catch (const bsa::compression_error& a_err) {
+					throw bsa::compression_error(a_err, detail::make_path(*key));
+				}
+			});
+
+		report.transcoded = jobs.size();
+		for (const auto& [key, chunk] : jobs) {
+			report.transcoded_bytes += chunk->size();
 		}
+
+		return report;
 	}
 
-	void archive::write_chunk(
-		const chunk& a_chunk,
-		detail::ostream_t& a_out,
-		format a_format,
-		std::uint64_t& a_dataOffset) const noexcept
+	std::size_t archive::read_files(
+		std::span<const std::pair<key_type, std::filesystem::path>> a_files,
+		const file::read_params& a_params,
+		std::size_t a_threads)
 	{
-		const auto size = a_chunk.size();
-		a_out.write(
-			a_dataOffset,
-			static_cast<std::uint32_t>(a_chunk.compressed() ? size : 0u),
-			static_cast<std::uint32_t>(
-				a_chunk.compressed() ? a_chunk.decompressed_size() : size));
-		a_dataOffset += size;
+		// each file is built on the thread which reads it, so it allocates from that thread's
+		//	memory resource, and is only moved into the archive's once it is inserted
+		std::vector<std::optional<file>> files(a_files.size());
+		detail::parallel_for(
+			a_files.size(),
+			a_threads,
+			[&](std::size_t a_idx) {
+				const auto& [key, path] = a_files[a_idx];
+				try {
+					auto& f = files[a_idx].emplace();
+					f.read(path, a_params);
+				} catch (const bsa::compression_error& a_err) {
+					throw bsa::compression_error(a_err, detail::make_path(key));
+				}
+			});
 
-		if (a_format == format::directx) {
-			a_out << a_chunk.mips;
+		std::size_t inserted = 0;
+		for (std::size_t i = 0; i < a_files.size(); ++i) {
+			if (this->insert(a_files[i].first, std::move(*files[i])).second) {
+				++inserted;
+			}
 		}
 
-		a_out.write<std::uint32_t>(detail::constants::chunk_sentinel);
+		return inserted;
 	}
 
-	void archive::write_file(
+	auto archive::verify(
+		compression_format a_format,
+		std::size_t a_threads) const
+		-> verify_report
+	{
+		verify_report report;
+		report.offsets = this->size() <= (std::numeric_limits<std::uint32_t>::max)();
+
+		std::vector<std::pair<const value_type*, std::size_t>> jobs;
+		for (const auto& elem : *this) {
+			const auto& [key, file] = elem;
+			if (const auto name = key.name();
+				!name.empty() && hashing::hash_file(name) != key.hash()) {
+				report.failures.push_back({ std::string(name), "file hash does not match its name"s });
+			}
+
+			if (file.size() > (std::numeric_limits<std::uint8_t>::max)()) {
+				report.offsets = false;
+			}
+
+			for (std::size_t i = 0; i < file.size(); ++i) {
+				const auto& chunk = file[i];
+				if (chunk.size() > (std::numeric_limits<std::uint32_t>::max)() ||
+					(chunk.compressed() &&
+						chunk.decompressed_size() > (std::numeric_limits<std::uint32_t>::max)())) {
+					report.offsets = false;
+				}
+				jobs.emplace_back(&elem, i);
+			}
+		}
+
+		detail::verify_entries(
+			report,
+			jobs.size(),
+			a_threads,
+			[&](std::size_t a_idx, detail::scratch_pool::lease& a_scratch) {
+				const auto& [elem, idx] = jobs[a_idx];
+				const auto& chunk = elem->second[idx];
+				if (!chunk.compressed()) {
+					return chunk.size();
+				}
+
+				const auto size = chunk.decompressed_size();
+				try {
+					chunk.decompress_into(a_scratch.get(size), a_format);
+				} catch (const bsa::compression_error& a_err) {
+					throw bsa::compression_error(a_err, "chunk "s + std::to_string(idx));
+				}
+				return size;
+			},
+			[&](std::size_t a_idx) {
+				return detail::make_path(jobs[a_idx].first->first);
+			});
+
+		return report;
+	}
+
+	void archive::extract_all(
+		const std::filesystem::path& a_root,
+		const file::write_params& a_params,
+		std::size_t a_threads) const
+	{
+		std::vector<const value_type*> jobs;
+		jobs.reserve(this->size());
+		std::vector<std::filesystem::path> paths;
+		paths.reserve(this->size());
+		for (const auto& elem : *this) {
+			jobs.push_back(&elem);
+			paths.push_back(detail::make_extract_path(a_root, detail::make_path(elem.first)));
+		}
+		detail::create_parent_directories(paths);
+
+		detail::for_each_streamed(
+			jobs.size(),
+			a_threads,
+			[&](std::size_t a_idx) {
+				return detail::unread(jobs[a_idx]->second);
+			},
+			[&](std::size_t a_idx, std::span<const std::byte> a_bytes) {
+				const auto& [key, original] = *jobs[a_idx];
+				auto file = original;
+				std::size_t offset = 0;
+				for (auto& chunk : file) {
+					const auto size = chunk.size();
+					chunk.set_data(
+						a_bytes.subspan(offset, size),
+						chunk.compressed() ?
+							std::make_optional(chunk.decompressed_size()) :
+							std::nullopt);
+					offset += size;
+				}
+				detail::extract_entry(paths[a_idx], key, file, a_params);
+			},
+			[&](std::size_t a_idx) {
+				detail::extract_entry(paths[a_idx], jobs[a_idx]->first, jobs[a_idx]->second, a_params);
+			});
+	}
+
+	auto archive::decompress_cached(
+		content_cache& a_cache,
+		const key_type& a_file,
+		const file::write_params& a_params) const
+		-> content_cache::contents_type
+	{
+		const auto it = this->find(a_file);
+		if (it == this->end()) {
+			return nullptr;
+		}
+
+		const auto& hash = a_file.hash();
+		const content_cache::key_type key{
+			.archive = this,
+			.generation = _generation,
+			.hi = hash.directory,
+			.lo = static_cast<std::uint64_t>(hash.file) << 32u | hash.extension,
+		};
+		return a_cache.get_or_load(key, [&]() {
+			std::vector<std::byte> contents(it->second.written_size(a_params));
+			it->second.write_into(contents, a_params);
+			return contents;
+		});
+	}
+
+	void archive::write(
+		write_sink a_sink,
+		const meta_info& a_meta) const
+	{
+		this->write(std::move(a_sink), a_meta, {});
+	}
+
+	void archive::write(
+		write_sink a_sink,
+		const meta_info& a_meta,
+		const write_params& a_params) const
+	{
+		const detail::observe_phase phase{ observer::phase::write };
+		auto& out = a_sink.stream();
+		const auto start = out.tell();
+
+		const auto shared =
+			a_params.deduplicate ?
+				this->share_chunk_data() :
+				std::vector<std::size_t>();
+		const auto [header, dataOffset] = make_header(a_meta, shared);
+		const auto layout = this->make_layout(shared, dataOffset, a_params.data_order);
+		out << header;
+		this->write_records(out, a_meta.format_, layout.offsets);
+
+		for (const auto idx : layout.order) {
+			out.write_bytes(layout.chunks[idx]->as_bytes());
+		}
+
+		if (a_meta.strings) {
+			this->write_strings(out);
+		}
+
+		detail::observe_io(observer::io::written, static_cast<std::size_t>(out.tell() - start));
+	}
+
+	void archive::write_mapped(
+		const std::filesystem::path& a_path,
+		const meta_info& a_meta,
+		const write_params& a_params,
+		std::size_t a_threads) const
+	{
+		const detail::observe_phase phase{ observer::phase::write };
+
+		const auto shared =
+			a_params.deduplicate ?
+				this->share_chunk_data() :
+				std::vector<std::size_t>();
+		const auto [header, dataOffset] = make_header(a_meta, shared);
+
+		const auto layout = this->make_layout(shared, dataOffset, a_params.data_order);
+		std::size_t size = static_cast<std::size_t>(dataOffset);
+		for (const auto idx : layout.order) {
+			size += layout.chunks[idx]->size();
+		}
+
+		const auto records = static_cast<std::size_t>(dataOffset);
+		const auto data = size;
+		if (a_meta.strings) {
+			for ([[maybe_unused]] const auto& [key, file] : *this) {
+				size += 2u + key.name().size();  // prefixed length
+			}
+		}
+
+		detail::extract_file(a_path, size, [&](std::span<std::byte> a_out) {
+			detail::ostream_t out{ std::in_place_type<binary_io::span_ostream>, a_out.first(records) };
+			out << header;
+			this->write_records(out, a_meta.format_, layout.offsets);
+			assert(static_cast<std::size_t>(out.tell()) == records);
+
+			// the data of every chunk goes exactly where its record points to
+			detail::parallel_for(
+				layout.order.size(),
+				a_threads,
+				[&](std::size_t a_idx) {
+					const auto idx = layout.order[a_idx];
+					const auto bytes = layout.chunks[idx]->as_bytes();
+					std::memcpy(
+						a_out.data() + static_cast<std::size_t>(layout.offsets[idx]),
+						bytes.data(),
+						bytes.size());
+				});
+
+			if (a_meta.strings) {
+				detail::ostream_t strings{ std::in_place_type<binary_io::span_ostream>, a_out.subspan(data) };
+				this->write_strings(strings);
+			}
+		});
+
+		detail::observe_io(observer::io::written, size);
+	}
+
+	auto archive::make_layout(
+		std::span<const std::size_t> a_shared,
+		std::uint64_t a_dataOffset,
+		std::span<const key_type> a_order) const
+		-> layout_t
+	{
+		layout_t layout;
+		std::vector<std::pair<hashing::hash, std::size_t>> files;  // the first chunk of each file
+		files.reserve(this->size());
+		for (const auto& [key, file] : *this) {
+			files.emplace_back(key.hash(), layout.chunks.size());
+			for (const auto& chunk : file) {
+				layout.chunks.push_back(&chunk);
+			}
+		}
+
+		const auto count = layout.chunks.size();
+		const auto representative = [&](std::size_t a_idx) noexcept {
+			return a_shared.empty() ? a_idx : a_shared[a_idx];
+		};
+
+		std::vector<bool> placed(count, false);
+		const auto place = [&](std::size_t a_idx) {
+			const auto idx = representative(a_idx);
+			if (!placed[idx]) {
+				placed[idx] = true;
+				layout.order.push_back(idx);
+			}
+		};
+
+		// records are iterated in hash order, so the files can be searched directly
+		for (const auto& key : a_order) {
+			const auto it = std::lower_bound(
+				files.begin(),
+				files.end(),
+				key.hash(),
+				[](const auto& a_lhs, const hashing::hash& a_rhs) noexcept {
+					return a_lhs.first < a_rhs;
+				});
+			if (it != files.end() && it->first == key.hash()) {
+				const auto last = std::next(it) != files.end() ? std::next(it)->second : count;
+				for (auto i = it->second; i < last; ++i) {
+					place(i);
+				}
+			}
+		}
+
+		for (std::size_t i = 0; i < count; ++i) {
+			place(i);
+		}
+
+		layout.offsets.resize(count);
+		for (const auto idx : layout.order) {
+			layout.offsets[idx] = a_dataOffset;
+			a_dataOffset += layout.chunks[idx]->size();
+		}
+
+		for (std::size_t i = 0; i < count; ++i) {
+			layout.offsets[i] = layout.offsets[representative(i)];
+		}
+
+		return layout;
+	}
+
+	void archive::write_records(
+		detail::ostream_t& a_out,
+		format a_format,
+		std::span<const std::uint64_t> a_offsets) const noexcept
+	{
+		std::size_t idx = 0;
+		for (const auto& [key, file] : *this) {
+			a_out << key.hash();
+			write_file_header(file, a_out, a_format);
+			for (const auto& chunk : file) {
+				auto offset = a_offsets[idx++];
+				write_chunk(chunk, a_out, a_format, offset);
+			}
+		}
+	}
+
+	void archive::write_strings(detail::ostream_t& a_out) const noexcept
+	{
+		for ([[maybe_unused]] const auto& [key, file] : *this) {
+			detail::write_wstring(a_out, key.name());
+		}
+	}
+
+	auto archive::make_header(
+		const meta_info& a_meta,
+		std::span<const std::size_t> a_shared) const
+		-> std::pair<detail::header_t, std::uint64_t>
+	{
+		const auto inspect = [&](auto a_gnrl, auto a_dx10) noexcept {
+			switch (a_meta.format_) {
+			case format::general:
+				return a_gnrl();
+			case format::directx:
+				return a_dx10();
+			default:
+				detail::declare_unreachable();
+			}
+		};
+
+		std::uint64_t dataOffset =
+			detail::sizeof_header(a_meta.version_) +
+			inspect(
+				[]() noexcept { return detail::constants::chunk_header_size_gnrl; },
+				[]() noexcept { return detail::constants::chunk_header_size_dx10; }) *
+				this->size();
+		std::uint64_t dataSize = 0;
+		std::size_t idx = 0;
+		for ([[maybe_unused]] const auto& [key, file] : *this) {
+			dataOffset +=
+				inspect(
+					[]() noexcept { return detail::constants::chunk_size_gnrl; },
+					[]() noexcept { return detail::constants::chunk_size_dx10; }) *
+				file.size();
+			for (const auto& chunk : file) {
+				if (a_shared.empty() || a_shared[idx] == idx) {
+					dataSize += chunk.size();
+				}
+				++idx;
+			}
+		}
+
+		return {
+			detail::header_t{
+				a_meta,
+				this->size(),
+				a_meta.strings ? dataOffset + dataSize : 0u },
+			dataOffset
+		};
+	}
+
+	auto archive::share_chunk_data() const
+		-> std::vector<std::size_t>
+	{
+		std::vector<const chunk*> chunks;
+		for ([[maybe_unused]] const auto& [key, file] : *this) {
+			for (const auto& chunk : file) {
+				chunks.push_back(&chunk);
+			}
+		}
+
+		return detail::share_duplicates(
+			chunks.size(),
+			[&](std::size_t a_idx) noexcept {
+				return detail::content_hash(chunks[a_idx]->as_bytes());
+			},
+			[&](std::size_t a_lhs, std::size_t a_rhs) noexcept {
+				return detail::same_contents(*chunks[a_lhs], *chunks[a_rhs]);
+			});
+	}
+
+	void archive::read_chunk(
+		chunk& a_chunk,
+		detail::istream_t& a_in,
+		format a_format)
+	{
+		const auto [dataFileOffset, compressedSize, decompressedSize] =
+			a_in->read<std::uint64_t, std::uint32_t, std::uint32_t>();
+
+		std::size_t size = 0;
+		std::optional<std::size_t> decompsz;
+		if (compressedSize != 0) {
+			decompsz = decompressedSize;
+			size = compressedSize;
+		} else {
+			size = decompressedSize;
+		}
+
+		if (a_format == format::directx) {
+			a_in >> a_chunk.mips;
+		}
+
+		const auto [sentinel] = a_in->read<std::uint32_t>();
+		if (sentinel != detail::constants::chunk_sentinel) {
+			throw exception("invalid chunk sentinel");
+		}
+
+		const detail::restore_point _{ a_in };
+		a_in->seek_absolute(dataFileOffset);
+		a_chunk.set_data(
+			a_in->read_bytes(size),
+			a_in,
+			decompsz);
+	}
+
+	void archive::read_file(
+		file& a_file,
+		detail::istream_t& a_in,
+		format a_format)
+	{
+		a_in->seek_relative(1u);  // skip mod index
+		const auto [count, hdrsz] = a_in->read<std::uint8_t, std::uint16_t>();
+
+		switch (a_format) {
+		case format::general:
+			if (hdrsz != detail::constants::chunk_header_size_gnrl) {
+				throw exception("invalid chunk header size");
+			}
+			break;
+		case format::directx:
+			if (hdrsz != detail::constants::chunk_header_size_dx10) {
+				throw exception("invalid chunk header size");
+			}
+			a_in >> a_file.header;
+			break;
+		default:
+			detail::declare_unreachable();
+		}
+
+		a_file.reserve(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			read_chunk(
+				a_file.emplace_back(),
+				a_in,
+				a_format);
+		}
+	}
+
+	void archive::write_chunk(
+		const chunk& a_chunk,
+		detail::ostream_t& a_out,
+		format a_format,
+		std::uint64_t& a_dataOffset) noexcept
+	{
+		const auto size = a_chunk.size();
+		a_out.write(
+			a_dataOffset,
+			static_cast<std::uint32_t>(a_chunk.compressed() ? size : 0u),
+			static_cast<std::uint32_t>(
+				a_chunk.compressed() ? a_chunk.decompressed_size() : size));
+		a_dataOffset += size;
+
+		if (a_format == format::directx) {
+			a_out << a_chunk.mips;
+		}
+
+		a_out.write<std::uint32_t>(detail::constants::chunk_sentinel);
+	}
+
+	void archive::write_file(
 		const file& a_file,
 		detail::ostream_t& a_out,
 		format a_format,
-		std::uint64_t& a_dataOffset) const noexcept
+		std::uint64_t& a_dataOffset) noexcept
+	{
+		write_file_header(a_file, a_out, a_format);
+		for (const auto& chunk : a_file) {
+			write_chunk(chunk, a_out, a_format, a_dataOffset);
+		}
+	}
+
+	void archive::write_file_header(
+		const file& a_file,
+		detail::ostream_t& a_out,
+		format a_format) noexcept
 	{
 		a_out.write(
 			std::byte{ 0 },  // skip mod index
@@ -1018,9 +2352,769 @@ namespace bsa::fo4
 		default:
 			detail::declare_unreachable();
 		}
+	}
 
-		for (const auto& chunk : a_file) {
-			this->write_chunk(chunk, a_out, a_format, a_dataOffset);
+	auto lazy_archive::lookup(const key_type& a_key)
+		-> const_index
+	{
+		if (const auto cached = std::as_const(_cache)[a_key]; cached) {
+			return cached;
 		}
+
+		const auto it = std::lower_bound(
+			_records.begin(),
+			_records.end(),
+			a_key.hash(),
+			[](const record_t& a_lhs, const hashing::hash& a_rhs) noexcept {
+				return a_lhs.hash < a_rhs;
+			});
+		if (it == _records.end() || it->hash != a_key.hash()) {
+			return {};
+		}
+
+		auto in = _source.open();
+		in->seek_absolute(it->offset);
+
+		file f;
+		archive::read_file(f, in, _format);
+		_cache.insert(a_key, std::move(f));
+
+		return std::as_const(_cache)[a_key];
+	}
+
+	void lazy_archive::clear() noexcept
+	{
+		_cache.clear();
+		_records.clear();
+		_source = {};
+		_format = format::general;
+	}
+
+	auto lazy_archive::read(read_source a_source)
+		-> meta_info
+	{
+		auto& in = a_source.stream();
+		const auto header = [&]() {
+			detail::header_t result;
+			in >> result;
+			return result;
+		}();
+
+		this->clear();
+		_format = header.archive_format();
+
+		const auto [hdrsz, chunksz] = [&]() noexcept {
+			switch (_format) {
+			case format::general:
+				return std::make_pair(
+					detail::constants::chunk_header_size_gnrl,
+					detail::constants::chunk_size_gnrl);
+			case format::directx:
+				return std::make_pair(
+					detail::constants::chunk_header_size_dx10,
+					detail::constants::chunk_size_dx10);
+			default:
+				detail::declare_unreachable();
+			}
+		}();
+
+		_records.reserve(header.file_count());
+		for (std::size_t i = 0; i < header.file_count(); ++i) {
+			auto& record = _records.emplace_back();
+			in >> record.hash;
+			record.offset = in->tell();
+
+			in->seek_relative(1u);  // skip mod index
+			const auto [count, size] = in->read<std::uint8_t, std::uint16_t>();
+			if (size != hdrsz) {
+				throw exception("invalid chunk header size");
+			}
+			in->seek_relative(
+				(hdrsz - detail::constants::chunk_header_size_gnrl) +
+				count * chunksz);
+		}
+
+		std::stable_sort(
+			_records.begin(),
+			_records.end(),
+			[](const record_t& a_lhs, const record_t& a_rhs) noexcept {
+				return a_lhs.hash < a_rhs.hash;
+			});
+		_source = detail::shared_source{ in };
+
+		return header.make_meta();
+	}
+
+	auto lazy_archive::read(
+		const std::filesystem::path& a_path,
+		const std::filesystem::path& a_cache)
+		-> meta_info
+	{
+		detail::cache_info_t info;
+		if (auto records = detail::index_cache::load<detail::cache_info_t, record_t>(a_cache, a_path, info);
+			records) {
+			this->clear();
+			read_source source{ a_path };
+			_records = std::move(*records);
+			_source = detail::shared_source{ source.stream() };
+			_format = static_cast<format>(info.format);
+			return {
+				.format_ = _format,
+				.version_ = static_cast<version>(info.version),
+				.compression_format_ = static_cast<compression_format>(info.compression_format),
+				.strings = info.strings != 0,
+			};
+		}
+
+		const auto result = this->read(read_source{ a_path });
+		detail::index_cache::store<detail::cache_info_t, record_t>(
+			a_cache,
+			a_path,
+			{ .format = detail::to_underlying(result.format_),
+				.version = detail::to_underlying(result.version_),
+				.compression_format = static_cast<std::uint32_t>(result.compression_format_),
+				.strings = result.strings ? 1u : 0u },
+			_records);
+		return result;
+	}
+
+	bool stream_writer::insert(
+		key_type a_key,
+		source_type a_source,
+		std::size_t a_chunks)
+	{
+		return _files
+		    .try_emplace(
+				std::move(a_key),
+				entry_t{ std::move(a_source), a_chunks })
+		    .second;
+	}
+
+	bool stream_writer::insert(
+		key_type a_key,
+		std::filesystem::path a_path,
+		const file::read_params& a_params)
+	{
+		// general files are always read as a single chunk, and textures are laid out from their
+		//	headers, so their pixels are only read once, when they are written
+		std::size_t chunks = 1;
+		if (a_params.format_ == format::directx) {
+			mmio::mapped_file_source dds;
+			dds.open(a_path);
+			chunks = dds.is_open() ?
+			             detail::predict_directx_chunks(
+							 { dds.data(), dds.size() },
+							 a_params.mip_chunk_width,
+							 a_params.mip_chunk_height) :
+			             0;
+		}
+
+		return this->insert(
+			std::move(a_key),
+			[path = std::move(a_path), a_params]() {
+				file f;
+				f.read(path, a_params);
+				return f;
+			},
+			chunks);
+	}
+
+	void stream_writer::write(
+		write_sink a_sink,
+		const meta_info& a_meta) const
+	{
+		auto& out = a_sink.stream();
+
+		// the file records are written with placeholder chunks, and then patched as
+		//	each file's data is written
+		std::vector<std::size_t> chunks;
+		chunks.reserve(_files.size());
+		for (const auto& [key, entry] : _files) {
+			chunks.push_back(entry.chunks != 0 ? entry.chunks : entry.source().size());
+		}
+
+		out << detail::header_t{ a_meta, _files.size(), 0u };
+
+		std::vector<std::size_t> records;
+		records.reserve(_files.size());
+		{
+			std::uint64_t dataOffset = 0;
+			file placeholder;
+			for (std::size_t i = 0; const auto& [key, entry] : _files) {
+				out << key.hash();
+				records.push_back(static_cast<std::size_t>(out.tell()));
+				placeholder.clear();
+				for (std::size_t j = 0; j < chunks[i]; ++j) {
+					placeholder.emplace_back();
+				}
+				archive::write_file(placeholder, out, a_meta.format_, dataOffset);
+				++i;
+			}
+		}
+
+		for (std::size_t i = 0; const auto& [key, entry] : _files) {
+			const auto data = entry.source();
+			if (data.size() != chunks[i]) {
+				throw bsa::exception("file source produced an unexpected number of chunks");
+			}
+
+			const auto start = static_cast<std::uint64_t>(out.tell());
+			for (const auto& chunk : data) {
+				out.write_bytes(chunk.as_bytes());
+			}
+			const auto end = out.tell();
+
+			auto dataOffset = start;
+			out.seek_absolute(records[i]);
+			archive::write_file(data, out, a_meta.format_, dataOffset);
+			out.seek_absolute(end);
+			++i;
+		}
+
+		if (a_meta.strings) {
+			const auto strings = out.tell();
+			for ([[maybe_unused]] const auto& [key, entry] : _files) {
+				detail::write_wstring(out, key.name());
+			}
+			const auto end = out.tell();
+
+			out.seek_absolute(0);
+			out << detail::header_t{
+				a_meta,
+				_files.size(),
+				static_cast<std::uint64_t>(strings)
+			};
+			out.seek_absolute(end);
+		}
+	}
+}
+
+namespace bsa::async
+{
+	auto extract(
+		executor& a_executor,
+		const fo4::archive& a_archive,
+		const std::filesystem::path& a_root,
+		const fo4::file::write_params& a_params)
+		-> extraction
+	{
+		std::vector<extraction::job_t> jobs;
+		jobs.reserve(a_archive.size());
+		for (const auto& elem : a_archive) {
+			jobs.push_back({
+				fo4::detail::make_extract_path(a_root, fo4::detail::make_path(elem.first)),
+				[&elem, a_params](const std::filesystem::path& a_path) {
+					fo4::detail::extract_entry(a_path, elem.first, elem.second, a_params);
+				},
+			});
+		}
+
+		return { a_executor, std::move(jobs) };
+	}
+}
+
+namespace bsa::fo4
+{
+	void updater::clear() noexcept
+	{
+		_path.clear();
+		_meta = meta_info{};
+		_entries.clear();
+		_index.clear();
+		_dead = 0;
+	}
+
+	bool updater::insert_or_assign(key_type a_key, file a_file)
+	{
+		if (a_file.size() > (std::numeric_limits<std::uint8_t>::max)()) {
+			throw bsa::exception("file has too many chunks");
+		}
+
+		const auto [it, inserted] = _index.try_emplace(a_key.hash(), _entries.size());
+		if (inserted) {
+			auto& entry = _entries.emplace_back();
+			entry.hash = a_key.hash();
+			entry.name = a_key.name();
+		} else if (const auto name = a_key.name(); !name.empty()) {
+			_entries[it->second].name = name;
+		}
+
+		_entries[it->second].pending = std::move(a_file);
+		return inserted;
+	}
+
+	bool updater::erase(const key_type& a_key) noexcept
+	{
+		const auto it = _index.find(a_key.hash());
+		if (it == _index.end()) {
+			return false;
+		}
+
+		_entries[it->second].erased = true;
+		_index.erase(it);
+		return true;
+	}
+
+	auto updater::open(std::filesystem::path a_path)
+		-> meta_info
+	{
+		this->clear();
+
+		detail::istream_t in{ a_path };
+		const auto header = [&]() {
+			detail::header_t result;
+			in >> result;
+			return result;
+		}();
+		_meta = header.make_meta();
+
+		const auto archiveFormat = header.archive_format();
+		_entries.resize(header.file_count());
+		for (auto& entry : _entries) {
+			in >> entry.hash;
+			in->seek_relative(1u);  // skip mod index
+			const auto [count, hdrsz] = in->read<std::uint8_t, std::uint16_t>();
+			if (hdrsz != (archiveFormat == format::general ?
+								 detail::constants::chunk_header_size_gnrl :
+								 detail::constants::chunk_header_size_dx10)) {
+				throw exception("invalid chunk header size");
+			} else if (archiveFormat == format::directx) {
+				in >> entry.header;
+			}
+
+			entry.chunks.resize(count);
+			for (auto& chunk : entry.chunks) {
+				in->read(chunk.offset, chunk.compressed_size, chunk.decompressed_size);
+				if (archiveFormat == format::directx) {
+					in >> chunk.mips;
+				}
+
+				const auto [sentinel] = in->read<std::uint32_t>();
+				if (sentinel != detail::constants::chunk_sentinel) {
+					throw exception("invalid chunk sentinel");
+				}
+			}
+		}
+
+		if (const auto strings = header.string_table_offset(); strings != 0) {
+			in->seek_absolute(strings);
+			for (auto& entry : _entries) {
+				entry.name = detail::read_wstring(in);
+			}
+		}
+
+		for (std::size_t i = 0; i < _entries.size(); ++i) {
+			_index.emplace(_entries[i].hash, i);
+		}
+
+		_path = std::move(a_path);
+		_dead = std::filesystem::file_size(_path) - this->live_size();
+		return _meta;
+	}
+
+	void updater::commit()
+	{
+		if (_path.empty()) {
+			throw bsa::exception("no archive is open");
+		}
+
+		std::fstream io{ _path, std::ios::in | std::ios::out | std::ios::binary };
+		if (!io) {
+			throw bsa::exception("failed to open archive for updating");
+		}
+
+		std::erase_if(_entries, [](const entry_t& a_entry) noexcept { return a_entry.erased; });
+		_index.clear();
+		for (std::size_t i = 0; i < _entries.size(); ++i) {
+			_index.emplace(_entries[i].hash, i);
+		}
+
+		// new data goes after the file records and every chunk which is still referenced, which
+		//	also reclaims the old string table and any dead data at the end of the archive
+		const auto recordsEnd = this->records_size();
+		auto end = recordsEnd;
+		for (const auto& entry : _entries) {
+			if (!entry.pending) {
+				for (const auto& chunk : entry.chunks) {
+					const auto size = chunk.compressed_size != 0 ? chunk.compressed_size : chunk.decompressed_size;
+					end = (std::max)(end, chunk.offset + size);
+				}
+			}
+		}
+
+		const auto write = [&](std::span<const std::byte> a_bytes) {
+			io.seekp(static_cast<std::streamoff>(end));
+			io.write(reinterpret_cast<const char*>(a_bytes.data()), static_cast<std::streamsize>(a_bytes.size()));
+			end += a_bytes.size();
+		};
+
+		// only the chunks which the file records grow into are moved, and chunks which share
+		//	their data keep sharing it
+		std::map<std::uint64_t, std::uint64_t> moved;
+		std::vector<std::byte> buffer;
+		for (auto& entry : _entries) {
+			if (entry.pending) {
+				continue;
+			}
+
+			for (auto& chunk : entry.chunks) {
+				if (chunk.offset >= recordsEnd) {
+					continue;
+				} else if (const auto it = moved.find(chunk.offset); it != moved.end()) {
+					chunk.offset = it->second;
+					continue;
+				}
+
+				buffer.resize(chunk.compressed_size != 0 ? chunk.compressed_size : chunk.decompressed_size);
+				io.seekg(static_cast<std::streamoff>(chunk.offset));
+				io.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+				moved.emplace(chunk.offset, end);
+				chunk.offset = end;
+				write(buffer);
+			}
+		}
+
+		for (auto& entry : _entries) {
+			if (!entry.pending) {
+				continue;
+			}
+
+			entry.header = entry.pending->header;
+			entry.chunks.clear();
+			for (const auto& chunk : *entry.pending) {
+				const auto size = static_cast<std::uint32_t>(chunk.size());
+				entry.chunks.push_back({
+					.offset = end,
+					.compressed_size = chunk.compressed() ? size : 0u,
+					.decompressed_size = static_cast<std::uint32_t>(chunk.compressed() ? chunk.decompressed_size() : size),
+					.mips = chunk.mips,
+				});
+				write(chunk.as_bytes());
+			}
+			entry.pending.reset();
+		}
+
+		const auto strings = _meta.strings ? end : 0u;
+		if (_meta.strings) {
+			detail::ostream_t out{ std::in_place_type<binary_io::memory_ostream> };
+			for (const auto& entry : _entries) {
+				detail::write_wstring(out, entry.name);
+			}
+			write(out.get<binary_io::memory_ostream>().rdbuf());
+		}
+
+		detail::ostream_t out{ std::in_place_type<binary_io::memory_ostream> };
+		out << detail::header_t{ _meta, _entries.size(), strings };
+		for (const auto& entry : _entries) {
+			out << entry.hash;
+			out.write(
+				std::byte{ 0 },  // skip mod index
+				static_cast<std::uint8_t>(entry.chunks.size()));
+			if (_meta.format_ == format::general) {
+				out.write<std::uint16_t>(detail::constants::chunk_header_size_gnrl);
+			} else {
+				out.write<std::uint16_t>(detail::constants::chunk_header_size_dx10);
+				out << entry.header;
+			}
+
+			for (const auto& chunk : entry.chunks) {
+				out.write(chunk.offset, chunk.compressed_size, chunk.decompressed_size);
+				if (_meta.format_ == format::directx) {
+					out << chunk.mips;
+				}
+				out.write<std::uint32_t>(detail::constants::chunk_sentinel);
+			}
+		}
+
+		const auto& records = out.get<binary_io::memory_ostream>().rdbuf();
+		assert(records.size() == recordsEnd);
+		io.seekp(0);
+		io.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size()));
+		io.close();
+		if (!io) {
+			throw bsa::exception("failed to write archive");
+		}
+
+		if (std::filesystem::file_size(_path) > end) {
+			std::filesystem::resize_file(_path, end);
+		}
+		_dead = end - this->live_size();
+	}
+
+	void updater::compact()
+	{
+		this->commit();
+
+		auto temp = _path;
+		temp += ".tmp"sv;
+		{
+			archive ba2;
+			const auto meta = ba2.read(_path);
+			ba2.write(temp, meta, { .deduplicate = true });
+		}
+
+		std::filesystem::rename(temp, _path);
+		this->open(_path);
+	}
+
+	auto updater::live_size() const noexcept
+		-> std::uint64_t
+	{
+		auto result = this->records_size();
+		std::map<std::uint64_t, std::uint64_t> chunks;
+		for (const auto& entry : _entries) {
+			for (const auto& chunk : entry.chunks) {
+				chunks.emplace(
+					chunk.offset,
+					chunk.compressed_size != 0 ? chunk.compressed_size : chunk.decompressed_size);
+			}
+
+			if (_meta.strings) {
+				result += 2 + entry.name.size();
+			}
+		}
+
+		for (const auto& [offset, size] : chunks) {
+			result += size;
+		}
+
+		return result;
+	}
+
+	auto updater::records_size() const noexcept
+		-> std::uint64_t
+	{
+		const auto [header, chunk] =
+			_meta.format_ == format::general ?
+				std::make_pair(detail::constants::chunk_header_size_gnrl, detail::constants::chunk_size_gnrl) :
+				std::make_pair(detail::constants::chunk_header_size_dx10, detail::constants::chunk_size_dx10);
+		std::uint64_t result = detail::sizeof_header(_meta.version_);
+		for (const auto& entry : _entries) {
+			if (!entry.erased) {
+				result += header + chunk * (entry.pending ? entry.pending->size() : entry.chunks.size());
+			}
+		}
+		return result;
+	}
+}
+
+namespace bsa::fo4
+{
+	void patch::clear() noexcept
+	{
+		_files.clear();
+		_erased.clear();
+		_manifest.clear();
+	}
+
+	void patch::diff(
+		const archive& a_from,
+		const archive& a_to,
+		std::size_t a_threads)
+	{
+		this->clear();
+
+		std::vector<const archive::value_type*> files;
+		files.reserve(a_to.size());
+		for (const auto& elem : a_to) {
+			files.push_back(&elem);
+		}
+
+		_manifest.resize(files.size());
+		std::vector<std::uint8_t> changed(files.size());
+		detail::parallel_for(files.size(), a_threads, [&](std::size_t a_idx) {
+			const auto& [key, file] = *files[a_idx];
+			const auto it = a_from.find(key);
+			_manifest[a_idx] = { key.hash(), detail::checksum(file) };
+			changed[a_idx] = it == a_from.end() || !detail::same_file(it->second, file);
+		});
+
+		for (std::size_t i = 0; i < files.size(); ++i) {
+			if (changed[i]) {
+				_files.insert(files[i]->first, files[i]->second);
+			}
+		}
+		_files._names = a_to._names;  // the keys copied into the patch may view interned names
+
+		for (const auto& [key, file] : a_from) {
+			if (a_to.find(key) == a_to.end()) {
+				_erased.push_back(key.hash());
+			}
+		}
+	}
+
+	void patch::apply(
+		archive& a_archive,
+		std::size_t a_threads) const
+	{
+		// everything is checked up front, so a mismatched archive is left unchanged
+		const auto mismatch = []() {
+			return bsa::exception("archive does not match the base of the patch");
+		};
+
+		auto size = a_archive.size();
+		for (const auto& hash : _erased) {
+			if (a_archive.find(key_type{ hash }) == a_archive.end()) {
+				throw mismatch();
+			}
+			--size;
+		}
+
+		std::vector<std::pair<const file*, std::uint32_t>> untouched;
+		untouched.reserve(_manifest.size());
+		for (const auto& entry : _manifest) {
+			const key_type key{ entry.hash };
+			const auto it = a_archive.find(key);
+			if (_files.find(key) != _files.end()) {
+				size += it == a_archive.end() ? 1 : 0;
+			} else if (it == a_archive.end()) {
+				throw mismatch();
+			} else {
+				untouched.emplace_back(&it->second, entry.checksum);
+			}
+		}
+
+		if (size != _manifest.size()) {
+			throw mismatch();
+		}
+
+		detail::parallel_for(untouched.size(), a_threads, [&](std::size_t a_idx) {
+			const auto& [file, checksum] = untouched[a_idx];
+			if (detail::checksum(*file) != checksum) {
+				throw mismatch();
+			}
+		});
+
+		for (const auto& hash : _erased) {
+			a_archive.erase(key_type{ hash });
+		}
+
+		for (const auto& [key, file] : _files) {
+			a_archive.erase(key);
+			a_archive.insert(key, file);
+		}
+	}
+
+	void patch::apply(updater& a_updater) const
+	{
+		const auto mismatch = []() {
+			return bsa::exception("archive does not match the base of the patch");
+		};
+
+		auto size = a_updater.size();
+		for (const auto& hash : _erased) {
+			if (!a_updater.contains(key_type{ hash })) {
+				throw mismatch();
+			}
+			--size;
+		}
+
+		for (const auto& entry : _manifest) {
+			const key_type key{ entry.hash };
+			const auto contained = a_updater.contains(key);
+			if (_files.find(key) != _files.end()) {
+				size += contained ? 0 : 1;
+			} else if (!contained) {
+				throw mismatch();
+			}
+		}
+
+		if (size != _manifest.size()) {
+			throw mismatch();
+		}
+
+		for (const auto& hash : _erased) {
+			a_updater.erase(key_type{ hash });
+		}
+
+		for (const auto& [key, file] : _files) {
+			a_updater.insert_or_assign(key, file);
+		}
+	}
+
+	auto patch::read(read_source a_source)
+		-> meta_info
+	{
+		auto& in = a_source.stream();
+		this->clear();
+
+		const auto [magic, version, erased, files] =
+			in->read<std::uint32_t, std::uint32_t, std::uint32_t, std::uint32_t>();
+		if (magic != detail::constants::bpat) {
+			throw exception("invalid magic");
+		} else if (version != detail::constants::patch_version) {
+			throw exception("invalid version");
+		}
+
+		const auto tables =
+			std::uint64_t{ erased } * detail::constants::file_hash_size +
+			std::uint64_t{ files } * (detail::constants::file_hash_size + 4u);
+		if (tables > in->rdbuf().size() - static_cast<std::size_t>(in->tell())) {
+			throw exception("patch tables lie outside of the patch");
+		}
+
+		_erased.resize(erased);
+		for (auto& hash : _erased) {
+			in >> hash;
+		}
+
+		_manifest.resize(files);
+		for (auto& entry : _manifest) {
+			in >> entry.hash;
+			in->read(entry.checksum);
+		}
+
+		const auto unordered = std::adjacent_find(
+			_manifest.begin(),
+			_manifest.end(),
+			[](const entry_t& a_lhs, const entry_t& a_rhs) noexcept {
+				return !(a_lhs.hash < a_rhs.hash);
+			});
+		if (unordered != _manifest.end()) {
+			throw exception("patch manifest is out of order");
+		}
+
+		// the files are an archive of their own, which runs to the end of the patch
+		const auto bytes = in->rdbuf().subspan(static_cast<std::size_t>(in->tell()));
+		const auto meta =
+			in.has_file() ?
+				_files.read(read_source(in.file(), bytes)) :
+				_files.read(read_source(bytes, in.deep_copy() ? copy_type::deep : copy_type::shallow));
+
+		for (const auto& [key, file] : _files) {
+			const auto it = std::lower_bound(
+				_manifest.begin(),
+				_manifest.end(),
+				key.hash(),
+				[](const entry_t& a_entry, const hashing::hash& a_hash) noexcept {
+					return a_entry.hash < a_hash;
+				});
+			if (it == _manifest.end() || it->hash != key.hash() || it->checksum != detail::checksum(file)) {
+				throw exception("file does not match the manifest of the patch");
+			}
+		}
+
+		return meta;
+	}
+
+	void patch::write(
+		write_sink a_sink,
+		const meta_info& a_meta) const
+	{
+		auto& out = a_sink.stream();
+		out.write(
+			detail::constants::bpat,
+			detail::constants::patch_version,
+			static_cast<std::uint32_t>(_erased.size()),
+			static_cast<std::uint32_t>(_manifest.size()));
+		for (const auto& hash : _erased) {
+			out << hash;
+		}
+		for (const auto& entry : _manifest) {
+			out << entry.hash;
+			out.write(entry.checksum);
+		}
+
+		_files.write(out, a_meta);
 	}
 }
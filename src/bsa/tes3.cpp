@@ -1,12 +1,13 @@
 #include "bsa/tes3.hpp"
 
 #include <array>
-#include <bit>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <limits>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -14,6 +15,8 @@
 #include <binary_io/any_stream.hpp>
 #include <binary_io/file_stream.hpp>
 
+#include "bsa/detail/observe.hpp"
+
 namespace bsa::tes3
 {
 	namespace detail
@@ -133,24 +136,7 @@ namespace bsa::tes3
 		hash hash_file_in_place(std::string& a_path) noexcept
 		{
 			detail::normalize_path(a_path);
-			hash h;
-
-			const std::size_t midpoint = a_path.length() / 2u;
-			std::size_t i = 0;
-			for (; i < midpoint; ++i) {
-				// rotate between first 4 bytes
-				h.lo ^= std::uint32_t{ static_cast<unsigned char>(a_path[i]) }
-				        << ((i % 4u) * 8u);
-			}
-
-			for (std::uint32_t rot = 0; i < a_path.length(); ++i) {
-				// rotate between last 4 bytes
-				rot = std::uint32_t{ static_cast<unsigned char>(a_path[i]) }
-				      << (((i - midpoint) % 4u) * 8u);
-				h.hi = std::rotr(h.hi ^ rot, static_cast<int>(rot));
-			}
-
-			return h;
+			return detail::hash_normalized(a_path);
 		}
 	}
 
@@ -197,11 +183,18 @@ namespace bsa::tes3
 		}
 	};
 
+	void archive::intern_names()
+	{
+		this->intern_keys(_names);
+	}
+
 	void archive::read(read_source a_source)
 	{
-		auto& in = a_source.stream();
+		const detail::observe_phase phase{ observer::phase::read };
+		auto& in = a_source.sparse_stream();
 
 		const auto header = [&]() {
+			in.fetch({ 0, detail::constants::header_size });
 			detail::header_t result;
 			in >> result;
 			return result;
@@ -209,6 +202,9 @@ namespace bsa::tes3
 
 		this->clear();
 
+		// every table precedes the file data, which is only read once it is accessed
+		in.fetch({ 0, detail::offsetof_file_data(header) });
+
 		const offsets_t offsets{
 			detail::offsetof_hashes(header),
 			detail::offsetof_name_offsets(header),
@@ -216,9 +212,11 @@ namespace bsa::tes3
 			detail::offsetof_file_data(header)
 		};
 
+		this->bulk_reserve(header.file_count());
 		for (std::size_t i = 0; i < header.file_count(); ++i) {
 			this->read_file(in, offsets, i);
 		}
+		this->bulk_finalize();
 	}
 
 	bool archive::verify_offsets() const noexcept
@@ -255,7 +253,9 @@ namespace bsa::tes3
 
 	void archive::write(write_sink a_sink) const
 	{
+		const detail::observe_phase phase{ observer::phase::write };
 		auto& out = a_sink.stream();
+		const auto start = out.tell();
 
 		out << this->make_header();
 
@@ -264,6 +264,7 @@ namespace bsa::tes3
 		this->write_file_names(out);
 		this->write_file_hashes(out);
 		this->write_file_data(out);
+		detail::observe_io(observer::io::written, static_cast<std::size_t>(out.tell() - start));
 	}
 
 	auto archive::make_header() const noexcept
@@ -304,17 +305,15 @@ namespace bsa::tes3
 			return detail::read_zstring(a_in);
 		}();
 
-		[[maybe_unused]] const auto [it, success] =
-			this->insert(
-				key_type{ hash, name, a_in },
-				mapped_type{});
-		assert(success);
+		auto& value = this->bulk_insert(
+			key_type{ hash, name, a_in },
+			mapped_type{});
 
 		const auto [size, offset] = a_in->read<std::uint32_t, std::uint32_t>();
 
 		const detail::restore_point _{ a_in };
 		a_in->seek_absolute(a_offsets.fileData + offset);
-		it->second.set_data(a_in->read_bytes(size), a_in);
+		value.second.set_data(a_in->read_bytes(size), a_in);
 	}
 
 	void archive::write_file_entries(detail::ostream_t& a_out) const noexcept
@@ -358,4 +357,84 @@ namespace bsa::tes3
 			a_out.write_bytes(file.as_bytes());
 		}
 	}
+
+	auto archive_view::find(const hashing::hash& a_hash) const
+		-> std::optional<std::span<const std::byte>>
+	{
+		const auto idx = this->search(a_hash);
+		if (!idx) {
+			return std::nullopt;
+		}
+
+		detail::istream_t in{ _source.bytes(), copy_type::shallow };
+		in->seek_absolute(detail::constants::header_size);
+		in->seek_relative(detail::constants::file_entry_size * *idx);
+		const auto [size, offset] = in->read<std::uint32_t, std::uint32_t>();
+
+		const auto bytes = in->rdbuf();
+		const auto start = _data + offset;
+		if (start > bytes.size() || size > bytes.size() - start) {
+			throw exception("file data lies outside of the archive");
+		}
+
+		return bytes.subspan(start, size);
+	}
+
+	void archive_view::clear() noexcept
+	{
+		_source = {};
+		_count = 0;
+		_hashes = 0;
+		_data = 0;
+	}
+
+	void archive_view::read(read_source a_source)
+	{
+		const detail::observe_phase phase{ observer::phase::read };
+		auto& in = a_source.stream();
+
+		const auto header = [&]() {
+			detail::header_t result;
+			in >> result;
+			return result;
+		}();
+
+		this->clear();
+
+		const auto size = in->rdbuf().size();
+		if (detail::offsetof_names(header) > size ||
+			detail::offsetof_file_data(header) > size) {
+			throw exception("file tables lie outside of the archive");
+		}
+
+		_source = detail::shared_source{ in };
+		_count = header.file_count();
+		_hashes = detail::offsetof_hashes(header);
+		_data = detail::offsetof_file_data(header);
+	}
+
+	auto archive_view::search(const hashing::hash& a_hash) const noexcept
+		-> std::optional<std::size_t>
+	{
+		// the bounds of the hash table were checked when the archive was read
+		detail::istream_t in{ _source.bytes(), copy_type::shallow };
+		std::size_t first = 0;
+		std::size_t last = _count;
+		while (first < last) {
+			const auto mid = first + (last - first) / 2u;
+			in->seek_absolute(_hashes + detail::constants::hash_size * mid);
+			hashing::hash h;
+			in >> h;
+
+			if (const auto cmp = h <=> a_hash; cmp < 0) {
+				first = mid + 1;
+			} else if (cmp > 0) {
+				last = mid;
+			} else {
+				return mid;
+			}
+		}
+
+		return std::nullopt;
+	}
 }
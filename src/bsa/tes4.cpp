@@ -3,17 +3,23 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
+#include <charconv>
 #include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
 #include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -22,9 +28,21 @@
 #include <binary_io/common.hpp>
 #include <binary_io/file_stream.hpp>
 #include <binary_io/memory_stream.hpp>
+#include <binary_io/span_stream.hpp>
 #include <lz4frame.h>
 #include <lz4hc.h>
-#include <zlib.h>
+
+#include "bsa/async.hpp"
+#include "bsa/detail/async_read.hpp"
+#include "bsa/detail/codec_context.hpp"
+#include "bsa/detail/deduplicate.hpp"
+#include "bsa/detail/deflate.hpp"
+#include "bsa/detail/extract.hpp"
+#include "bsa/detail/index_cache.hpp"
+#include "bsa/detail/lzx.hpp"
+#include "bsa/detail/observe.hpp"
+#include "bsa/detail/parallel.hpp"
+#include "bsa/detail/verify.hpp"
 
 #ifdef BSA_SUPPORT_XMEM
 #	include <Windows.h>
@@ -63,6 +81,18 @@ namespace bsa::tes4
 				pref.autoFlush = 1;
 				return pref;
 			}();
+
+			[[nodiscard]] auto codec_of(const file::compression_params& a_params) noexcept
+				-> observer::codec
+			{
+				if (to_underlying(a_params.version_) == 105) {
+					return observer::codec::lz4;
+				} else if (a_params.compression_codec_ == compression_codec::xmem) {
+					return observer::codec::xmem;
+				} else {
+					return observer::codec::zlib;
+				}
+			}
 		}
 
 		class header_t final
@@ -210,24 +240,27 @@ namespace bsa::tes4
 				return a_header.directories_offset();
 			}
 
-			[[nodiscard]] auto offsetof_file_entries(
+			[[nodiscard]] auto directory_entry_size(
 				const detail::header_t& a_header) noexcept
 				-> std::size_t
 			{
-				const auto dirsz = [](std::size_t a_version) noexcept {
-					switch (a_version) {
-					case 103:
-					case 104:
-						return constants::directory_entry_size_x86;
-					case 105:
-						return constants::directory_entry_size_x64;
-					default:
-						declare_unreachable();
-					}
-				}(a_header.archive_version());
+				switch (a_header.archive_version()) {
+				case 103:
+				case 104:
+					return constants::directory_entry_size_x86;
+				case 105:
+					return constants::directory_entry_size_x64;
+				default:
+					declare_unreachable();
+				}
+			}
 
+			[[nodiscard]] auto offsetof_file_entries(
+				const detail::header_t& a_header) noexcept
+				-> std::size_t
+			{
 				return offsetof_directory_entries(a_header) +
-				       dirsz * a_header.directory_count();
+				       directory_entry_size(a_header) * a_header.directory_count();
 			}
 
 			[[nodiscard]] auto offsetof_file_strings(
@@ -385,32 +418,217 @@ namespace bsa::tes4
 				reproc::process _proxy;
 			};
 
-			[[nodiscard]] auto get_xmem_proxy()
-				-> reproc::process&
+			// A shared pool of proxies, which grows on demand up to one proxy per hardware thread.
+			// Callers which find every proxy busy block until one is released, instead of
+			//	spawning another process.
+			class xmem_pool final
+			{
+			public:
+				class lease final
+				{
+				public:
+					lease(
+						xmem_pool& a_pool,
+						std::unique_ptr<xmem_proxy> a_proxy) noexcept :
+						_pool(a_pool),
+						_proxy(std::move(a_proxy))
+					{}
+
+					~lease() noexcept { _pool.release(std::move(_proxy), _valid); }
+
+					lease(const volatile lease&) = delete;
+					lease& operator=(const volatile lease&) = delete;
+
+					[[nodiscard]] auto get() noexcept
+						-> reproc::process&
+					{
+						return _proxy->get();
+					}
+
+					// the proxy is in an unknown state after a communication failure, so it
+					//	must not be handed out again
+					void invalidate() noexcept { _valid = false; }
+
+				private:
+					xmem_pool& _pool;
+					std::unique_ptr<xmem_proxy> _proxy;
+					bool _valid{ true };
+				};
+
+				[[nodiscard]] auto acquire()
+					-> lease
+				{
+					std::unique_lock l{ _lock };
+					_available.wait(l, [&]() noexcept {
+						return !_idle.empty() || _spawned < _capacity;
+					});
+
+					if (!_idle.empty()) {
+						auto proxy = std::move(_idle.back());
+						_idle.pop_back();
+						return lease{ *this, std::move(proxy) };
+					}
+
+					++_spawned;
+					l.unlock();
+					try {
+						return lease{ *this, std::make_unique<xmem_proxy>() };
+					} catch (...) {
+						l.lock();
+						--_spawned;
+						_available.notify_one();
+						throw;
+					}
+				}
+
+			private:
+				void release(
+					std::unique_ptr<xmem_proxy> a_proxy,
+					bool a_valid) noexcept
+				{
+					{
+						const std::lock_guard l{ _lock };
+						if (a_valid) {
+							_idle.push_back(std::move(a_proxy));
+						} else {
+							--_spawned;
+						}
+					}
+					_available.notify_one();
+				}
+
+				std::mutex _lock;
+				std::condition_variable _available;
+				std::vector<std::unique_ptr<xmem_proxy>> _idle;
+				std::size_t _spawned{ 0 };
+				std::size_t _capacity{ (std::max)(std::thread::hardware_concurrency(), 1u) };
+			};
+
+			[[nodiscard]] auto get_xmem_pool()
+				-> xmem_pool&
 			{
-				thread_local xmem_proxy proxy;
-				return proxy.get();
+				static xmem_pool pool;
+				return pool;
+			}
+
+			// Compresses every file with a single round trip to a proxy.
+			void compress_xmem_batch(std::span<file* const> a_files)
+			{
+				auto lease = get_xmem_pool().acquire();
+				observe_codec observe{ observer::codec::xmem, observer::operation::compress };
+				try {
+					auto& proxy = lease.get();
+					const observe_xmem round_trip;
+					xmem::compress_batch_request request;
+					request.data.reserve(a_files.size());
+					for (const auto file : a_files) {
+						request.data.emplace_back(file->as_bytes());
+					}
+
+					detail::process_out os{ proxy };
+					os << xmem::request_header{ xmem::request_type::compress_batch }
+					   << request;
+
+					detail::process_in is{ proxy };
+					xmem::response_header header;
+					is >> header;
+					if (header.error != xmem::error_code::ok) {
+						throw bsa::compression_error(header.error);
+					}
+
+					xmem::compress_batch_response response;
+					is >> response;
+					if (response.data.size() != a_files.size()) {
+						lease.invalidate();
+						throw bsa::compression_error(detail::error_code::xmem_communication_failure);
+					}
+
+					std::size_t insz = 0;
+					std::size_t outsz = 0;
+					for (std::size_t i = 0; i < a_files.size(); ++i) {
+						const auto size = a_files[i]->size();
+						insz += size;
+						outsz += response.data[i].as_bytes().size();
+						a_files[i]->set_data(std::move(response.data[i]).as_vector(), size);
+					}
+					observe.finish(insz, outsz);
+				} catch (const binary_io::exception&) {
+					lease.invalidate();
+					throw bsa::compression_error(detail::error_code::xmem_communication_failure);
+				}
 			}
 #endif
-		}
-	}
 
-	namespace hashing
-	{
-		namespace
-		{
-			[[nodiscard]] auto crc32(std::span<const std::byte> a_bytes)
-				-> std::uint32_t
+			template <class Key>
+			void append_name(std::string& a_path, const Key& a_key)
+			{
+				if (const auto name = a_key.name(); !name.empty()) {
+					a_path.append(name);
+				} else {
+					std::array<char, 2 + sizeof(std::uint64_t) * 2> buf{ '0', 'x' };
+					const auto [last, ec] = std::to_chars(
+						buf.data() + 2,
+						buf.data() + buf.size(),
+						a_key.hash().numeric(),
+						16);
+					assert(ec == std::errc());
+					a_path.append(buf.data(), last);
+				}
+			}
+
+			// the parts of the header a lazy archive keeps, as stored in its sidecar index
+			struct cache_info_t final
+			{
+				std::uint32_t version{ 0 };
+				std::uint32_t flags{ 0 };
+				std::uint32_t types{ 0 };
+			};
+
+			[[nodiscard]] auto make_path(
+				const archive::key_type& a_directory,
+				const directory::key_type& a_file)
+				-> std::string
+			{
+				std::string result;
+				append_name(result, a_directory);
+				result += '\\';
+				append_name(result, a_file);
+				return result;
+			}
+
+			void extract_entry(
+				const std::filesystem::path& a_path,
+				const archive::key_type& a_directory,
+				const directory::key_type& a_key,
+				const file& a_file,
+				const file::write_params& a_params)
 			{
-				constexpr auto constant = std::uint32_t{ 0x1003Fu };
-				std::uint32_t crc = 0;
-				for (const auto c : a_bytes) {
-					crc = static_cast<std::uint8_t>(c) + crc * constant;
+				try {
+					extract_file(
+						a_path,
+						a_file.compressed() ? a_file.decompressed_size() : a_file.size(),
+						[&](std::span<std::byte> a_out) {
+							if (a_file.compressed()) {
+								a_file.decompress_into(
+									a_out,
+									{ .version_ = a_params.version_,
+										.compression_codec_ = a_params.compression_codec_ });
+							} else {
+								const auto bytes = a_file.as_bytes();
+								std::memcpy(a_out.data(), bytes.data(), bytes.size());
+							}
+						});
+				} catch (const bsa::compression_error& a_err) {
+					throw bsa::compression_error(
+						a_err,
+						make_path(a_directory, a_key));
 				}
-				return crc;
 			}
 		}
+	}
 
+	namespace hashing
+	{
 		void hash::read(
 			detail::istream_t& a_in,
 			std::endian a_endian)
@@ -440,103 +658,46 @@ namespace bsa::tes4
 		hash hash_directory_in_place(std::string& a_path) noexcept
 		{
 			detail::normalize_path(a_path);
-			const std::span<const std::byte> view{
-				reinterpret_cast<const std::byte*>(a_path.data()),
-				a_path.size()
-			};
-
-			hash h;
-
-			switch (std::min<std::size_t>(view.size(), 3)) {
-			case 3:
-				h.last2 = static_cast<std::uint8_t>(*(view.end() - 2));
-				[[fallthrough]];
-			case 2:
-			case 1:
-				h.last = static_cast<std::uint8_t>(view.back());
-				h.first = static_cast<std::uint8_t>(view.front());
-				[[fallthrough]];
-			default:
-				break;
-			}
-
-			h.length = static_cast<std::uint8_t>(view.size());
-			if (h.length > 3) {
-				// skip first and last two chars -> already processed
-				h.crc = crc32(view.subspan(1, view.size() - 3));
-			}
-
-			return h;
+			return detail::hash_directory_normalized(a_path);
 		}
 
 		hash hash_file_in_place(std::string& a_path) noexcept
 		{
-			constexpr std::array lut{
-				make_four_cc(""sv),
-				make_four_cc(".nif"sv),
-				make_four_cc(".kf"sv),
-				make_four_cc(".dds"sv),
-				make_four_cc(".wav"sv),
-				make_four_cc(".adp"sv),
-			};
-
 			detail::normalize_path(a_path);
 			if (const auto pos = a_path.find_last_of('\\'); pos != std::string::npos) {
-				a_path = a_path.substr(pos + 1);
-			}
-			const std::string_view pview{ a_path };
-
-			const auto [stem, extension] = [&]() noexcept
-				-> std::pair<std::string_view, std::string_view> {
-				const auto split = pview.find_last_of('.');
-				if (split != std::string_view::npos) {
-					return {
-						pview.substr(0, split),
-						pview.substr(split)
-					};
-				} else {
-					return {
-						pview,
-						""sv
-					};
-				}
-			}();
-
-			if (!stem.empty() &&
-				stem.length() < 260 &&
-				extension.length() < 16) {
-				auto h = [&]() noexcept {
-					std::string temp{ stem };
-					return hash_directory(temp);
-				}();
-				h.crc += crc32({ //
-					reinterpret_cast<const std::byte*>(extension.data()),
-					extension.size() });
-
-				const auto it = std::find(
-					lut.begin(),
-					lut.end(),
-					make_four_cc(extension));
-				if (it != lut.end()) {
-					const auto i = static_cast<std::uint8_t>(it - lut.begin());
-					h.first += 32u * (i & 0xFCu);
-					h.last += (i & 0xFEu) << 6u;
-					h.last2 += i << 7u;
-				}
-
-				return h;
-			} else {
-				return {};
+				a_path.erase(0, pos + 1);
 			}
+			return detail::hash_file_normalized(a_path);
 		}
 	}
 
 	void file::compress(const compression_params& a_params)
 	{
+		if (detail::skip_compression(this->as_bytes(), a_params.compression_policy_)) {
+			return;
+		}
+
+#ifdef BSA_SUPPORT_XMEM
+		if (detail::to_underlying(a_params.version_) == 104 &&
+			a_params.compression_codec_ == compression_codec::xmem) {
+			// a batch of one skips the separate round trip to compute the bound
+			assert(!this->compressed());
+			file* const self = this;
+			detail::compress_xmem_batch({ &self, 1 });
+			assert(this->compressed());
+			return;
+		}
+#endif
+
 		std::vector<std::byte> out;
 		out.resize(this->compress_bound(a_params));
+		detail::observe_allocation(out.size());
 
 		const auto outsz = this->compress_into({ out.data(), out.size() }, a_params);
+		if (!detail::keep_compression(this->size(), outsz, a_params.compression_policy_)) {
+			return;
+		}
+
 		out.resize(outsz);
 		out.shrink_to_fit();
 		this->set_data(std::move(out), this->size());
@@ -551,11 +712,11 @@ namespace bsa::tes4
 		switch (detail::to_underlying(a_params.version_)) {
 		case 103:
 			assert(a_params.compression_codec_ == compression_codec::normal);
-			return ::compressBound(static_cast<::uLong>(this->size()));
+			return detail::deflate::compress_bound(this->size());
 		case 104:
 			return a_params.compression_codec_ == compression_codec::xmem ?
 			           this->compress_bound_xmem() :
-			           ::compressBound(static_cast<::uLong>(this->size()));
+			           detail::deflate::compress_bound(this->size());
 		case 105:
 			assert(a_params.compression_codec_ == compression_codec::normal);
 			return ::LZ4F_compressFrameBound(this->size(), &detail::lz4f_preferences);
@@ -569,26 +730,44 @@ namespace bsa::tes4
 		const compression_params& a_params) const
 		-> std::size_t
 	{
-		switch (detail::to_underlying(a_params.version_)) {
-		case 103:
-			assert(a_params.compression_codec_ == compression_codec::normal);
-			return this->compress_into_zlib(a_out);
-		case 104:
-			return a_params.compression_codec_ == compression_codec::xmem ?
-			           this->compress_into_xmem(a_out) :
-			           this->compress_into_zlib(a_out);
-		case 105:
-			assert(a_params.compression_codec_ == compression_codec::normal);
-			return this->compress_into_lz4(a_out);
-		default:
-			detail::declare_unreachable();
-		}
+		return this->compress_into(a_out, a_params, detail::local_codec_context());
+	}
+
+	auto file::compress_into(
+		std::span<std::byte> a_out,
+		const compression_params& a_params,
+		codec_context& a_context) const
+		-> std::size_t
+	{
+		detail::observe_codec observe{
+			detail::codec_of(a_params),
+			observer::operation::compress
+		};
+		const auto outsz = [&]() {
+			switch (detail::to_underlying(a_params.version_)) {
+			case 103:
+				assert(a_params.compression_codec_ == compression_codec::normal);
+				return this->compress_into_zlib(a_out, a_context);
+			case 104:
+				return a_params.compression_codec_ == compression_codec::xmem ?
+				           this->compress_into_xmem(a_out) :
+				           this->compress_into_zlib(a_out, a_context);
+			case 105:
+				assert(a_params.compression_codec_ == compression_codec::normal);
+				return this->compress_into_lz4(a_out, a_context);
+			default:
+				detail::declare_unreachable();
+			}
+		}();
+		observe.finish(this->size(), outsz);
+		return outsz;
 	}
 
 	void file::decompress(const compression_params& a_params)
 	{
 		std::vector<std::byte> out;
 		out.resize(this->decompressed_size());
+		detail::observe_allocation(out.size());
 		this->decompress_into({ out.data(), out.size() }, a_params);
 		this->set_data(std::move(out));
 
@@ -599,25 +778,63 @@ namespace bsa::tes4
 		std::span<std::byte> a_out,
 		const compression_params& a_params) const
 	{
+		this->decompress_into(a_out, a_params, detail::local_codec_context());
+	}
+
+	void file::decompress_into(
+		std::span<std::byte> a_out,
+		const compression_params& a_params,
+		codec_context& a_context) const
+	{
+		detail::observe_codec observe{
+			detail::codec_of(a_params),
+			observer::operation::decompress
+		};
 		switch (detail::to_underlying(a_params.version_)) {
 		case 103:
 			assert(a_params.compression_codec_ == compression_codec::normal);
-			this->decompress_into_zlib(a_out);
+			this->decompress_into_zlib(a_out, a_context);
 			break;
 		case 104:
 			if (a_params.compression_codec_ == compression_codec::xmem) {
 				this->decompress_into_xmem(a_out);
 			} else {
-				this->decompress_into_zlib(a_out);
+				this->decompress_into_zlib(a_out, a_context);
 			}
 			break;
 		case 105:
 			assert(a_params.compression_codec_ == compression_codec::normal);
-			this->decompress_into_lz4(a_out);
+			this->decompress_into_lz4(a_out, a_context);
 			break;
 		default:
 			detail::declare_unreachable();
 		}
+		observe.finish(this->size(), this->decompressed_size());
+	}
+
+	auto file::open_stream(const compression_params& a_params) const
+		-> decompression_stream
+	{
+		using codec = decompression_stream::codec;
+		if (!this->compressed()) {
+			return { codec::none, this->as_bytes(), this->size() };
+		}
+
+		switch (detail::to_underlying(a_params.version_)) {
+		case 103:
+			assert(a_params.compression_codec_ == compression_codec::normal);
+			return { codec::zlib, this->as_bytes(), this->decompressed_size() };
+		case 104:
+			if (a_params.compression_codec_ == compression_codec::xmem) {
+				throw bsa::exception("xmem compressed files can not be streamed");
+			}
+			return { codec::zlib, this->as_bytes(), this->decompressed_size() };
+		case 105:
+			assert(a_params.compression_codec_ == compression_codec::normal);
+			return { codec::lz4_frame, this->as_bytes(), this->decompressed_size() };
+		default:
+			detail::declare_unreachable();
+		}
 	}
 
 	void file::read(
@@ -631,6 +848,7 @@ namespace bsa::tes4
 			this->compress({
 				.version_ = a_params.version_,
 				.compression_codec_ = a_params.compression_codec_,
+				.compression_policy_ = a_params.compression_policy_,
 			});
 		}
 	}
@@ -659,8 +877,10 @@ namespace bsa::tes4
 		-> std::size_t
 	{
 #ifdef BSA_SUPPORT_XMEM
+		auto lease = detail::get_xmem_pool().acquire();
 		try {
-			auto& proxy = detail::get_xmem_proxy();
+			auto& proxy = lease.get();
+			const detail::observe_xmem round_trip;
 			detail::process_out os{ proxy };
 			os << xmem::request_header{ xmem::request_type::compress_bound }
 			   << xmem::compress_bound_request{ this->as_bytes() };
@@ -676,14 +896,17 @@ namespace bsa::tes4
 			is >> response;
 			return response.bound;
 		} catch (const binary_io::exception&) {
+			lease.invalidate();
 			throw bsa::compression_error(detail::error_code::xmem_communication_failure);
 		}
 #else
-		throw bsa::compression_error(detail::error_code::xmem_unavailable);
+		return detail::lzx::compress_bound(this->size());
 #endif
 	}
 
-	auto file::compress_into_lz4(std::span<std::byte> a_out) const
+	auto file::compress_into_lz4(
+		std::span<std::byte> a_out,
+		codec_context& a_context) const
 		-> std::size_t
 	{
 		assert(!this->compressed());
@@ -691,11 +914,15 @@ namespace bsa::tes4
 
 		const auto in = this->as_bytes();
 
-		const auto result = ::LZ4F_compressFrame(
+		// without a dictionary, this is exactly `LZ4F_compressFrame`, minus the context it
+		//	would otherwise create and destroy for every file
+		const auto result = ::LZ4F_compressFrame_usingCDict(
+			&detail::get_codec_state(a_context).lz4f_compressor(),
 			a_out.data(),
 			a_out.size_bytes(),
 			in.data(),
 			in.size_bytes(),
+			nullptr,
 			&detail::lz4f_preferences);
 		if (::LZ4F_isError(result)) {
 			throw bsa::compression_error(bsa::compression_error::library::lz4, result);
@@ -704,11 +931,9 @@ namespace bsa::tes4
 		return result;
 	}
 
-	auto file::compress_into_xmem(
-		[[maybe_unused]] std::span<std::byte> a_out) const
+	auto file::compress_into_xmem(std::span<std::byte> a_out) const
 		-> std::size_t
 	{
-#ifdef BSA_SUPPORT_XMEM
 		assert(!this->compressed());
 		assert(a_out.size_bytes() >=
 			   this->compress_bound({
@@ -716,8 +941,13 @@ namespace bsa::tes4
 				   .compression_codec_ = compression_codec::xmem,
 			   }));
 
+		// the proxy is preferred where it is available, since only xcompress produces output
+		//	identical to the original archives
+#ifdef BSA_SUPPORT_XMEM
+		auto lease = detail::get_xmem_pool().acquire();
 		try {
-			auto& proxy = detail::get_xmem_proxy();
+			auto& proxy = lease.get();
+			const detail::observe_xmem round_trip;
 			detail::process_out os{ proxy };
 			os << xmem::request_header{ xmem::request_type::compress }
 			   << xmem::compress_request(
@@ -738,48 +968,33 @@ namespace bsa::tes4
 			std::memcpy(a_out.data(), out.data(), out.size_bytes());
 			return out.size_bytes();
 		} catch (const binary_io::exception&) {
+			lease.invalidate();
 			throw bsa::compression_error(detail::error_code::xmem_communication_failure);
 		}
 #else
-		throw bsa::compression_error(detail::error_code::xmem_unavailable);
+		return detail::lzx::compress(a_out, this->as_bytes());
 #endif
 	}
 
-	auto file::compress_into_zlib(std::span<std::byte> a_out) const
+	auto file::compress_into_zlib(
+		std::span<std::byte> a_out,
+		codec_context& a_context) const
 		-> std::size_t
 	{
 		assert(!this->compressed());
 		assert(a_out.size_bytes() >= this->compress_bound({ .version_ = version::tes4 }));
 
-		const auto in = this->as_bytes();
-		auto outsz = static_cast<::uLong>(a_out.size_bytes());
-
-		const auto result = ::compress(
-			reinterpret_cast<::Byte*>(a_out.data()),
-			&outsz,
-			reinterpret_cast<const ::Byte*>(in.data()),
-			static_cast<::uLong>(in.size_bytes()));
-		if (result != Z_OK) {
-			throw bsa::compression_error(bsa::compression_error::library::zlib, result);
-		}
-
-		return static_cast<std::size_t>(outsz);
+		return detail::deflate::compress(a_context, a_out, this->as_bytes());
 	}
 
-	void file::decompress_into_lz4(std::span<std::byte> a_out) const
+	void file::decompress_into_lz4(
+		std::span<std::byte> a_out,
+		codec_context& a_context) const
 	{
 		assert(this->compressed());
 		assert(a_out.size_bytes() >= this->decompressed_size());
 
-		::LZ4F_dctx* pdctx = nullptr;
-		if (const auto result = ::LZ4F_createDecompressionContext(&pdctx, LZ4F_VERSION);
-			::LZ4F_isError(result)) {
-			throw bsa::compression_error(bsa::compression_error::library::lz4, result);
-		}
-		std::unique_ptr<::LZ4F_dctx, decltype(&::LZ4F_freeDecompressionContext)> dctx{
-			pdctx,
-			::LZ4F_freeDecompressionContext
-		};
+		auto& dctx = detail::get_codec_state(a_context).lz4f_decompressor();
 
 		const auto in = this->as_bytes();
 
@@ -794,7 +1009,7 @@ namespace bsa::tes4
 			outptr += outsz;
 			outsz = static_cast<std::size_t>(std::to_address(a_out.end()) - outptr);
 			result = ::LZ4F_decompress(
-				dctx.get(),
+				&dctx,
 				outptr,
 				&outsz,
 				inptr,
@@ -813,72 +1028,45 @@ namespace bsa::tes4
 		}
 	}
 
-	void file::decompress_into_xmem(
-		[[maybe_unused]] std::span<std::byte> a_out) const
+	void file::decompress_into_xmem(std::span<std::byte> a_out) const
 	{
-#ifdef BSA_SUPPORT_XMEM
 		assert(this->compressed());
 		assert(a_out.size_bytes() >= this->decompressed_size());
 
-		try {
-			auto& proxy = detail::get_xmem_proxy();
-			detail::process_out os{ proxy };
-			os << xmem::request_header{ xmem::request_type::decompress }
-			   << xmem::decompress_request(
-					  static_cast<std::uint32_t>(this->decompressed_size()),
-					  this->as_bytes());
-
-			detail::process_in is{ proxy };
-			xmem::response_header header;
-			is >> header;
-			if (header.error != xmem::error_code::ok) {
-				throw bsa::compression_error(header.error);
-			}
-
-			xmem::decompress_response response;
-			is >> response;
-			const auto out = response.data.as_bytes();
-			if (out.size_bytes() != this->decompressed_size()) {
-				throw bsa::compression_error(detail::error_code::decompress_size_mismatch);
-			}
-
-			std::memcpy(a_out.data(), out.data(), this->decompressed_size());
-		} catch (const binary_io::exception&) {
-			throw bsa::compression_error(detail::error_code::xmem_communication_failure);
+		const auto outsz = detail::lzx::decompress(
+			a_out.first(this->decompressed_size()),
+			this->as_bytes());
+		if (outsz != this->decompressed_size()) {
+			throw bsa::compression_error(detail::error_code::decompress_size_mismatch);
 		}
-#else
-		throw bsa::compression_error(detail::error_code::xmem_unavailable);
-#endif
 	}
 
-	void file::decompress_into_zlib(std::span<std::byte> a_out) const
+	void file::decompress_into_zlib(
+		std::span<std::byte> a_out,
+		codec_context& a_context) const
 	{
 		assert(this->compressed());
 		assert(a_out.size_bytes() >= this->decompressed_size());
 
-		const auto in = this->as_bytes();
-		auto outsz = static_cast<::uLong>(a_out.size_bytes());
-
-		const auto result = ::uncompress(
-			reinterpret_cast<::Byte*>(a_out.data()),
-			&outsz,
-			reinterpret_cast<const ::Byte*>(in.data()),
-			static_cast<::uLong>(in.size_bytes()));
-		if (result != Z_OK) {
-			throw bsa::compression_error(bsa::compression_error::library::zlib, result);
-		}
-
+		const auto outsz = detail::deflate::decompress(a_context, a_out, this->as_bytes());
 		if (outsz != this->decompressed_size()) {
 			throw bsa::compression_error(detail::error_code::decompress_size_mismatch);
 		}
 	}
 
+	void archive::intern_names()
+	{
+		this->intern_keys(_names);
+	}
+
 	auto archive::read(read_source a_source)
 		-> version
 	{
-		auto& in = a_source.stream();
+		const detail::observe_phase phase{ observer::phase::read };
+		auto& in = a_source.sparse_stream();
 
 		const auto header = [&]() {
+			in.fetch({ 0, detail::constants::header_size });
 			detail::header_t result;
 			in >> result;
 			return result;
@@ -889,16 +1077,181 @@ namespace bsa::tes4
 		_flags = header.archive_flags();
 		_types = header.archive_types();
 
+		// every table precedes the file data, which is only read once it is accessed
+		in.fetch({ 0, detail::offsetof_file_data(header) });
+		if (in.sparse()) {
+			fetch_file_prefixes(in, header);
+		}
+
 		std::size_t namesOffset = detail::offsetof_file_strings(header);
 		std::size_t filesOffset = detail::offsetof_file_entries(header);
 		in->seek_absolute(header.directories_offset());
+		this->bulk_reserve(header.directory_count());
 		for (std::size_t i = 0; i < header.directory_count(); ++i) {
 			this->read_directory(in, header, filesOffset, namesOffset);
 		}
+		this->bulk_finalize();
 
 		return static_cast<version>(header.archive_version());
 	}
 
+	void archive::compress_all(
+		const file::compression_params& a_params,
+		std::size_t a_threads)
+	{
+		std::vector<std::pair<const key_type*, directory::value_type*>> jobs;
+		for (auto& [dkey, dir] : *this) {
+			for (auto& file : dir) {
+				if (!file.second.compressed()) {
+					jobs.emplace_back(&dkey, &file);
+				}
+			}
+		}
+
+		const auto compress = [&](std::size_t a_idx) {
+			const auto& [dkey, file] = jobs[a_idx];
+			try {
+				file->second.compress(a_params);
+			} catch (const bsa::compression_error& a_err) {
+				throw bsa::compression_error(
+					a_err,
+					detail::make_path(*dkey, file->first));
+			}
+		};
+
+#ifdef BSA_SUPPORT_XMEM
+		if (detail::to_underlying(a_params.version_) == 104 &&
+			a_params.compression_codec_ == compression_codec::xmem) {
+			// send files to the proxies in batches, so that every proxy in the pool has a
+			//	batch in flight at once
+			constexpr std::size_t max_batch = 64;
+			const auto threads = detail::resolve_thread_count(a_threads, jobs.size());
+			const auto batch = std::clamp<std::size_t>(
+				(jobs.size() + threads - 1) / threads,
+				1,
+				max_batch);
+			const auto batches = (jobs.size() + batch - 1) / batch;
+
+			detail::parallel_for(
+				batches,
+				threads,
+				[&](std::size_t a_idx) {
+					const auto first = a_idx * batch;
+					const auto last = (std::min)(first + batch, jobs.size());
+					std::vector<file*> files;
+					files.reserve(last - first);
+					for (std::size_t i = first; i < last; ++i) {
+						auto& f = jobs[i].second->second;
+						if (!detail::skip_compression(f.as_bytes(), a_params.compression_policy_)) {
+							files.push_back(&f);
+						}
+					}
+
+					if (files.empty()) {
+						return;
+					}
+
+					try {
+						detail::compress_xmem_batch(files);
+					} catch (const bsa::compression_error&) {
+						// retry each file on its own, to find out which one is at fault
+						for (std::size_t i = first; i < last; ++i) {
+							compress(i);
+						}
+					}
+				});
+			return;
+		}
+#endif
+
+		detail::parallel_for(jobs.size(), a_threads, compress);
+	}
+
+	auto archive::transcode(
+		const file::compression_params& a_from,
+		const file::compression_params& a_to,
+		std::size_t a_threads)
+		-> transcode_report
+	{
+		transcode_report report;
+		std::vector<std::pair<const key_type*, directory::value_type*>> jobs;
+		const bool passthrough = detail::codec_of(a_from) == detail::codec_of(a_to);
+		for (auto& [dkey, dir] : *this) {
+			for (auto& file : dir) {
+				if (passthrough || !file.second.compressed()) {
+					++report.passed_through;
+					report.passed_through_bytes += file.second.size();
+				} else {
+					jobs.emplace_back(&dkey, &file);
+				}
+			}
+		}
+
+		detail::parallel_for(
+			jobs.size(),
+			a_threads,
+			[&](std::size_t a_idx) {
+				const auto& [dkey, file] = jobs[a_idx];
+				try {
+					// work on a copy, so a failure leaves the original as it was
+					auto transcoded = file->second;
+					transcoded.decompress(a_from);
+					transcoded.compress(a_to);
+					file->second = std::move(transcoded);
+				} catch (const bsa::compression_error& a_err) {
+					throw bsa::compression_error(
+						a_err,
+						detail::make_path(*dkey, file->first));
+				}
+			});
+
+		report.transcoded = jobs.size();
+		for (const auto& [dkey, file] : jobs) {
+			report.transcoded_bytes += file->second.size();
+		}
+
+		return report;
+	}
+
+	void archive::extract_all(
+		const std::filesystem::path& a_root,
+		const file::write_params& a_params,
+		std::size_t a_threads) const
+	{
+		std::vector<std::pair<const key_type*, const directory::value_type*>> jobs;
+		std::vector<std::filesystem::path> paths;
+		for (const auto& [dkey, dir] : *this) {
+			for (const auto& file : dir) {
+				jobs.emplace_back(&dkey, &file);
+				paths.push_back(detail::make_extract_path(
+					a_root,
+					detail::make_path(dkey, file.first)));
+			}
+		}
+		detail::create_parent_directories(paths);
+
+		detail::for_each_streamed(
+			jobs.size(),
+			a_threads,
+			[&](std::size_t a_idx) {
+				return jobs[a_idx].second->second.unread();
+			},
+			[&](std::size_t a_idx, std::span<const std::byte> a_bytes) {
+				const auto& [dkey, elem] = jobs[a_idx];
+				auto file = elem->second;
+				file.set_data(
+					a_bytes,
+					file.compressed() ?
+						std::make_optional(file.decompressed_size()) :
+						std::nullopt);
+				detail::extract_entry(paths[a_idx], *dkey, elem->first, file, a_params);
+			},
+			[&](std::size_t a_idx) {
+				const auto& [dkey, elem] = jobs[a_idx];
+				detail::extract_entry(paths[a_idx], *dkey, elem->first, elem->second, a_params);
+			});
+	}
+
 	bool archive::verify_offsets(version a_version) const noexcept
 	{
 		const auto header = this->make_header(a_version);
@@ -921,31 +1274,303 @@ namespace bsa::tes4
 		return offset <= (std::numeric_limits<std::int32_t>::max)();
 	}
 
-	void archive::write(
-		write_sink a_sink,
-		version a_version) const
+	auto archive::verify(
+		const file::compression_params& a_params,
+		std::size_t a_threads) const
+		-> verify_report
 	{
-		auto& out = a_sink.stream();
+		verify_report report;
+		report.offsets = this->verify_offsets(a_params.version_);
+
+		std::vector<std::pair<const key_type*, const directory::value_type*>> jobs;
+		for (const auto& [dkey, dir] : *this) {
+			if (const auto name = dkey.name();
+				!name.empty() && hashing::hash_directory(name) != dkey.hash()) {
+				report.failures.push_back({ std::string(name), "directory hash does not match its name"s });
+			}
 
-		const auto header = this->make_header(a_version);
-		out << header;
+			for (const auto& file : dir) {
+				jobs.emplace_back(&dkey, &file);
+			}
+		}
 
-		const auto intermediate = sort_for_write(header.xbox_archive());
+		detail::verify_entries(
+			report,
+			jobs.size(),
+			a_threads,
+			[&](std::size_t a_idx, detail::scratch_pool::lease& a_scratch) {
+				const auto& [key, file] = *jobs[a_idx].second;
+				if (const auto name = key.name();
+					!name.empty() && hashing::hash_file(name) != key.hash()) {
+					throw bsa::exception("file hash does not match its name");
+				}
 
-		this->write_directory_entries(intermediate, out, header);
-		this->write_file_entries(intermediate, out, header);
-		if (header.file_strings()) {
-			this->write_file_names(intermediate, out);
-		}
-		this->write_file_data(intermediate, out, header);
+				if (!file.compressed()) {
+					return file.size();
+				}
+
+				const auto size = file.decompressed_size();
+				file.decompress_into(a_scratch.get(size), a_params);
+				return size;
+			},
+			[&](std::size_t a_idx) {
+				return detail::make_path(*jobs[a_idx].first, jobs[a_idx].second->first);
+			});
+
+		return report;
 	}
 
-	struct archive::xbox_sort_t final
+	auto archive::estimate_size(
+		const file::compression_params& a_params,
+		std::size_t a_samples,
+		std::size_t a_threads) const
+		-> size_estimate
 	{
-		// i legitimately have no idea how they sort hashes in the xbox format
-		// it simply defies all reason
-
-		template <class T>
+		size_estimate result;
+		const auto sizes = this->predict_file_sizes(a_params, a_samples, a_threads, result.sampled);
+		const auto header = this->make_header(a_params.version_);
+
+		std::uint64_t offset = detail::offsetof_file_data(header);
+		result.last_offset = offset;
+		std::size_t idx = 0;
+		for (const auto& [dkey, dir] : *this) {
+			for (const auto& [fkey, file] : dir) {
+				result.last_offset = offset;
+				offset += sizes[idx++];
+				if (header.embedded_file_names()) {
+					offset += 1u +  // prefixed byte length
+					          dkey.name().length() +
+					          1u +  // directory separator
+					          fkey.name().length();
+				}
+			}
+		}
+
+		result.size = offset;
+		return result;
+	}
+
+	auto archive::split(
+		const file::compression_params& a_params,
+		std::uint64_t a_limit,
+		std::size_t a_samples,
+		std::size_t a_threads)
+		-> std::vector<archive>
+	{
+		std::size_t sampled = 0;
+		const auto sizes = this->predict_file_sizes(a_params, a_samples, a_threads, sampled);
+		const bool embedded = detail::header_t{ a_params.version_, _flags, _types, {}, {} }.embedded_file_names();
+
+		std::vector<archive> result;
+		detail::header_t::info_t dirs;
+		detail::header_t::info_t files;
+		std::uint64_t data = 0;
+		const auto start = [&]() {
+			auto& part = result.emplace_back();
+			part._flags = _flags;
+			part._types = _types;
+			part._names = _names;  // the keys moved into the part may view interned names
+			dirs = {};
+			files = {};
+			data = 0;
+		};
+
+		start();
+		std::size_t idx = 0;
+		for (auto& [dkey, dir] : *this) {
+			directory* target = nullptr;
+			for (auto& [fkey, file] : dir) {
+				// the records of this file push back where the data of every file goes
+				const auto grow = [&](detail::header_t::info_t& a_dirs, detail::header_t::info_t& a_files) {
+					if (!target) {
+						a_dirs.count += 1;
+						if (this->directory_strings()) {
+							a_dirs.blobsz += static_cast<std::uint32_t>(
+								dkey.name().length() +
+								1u);  // null terminator
+						}
+					}
+
+					a_files.count += 1;
+					if (this->file_strings()) {
+						a_files.blobsz += static_cast<std::uint32_t>(
+							fkey.name().length() +
+							1u);  // null terminator
+					}
+				};
+
+				auto nextDirs = dirs;
+				auto nextFiles = files;
+				grow(nextDirs, nextFiles);
+				const detail::header_t header{ a_params.version_, _flags, _types, nextDirs, nextFiles };
+				if (detail::offsetof_file_data(header) + data > a_limit && files.count > 0) {
+					start();
+					target = nullptr;
+					nextDirs = {};
+					nextFiles = {};
+					grow(nextDirs, nextFiles);
+				}
+
+				if (!target) {
+					auto& part = result.back();
+					target = &part.insert(dkey, directory{}).first->second;
+				}
+
+				target->insert(fkey, std::move(file));
+				dirs = nextDirs;
+				files = nextFiles;
+				data += sizes[idx++];
+				if (embedded) {
+					data += 1u +  // prefixed byte length
+					        dkey.name().length() +
+					        1u +  // directory separator
+					        fkey.name().length();
+				}
+			}
+		}
+
+		super::clear();
+		return result;
+	}
+
+	auto archive::decompress_cached(
+		content_cache& a_cache,
+		const key_type& a_directory,
+		const directory::key_type& a_file,
+		const file::compression_params& a_params) const
+		-> content_cache::contents_type
+	{
+		const auto dir = this->find(a_directory);
+		if (dir == this->end()) {
+			return nullptr;
+		}
+
+		const auto file = dir->second.find(a_file);
+		if (file == dir->second.end()) {
+			return nullptr;
+		}
+
+		const content_cache::key_type key{
+			.archive = this,
+			.generation = _generation,
+			.hi = a_directory.hash().numeric(),
+			.lo = a_file.hash().numeric(),
+		};
+		return a_cache.get_or_load(key, [&]() {
+			const auto& f = file->second;
+			if (!f.compressed()) {
+				const auto bytes = f.as_bytes();
+				return std::vector<std::byte>(bytes.begin(), bytes.end());
+			}
+
+			std::vector<std::byte> contents(f.decompressed_size());
+			f.decompress_into(contents, a_params);
+			return contents;
+		});
+	}
+
+	void archive::write(
+		write_sink a_sink,
+		version a_version) const
+	{
+		this->write(std::move(a_sink), a_version, {});
+	}
+
+	void archive::write(
+		write_sink a_sink,
+		version a_version,
+		const write_params& a_params) const
+	{
+		const detail::observe_phase phase{ observer::phase::write };
+		auto& out = a_sink.stream();
+		const auto start = out.tell();
+
+		const auto header = this->make_header(a_version);
+		out << header;
+
+		const auto intermediate = sort_for_write(header.xbox_archive());
+		const auto shared =
+			a_params.deduplicate && !header.embedded_file_names() ?
+				share_file_data(intermediate) :
+				std::vector<std::size_t>();
+
+		const auto layout = make_layout(intermediate, header, shared, a_params.data_order);
+
+		this->write_directory_entries(intermediate, out, header);
+		this->write_file_entries(intermediate, out, header, layout.offsets);
+		if (header.file_strings()) {
+			this->write_file_names(intermediate, out);
+		}
+		write_file_data(layout, out, header);
+		detail::observe_io(observer::io::written, static_cast<std::size_t>(out.tell() - start));
+	}
+
+	void archive::write_mapped(
+		const std::filesystem::path& a_path,
+		version a_version,
+		const write_params& a_params,
+		std::size_t a_threads) const
+	{
+		const detail::observe_phase phase{ observer::phase::write };
+
+		const auto header = this->make_header(a_version);
+		const auto intermediate = sort_for_write(header.xbox_archive());
+		const auto shared =
+			a_params.deduplicate && !header.embedded_file_names() ?
+				share_file_data(intermediate) :
+				std::vector<std::size_t>();
+
+		const auto layout = make_layout(intermediate, header, shared, a_params.data_order);
+		const auto records = detail::offsetof_file_data(header);
+		std::size_t size = records;
+		for (const auto idx : layout.order) {
+			const auto& [dkey, file] = layout.files[idx];
+			size += make_file_size(*dkey, file->first, file->second, header) & ~file::icompression;
+		}
+
+		detail::extract_file(a_path, size, [&](std::span<std::byte> a_out) {
+			detail::ostream_t out{ std::in_place_type<binary_io::span_ostream>, a_out.first(records) };
+			out << header;
+			this->write_directory_entries(intermediate, out, header);
+			this->write_file_entries(intermediate, out, header, layout.offsets);
+			if (header.file_strings()) {
+				this->write_file_names(intermediate, out);
+			}
+			assert(static_cast<std::size_t>(out.tell()) == records);
+
+			// the data of every file goes exactly where its entry points to
+			detail::parallel_for(
+				layout.order.size(),
+				a_threads,
+				[&](std::size_t a_idx) {
+					const auto idx = layout.order[a_idx];
+					const auto& [dkey, file] = layout.files[idx];
+					const auto dirname = dkey->name();
+					const auto fsize =
+						make_file_size(*dkey, file->first, file->second, header) &
+						~file::icompression;
+					detail::ostream_t region{
+						std::in_place_type<binary_io::span_ostream>,
+						a_out.subspan(layout.offsets[idx], fsize)
+					};
+					write_file_data(
+						{ reinterpret_cast<const std::byte*>(dirname.data()), dirname.size() },
+						file->first,
+						file->second,
+						region,
+						header);
+				});
+		});
+
+		detail::observe_io(observer::io::written, size);
+	}
+
+	struct archive::xbox_sort_t final
+	{
+		// i legitimately have no idea how they sort hashes in the xbox format
+		// it simply defies all reason
+
+		template <class T>
 		[[nodiscard]] bool operator()(
 			const T& a_lhs,
 			const T& a_rhs) const noexcept
@@ -1015,6 +1640,7 @@ namespace bsa::tes4
 	{
 		std::optional<std::string_view> dirname;
 
+		a_dir.bulk_reserve(a_count);
 		for (std::size_t i = 0; i < a_count; ++i) {
 			hashing::hash hash;
 			hash.read(a_in, a_header.endian());
@@ -1060,14 +1686,12 @@ namespace bsa::tes4
 				embeddedName ? *embeddedName :
 							   ""sv;
 
-			[[maybe_unused]] const auto [it, success] =
-				a_dir.insert(
-					directory::key_type{ hash, fname, a_in },
-					directory::mapped_type{});
-			assert(success);
-
-			this->read_file_data(it->second, a_in, a_header, size);
+			auto& value = a_dir.bulk_insert(
+				directory::key_type{ hash, fname, a_in },
+				directory::mapped_type{});
+			this->read_file_data(value.second, a_in, a_header, size);
 		}
+		a_dir.bulk_finalize();
 
 		return dirname;
 	}
@@ -1092,6 +1716,48 @@ namespace bsa::tes4
 		a_file.set_data(a_in->read_bytes(a_size), a_in, decompsz);
 	}
 
+	void archive::fetch_file_prefixes(
+		detail::istream_t& a_in,
+		const detail::header_t& a_header)
+	{
+		const detail::restore_point _{ a_in };
+		std::vector<detail::extent_t> prefixes;
+		std::size_t files = detail::offsetof_file_entries(a_header);
+		for (std::size_t i = 0; i < a_header.directory_count(); ++i) {
+			a_in->seek_absolute(
+				detail::offsetof_directory_entries(a_header) +
+				detail::directory_entry_size(a_header) * i);
+			hashing::hash hash;
+			hash.read(a_in, a_header.endian());
+			const auto [count] = a_in->read<std::uint32_t>();
+
+			a_in->seek_absolute(files);
+			if (a_header.directory_strings()) {
+				const auto [length] = a_in->read<std::uint8_t>();
+				a_in->seek_relative(length);
+			}
+
+			for (std::size_t j = 0; j < count; ++j) {
+				hash.read(a_in, a_header.endian());
+				const auto [size, offset] = a_in->read<std::uint32_t, std::uint32_t>();
+				const bool compressed =
+					size & file::icompression ?
+						!a_header.compressed() :
+						a_header.compressed();
+				const std::size_t prefix =
+					(a_header.embedded_file_names() ? 1u + 0xFFu : 0u) +
+					(compressed ? 4u : 0u);
+				if (prefix > 0) {
+					prefixes.push_back({ offset & ~file::isecondary_archive,
+						(std::min<std::size_t>)(prefix, size & ~(file::ichecked | file::icompression)) });
+				}
+			}
+			files = a_in->tell();
+		}
+
+		a_in.fetch(prefixes);
+	}
+
 	void archive::read_directory(
 		detail::istream_t& a_in,
 		const detail::header_t& a_header,
@@ -1134,11 +1800,9 @@ namespace bsa::tes4
 			embeddedName ? *embeddedName :
 						   ""sv;
 
-		[[maybe_unused]] const auto [it, success] =
-			this->insert(
-				key_type{ hash, dname, a_in },
-				std::move(d));
-		assert(success);
+		this->bulk_insert(
+			key_type{ hash, dname, a_in },
+			std::move(d));
 
 		a_filesOffset = a_in->tell();
 	}
@@ -1209,48 +1873,147 @@ namespace bsa::tes4
 		}
 	}
 
-	void archive::write_file_data(
-		const intermediate_t& a_intermediate,
-		detail::ostream_t& a_out,
-		const detail::header_t& a_header) const noexcept
+	auto archive::share_file_data(const intermediate_t& a_intermediate)
+		-> std::vector<std::size_t>
 	{
+		std::vector<const file*> files;
 		for (const auto& elem : a_intermediate) {
-			const auto& dir = *elem.first;
-			const auto dirname = dir.first.name();
-			std::span dirbytes{
-				reinterpret_cast<const std::byte*>(dirname.data()),
-				dirname.size()
-			};
+			for (const auto file : elem.second) {
+				files.push_back(&file->second);
+			}
+		}
 
+		return detail::share_duplicates(
+			files.size(),
+			[&](std::size_t a_idx) noexcept {
+				return detail::content_hash(files[a_idx]->as_bytes());
+			},
+			[&](std::size_t a_lhs, std::size_t a_rhs) noexcept {
+				return detail::same_contents(*files[a_lhs], *files[a_rhs]);
+			});
+	}
+
+	auto archive::make_layout(
+		const intermediate_t& a_intermediate,
+		const detail::header_t& a_header,
+		std::span<const std::size_t> a_shared,
+		std::span<const std::pair<key_type, directory::key_type>> a_order)
+		-> layout_t
+	{
+		layout_t layout;
+		for (const auto& elem : a_intermediate) {
 			for (const auto file : elem.second) {
-				if (a_header.embedded_file_names()) {
-					const auto fname = file->first.name();
-					const auto len = dirbytes.size() +
-					                 1u +  // directory separator
-					                 fname.size();
-					a_out.write(static_cast<std::uint8_t>(len));
-					a_out.write_bytes(dirbytes);
-					a_out.write(std::byte{ '\\' });
-					a_out.write_bytes({ //
-						reinterpret_cast<const std::byte*>(fname.data()),
-						fname.size() });
-				}
+				layout.files.emplace_back(&elem.first->first, file);
+			}
+		}
 
-				if (file->second.compressed()) {
-					a_out.write(static_cast<std::uint32_t>(file->second.decompressed_size()));
+		const auto count = layout.files.size();
+		const auto representative = [&](std::size_t a_idx) noexcept {
+			return a_shared.empty() ? a_idx : a_shared[a_idx];
+		};
+
+		std::vector<bool> placed(count, false);
+		if (!a_order.empty()) {
+			using hashes_t = std::pair<hashing::hash, hashing::hash>;
+			std::vector<std::pair<hashes_t, std::size_t>> lookup;
+			lookup.reserve(count);
+			for (std::size_t i = 0; i < count; ++i) {
+				const auto& [dkey, file] = layout.files[i];
+				lookup.emplace_back(hashes_t{ dkey->hash(), file->first.hash() }, i);
+			}
+			std::sort(lookup.begin(), lookup.end());
+
+			for (const auto& [dkey, fkey] : a_order) {
+				const hashes_t hashes{ dkey.hash(), fkey.hash() };
+				const auto it = std::lower_bound(
+					lookup.begin(),
+					lookup.end(),
+					hashes,
+					[](const auto& a_lhs, const hashes_t& a_rhs) noexcept {
+						return a_lhs.first < a_rhs;
+					});
+				if (it != lookup.end() && it->first == hashes) {
+					const auto idx = representative(it->second);
+					if (!placed[idx]) {
+						placed[idx] = true;
+						layout.order.push_back(idx);
+					}
 				}
+			}
+		}
 
-				a_out.write_bytes(file->second.as_bytes());
+		for (std::size_t i = 0; i < count; ++i) {
+			if (representative(i) == i && !placed[i]) {
+				layout.order.push_back(i);
 			}
 		}
+
+		layout.offsets.resize(count);
+		auto offset = static_cast<std::uint32_t>(detail::offsetof_file_data(a_header));
+		for (const auto idx : layout.order) {
+			const auto& [dkey, file] = layout.files[idx];
+			layout.offsets[idx] = offset;
+			offset += make_file_size(*dkey, file->first, file->second, a_header) & ~file::icompression;
+		}
+
+		for (std::size_t i = 0; i < count; ++i) {
+			layout.offsets[i] = layout.offsets[representative(i)];
+		}
+
+		return layout;
+	}
+
+	void archive::write_file_data(
+		const layout_t& a_layout,
+		detail::ostream_t& a_out,
+		const detail::header_t& a_header) noexcept
+	{
+		for (const auto idx : a_layout.order) {
+			const auto& [dkey, file] = a_layout.files[idx];
+			const auto dirname = dkey->name();
+			write_file_data(
+				{ reinterpret_cast<const std::byte*>(dirname.data()), dirname.size() },
+				file->first,
+				file->second,
+				a_out,
+				a_header);
+		}
+	}
+
+	void archive::write_file_data(
+		std::span<const std::byte> a_dirname,
+		const directory::key_type& a_key,
+		const file& a_file,
+		detail::ostream_t& a_out,
+		const detail::header_t& a_header) noexcept
+	{
+		if (a_header.embedded_file_names()) {
+			const auto fname = a_key.name();
+			const auto len = a_dirname.size() +
+			                 1u +  // directory separator
+			                 fname.size();
+			a_out.write(static_cast<std::uint8_t>(len));
+			a_out.write_bytes(a_dirname);
+			a_out.write(std::byte{ '\\' });
+			a_out.write_bytes({ //
+				reinterpret_cast<const std::byte*>(fname.data()),
+				fname.size() });
+		}
+
+		if (a_file.compressed()) {
+			a_out.write(static_cast<std::uint32_t>(a_file.decompressed_size()));
+		}
+
+		a_out.write_bytes(a_file.as_bytes());
 	}
 
 	void archive::write_file_entries(
 		const intermediate_t& a_intermediate,
 		detail::ostream_t& a_out,
-		const detail::header_t& a_header) const noexcept
+		const detail::header_t& a_header,
+		std::span<const std::uint32_t> a_offsets) const
 	{
-		auto offset = static_cast<std::uint32_t>(detail::offsetof_file_data(a_header));
+		std::size_t idx = 0;
 		for (const auto& elem : a_intermediate) {
 			const auto& dir = *elem.first;
 			if (a_header.directory_strings()) {
@@ -1259,30 +2022,123 @@ namespace bsa::tes4
 
 			for (const auto file : elem.second) {
 				file->first.hash().write(a_out, a_header.endian());
-				auto fsize = file->second.size();
+				const auto fsize = make_file_size(dir.first, file->first, file->second, a_header);
+				a_out.write(fsize, a_offsets.empty() ? std::uint32_t{ 0 } : a_offsets[idx]);
+				++idx;
+			}
+		}
+	}
 
-				if (!!a_header.compressed() != !!file->second.compressed()) {
-					fsize |= file::icompression;
-				}
+	auto archive::predict_file_sizes(
+		const file::compression_params& a_params,
+		std::size_t a_samples,
+		std::size_t a_threads,
+		std::size_t& a_sampled) const
+		-> std::vector<std::uint64_t>
+	{
+		std::vector<const file*> files;
+		std::vector<std::uint64_t> result;
 
-				if (a_header.embedded_file_names()) {
-					fsize += static_cast<std::uint32_t>(
-						1u +  // prefixed byte length
-						dir.first.name().length() +
-						1u +  // directory separator
-						file->first.name().length());
+		// files of a type tend to compress alike, so group the files which have yet to be
+		//	compressed by their extension
+		std::map<std::string_view, std::vector<std::size_t>> groups;
+		for (const auto& dir : *this) {
+			for (const auto& [key, file] : dir.second) {
+				const auto idx = files.size();
+				files.push_back(&file);
+				if (file.compressed()) {
+					result.push_back(file.size() + 4u);  // decompressed size
+				} else {
+					result.push_back(file.size());
+					const auto name = key.name();
+					const auto dot = name.find_last_of("."sv);
+					groups[dot != std::string_view::npos ? name.substr(dot) : ""sv].push_back(idx);
 				}
+			}
+		}
 
-				if (file->second.compressed()) {
-					fsize += 4u;
-				}
+		// samples are spread evenly across each group
+		const auto sample = [&](const std::vector<std::size_t>& a_group, std::size_t a_idx) noexcept {
+			const auto count = (std::min)(a_samples, a_group.size());
+			return a_group[a_idx * a_group.size() / count];
+		};
 
-				a_out.write(
-					static_cast<std::uint32_t>(fsize),
-					offset);
-				offset += static_cast<std::uint32_t>(fsize & ~file::icompression);
+		std::vector<std::size_t> samples;
+		for (const auto& group : groups) {
+			const auto count = (std::min)(a_samples, group.second.size());
+			for (std::size_t i = 0; i < count; ++i) {
+				samples.push_back(sample(group.second, i));
+			}
+		}
+
+		detail::parallel_for(
+			samples.size(),
+			a_threads,
+			[&](std::size_t a_idx) {
+				const auto idx = samples[a_idx];
+				auto copy = *files[idx];
+				copy.compress(a_params);
+				result[idx] = copy.compressed() ?
+				                  copy.size() + 4u :  // decompressed size
+				                  copy.size();
+			});
+
+		for (const auto& group : groups) {
+			const auto& members = group.second;
+			const auto count = (std::min)(a_samples, members.size());
+			std::uint64_t before = 0;
+			std::uint64_t after = 0;
+			for (std::size_t i = 0; i < count; ++i) {
+				const auto idx = sample(members, i);
+				before += files[idx]->size();
+				after += result[idx];
+			}
+
+			if (before == 0) {
+				continue;
+			}
+
+			const auto ratio = static_cast<double>(after) / static_cast<double>(before);
+			for (std::size_t i = 0, next = 0; i < members.size(); ++i) {
+				if (next < count && members[i] == sample(members, next)) {
+					++next;  // sampled files are known exactly
+				} else {
+					const auto size = static_cast<double>(files[members[i]]->size());
+					result[members[i]] = static_cast<std::uint64_t>(std::ceil(size * ratio));
+				}
 			}
 		}
+
+		a_sampled = samples.size();
+		return result;
+	}
+
+	auto archive::make_file_size(
+		const key_type& a_directory,
+		const directory::key_type& a_key,
+		const file& a_file,
+		const detail::header_t& a_header) noexcept
+		-> std::uint32_t
+	{
+		auto fsize = a_file.size();
+
+		if (!!a_header.compressed() != !!a_file.compressed()) {
+			fsize |= file::icompression;
+		}
+
+		if (a_header.embedded_file_names()) {
+			fsize += static_cast<std::uint32_t>(
+				1u +  // prefixed byte length
+				a_directory.name().length() +
+				1u +  // directory separator
+				a_key.name().length());
+		}
+
+		if (a_file.compressed()) {
+			fsize += 4u;
+		}
+
+		return static_cast<std::uint32_t>(fsize);
 	}
 
 	void archive::write_file_names(
@@ -1295,4 +2151,303 @@ namespace bsa::tes4
 			}
 		}
 	}
+
+	auto lazy_archive::lookup(
+		const key_type& a_directory,
+		const directory::key_type& a_file)
+		-> const_index
+	{
+		if (const auto cached = std::as_const(_cache)[a_directory][a_file]; cached) {
+			return cached;
+		}
+
+		const auto record = std::lower_bound(
+			_records.begin(),
+			_records.end(),
+			a_directory.hash(),
+			[](const record_t& a_lhs, const hashing::hash& a_rhs) noexcept {
+				return a_lhs.hash < a_rhs;
+			});
+		if (record == _records.end() || record->hash != a_directory.hash()) {
+			return {};
+		}
+
+		auto in = _source.open();
+		const auto header = [&]() {
+			detail::header_t result;
+			in >> result;
+			return result;
+		}();
+
+		in->seek_absolute(record->files);
+		std::uint32_t size = 0;
+		std::uint32_t offset = 0;
+		for (std::size_t i = 0;; ++i) {
+			if (i == record->count) {
+				return {};
+			}
+
+			hashing::hash hash;
+			hash.read(in, header.endian());
+			std::tie(size, offset) = in->read<std::uint32_t, std::uint32_t>();
+			if (hash == a_file.hash()) {
+				break;
+			}
+		}
+
+		in->seek_absolute(offset & ~file::isecondary_archive);
+		std::optional<std::string_view> dirname;
+		std::string_view fname;
+		if (header.embedded_file_names()) {
+			fname = detail::read_bstring(in);
+			size -= static_cast<std::uint32_t>(fname.length() + 1u);
+			const auto pos = fname.find_last_of("\\/"sv);
+			if (pos != std::string_view::npos) {
+				dirname = fname.substr(0, pos);
+				fname = fname.substr(pos + 1);
+			}
+		}
+
+		file f;
+		archive::read_file_data(f, in, header, size);
+
+		// keys which were looked up by name own their strings, so prefer copying those
+		auto dir = _cache.find(a_directory);
+		if (dir == _cache.end()) {
+			auto key = [&]() {
+				if (!a_directory.name().empty()) {
+					return a_directory;
+				} else if (header.directory_strings()) {
+					const detail::restore_point _{ in };
+					in->seek_absolute(record->name);
+					return key_type{ a_directory.hash(), detail::read_bzstring(in), in };
+				} else {
+					return key_type{ a_directory.hash(), dirname.value_or(""sv), in };
+				}
+			}();
+			dir = _cache.insert(std::move(key), directory{}).first;
+		}
+
+		dir->second.insert(
+			!a_file.name().empty() ?
+				a_file :
+				directory::key_type{ a_file.hash(), fname, in },
+			std::move(f));
+
+		return std::as_const(dir->second)[a_file];
+	}
+
+	void lazy_archive::clear() noexcept
+	{
+		_cache.clear();
+		_records.clear();
+		_source = {};
+		_flags = archive_flag::none;
+		_types = archive_type::none;
+	}
+
+	auto lazy_archive::read(read_source a_source)
+		-> version
+	{
+		auto& in = a_source.stream();
+		const auto header = [&]() {
+			detail::header_t result;
+			in >> result;
+			return result;
+		}();
+
+		this->clear();
+		_flags = header.archive_flags();
+		_types = header.archive_types();
+
+		std::size_t files = detail::offsetof_file_entries(header);
+		in->seek_absolute(header.directories_offset());
+		_records.reserve(header.directory_count());
+		for (std::size_t i = 0; i < header.directory_count(); ++i) {
+			auto& record = _records.emplace_back();
+			record.hash.read(in, header.endian());
+
+			const auto [count] = in->read<std::uint32_t>();
+			record.count = count;
+
+			switch (header.archive_version()) {
+			case 103:
+			case 104:
+				in->seek_relative(4u);
+				break;
+			case 105:
+				in->seek_relative(4u * 3u);
+				break;
+			default:
+				detail::declare_unreachable();
+			}
+
+			if (header.directory_strings()) {
+				const detail::restore_point _{ in };
+				in->seek_absolute(files);
+				const auto [len] = in->read<std::uint8_t>();
+				record.name = files;
+				files += 1u + len;
+			}
+
+			record.files = files;
+			files += record.count * detail::constants::file_entry_size;
+		}
+
+		std::stable_sort(
+			_records.begin(),
+			_records.end(),
+			[](const record_t& a_lhs, const record_t& a_rhs) noexcept {
+				return a_lhs.hash < a_rhs.hash;
+			});
+		_source = detail::shared_source{ in };
+
+		return static_cast<version>(header.archive_version());
+	}
+
+	auto lazy_archive::read(
+		const std::filesystem::path& a_path,
+		const std::filesystem::path& a_cache)
+		-> version
+	{
+		detail::cache_info_t info;
+		if (auto records = detail::index_cache::load<detail::cache_info_t, record_t>(a_cache, a_path, info);
+			records) {
+			this->clear();
+			read_source source{ a_path };
+			_records = std::move(*records);
+			_source = detail::shared_source{ source.stream() };
+			_flags = static_cast<archive_flag>(info.flags);
+			_types = static_cast<archive_type>(info.types);
+			return static_cast<version>(info.version);
+		}
+
+		const auto result = this->read(read_source{ a_path });
+		detail::index_cache::store<detail::cache_info_t, record_t>(
+			a_cache,
+			a_path,
+			{ .version = detail::to_underlying(result),
+				.flags = detail::to_underlying(_flags),
+				.types = detail::to_underlying(_types) },
+			_records);
+		return result;
+	}
+
+	bool stream_writer::insert(
+		key_type a_directory,
+		directory::key_type a_file,
+		source_type a_source)
+	{
+		const std::pair hashes{ a_directory.hash(), a_file.hash() };
+		if (_sources.contains(hashes)) {
+			return false;
+		}
+
+		auto dir = _layout.find(a_directory);
+		if (dir == _layout.end()) {
+			dir = _layout.insert(std::move(a_directory), directory{}).first;
+		}
+		dir->second.insert(std::move(a_file), file{});
+		_sources.emplace(hashes, std::move(a_source));
+
+		return true;
+	}
+
+	bool stream_writer::insert(
+		key_type a_directory,
+		directory::key_type a_file,
+		std::filesystem::path a_path,
+		const file::read_params& a_params)
+	{
+		return this->insert(
+			std::move(a_directory),
+			std::move(a_file),
+			[path = std::move(a_path), a_params]() {
+				file f;
+				f.read(path, a_params);
+				return f;
+			});
+	}
+
+	void stream_writer::write(
+		write_sink a_sink,
+		version a_version) const
+	{
+		auto& out = a_sink.stream();
+
+		// the file entries are written with placeholder sizes/offsets, and then patched
+		//	as each file's data is written
+		const auto header = _layout.make_header(a_version);
+		out << header;
+
+		const auto intermediate = _layout.sort_for_write(header.xbox_archive());
+		_layout.write_directory_entries(intermediate, out, header);
+		_layout.write_file_entries(intermediate, out, header, {});
+		if (header.file_strings()) {
+			_layout.write_file_names(intermediate, out);
+		}
+
+		std::size_t entry = detail::offsetof_file_entries(header);
+		std::size_t offset = detail::offsetof_file_data(header);
+		for (const auto& elem : intermediate) {
+			const auto& [dkey, dir] = *elem.first;
+			const auto dirname = dkey.name();
+			const std::span dirbytes{
+				reinterpret_cast<const std::byte*>(dirname.data()),
+				dirname.size()
+			};
+
+			if (header.directory_strings()) {
+				entry += dirname.length() +
+				         1u +  // prefixed byte length
+				         1u;   // null terminator
+			}
+
+			for (const auto f : elem.second) {
+				const auto it = _sources.find({ dkey.hash(), f->first.hash() });
+				assert(it != _sources.end());
+				const auto data = it->second();
+
+				if (offset > (std::numeric_limits<std::uint32_t>::max)()) {
+					throw bsa::exception("file data exceeds the maximum archive size");
+				}
+
+				archive::write_file_data(dirbytes, f->first, data, out, header);
+				const auto fsize = archive::make_file_size(dkey, f->first, data, header);
+
+				out.seek_absolute(entry + 8u);  // skip hash
+				out.write(fsize, static_cast<std::uint32_t>(offset));
+				entry += detail::constants::file_entry_size;
+				offset += fsize & ~file::icompression;
+				out.seek_absolute(offset);
+			}
+		}
+	}
+}
+
+namespace bsa::async
+{
+	auto extract(
+		executor& a_executor,
+		const tes4::archive& a_archive,
+		const std::filesystem::path& a_root,
+		const tes4::file::write_params& a_params)
+		-> extraction
+	{
+		std::vector<extraction::job_t> jobs;
+		for (const auto& [dkey, dir] : a_archive) {
+			for (const auto& file : dir) {
+				jobs.push_back({
+					tes4::detail::make_extract_path(
+						a_root,
+						tes4::detail::make_path(dkey, file.first)),
+					[&dkey, &file, a_params](const std::filesystem::path& a_path) {
+						tes4::detail::extract_entry(a_path, dkey, file.first, file.second, a_params);
+					},
+				});
+			}
+		}
+
+		return { a_executor, std::move(jobs) };
+	}
 }
@@ -0,0 +1,245 @@
+#include "bsa/vfs.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace bsa::vfs
+{
+	namespace detail
+	{
+		namespace
+		{
+			template <class Entry>
+			[[nodiscard]] bool entry_less(const Entry& a_lhs, const Entry& a_rhs) noexcept
+			{
+				if (a_lhs.key != a_rhs.key) {
+					return a_lhs.key < a_rhs.key;
+				} else {
+					return a_lhs.archive > a_rhs.archive;
+				}
+			}
+		}
+	}
+
+	template <class Key, class File>
+	void overlay::index_t<Key, File>::insert(std::vector<entry_t> a_entries)
+	{
+		std::sort(a_entries.begin(), a_entries.end(), detail::entry_less<entry_t>);
+
+		// mounting merges the new entries in linear time, instead of resorting the whole index
+		const auto middle = static_cast<std::ptrdiff_t>(_entries.size());
+		_entries.insert(
+			_entries.end(),
+			std::make_move_iterator(a_entries.begin()),
+			std::make_move_iterator(a_entries.end()));
+		std::inplace_merge(
+			_entries.begin(),
+			_entries.begin() + middle,
+			_entries.end(),
+			detail::entry_less<entry_t>);
+	}
+
+	template <class Key, class File>
+	void overlay::index_t<Key, File>::erase(archive_id a_archive) noexcept
+	{
+		std::erase_if(_entries, [&](const entry_t& a_entry) noexcept {
+			return a_entry.archive == a_archive;
+		});
+	}
+
+	template <class Key, class File>
+	auto overlay::index_t<Key, File>::find(const Key& a_key) const noexcept
+		-> const entry_t*
+	{
+		const auto it = std::lower_bound(
+			_entries.begin(),
+			_entries.end(),
+			a_key,
+			[](const entry_t& a_entry, const Key& a_rhs) noexcept {
+				return a_entry.key < a_rhs;
+			});
+		return it != _entries.end() && it->key == a_key ? &*it : nullptr;
+	}
+
+	auto overlay::archive(archive_id a_archive) const noexcept
+		-> const mounted_archive*
+	{
+		const auto it = _archives.find(a_archive);
+		return it != _archives.end() ? &it->second : nullptr;
+	}
+
+	auto overlay::find(std::string_view a_path) const noexcept
+		-> std::optional<file_ref>
+	{
+		// lookups normalize once into a buffer on the stack, so they never allocate
+		std::array<char, bsa::detail::max_path> buffer;
+		const auto path = bsa::detail::normalize_path(a_path, buffer);
+
+		std::optional<file_ref> result;
+		const auto consider = [&](const auto* a_entry) noexcept {
+			if (a_entry && (!result || a_entry->archive > result->archive)) {
+				result = file_ref{ a_entry->archive, a_entry->file };
+			}
+		};
+
+		if (!_tes3.empty()) {
+			consider(_tes3.find(tes3::detail::hash_normalized(path)));
+		}
+
+		if (!_tes4.empty()) {
+			const auto pos = path.find_last_of('\\');
+			const auto parent = pos != std::string_view::npos ?
+			                        path.substr(0, pos) :
+			                        std::string_view{};
+			const auto filename = pos != std::string_view::npos ?
+			                          path.substr(pos + 1) :
+			                          path;
+			consider(_tes4.find({ tes4::hashing::hash_directory(parent),
+				tes4::hashing::hash_file(filename) }));
+		}
+
+		if (!_fo4.empty()) {
+			consider(_fo4.find(fo4::detail::hash_normalized(path)));
+		}
+
+		return result;
+	}
+
+	void overlay::clear() noexcept
+	{
+		_archives.clear();
+		_tes3.clear();
+		_tes4.clear();
+		_fo4.clear();
+	}
+
+	auto overlay::mount(std::filesystem::path a_path)
+		-> archive_id
+	{
+		const auto format = guess_file_format(a_path);
+		if (!format) {
+			throw bsa::exception("file is not a recognized archive format");
+		}
+
+		switch (*format) {
+		case file_format::tes3:
+			{
+				tes3::archive bsa;
+				bsa.read(std::move(a_path));
+				return this->mount(std::move(bsa));
+			}
+		case file_format::tes4:
+			{
+				tes4::archive bsa;
+				const auto version = bsa.read(std::move(a_path));
+				return this->mount(std::move(bsa), version);
+			}
+		case file_format::fo4:
+			{
+				fo4::archive ba2;
+				const auto meta = ba2.read(std::move(a_path));
+				return this->mount(std::move(ba2), meta);
+			}
+		default:
+			throw bsa::exception("file is not a recognized archive format");
+		}
+	}
+
+	auto overlay::mount(tes3::archive a_archive)
+		-> archive_id
+	{
+		return this->do_mount({ .archive = std::move(a_archive) });
+	}
+
+	auto overlay::mount(
+		tes4::archive a_archive,
+		tes4::version a_version)
+		-> archive_id
+	{
+		return this->do_mount({ .archive = std::move(a_archive), .tes4_version = a_version });
+	}
+
+	auto overlay::mount(
+		fo4::archive a_archive,
+		const fo4::archive::meta_info& a_meta)
+		-> archive_id
+	{
+		return this->do_mount({ .archive = std::move(a_archive), .fo4_meta = a_meta });
+	}
+
+	bool overlay::unmount(archive_id a_archive) noexcept
+	{
+		const auto it = _archives.find(a_archive);
+		if (it == _archives.end()) {
+			return false;
+		}
+
+		switch (it->second.archive.index()) {
+		case 0:
+			_tes3.erase(a_archive);
+			break;
+		case 1:
+			_tes4.erase(a_archive);
+			break;
+		case 2:
+			_fo4.erase(a_archive);
+			break;
+		default:
+			break;
+		}
+
+		_archives.erase(it);
+		return true;
+	}
+
+	auto overlay::do_mount(mounted_archive a_archive)
+		-> archive_id
+	{
+		const auto id = _next++;
+		const auto it = _archives.emplace(id, std::move(a_archive)).first;
+
+		try {
+			std::visit(
+				[&](const auto& a_bsa) {
+					using archive_t = std::remove_cvref_t<decltype(a_bsa)>;
+					if constexpr (std::is_same_v<archive_t, tes3::archive>) {
+						std::vector<tes3_index::entry_t> entries;
+						entries.reserve(a_bsa.size());
+						for (const auto& [key, file] : a_bsa) {
+							entries.push_back({ key.hash(), id, &file });
+						}
+						_tes3.insert(std::move(entries));
+					} else if constexpr (std::is_same_v<archive_t, tes4::archive>) {
+						std::vector<tes4_index::entry_t> entries;
+						for (const auto& [dkey, dir] : a_bsa) {
+							for (const auto& [fkey, file] : dir) {
+								entries.push_back({ { dkey.hash(), fkey.hash() }, id, &file });
+							}
+						}
+						_tes4.insert(std::move(entries));
+					} else {
+						std::vector<fo4_index::entry_t> entries;
+						entries.reserve(a_bsa.size());
+						for (const auto& [key, file] : a_bsa) {
+							entries.push_back({ key.hash(), id, &file });
+						}
+						_fo4.insert(std::move(entries));
+					}
+				},
+				it->second.archive);
+		} catch (...) {
+			_archives.erase(it);
+			throw;
+		}
+
+		return id;
+	}
+}
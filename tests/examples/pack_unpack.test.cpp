@@ -160,6 +160,29 @@ TEST_CASE("pack_unpack", "[examples]")
 			invokeMain("unpack", filename.c_str(), outdir.c_str());
 			checkUnpack(datadir, outdir);
 		}
+
+		SECTION("packing with a fixed number of jobs")
+		{
+			const auto format = [&]() {
+				std::string result;
+				result += '-';
+				result += a_format;
+				return result;
+			}();
+
+			std::filesystem::remove(filename);
+			invokeMain("pack", datadir.c_str(), filename.c_str(), format.c_str(), "-j", "3");
+			a_verifyPack(filename);
+		}
+
+		SECTION("unpacking with a fixed number of jobs")
+		{
+			auto outdir = root / a_format;
+			outdir += "_jobs"sv;
+			std::filesystem::remove_all(outdir);
+			invokeMain("unpack", filename.c_str(), outdir.string().c_str(), "-j", "3");
+			checkUnpack(datadir, outdir);
+		}
 	};
 
 	SECTION("tes3")
@@ -252,6 +275,12 @@ TEST_CASE("pack_unpack", "[examples]")
 		REQUIRE_THROWS_WITH(
 			invokeMain("pack", "foo", "bar", "-tes4", "baz"),
 			make_substr_matcher("too many"sv));
+		REQUIRE_THROWS_WITH(
+			invokeMain("pack", "foo", "bar", "-tes4", "-j"),
+			make_substr_matcher("too many"sv));
+		REQUIRE_THROWS_WITH(
+			invokeMain("unpack", "foo", "bar", "-j", "many"),
+			make_substr_matcher("invalid job count"sv));
 		REQUIRE_THROWS_WITH(
 			invokeMain("foo", "bar", "baz"),
 			make_substr_matcher("unrecognized operation"sv));
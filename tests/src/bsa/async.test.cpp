@@ -0,0 +1,210 @@
+#include "utility.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "catch2.hpp"
+
+#include "bsa/async.hpp"
+
+namespace
+{
+	// runs every piece of work on a single thread, like the loop of an io service
+	class loop_executor final :
+		public bsa::async::executor
+	{
+	public:
+		loop_executor() :
+			_thread([this]() { this->run(); })
+		{}
+
+		~loop_executor() noexcept
+		{
+			{
+				const std::lock_guard l{ _lock };
+				_stopped = true;
+			}
+			_wake.notify_one();
+			_thread.join();
+		}
+
+		void post(work_type a_work) override
+		{
+			{
+				const std::lock_guard l{ _lock };
+				_queue.push_back(std::move(a_work));
+				++_posted;
+			}
+			_wake.notify_one();
+		}
+
+		[[nodiscard]] bool on_loop() const noexcept { return std::this_thread::get_id() == _thread.get_id(); }
+		[[nodiscard]] std::size_t posted() const noexcept
+		{
+			const std::lock_guard l{ _lock };
+			return _posted;
+		}
+
+	private:
+		void run()
+		{
+			for (;;) {
+				work_type work;
+				{
+					std::unique_lock l{ _lock };
+					_wake.wait(l, [&]() { return _stopped || !_queue.empty(); });
+					if (_queue.empty()) {
+						return;
+					}
+					work = std::move(_queue.front());
+					_queue.pop_front();
+				}
+				work();
+			}
+		}
+
+		mutable std::mutex _lock;
+		std::condition_variable _wake;
+		std::deque<work_type> _queue;
+		std::size_t _posted{ 0 };
+		bool _stopped{ false };
+		std::thread _thread;
+	};
+
+	// an eagerly started coroutine, whose completion can be waited on from outside
+	struct task final
+	{
+		struct promise_type final
+		{
+			std::promise<void> done;
+
+			task get_return_object() { return { done.get_future() }; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() { done.set_value(); }
+			void unhandled_exception() { done.set_exception(std::current_exception()); }
+		};
+
+		void get() { result.get(); }
+
+		std::future<void> result;
+	};
+}
+
+TEST_CASE("bsa::async", "[src][async]")
+{
+	loop_executor executor;
+
+	SECTION("archives can be read and decompressed on an executor")
+	{
+		const std::filesystem::path root{ "tes4_compression_test"sv };
+
+		bsa::tes4::archive expected;
+		const auto expected_version = expected.read(root / "test_104.bsa"sv);
+
+		bsa::tes4::archive bsa;
+		const auto run = [&]() -> task {
+			const auto version = co_await bsa::async::read(executor, bsa, root / "test_104.bsa"sv);
+			REQUIRE(executor.on_loop());
+			REQUIRE(version == expected_version);
+
+			for (const auto& [dkey, dir] : bsa) {
+				for (const auto& [fkey, file] : dir) {
+					REQUIRE(file.compressed());
+					std::vector<std::byte> out(file.decompressed_size());
+					co_await bsa::async::decompress_into(
+						executor,
+						file,
+						out,
+						bsa::tes4::file::compression_params{ .version_ = version });
+					REQUIRE(executor.on_loop());
+
+					auto original = *expected[dkey.name()][fkey.name()];
+					original.decompress({ .version_ = version });
+					assert_byte_equality(std::span{ out.data(), out.size() }, original.as_bytes());
+				}
+			}
+		};
+		run().get();
+		REQUIRE(executor.posted() > 1);
+	}
+
+	SECTION("exceptions are rethrown to the awaiting coroutine")
+	{
+		bsa::tes4::file f;
+		f.set_data(std::vector<std::byte>(16, std::byte{ 0xFF }), 64);
+		std::vector<std::byte> out(f.decompressed_size());
+		const auto run = [&]() -> task {
+			REQUIRE_THROWS_AS(
+				co_await bsa::async::decompress_into(
+					executor,
+					f,
+					out,
+					bsa::tes4::file::compression_params{ .version_ = bsa::tes4::version::sse }),
+				bsa::compression_error);
+			REQUIRE(executor.on_loop());
+		};
+		run().get();
+	}
+
+	SECTION("archives can be extracted one file at a time")
+	{
+		const std::filesystem::path root{ "fo4_compression_test"sv };
+		const std::filesystem::path out{ "async_extract_test_out"sv };
+		std::filesystem::remove_all(out);
+
+		bsa::fo4::archive ba2;
+		const auto meta = ba2.read(root / "normal.ba2"sv);
+		auto files = bsa::async::extract(
+			executor,
+			ba2,
+			out,
+			{ .format_ = meta.format_, .compression_format_ = meta.compression_format_ });
+		REQUIRE(files.remaining() == ba2.size());
+		REQUIRE(!std::filesystem::exists(out));
+
+		std::size_t extracted = 0;
+		const auto run = [&]() -> task {
+			while (const auto path = co_await files.next()) {
+				REQUIRE(executor.on_loop());
+				REQUIRE(std::filesystem::exists(*path));
+				++extracted;
+			}
+		};
+		run().get();
+		REQUIRE(files.done());
+		REQUIRE(extracted == ba2.size());
+
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(root / "data"sv)) {
+			if (entry.is_regular_file()) {
+				const auto p = std::filesystem::relative(entry.path(), root / "data"sv);
+				const auto original = map_file(entry.path());
+				const auto disk = map_file(out / p);
+				assert_byte_equality(
+					std::span{ disk.data(), disk.size() },
+					std::span{ original.data(), original.size() });
+			}
+		}
+
+		bsa::tes4::file f;
+		const std::array payload{ std::byte{ 1 } };
+		f.set_data(std::span{ payload });
+		bsa::tes4::directory d;
+		REQUIRE(d.insert("evil.txt"sv, std::move(f)).second);
+		bsa::tes4::archive evil;
+		REQUIRE(evil.insert("..\\.."sv, std::move(d)).second);
+		REQUIRE_THROWS_AS(bsa::async::extract(executor, evil, out, {}), bsa::exception);
+	}
+}
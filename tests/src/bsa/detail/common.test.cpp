@@ -1,14 +1,37 @@
 #include "utility.hpp"
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <string>
 #include <system_error>
 #include <utility>
+#include <vector>
 
 #include "catch2.hpp"
 
 #include "bsa/detail/common.hpp"
 
+namespace
+{
+	// the master copies were written by the official tools, which compress with zlib, so every
+	//	test starts on the reference backend, regardless of which backend the build defaults to
+	class reference_deflate_listener final :
+		public Catch::EventListenerBase
+	{
+	public:
+		using Catch::EventListenerBase::EventListenerBase;
+
+		void testCasePartialStarting(const Catch::TestCaseInfo&, std::uint64_t) override
+		{
+			bsa::set_deflate_backend(bsa::deflate_backend::zlib);
+		}
+	};
+}
+
+CATCH_REGISTER_LISTENER(reference_deflate_listener)
+
 TEST_CASE("bsa::functional", "[src][common]")
 {
 	SECTION("guess_file_format")
@@ -42,4 +65,106 @@ TEST_CASE("bsa::functional", "[src][common]")
 		REQUIRE(bsa::make_four_cc("ABCD"sv) == 0x44434241);
 		REQUIRE(bsa::make_four_cc("ABCDE"sv) == 0x44434241);
 	}
+
+	SECTION("normalize_path")
+	{
+		const auto reference = [](std::string a_path) {
+			for (auto& c : a_path) {
+				if ('A' <= c && c <= 'Z') {
+					c = static_cast<char>(c - 'A' + 'a');
+				} else if (c == '/') {
+					c = '\\';
+				}
+			}
+			while (!a_path.empty() && a_path.back() == '\\') {
+				a_path.pop_back();
+			}
+			while (!a_path.empty() && a_path.front() == '\\') {
+				a_path.erase(a_path.begin());
+			}
+			return a_path.empty() || a_path.size() >= 260 ? "."s : a_path;
+		};
+
+		// exercise every byte value in every lane, across the vectorized and scalar paths
+		std::string all;
+		for (std::size_t i = 0; i < 256; ++i) {
+			all += static_cast<char>(i);
+		}
+		for (std::size_t len = 0; len <= all.size(); ++len) {
+			for (const std::size_t offset : { 0u, 7u, 15u }) {
+				auto path = std::string(offset, '/') + all.substr(0, len);
+				const auto expected = reference(path);
+				bsa::detail::normalize_path(path);
+				REQUIRE(path == expected);
+			}
+		}
+
+		std::string path = "//Textures/ARMOR/"s;
+		bsa::detail::normalize_path(path);
+		REQUIRE(path == "textures\\armor"sv);
+	}
+}
+
+TEST_CASE("bsa::content_cache", "[src][common]")
+{
+	const auto bytes = [](std::size_t a_size, std::byte a_fill) {
+		return std::vector<std::byte>(a_size, a_fill);
+	};
+	const auto key = [](std::uint64_t a_lo) {
+		return bsa::content_cache::key_type{ .lo = a_lo };
+	};
+
+	SECTION("contents are shared, and evicted least recently used first")
+	{
+		bsa::content_cache cache{ 300, 1 };
+		REQUIRE(cache.budget() == 300);
+		REQUIRE(cache.find(key(0)) == nullptr);
+
+		const auto first = cache.insert(key(0), bytes(100, std::byte{ 0 }));
+		REQUIRE(cache.find(key(0)) == first);
+		REQUIRE(cache.insert(key(0), bytes(100, std::byte{ 1 })) == first);
+		REQUIRE(cache.insert(key(1), bytes(100, std::byte{ 1 })));
+		REQUIRE(cache.insert(key(2), bytes(100, std::byte{ 2 })));
+		REQUIRE(cache.size() == 300);
+
+		// 0 was used more recently than 1
+		REQUIRE(cache.find(key(0)));
+		REQUIRE(cache.insert(key(3), bytes(100, std::byte{ 3 })));
+		REQUIRE(cache.find(key(1)) == nullptr);
+		REQUIRE(cache.find(key(0)) == first);
+		REQUIRE(cache.size() == 300);
+
+		// contents too large to cache are still handed out
+		const auto large = cache.insert(key(4), bytes(301, std::byte{ 4 }));
+		REQUIRE(large);
+		REQUIRE(large->size() == 301);
+		REQUIRE(cache.find(key(4)) == nullptr);
+
+		cache.clear();
+		REQUIRE(cache.size() == 0);
+		REQUIRE(first->size() == 100);
+		REQUIRE((*first)[0] == std::byte{ 0 });
+
+		const auto stats = cache.stats();
+		REQUIRE(stats.hits == 3);
+		REQUIRE(stats.misses == 3);
+		REQUIRE(stats.evictions == 1);
+	}
+
+	SECTION("contents are only loaded on a miss")
+	{
+		bsa::content_cache cache{ 1u << 20 };
+		std::size_t loads = 0;
+		const auto load = [&]() {
+			++loads;
+			return bytes(16, std::byte{ 42 });
+		};
+
+		const auto first = cache.get_or_load(key(7), load);
+		const auto second = cache.get_or_load(key(7), load);
+		REQUIRE(loads == 1);
+		REQUIRE(first == second);
+		REQUIRE(cache.get_or_load({ .archive = &cache, .lo = 7 }, load) != first);
+		REQUIRE(loads == 2);
+	}
 }
@@ -1,15 +1,23 @@
 #include "utility.hpp"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <filesystem>
+#include <iterator>
+#include <memory_resource>
+#include <optional>
 #include <span>
 #include <sstream>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include <DirectXTex.h>
 
@@ -201,6 +209,33 @@ TEST_CASE("bsa::fo4::hashing", "[src][fo4][hashing]")
 		REQUIRE(h(R"(Textures\Terrain\SanctuaryHillsWorld\SanctuaryHillsWorld.4.76.-24.DDS)"sv) == hash_t{ 0x71560B31, 0x00736464, 0x49AAA5E1 });
 		REQUIRE(h(R"(Sound\Voice\Fallout4.esm\NPCMTravisMiles\000A6032_1.fuz)"sv) == hash_t{ 0x34402DE0, 0x007A7566, 0xF186D761 });
 	}
+
+	SECTION("hashing paths in bulk is equivalent to hashing each path")
+	{
+		const std::array paths{
+			"meshes/c/artifact_bloodring_01.nif"sv,
+			"Textures\\Architecture\\Windhelm\\WHWall01.dds"sv,
+			"sound/voice/skyrim.esm/maleuniquedbguardian/dbguardian_00027fa2_1.fuz"sv,
+			"a.kf"sv,
+			""sv,
+		};
+
+		const auto hashes = bsa::fo4::hashing::hash_file_many(paths);
+		REQUIRE(hashes.size() == paths.size());
+		for (std::size_t i = 0; i < paths.size(); ++i) {
+			REQUIRE(hashes[i] == bsa::fo4::hashing::hash_file(paths[i]));
+		}
+	}
+
+	SECTION("hashes can be computed at compile time")
+	{
+		using hash_t = bsa::fo4::hashing::hash;
+		constexpr auto h = bsa::fo4::hashing::hash_file(
+			R"(/Textures/CreationClub/BGSFO4016/Clothes/Prey/Morgan_Male_Body_s.DDS)"sv);
+		static_assert(h == hash_t{ 0x9C672F34, 0x00736464, 0x1D5F0EDF });
+		REQUIRE(h == bsa::fo4::hashing::hash_file(
+						 R"(Textures\CreationClub\BGSFO4016\Clothes\Prey\Morgan_Male_Body_s.DDS)"s));
+	}
 }
 
 TEST_CASE("bsa::fo4::chunk", "[src][fo4][vfs]")
@@ -214,6 +249,124 @@ TEST_CASE("bsa::fo4::chunk", "[src][fo4][vfs]")
 		REQUIRE(chunk.mips.first == 0);
 		REQUIRE(chunk.mips.last == 0);
 	}
+
+	SECTION("chunks can be decompressed incrementally")
+	{
+		// long enough, and repetitive enough, to reach back across the whole lz4 window
+		std::vector<std::byte> payload;
+		for (std::uint32_t i = 0; payload.size() < (1u << 18); ++i) {
+			const auto word = std::to_string(i % 7919 * 31) + (i % 3 == 0 ? "\r\n"s : " "s);
+			for (const auto c : word) {
+				payload.push_back(static_cast<std::byte>(c));
+			}
+		}
+
+		const auto test = [&](const bsa::fo4::chunk& a_chunk, bsa::fo4::compression_format a_format) {
+			auto stream = a_chunk.open_stream(a_format);
+			REQUIRE(stream.size() == payload.size());
+
+			std::vector<std::byte> streamed(payload.size());
+			stream.read_bytes(std::span{ streamed }.first(10));
+			stream.seek_relative(1000);
+			REQUIRE(stream.tell() == 1010);
+			REQUIRE_THROWS_AS(stream.seek_absolute(0), bsa::exception);
+			for (auto out = std::span{ streamed }.subspan(1010); !out.empty();) {
+				const auto size = stream.read_some(out.first((std::min<std::size_t>)(out.size(), 4099)));
+				REQUIRE(size > 0);
+				out = out.subspan(size);
+			}
+
+			REQUIRE(stream.eof());
+			REQUIRE(stream.read_some(streamed) == 0);
+			REQUIRE_THROWS_AS(stream.read_bytes(std::span{ streamed }.first(1)), binary_io::buffer_exhausted);
+			assert_byte_equality(std::span{ streamed }.first(10), std::span{ payload }.first(10));
+			assert_byte_equality(std::span{ streamed }.subspan(1010), std::span{ payload }.subspan(1010));
+		};
+
+		for (const auto format : { bsa::fo4::compression_format::zip, bsa::fo4::compression_format::lz4 }) {
+			bsa::fo4::chunk chunk;
+			chunk.set_data(std::span{ payload });
+			test(chunk, format);
+			chunk.compress({ .compression_format_ = format });
+			REQUIRE(chunk.compressed());
+			test(chunk, format);
+		}
+	}
+
+	SECTION("compression policies can skip data which will not shrink")
+	{
+		const auto noise = make_noise(1u << 18);
+
+		for (const auto format : { bsa::fo4::compression_format::zip, bsa::fo4::compression_format::lz4 }) {
+			bsa::fo4::chunk chunk;
+			chunk.set_data(std::span{ noise });
+			chunk.compress({ .compression_format_ = format, .compression_policy_ = { .max_entropy = 7.9 } });
+			REQUIRE(!chunk.compressed());
+			chunk.compress({ .compression_format_ = format, .compression_policy_ = { .max_ratio = 0.95 } });
+			REQUIRE(!chunk.compressed());
+			chunk.compress({ .compression_format_ = format });
+			REQUIRE(chunk.compressed());
+		}
+
+		// the policy is applied to each chunk of a texture on its own
+		bsa::fo4::file f;
+		f.read(
+			std::filesystem::path{ "fo4_dds_test/Fence006_1K_Roughness.dds"sv },
+			{
+				.format_ = bsa::fo4::format::directx,
+				.compression_type_ = bsa::compression_type::compressed,
+				.compression_policy_ = { .max_ratio = 0.0 },
+			});
+		REQUIRE(f.size() == 3);
+		for (const auto& chunk : f) {
+			REQUIRE(!chunk.compressed());
+		}
+	}
+
+	SECTION("codec contexts can be reused across chunks")
+	{
+		std::vector<std::byte> payload(1u << 16);
+		for (std::size_t i = 0; i < payload.size(); ++i) {
+			payload[i] = static_cast<std::byte>((i * i) >> 9);
+		}
+
+		const std::array params{
+			bsa::fo4::chunk::compression_params{ .compression_level_ = bsa::fo4::compression_level::fo4 },
+			bsa::fo4::chunk::compression_params{ .compression_level_ = bsa::fo4::compression_level::fo4 },
+			bsa::fo4::chunk::compression_params{ .compression_level_ = bsa::fo4::compression_level::fo4_xbox },
+			bsa::fo4::chunk::compression_params{ .compression_format_ = bsa::fo4::compression_format::lz4 },
+			bsa::fo4::chunk::compression_params{ .compression_level_ = bsa::fo4::compression_level::sf },
+			bsa::fo4::chunk::compression_params{ .compression_format_ = bsa::fo4::compression_format::lz4 },
+		};
+
+		const auto test = [&](bsa::codec_context& a_context) {
+			for (const auto& param : params) {
+				bsa::fo4::chunk chunk;
+				chunk.set_data(std::span{ payload });
+				std::vector<std::byte> expected(chunk.compress_bound(param.compression_format_));
+				expected.resize(chunk.compress_into(std::span{ expected }, param));
+
+				// reusing a context must produce exactly what a fresh one does
+				std::vector<std::byte> out(chunk.compress_bound(param.compression_format_));
+				out.resize(chunk.compress_into(std::span{ out }, param, a_context));
+				assert_byte_equality(std::span{ out }, std::span{ expected });
+
+				chunk.set_data(std::move(out), payload.size());
+				std::vector<std::byte> decompressed(payload.size());
+				chunk.decompress_into(std::span{ decompressed }, param.compression_format_, a_context);
+				assert_byte_equality(std::span{ decompressed }, std::span{ payload });
+			}
+		};
+
+		bsa::codec_context context;
+		test(context);
+		test(context);
+		context.clear();
+		test(context);
+
+		bsa::codec_context moved{ std::move(context) };
+		test(moved);
+	}
 }
 
 TEST_CASE("bsa::fo4::file", "[src][fo4][vfs]")
@@ -374,6 +527,131 @@ TEST_CASE("bsa::fo4::archive", "[src][fo4][archive]")
 		test(false);
 	}
 
+	SECTION("archives can share the data of identical chunks")
+	{
+		const std::filesystem::path root{ "fo4_dds_test"sv };
+
+		bsa::fo4::archive original;
+		const auto meta = original.read(root / "in.ba2"sv);
+		REQUIRE(!original.empty());
+
+		bsa::fo4::archive ba2;
+		std::size_t dataSize = 0;
+		for (const auto& [key, file] : original) {
+			for (const auto& chunk : file) {
+				dataSize += chunk.size();
+			}
+			REQUIRE(ba2.insert(key, file).second);
+			REQUIRE(ba2.insert("copy/"s + std::string(key.name()), file).second);
+		}
+
+		const auto write = [&](bool a_deduplicate) {
+			binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+			ba2.write(os, meta, { .deduplicate = a_deduplicate });
+			return std::move(os.get<binary_io::memory_ostream>().rdbuf());
+		};
+
+		const auto full = write(false);
+		const auto shared = write(true);
+		REQUIRE(full.size() - shared.size() == dataSize);
+
+		bsa::fo4::archive in;
+		const auto inMeta = in.read({ shared });
+		REQUIRE(inMeta.strings == meta.strings);
+		REQUIRE(in.size() == ba2.size());
+		for (const auto& [key, file] : ba2) {
+			const auto read = in[key.name()];
+			REQUIRE(read);
+			REQUIRE(read->size() == file.size());
+			for (std::size_t i = 0; i < file.size(); ++i) {
+				assert_byte_equality((*read)[i].as_bytes(), file[i].as_bytes());
+			}
+		}
+	}
+
+	SECTION("mapped writes are identical to streamed writes")
+	{
+		const std::array archives{
+			std::filesystem::path{ "fo4_compression_test/normal.ba2"sv },
+			std::filesystem::path{ "fo4_dds_test/in.ba2"sv },
+			std::filesystem::path{ "fo4_missing_string_table_test/in.ba2"sv },
+		};
+		const std::filesystem::path out{ "fo4_mapped_write_test_out.ba2"sv };
+
+		for (const auto& path : archives) {
+			bsa::fo4::archive ba2;
+			auto meta = ba2.read(path);
+			for (const bool strings : { false, true }) {
+				meta.strings = strings;
+				for (const bool deduplicate : { false, true }) {
+					binary_io::any_ostream expected{ std::in_place_type<binary_io::memory_ostream> };
+					ba2.write(expected, meta, { .deduplicate = deduplicate });
+
+					for (const std::size_t threads : { 1u, 4u }) {
+						ba2.write_mapped(out, meta, { .deduplicate = deduplicate }, threads);
+						const auto written = map_file(out);
+						assert_byte_equality(
+							std::span{ written.data(), written.size() },
+							expected.get<binary_io::memory_ostream>().rdbuf());
+					}
+				}
+			}
+		}
+	}
+
+	SECTION("file data can be laid out in the order it will be accessed")
+	{
+		bsa::fo4::archive ba2;
+		auto meta = ba2.read(std::filesystem::path{ "fo4_compression_test/normal.ba2"sv });
+		meta.strings = true;
+
+		// access the files in the reverse of their record order
+		std::vector<bsa::fo4::archive::key_type> order;
+		for ([[maybe_unused]] const auto& [key, file] : ba2) {
+			order.push_back(key);
+		}
+		std::reverse(order.begin(), order.end());
+		REQUIRE(order.size() > 1);
+		order.emplace_back("missing/file.txt"sv);
+		order.push_back(order.front());
+
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		ba2.write(os, meta, { .data_order = order });
+		const auto& written = os.get<binary_io::memory_ostream>().rdbuf();
+
+		const std::filesystem::path out{ "fo4_data_order_test_out.ba2"sv };
+		ba2.write_mapped(out, meta, { .data_order = order }, 4);
+		const auto mapped = map_file(out);
+		assert_byte_equality(std::span{ mapped.data(), mapped.size() }, written);
+
+		std::size_t last = 0;
+		for (const auto& key : std::span{ order }.first(order.size() - 2)) {
+			const auto file = ba2[key.hash()];
+			REQUIRE(file);
+			for (const auto& chunk : *file) {
+				const auto data = chunk.as_bytes();
+				const auto pos = static_cast<std::size_t>(
+					std::search(written.begin(), written.end(), data.begin(), data.end()) -
+					written.begin());
+				REQUIRE(pos < written.size());
+				REQUIRE(pos > last);
+				last = pos;
+			}
+		}
+
+		bsa::fo4::archive in;
+		in.read({ written });
+		REQUIRE(in.size() == ba2.size());
+		for (const auto& [key, file] : ba2) {
+			const auto other = in[key.hash()];
+			REQUIRE(other);
+			REQUIRE(other->size() == file.size());
+			for (std::size_t i = 0; i < file.size(); ++i) {
+				assert_byte_equality((*other)[i].as_bytes(), file[i].as_bytes());
+			}
+		}
+	}
+
 	SECTION("archives will bail on malformed inputs")
 	{
 		const std::filesystem::path root{ "fo4_invalid_test"sv };
@@ -396,6 +674,63 @@ TEST_CASE("bsa::fo4::archive", "[src][fo4][archive]")
 			REQUIRE_THROWS_WITH(
 				ba2.read(root / filename),
 				make_substr_matcher(type));
+			REQUIRE_THROWS_WITH(
+				ba2.read(root / filename, 4),
+				make_substr_matcher(type));
+		}
+	}
+
+	SECTION("reading records across threads is equivalent to reading them serially")
+	{
+		const std::array paths{
+			std::filesystem::path{ "fo4_compression_test/normal.ba2"sv },
+			std::filesystem::path{ "fo4_cubemap_test/in.ba2"sv },
+			std::filesystem::path{ "fo4_chunk_test/in.ba2"sv },
+			std::filesystem::path{ "fo4_missing_string_table_test/in.ba2"sv },
+			std::filesystem::path{ "fo4_next_gen_test/dx10_v8.ba2"sv },
+			std::filesystem::path{ "fo4_next_gen_test/gnrl_v7.ba2"sv },
+		};
+
+		for (const auto& path : paths) {
+			bsa::fo4::archive expected;
+			const auto expectedMeta = expected.read(path);
+
+			for (const std::size_t threads : { 1u, 3u, 0u }) {
+				bsa::fo4::archive ba2;
+				const auto meta = ba2.read(path, threads);
+				REQUIRE(meta.format_ == expectedMeta.format_);
+				REQUIRE(meta.compression_format_ == expectedMeta.compression_format_);
+				REQUIRE(ba2.size() == expected.size());
+
+				for (auto lhs = ba2.begin(), rhs = expected.begin(); rhs != expected.end(); ++lhs, ++rhs) {
+					REQUIRE(lhs->first == rhs->first);
+					REQUIRE(lhs->first.name() == rhs->first.name());
+					REQUIRE(lhs->second.header == rhs->second.header);
+					REQUIRE(lhs->second.size() == rhs->second.size());
+					for (std::size_t i = 0; i < rhs->second.size(); ++i) {
+						const auto& l = lhs->second[i];
+						const auto& r = rhs->second[i];
+						REQUIRE(l.compressed() == r.compressed());
+						REQUIRE(l.mips == r.mips);
+						assert_byte_equality(l.as_bytes(), r.as_bytes());
+					}
+				}
+			}
+		}
+	}
+
+	SECTION("files decoded across threads are moved into the resource of the archive")
+	{
+		counting_resource arena;
+		const bsa::memory_scope scope{ arena };
+
+		bsa::fo4::archive ba2;
+		ba2.read(std::filesystem::path{ "fo4_chunk_test/in.ba2"sv }, 4);
+		REQUIRE(!ba2.empty());
+		REQUIRE(!arena.used_across_threads());
+		REQUIRE(ba2.get_allocator().resource() == &arena);
+		for (const auto& [key, file] : ba2) {
+			REQUIRE(file.get_allocator().resource() == &arena);
 		}
 	}
 
@@ -465,6 +800,427 @@ TEST_CASE("bsa::fo4::archive", "[src][fo4][archive]")
 		}
 	}
 
+	SECTION("compressing an archive in bulk is equivalent to compressing each chunk")
+	{
+		const std::filesystem::path root{ "fo4_compression_test"sv };
+		const std::array archives{
+			std::make_pair("normal.ba2"sv, bsa::fo4::compression_level::fo4),
+			std::make_pair("xbox.ba2"sv, bsa::fo4::compression_level::fo4_xbox),
+		};
+
+		for (const auto& [archive, compression] : archives) {
+			bsa::fo4::archive serial;
+			const auto meta = serial.read(root / archive);
+			for (auto& file : serial) {
+				for (auto& chunk : file.second) {
+					chunk.decompress(meta.compression_format_);
+				}
+			}
+
+			auto bulk = serial;
+			for (auto& file : serial) {
+				for (auto& chunk : file.second) {
+					chunk.compress({ .compression_level_ = compression });
+				}
+			}
+			bulk.compress_all({ .compression_level_ = compression }, 4);
+
+			for (const auto& file : serial) {
+				const auto other = bulk[file.first];
+				REQUIRE(other);
+				REQUIRE(other->size() == file.second.size());
+				for (std::size_t i = 0; i < other->size(); ++i) {
+					const auto& lhs = (*other)[i];
+					const auto& rhs = file.second[i];
+					REQUIRE(lhs.compressed());
+					REQUIRE(lhs.decompressed_size() == rhs.decompressed_size());
+					assert_byte_equality(lhs.as_bytes(), rhs.as_bytes());
+				}
+			}
+		}
+	}
+
+	SECTION("transcoding only recompresses chunks whose format changes")
+	{
+		bsa::fo4::archive original;
+		const auto meta = original.read(std::filesystem::path{ "fo4_compression_test/normal.ba2"sv });
+
+		std::size_t chunks = 0;
+		for (const auto& file : original) {
+			chunks += file.second.size();
+		}
+
+		// the level only changes how the data is encoded, not whether it can be decoded
+		auto zip = original;
+		const auto kept = zip.transcode(
+			meta.compression_format_,
+			{ .compression_level_ = bsa::fo4::compression_level::fo4_xbox },
+			4);
+		REQUIRE(kept.passed_through == chunks);
+		REQUIRE(kept.transcoded == 0);
+
+		auto lz4 = original;
+		const auto report = lz4.transcode(
+			meta.compression_format_,
+			{ .compression_format_ = bsa::fo4::compression_format::lz4 },
+			4);
+		REQUIRE(report.passed_through == 0);
+		REQUIRE(report.transcoded == chunks);
+
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		lz4.write(os, { .version_ = bsa::fo4::version::v3, .compression_format_ = bsa::fo4::compression_format::lz4 });
+		bsa::fo4::archive in;
+		const auto inMeta = in.read({ os.get<binary_io::memory_ostream>().rdbuf() });
+		REQUIRE(inMeta.compression_format_ == bsa::fo4::compression_format::lz4);
+		for (const auto& [key, file] : original) {
+			const auto other = in[key.hash()];
+			REQUIRE(other);
+			REQUIRE(other->size() == file.size());
+			for (std::size_t i = 0; i < file.size(); ++i) {
+				auto lhs = (*other)[i];
+				lhs.decompress(inMeta.compression_format_);
+				auto rhs = file[i];
+				rhs.decompress(meta.compression_format_);
+				assert_byte_equality(lhs.as_bytes(), rhs.as_bytes());
+			}
+		}
+	}
+
+	SECTION("we can verify the integrity of an archive")
+	{
+		const std::filesystem::path root{ "fo4_compression_test"sv };
+		bsa::fo4::archive ba2;
+		const auto meta = ba2.read(root / "normal.ba2"sv);
+
+		std::size_t chunks = 0;
+		std::uint64_t bytes = 0;
+		for (const auto& file : ba2) {
+			for (const auto& chunk : file.second) {
+				++chunks;
+				bytes += chunk.decompressed_size();
+			}
+		}
+
+		for (const std::size_t threads : { 1u, 4u }) {
+			const auto report = ba2.verify(meta.compression_format_, threads);
+			REQUIRE(report.ok());
+			REQUIRE(report.entries == chunks);
+			REQUIRE(report.bytes == bytes);
+		}
+
+		// claim a chunk is larger than it is
+		auto& [key, file] = *ba2.begin();
+		auto& chunk = file.front();
+		const auto data = chunk.as_bytes();
+		chunk.set_data(std::vector(data.begin(), data.end()), chunk.decompressed_size() + 1);
+
+		const auto report = ba2.verify(meta.compression_format_, 4);
+		REQUIRE(!report.ok());
+		REQUIRE(report.offsets);
+		REQUIRE(report.entries == chunks);
+		REQUIRE(report.failures.size() == 1);
+		REQUIRE(report.failures[0].path == key.name());
+		REQUIRE(report.failures[0].what.starts_with("chunk 0: "sv));
+	}
+
+	SECTION("observers see the work done on their behalf")
+	{
+		class counting_observer final :
+			public bsa::observer
+		{
+		public:
+			struct codec_t final
+			{
+				std::atomic_size_t count{ 0 };
+				std::atomic_size_t in{ 0 };
+				std::atomic_size_t out{ 0 };
+			};
+
+			void on_phase(phase a_phase, std::chrono::nanoseconds) noexcept override
+			{
+				++phases[static_cast<std::size_t>(a_phase)];
+			}
+
+			void on_io(io a_io, std::size_t a_bytes) noexcept override
+			{
+				bytes[static_cast<std::size_t>(a_io)] += a_bytes;
+			}
+
+			void on_codec(
+				codec a_codec,
+				operation a_operation,
+				std::size_t a_in,
+				std::size_t a_out,
+				std::chrono::nanoseconds) noexcept override
+			{
+				auto& c = codecs[static_cast<std::size_t>(a_codec)][static_cast<std::size_t>(a_operation)];
+				++c.count;
+				c.in += a_in;
+				c.out += a_out;
+			}
+
+			void on_allocation(std::size_t) noexcept override { ++allocations; }
+
+			[[nodiscard]] auto get(codec a_codec, operation a_operation) const noexcept
+				-> const codec_t&
+			{
+				return codecs[static_cast<std::size_t>(a_codec)][static_cast<std::size_t>(a_operation)];
+			}
+
+			std::array<std::atomic_size_t, 3> phases{};
+			std::array<std::atomic_size_t, 3> bytes{};
+			std::array<std::array<codec_t, 2>, 3> codecs{};
+			std::atomic_size_t allocations{ 0 };
+		};
+
+		using observer = bsa::observer;
+		const std::filesystem::path root{ "fo4_compression_test"sv };
+		counting_observer counter;
+		bsa::set_observer(&counter);
+
+		bsa::fo4::archive ba2;
+		ba2.read(root / "normal.ba2"sv);
+		REQUIRE(counter.phases[static_cast<std::size_t>(observer::phase::read)] == 1);
+		REQUIRE(counter.bytes[static_cast<std::size_t>(observer::io::mapped)] ==
+				std::filesystem::file_size(root / "normal.ba2"sv));
+
+		std::size_t chunks = 0;
+		std::size_t compressed = 0;
+		std::size_t decompressed = 0;
+		for (auto& file : ba2) {
+			for (auto& chunk : file.second) {
+				++chunks;
+				compressed += chunk.size();
+				decompressed += chunk.decompressed_size();
+				chunk.decompress(bsa::fo4::compression_format::zip);
+			}
+		}
+		REQUIRE(chunks > 0);
+		const auto& inflated = counter.get(observer::codec::zlib, observer::operation::decompress);
+		REQUIRE(inflated.count == chunks);
+		REQUIRE(inflated.in == compressed);
+		REQUIRE(inflated.out == decompressed);
+		REQUIRE(counter.allocations == chunks);
+
+		// worker threads report to the same observer
+		ba2.compress_all({ .compression_format_ = bsa::fo4::compression_format::lz4 }, 2);
+		const auto& lz4 = counter.get(observer::codec::lz4, observer::operation::compress);
+		REQUIRE(lz4.count == chunks);
+		REQUIRE(lz4.in == decompressed);
+		REQUIRE(counter.allocations == chunks * 2);
+
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		ba2.write(os, { .version_ = bsa::fo4::version::v3, .compression_format_ = bsa::fo4::compression_format::lz4 });
+		const auto& written = os.get<binary_io::memory_ostream>().rdbuf();
+		REQUIRE(counter.phases[static_cast<std::size_t>(observer::phase::write)] == 1);
+		REQUIRE(counter.bytes[static_cast<std::size_t>(observer::io::written)] == written.size());
+
+		bsa::fo4::archive copy;
+		copy.read({ std::span{ written }, bsa::copy_type::deep });
+		REQUIRE(counter.phases[static_cast<std::size_t>(observer::phase::read)] == 2);
+		std::size_t copied = 0;
+		for (const auto& file : copy) {
+			for (const auto& chunk : file.second) {
+				copied += chunk.size();
+			}
+		}
+		REQUIRE(counter.bytes[static_cast<std::size_t>(observer::io::read)] == copied);
+
+		bsa::set_observer(nullptr);
+		REQUIRE(bsa::get_observer() == nullptr);
+		copy.read({ std::span{ written }, bsa::copy_type::deep });
+		REQUIRE(counter.phases[static_cast<std::size_t>(observer::phase::read)] == 2);
+	}
+
+	SECTION("archives read asynchronously extract like archives read through a mapping")
+	{
+		const std::array paths{
+			std::filesystem::path{ "fo4_compression_test/normal.ba2"sv },
+			std::filesystem::path{ "fo4_dds_test/in.ba2"sv },
+		};
+		const std::filesystem::path out{ "fo4_async_extract_test_out"sv };
+
+		for (const auto& path : paths) {
+			for (const std::size_t threads : { 0, 4 }) {
+				bsa::fo4::archive expected;
+				const auto meta = expected.read(path);
+
+				bsa::fo4::archive ba2;
+				const auto other =
+					threads == 0 ?
+						ba2.read({ path, bsa::read_backend::async }) :
+						ba2.read({ path, bsa::read_backend::async }, threads);
+				REQUIRE(other.format_ == meta.format_);
+				REQUIRE(ba2.size() == expected.size());
+
+				const bsa::fo4::file::write_params params{
+					.format_ = meta.format_,
+					.compression_format_ = meta.compression_format_,
+				};
+				std::filesystem::remove_all(out);
+				ba2.extract_all(out, params, threads);
+
+				for (const auto& [key, file] : expected) {
+					binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+					file.write(os, params);
+					const auto& written = os.get<binary_io::memory_ostream>().rdbuf();
+					std::string name{ key.name() };
+					std::ranges::replace(name, '\\', '/');
+					const auto extracted = map_file(out / name);
+					assert_byte_equality(
+						std::span{ extracted.data(), extracted.size() },
+						std::span{ written });
+
+					const auto chunks = ba2[key.hash()];
+					REQUIRE(chunks);
+					REQUIRE(chunks->size() == file.size());
+					for (std::size_t i = 0; i < file.size(); ++i) {
+						assert_byte_equality((*chunks)[i].as_bytes(), file[i].as_bytes());
+					}
+				}
+			}
+		}
+	}
+
+	SECTION("we can extract archives to disk")
+	{
+		const std::filesystem::path compression{ "fo4_compression_test"sv };
+		const std::filesystem::path out{ "fo4_extract_test_out"sv };
+
+		{
+			std::filesystem::remove_all(out);
+			bsa::fo4::archive ba2;
+			const auto meta = ba2.read(compression / "normal.ba2"sv);
+			ba2.extract_all(out, { .format_ = meta.format_, .compression_format_ = meta.compression_format_ }, 4);
+
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(compression / "data"sv)) {
+				if (entry.is_regular_file()) {
+					const auto p = std::filesystem::relative(entry.path(), compression / "data"sv);
+					const auto original = map_file(entry.path());
+					const auto extracted = map_file(out / p);
+					assert_byte_equality(
+						std::span{ extracted.data(), extracted.size() },
+						std::span{ original.data(), original.size() });
+				}
+			}
+		}
+
+		{
+			bsa::fo4::archive ba2;
+			const auto meta = ba2.read(std::filesystem::path{ "fo4_dds_test"sv } / "in.ba2"sv);
+			const auto file = ba2["Fence006_1K_Roughness.dds"sv];
+			REQUIRE(file);
+
+			const bsa::fo4::file::write_params params{
+				.format_ = meta.format_,
+				.compression_format_ = meta.compression_format_,
+			};
+			binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+			file->write(os, params);
+			const auto& written = os.get<binary_io::memory_ostream>().rdbuf();
+
+			std::vector<std::byte> buffer(file->written_size(params));
+			REQUIRE(buffer.size() == written.size());
+			file->write_into(buffer, params);
+			assert_byte_equality(buffer, written);
+		}
+
+		{
+			bsa::fo4::file f;
+			const std::array payload{ std::byte{ 1 } };
+			f.emplace_back().set_data(std::span{ payload });
+
+			bsa::fo4::archive ba2;
+			REQUIRE(ba2.insert("..\\evil.txt"sv, std::move(f)).second);
+			REQUIRE_THROWS_AS(ba2.extract_all(out, {}), bsa::exception);
+			REQUIRE(!std::filesystem::exists("evil.txt"sv));
+		}
+	}
+
+	SECTION("we can read parts of files")
+	{
+		{
+			bsa::fo4::archive ba2;
+			const auto meta = ba2.read(std::filesystem::path{ "fo4_dds_test"sv } / "in.ba2"sv);
+			const auto file = ba2["Fence006_1K_Roughness.dds"sv];
+			REQUIRE(file);
+			REQUIRE(file->size() == 3);
+			REQUIRE(file->header.mip_count == 11);
+
+			binary_io::any_ostream full{ std::in_place_type<binary_io::memory_ostream> };
+			file->write(full, { .format_ = meta.format_, .compression_format_ = meta.compression_format_ });
+			const auto& expected = full.get<binary_io::memory_ostream>().rdbuf();
+
+			binary_io::any_ostream all{ std::in_place_type<binary_io::memory_ostream> };
+			file->write_mips(all, { 0, 10 }, meta.compression_format_);
+			assert_byte_equality(all.get<binary_io::memory_ostream>().rdbuf(), expected);
+
+			// the tail mips span the last chunk only partially
+			binary_io::any_ostream tail{ std::in_place_type<binary_io::memory_ostream> };
+			file->write_mips(tail, { 3, 10 }, meta.compression_format_);
+			const auto& written = tail.get<binary_io::memory_ostream>().rdbuf();
+
+			DirectX::TexMetadata info;
+			REQUIRE(SUCCEEDED(DirectX::GetMetadataFromDDSMemory(
+				written.data(),
+				written.size(),
+				DirectX::DDS_FLAGS_NONE,
+				info)));
+			REQUIRE(info.width == file->header.width >> 3);
+			REQUIRE(info.height == file->header.height >> 3);
+			REQUIRE(info.mipLevels == 8);
+
+			const auto pixels = file->read_mips({ 3, 10 }, meta.compression_format_);
+			REQUIRE(pixels.size() < written.size());
+			assert_byte_equality(
+				std::span{ written }.last(pixels.size()),
+				std::span{ expected }.last(pixels.size()));
+			assert_byte_equality(std::span{ written }.last(pixels.size()), pixels);
+
+			REQUIRE_THROWS_AS(file->read_mips({ 0, 11 }, meta.compression_format_), bsa::exception);
+			REQUIRE_THROWS_AS(file->read_mips({ 2, 1 }, meta.compression_format_), bsa::exception);
+		}
+
+		{
+			bsa::fo4::file f;
+			const auto payload = std::as_bytes(std::span{ "0123456789"sv });
+			f.emplace_back().set_data(payload.first(4));
+			f.emplace_back().set_data(payload.subspan(4, 3));
+			f.emplace_back().set_data(payload.subspan(7));
+			f[1].compress({});
+
+			std::array<std::byte, 6> buffer{};
+			REQUIRE(f.read_range(2, buffer, bsa::fo4::compression_format::zip) == 6);
+			assert_byte_equality(buffer, payload.subspan(2, 6));
+			REQUIRE(f.read_range(4, std::span{ buffer }.first(3), bsa::fo4::compression_format::zip) == 3);
+			assert_byte_equality(std::span{ buffer }.first(3), payload.subspan(4, 3));
+			REQUIRE(f.read_range(7, buffer, bsa::fo4::compression_format::zip) == 3);
+			assert_byte_equality(std::span{ buffer }.first(3), payload.subspan(7));
+			REQUIRE(f.read_range(10, buffer, bsa::fo4::compression_format::zip) == 0);
+		}
+
+		{
+			const std::filesystem::path root{ "fo4_compression_test"sv };
+			bsa::fo4::archive ba2;
+			const auto meta = ba2.read(root / "normal.ba2"sv);
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(root / "data"sv)) {
+				if (!entry.is_regular_file()) {
+					continue;
+				}
+
+				const auto file = ba2[std::filesystem::relative(entry.path(), root / "data"sv).string()];
+				REQUIRE(file);
+				const auto original = map_file(entry.path());
+				const std::span expected{ original.data(), original.size() };
+				const auto offset = expected.size() / 3;
+
+				std::vector<std::byte> buffer(expected.size());
+				REQUIRE(file->read_range(offset, buffer, meta.compression_format_) == expected.size() - offset);
+				assert_byte_equality(std::span{ buffer }.first(expected.size() - offset), expected.subspan(offset));
+			}
+		}
+	}
+
 	SECTION("we can read/write archives without touching the disk")
 	{
 		test_in_memory_buffer<bsa::fo4::archive>(
@@ -620,6 +1376,160 @@ TEST_CASE("bsa::fo4::archive", "[src][fo4][archive]")
 		}
 	}
 
+	SECTION("dds headers are identical to those encoded by DirectXTex")
+	{
+		constexpr std::array formats{
+			DXGI_FORMAT_BC1_UNORM,
+			DXGI_FORMAT_BC1_UNORM_SRGB,
+			DXGI_FORMAT_BC2_UNORM,
+			DXGI_FORMAT_BC3_UNORM_SRGB,
+			DXGI_FORMAT_BC4_UNORM,
+			DXGI_FORMAT_BC5_SNORM,
+			DXGI_FORMAT_BC6H_UF16,
+			DXGI_FORMAT_BC7_UNORM,
+			DXGI_FORMAT_R8G8B8A8_UNORM,
+			DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
+			DXGI_FORMAT_B8G8R8A8_UNORM,
+			DXGI_FORMAT_B8G8R8X8_UNORM,
+			DXGI_FORMAT_R8_UNORM,  // not handled by the fast path
+		};
+		constexpr std::array extents{
+			std::make_pair(std::uint16_t{ 1 }, std::uint16_t{ 1 }),
+			std::make_pair(std::uint16_t{ 3 }, std::uint16_t{ 10 }),
+			std::make_pair(std::uint16_t{ 256 }, std::uint16_t{ 512 }),
+		};
+
+		for (const auto format : formats) {
+			for (const auto& [height, width] : extents) {
+				for (const bool cubemap : { false, true }) {
+					bsa::fo4::file f;
+					f.header = {
+						.height = height,
+						.width = width,
+						.mip_count = static_cast<std::uint8_t>(std::bit_width(std::max(height, width))),
+						.format = static_cast<std::uint8_t>(format),
+						.flags = static_cast<std::uint8_t>(cubemap ? 1u : 0u),
+					};
+
+					const DirectX::TexMetadata meta{
+						.width = width,
+						.height = height,
+						.depth = 1,
+						.arraySize = cubemap ? 6u : 1u,
+						.mipLevels = f.header.mip_count,
+						.miscFlags = cubemap ? std::uint32_t{ DirectX::TEX_MISC_TEXTURECUBE } : 0u,
+						.miscFlags2 = 0,
+						.format = format,
+						.dimension = DirectX::TEX_DIMENSION_TEXTURE2D,
+					};
+					std::array<std::byte, 148> expected{};
+					std::size_t size = 0;
+					REQUIRE(SUCCEEDED(DirectX::EncodeDDSHeader(
+						meta,
+						DirectX::DDS_FLAGS_NONE,
+						expected.data(),
+						expected.size(),
+						size)));
+
+					const bsa::fo4::file::write_params params{ .format_ = bsa::fo4::format::directx };
+					binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+					f.write(os, params);
+					const auto& written = os.get<binary_io::memory_ostream>().rdbuf();
+					REQUIRE(f.written_size(params) == size);
+					assert_byte_equality(
+						std::span{ written.data(), written.size() },
+						std::span{ expected.data(), size });
+				}
+			}
+		}
+	}
+
+	SECTION("directx files are sliced directly out of their source")
+	{
+		const std::array files{
+			std::filesystem::path{ "fo4_dds_test/Fence006_1K_Roughness.dds"sv },
+			std::filesystem::path{ "fo4_dx9_test/dx9.dds"sv },
+			std::filesystem::path{ "fo4_dx9_test/blacksky_e.dds"sv },
+			std::filesystem::path{ "fo4_dx9_test/bleakfallscube_e.dds"sv },
+		};
+
+		for (const auto& path : files) {
+			const auto mapped = map_file(path);
+			REQUIRE(mapped.is_open());
+			const std::span bytes{ mapped.data(), mapped.size() };
+
+			bsa::fo4::file file;
+			file.read({ bytes, bsa::copy_type::shallow }, { .format_ = bsa::fo4::format::directx });
+			REQUIRE(!file.empty());
+			for (const auto& chunk : file) {
+				const auto data = chunk.as_bytes();
+				REQUIRE(data.data() >= bytes.data());
+				REQUIRE(data.data() + data.size() <= bytes.data() + bytes.size());
+			}
+		}
+	}
+
+	SECTION("reading files in bulk is equivalent to reading each file")
+	{
+		const std::array files{
+			std::make_pair(
+				bsa::fo4::archive::key_type{ "Fence006_1K_Roughness.dds"sv },
+				std::filesystem::path{ "fo4_dds_test/Fence006_1K_Roughness.dds"sv }),
+			std::make_pair(
+				bsa::fo4::archive::key_type{ "dx9.dds"sv },
+				std::filesystem::path{ "fo4_dx9_test/dx9.dds"sv }),
+			std::make_pair(
+				bsa::fo4::archive::key_type{ "blacksky_e.dds"sv },
+				std::filesystem::path{ "fo4_dx9_test/blacksky_e.dds"sv }),
+			std::make_pair(
+				bsa::fo4::archive::key_type{ "bleakfallscube_e.dds"sv },
+				std::filesystem::path{ "fo4_dx9_test/bleakfallscube_e.dds"sv }),
+			std::make_pair(
+				bsa::fo4::archive::key_type{ "dx9.dds"sv },
+				std::filesystem::path{ "fo4_dx9_test/dx9.dds"sv }),
+		};
+		const bsa::fo4::file::read_params params{
+			.format_ = bsa::fo4::format::directx,
+			.compression_type_ = bsa::compression_type::compressed,
+		};
+
+		bsa::fo4::archive bulk;
+		REQUIRE(bulk.read_files(files, params, 4) == files.size() - 1);
+		REQUIRE(bulk.size() == files.size() - 1);
+
+		for (const auto& [key, path] : files) {
+			bsa::fo4::file serial;
+			serial.read(path, params);
+
+			const auto file = bulk[key.name()];
+			REQUIRE(file);
+			REQUIRE(file->header == serial.header);
+			REQUIRE(file->size() == serial.size());
+			for (std::size_t i = 0; i < serial.size(); ++i) {
+				const auto& lhs = (*file)[i];
+				const auto& rhs = serial[i];
+				REQUIRE(lhs.compressed() == rhs.compressed());
+				REQUIRE(lhs.mips == rhs.mips);
+				assert_byte_equality(lhs.as_bytes(), rhs.as_bytes());
+			}
+		}
+
+		REQUIRE(bulk.read_files(files, params) == 0);
+
+		SECTION("files read in bulk never touch the memory resource from another thread")
+		{
+			counting_resource arena;
+			const bsa::memory_scope scope{ arena };
+
+			bsa::fo4::archive scoped;
+			REQUIRE(scoped.read_files(files, params, 4) == files.size() - 1);
+			REQUIRE(!arena.used_across_threads());
+			for (const auto& [key, file] : scoped) {
+				REQUIRE(file.get_allocator().resource() == &arena);
+			}
+		}
+	}
+
 	SECTION("we can archives from the fallout 4 next-gen update")
 	{
 		const std::filesystem::path root{ "fo4_next_gen_test"sv };
@@ -629,7 +1539,7 @@ TEST_CASE("bsa::fo4::archive", "[src][fo4][archive]")
 		};
 		const std::array versions = { bsa::fo4::version::v7, bsa::fo4::version::v8 };
 
-		for (const auto [format, format_str] : formats) {
+		for (const auto& [format, format_str] : formats) {
 			for (const auto version : versions) {
 				std::vector<std::string_view> files;
 				switch (format) {
@@ -664,3 +1574,505 @@ TEST_CASE("bsa::fo4::archive", "[src][fo4][archive]")
 		}
 	}
 }
+
+TEST_CASE("bsa::fo4::lazy_archive", "[src][fo4][archive]")
+{
+	SECTION("lazy archives start empty")
+	{
+		const bsa::fo4::lazy_archive ba2;
+		REQUIRE(ba2.empty());
+		REQUIRE(ba2.size() == 0);
+		REQUIRE(ba2.cache().empty());
+	}
+
+	SECTION("lazy lookups are equivalent to reading the whole archive")
+	{
+		const std::array archives{
+			std::filesystem::path{ "fo4_compression_test/normal.ba2"sv },
+			std::filesystem::path{ "fo4_cubemap_test/in.ba2"sv },
+			std::filesystem::path{ "fo4_dds_test/in.ba2"sv },
+			std::filesystem::path{ "fo4_missing_string_table_test/in.ba2"sv },
+			std::filesystem::path{ "fo4_next_gen_test/dx10_v8.ba2"sv },
+			std::filesystem::path{ "fo4_next_gen_test/gnrl_v7.ba2"sv },
+		};
+
+		for (const auto& path : archives) {
+			bsa::fo4::archive full;
+			const auto meta = full.read(path);
+
+			bsa::fo4::lazy_archive lazy;
+			const auto lazyMeta = lazy.read(path);
+			REQUIRE(lazyMeta.format_ == meta.format_);
+			REQUIRE(lazyMeta.version_ == meta.version_);
+			REQUIRE(lazyMeta.compression_format_ == meta.compression_format_);
+			REQUIRE(lazyMeta.strings == meta.strings);
+			REQUIRE(lazy.size() == full.size());
+			REQUIRE(lazy.cache().empty());
+
+			for (const auto& [key, file] : full) {
+				const auto found = lazy.lookup(key);
+				REQUIRE(found);
+				REQUIRE(found->header == file.header);
+				REQUIRE(found->size() == file.size());
+				for (std::size_t i = 0; i < file.size(); ++i) {
+					const auto& lhs = (*found)[i];
+					const auto& rhs = file[i];
+					REQUIRE(lhs.compressed() == rhs.compressed());
+					REQUIRE(lhs.mips == rhs.mips);
+					assert_byte_equality(lhs.as_bytes(), rhs.as_bytes());
+				}
+				REQUIRE(&*lazy.lookup(key) == &*found);
+			}
+			REQUIRE(lazy.cache().size() == full.size());
+			REQUIRE(!lazy.lookup("not/a/file.txt"sv));
+		}
+	}
+
+	SECTION("lazy archives can reuse a sidecar index")
+	{
+		const std::filesystem::path path{ "fo4_compression_test/normal.ba2"sv };
+		const std::filesystem::path other{ "fo4_dds_test/in.ba2"sv };
+		const std::filesystem::path cache{ "fo4_index_cache_test.idx"sv };
+		std::filesystem::remove(cache);
+
+		const auto compare = [](bsa::fo4::lazy_archive& a_lazy, const std::filesystem::path& a_path) {
+			bsa::fo4::archive full;
+			full.read(a_path);
+			REQUIRE(a_lazy.size() == full.size());
+			for (const auto& [key, file] : full) {
+				const auto found = a_lazy.lookup(key);
+				REQUIRE(found);
+				REQUIRE(found->header == file.header);
+				REQUIRE(found->size() == file.size());
+				for (std::size_t i = 0; i < file.size(); ++i) {
+					assert_byte_equality((*found)[i].as_bytes(), file[i].as_bytes());
+				}
+			}
+		};
+
+		const auto expected = [&]() {
+			bsa::fo4::lazy_archive lazy;
+			return lazy.read(path);
+		}();
+		const auto same_meta = [&](const bsa::fo4::archive::meta_info& a_meta) {
+			REQUIRE(a_meta.format_ == expected.format_);
+			REQUIRE(a_meta.version_ == expected.version_);
+			REQUIRE(a_meta.compression_format_ == expected.compression_format_);
+			REQUIRE(a_meta.strings == expected.strings);
+		};
+
+		{
+			bsa::fo4::lazy_archive lazy;
+			same_meta(lazy.read(path, cache));
+			REQUIRE(std::filesystem::exists(cache));
+			compare(lazy, path);
+		}
+
+		// an unchanged archive reuses the sidecar as is
+		const auto stale = std::filesystem::file_time_type{};
+		std::filesystem::last_write_time(cache, stale);
+		{
+			bsa::fo4::lazy_archive lazy;
+			same_meta(lazy.read(path, cache));
+			REQUIRE(std::filesystem::last_write_time(cache) == stale);
+			compare(lazy, path);
+		}
+
+		// sidecars for a different archive are rebuilt
+		{
+			bsa::fo4::lazy_archive lazy;
+			REQUIRE(lazy.read(other, cache).format_ == bsa::fo4::format::directx);
+			REQUIRE(std::filesystem::last_write_time(cache) != stale);
+			compare(lazy, other);
+		}
+	}
+
+	SECTION("lazy archives will bail on malformed inputs")
+	{
+		const std::filesystem::path root{ "fo4_invalid_test"sv };
+		// file data and chunk sentinels are never touched until a lookup
+		constexpr std::array types{
+			"format"sv,
+			"magic"sv,
+			"size"sv,
+			"version"sv,
+		};
+
+		for (const auto& type : types) {
+			std::string filename;
+			filename += "invalid_"sv;
+			filename += type;
+			filename += ".ba2"sv;
+
+			bsa::fo4::lazy_archive ba2;
+			REQUIRE_THROWS_WITH(
+				ba2.read(root / filename),
+				make_substr_matcher(type));
+		}
+	}
+}
+
+TEST_CASE("bsa::fo4::stream_writer", "[src][fo4][archive]")
+{
+	SECTION("stream writers start empty")
+	{
+		const bsa::fo4::stream_writer writer;
+		REQUIRE(writer.empty());
+		REQUIRE(writer.size() == 0);
+	}
+
+	SECTION("stream writers will not insert the same file twice")
+	{
+		bsa::fo4::stream_writer writer;
+		const auto source = []() { return bsa::fo4::file{}; };
+		REQUIRE(writer.insert("misc/example.txt"sv, source));
+		REQUIRE(writer.insert("misc/other.txt"sv, source));
+		REQUIRE(!writer.insert("misc/example.txt"sv, source));
+		REQUIRE(writer.size() == 2);
+
+		writer.clear();
+		REQUIRE(writer.empty());
+	}
+
+	SECTION("streamed archives are identical to archives written from memory")
+	{
+		const std::array archives{
+			std::filesystem::path{ "fo4_compression_test/normal.ba2"sv },
+			std::filesystem::path{ "fo4_cubemap_test/in.ba2"sv },
+			std::filesystem::path{ "fo4_dds_test/in.ba2"sv },
+			std::filesystem::path{ "fo4_missing_string_table_test/in.ba2"sv },
+			std::filesystem::path{ "fo4_next_gen_test/dx10_v8.ba2"sv },
+			std::filesystem::path{ "fo4_next_gen_test/gnrl_v7.ba2"sv },
+		};
+
+		for (const auto& path : archives) {
+			bsa::fo4::archive full;
+			const auto meta = full.read(path);
+
+			for (const bool known : { true, false }) {
+				bsa::fo4::stream_writer writer;
+				for (const auto& [key, file] : full) {
+					REQUIRE(writer.insert(
+						key,
+						[&]() { return file; },
+						known ? file.size() : 0u));
+				}
+
+				binary_io::any_ostream expected{ std::in_place_type<binary_io::memory_ostream> };
+				full.write(expected, meta);
+
+				binary_io::any_ostream streamed{ std::in_place_type<binary_io::memory_ostream> };
+				writer.write(streamed, meta);
+
+				assert_byte_equality(
+					expected.get<binary_io::memory_ostream>().rdbuf(),
+					streamed.get<binary_io::memory_ostream>().rdbuf());
+			}
+		}
+	}
+
+	SECTION("textures streamed from disk are laid out from their headers")
+	{
+		const std::array textures{
+			std::filesystem::path{ "fo4_dds_test/Fence006_1K_Roughness.dds"sv },
+			std::filesystem::path{ "fo4_cubemap_test/blacksky_e.dds"sv },
+		};
+		const bsa::fo4::archive::meta_info meta{ .format_ = bsa::fo4::format::directx };
+
+		for (const std::size_t extent : { 64u, 512u }) {
+			const bsa::fo4::file::read_params params{
+				.format_ = bsa::fo4::format::directx,
+				.mip_chunk_width = extent,
+				.mip_chunk_height = extent,
+			};
+
+			bsa::fo4::archive full;
+			bsa::fo4::stream_writer writer;
+			for (const auto& path : textures) {
+				const auto name = path.filename().string();
+				bsa::fo4::file f;
+				f.read(path, params);
+				REQUIRE(full.insert(name, std::move(f)).second);
+				REQUIRE(writer.insert(name, path, params));
+			}
+
+			binary_io::any_ostream expected{ std::in_place_type<binary_io::memory_ostream> };
+			full.write(expected, meta);
+
+			binary_io::any_ostream streamed{ std::in_place_type<binary_io::memory_ostream> };
+			writer.write(streamed, meta);
+
+			assert_byte_equality(
+				expected.get<binary_io::memory_ostream>().rdbuf(),
+				streamed.get<binary_io::memory_ostream>().rdbuf());
+		}
+	}
+
+	SECTION("stream writers will bail when a source changes its chunk count")
+	{
+		bsa::fo4::stream_writer writer;
+		REQUIRE(writer.insert(
+			"misc/example.txt"sv,
+			[]() { return bsa::fo4::file{}; },
+			1));
+
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		REQUIRE_THROWS_AS(
+			writer.write(os, { .format_ = bsa::fo4::format::general }),
+			bsa::exception);
+	}
+}
+
+
+TEST_CASE("bsa::fo4::updater", "[src][fo4][archive]")
+{
+	const auto contents = [](const bsa::fo4::file& a_file, bsa::fo4::compression_format a_format) {
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		a_file.write(os, { .format_ = bsa::fo4::format::general, .compression_format_ = a_format });
+		return std::move(os.get<binary_io::memory_ostream>().rdbuf());
+	};
+
+	const auto make_file = [](std::span<const std::byte> a_data, bsa::fo4::compression_format a_format) {
+		bsa::fo4::file f;
+		auto& chunk = f.emplace_back();
+		chunk.set_data(a_data);
+		chunk.compress({ .compression_format_ = a_format });
+		return f;
+	};
+
+	const auto assert_equivalent = [&](
+									   const std::filesystem::path& a_path,
+									   const bsa::fo4::archive& a_expected,
+									   bsa::fo4::compression_format a_format) {
+		bsa::fo4::archive actual;
+		actual.read(a_path);
+		REQUIRE(actual.size() == a_expected.size());
+		for (const auto& [key, file] : a_expected) {
+			const auto found = actual[key.name()];
+			REQUIRE(found);
+			assert_byte_equality(contents(*found, a_format), contents(file, a_format));
+		}
+	};
+
+	SECTION("updaters start empty")
+	{
+		const bsa::fo4::updater updater;
+		REQUIRE(updater.empty());
+		REQUIRE(updater.size() == 0);
+		REQUIRE(updater.dead_bytes() == 0);
+	}
+
+	SECTION("updating an archive is equivalent to rewriting it")
+	{
+		const std::filesystem::path original{ "fo4_compression_test/normal.ba2"sv };
+		const std::filesystem::path path{ "fo4_updater_test_out.ba2"sv };
+		std::filesystem::copy_file(original, path, std::filesystem::copy_options::overwrite_existing);
+
+		bsa::fo4::archive expected;
+		const auto meta = expected.read(original);
+		const auto format = meta.compression_format_;
+		REQUIRE(expected.size() > 1);
+
+		bsa::fo4::updater updater;
+		REQUIRE(updater.open(path).format_ == meta.format_);
+		REQUIRE(updater.size() == expected.size());
+		REQUIRE(updater.dead_bytes() == 0);
+
+		const auto replaced = std::string(expected.begin()->first.name());
+		const auto erased = std::string(std::next(expected.begin())->first.name());
+		REQUIRE(updater.contains(replaced));
+
+		const auto payload = std::as_bytes(std::span{ "the quick brown fox jumps over the lazy dog"sv });
+		REQUIRE(!updater.insert_or_assign(replaced, make_file(payload, format)));
+		REQUIRE(updater.insert_or_assign("misc/added.txt"sv, make_file(payload, format)));
+		REQUIRE(updater.erase(erased));
+		REQUIRE(!updater.erase(erased));
+		REQUIRE(!updater.contains(erased));
+		REQUIRE(updater.size() == expected.size());
+
+		expected.erase(replaced);
+		REQUIRE(expected.insert(replaced, make_file(payload, format)).second);
+		REQUIRE(expected.insert("misc/added.txt"sv, make_file(payload, format)).second);
+		REQUIRE(expected.erase(erased));
+
+		updater.commit();
+		REQUIRE(updater.dead_bytes() > 0);
+		assert_equivalent(path, expected, format);
+
+		SECTION("growing the file records only moves the chunks they overlap")
+		{
+			std::vector<std::string> names;
+			for (std::size_t i = 0; i < 64; ++i) {
+				names.push_back("misc/grown/file"s + std::to_string(i) + ".txt"s);
+			}
+			for (const auto& name : names) {
+				REQUIRE(updater.insert_or_assign(name, make_file(payload, format)));
+				REQUIRE(expected.insert(name, make_file(payload, format)).second);
+			}
+
+			updater.commit();
+			assert_equivalent(path, expected, format);
+		}
+
+		SECTION("compacting an archive reclaims its dead bytes")
+		{
+			const auto before = std::filesystem::file_size(path);
+			updater.compact();
+			REQUIRE(updater.dead_bytes() == 0);
+			REQUIRE(std::filesystem::file_size(path) < before);
+			assert_equivalent(path, expected, format);
+		}
+	}
+
+	SECTION("updaters will bail when no archive is open")
+	{
+		bsa::fo4::updater updater;
+		REQUIRE_THROWS_AS(updater.commit(), bsa::exception);
+	}
+}
+
+TEST_CASE("bsa::fo4::patch", "[src][fo4][archive]")
+{
+	const auto contents = [](const bsa::fo4::file& a_file, bsa::fo4::compression_format a_format) {
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		a_file.write(os, { .format_ = bsa::fo4::format::general, .compression_format_ = a_format });
+		return std::move(os.get<binary_io::memory_ostream>().rdbuf());
+	};
+
+	const auto make_file = [](std::span<const std::byte> a_data, bsa::fo4::compression_format a_format) {
+		bsa::fo4::file f;
+		auto& chunk = f.emplace_back();
+		chunk.set_data(a_data);
+		chunk.compress({ .compression_format_ = a_format });
+		return f;
+	};
+
+	const auto assert_equivalent = [&](
+									   const bsa::fo4::archive& a_actual,
+									   const bsa::fo4::archive& a_expected,
+									   bsa::fo4::compression_format a_format) {
+		REQUIRE(a_actual.size() == a_expected.size());
+		for (const auto& [key, file] : a_expected) {
+			const auto found = a_actual[key.hash()];
+			REQUIRE(found);
+			assert_byte_equality(contents(*found, a_format), contents(file, a_format));
+		}
+	};
+
+	const std::filesystem::path original{ "fo4_compression_test/normal.ba2"sv };
+	bsa::fo4::archive from;
+	const auto meta = from.read(original);
+	const auto format = meta.compression_format_;
+	REQUIRE(from.size() > 2);
+
+	const auto payload = std::as_bytes(std::span{ "the quick brown fox jumps over the lazy dog"sv });
+	auto to = from;
+	const auto replaced = from.begin()->first.hash();
+	const auto erased = std::next(from.begin())->first.hash();
+	REQUIRE(to.erase(bsa::fo4::archive::key_type{ replaced }));
+	REQUIRE(to.insert(bsa::fo4::archive::key_type{ replaced }, make_file(payload, format)).second);
+	REQUIRE(to.insert("misc/added.txt"sv, make_file(payload, format)).second);
+	REQUIRE(to.erase(bsa::fo4::archive::key_type{ erased }));
+
+	bsa::fo4::patch patch;
+	REQUIRE(patch.empty());
+	patch.diff(from, to, 4);
+
+	SECTION("patches hold only the files which changed")
+	{
+		REQUIRE(!patch.empty());
+		REQUIRE(patch.files().size() == 2);
+		REQUIRE(patch.files()[replaced]);
+		REQUIRE(patch.files()["misc/added.txt"sv]);
+		REQUIRE(patch.erased().size() == 1);
+		REQUIRE(patch.erased().front() == erased);
+		REQUIRE(patch.target_size() == to.size());
+
+		bsa::fo4::patch same;
+		same.diff(from, from);
+		REQUIRE(same.empty());
+		REQUIRE(same.target_size() == from.size());
+	}
+
+	SECTION("patches outlive the interned names of the archive they were made from")
+	{
+		std::optional<bsa::fo4::archive> interned{ to };
+		interned->intern_names();
+		bsa::fo4::patch kept;
+		kept.diff(from, *interned);
+		interned.reset();
+
+		const auto added = kept.files().find("misc/added.txt"sv);
+		REQUIRE(added != kept.files().end());
+		REQUIRE(added->first.name() == "misc\\added.txt"sv);
+	}
+
+	SECTION("applying a patch turns the older archive into the newer one")
+	{
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		patch.write(os, meta);
+		const auto& bytes = os.get<binary_io::memory_ostream>().rdbuf();
+
+		bsa::fo4::patch read;
+		REQUIRE(read.read({ std::span{ bytes }, bsa::copy_type::shallow }).format_ == meta.format_);
+		REQUIRE(read.files().size() == patch.files().size());
+		REQUIRE(read.erased().size() == patch.erased().size());
+		REQUIRE(read.target_size() == patch.target_size());
+
+		bsa::fo4::archive patched;
+		patched.read(original);
+		read.apply(patched, 4);
+		assert_equivalent(patched, to, format);
+
+		const std::filesystem::path path{ "fo4_patch_test_out.ba2"sv };
+		std::filesystem::copy_file(original, path, std::filesystem::copy_options::overwrite_existing);
+		bsa::fo4::updater updater;
+		updater.open(path);
+		read.apply(updater);
+		updater.commit();
+
+		bsa::fo4::archive updated;
+		updated.read(path);
+		assert_equivalent(updated, to, format);
+	}
+
+	SECTION("patches are rejected by archives they were not made from")
+	{
+		auto patched = to;
+		REQUIRE_THROWS_AS(patch.apply(patched), bsa::exception);
+		assert_equivalent(patched, to, format);
+
+		auto modified = from;
+		const auto untouched = std::prev(modified.end())->first;
+		REQUIRE(modified.erase(untouched));
+		REQUIRE(modified.insert(untouched, make_file(payload, format)).second);
+		REQUIRE_THROWS_AS(patch.apply(modified), bsa::exception);
+		REQUIRE(modified.size() == from.size());
+		REQUIRE(modified[erased]);
+
+		bsa::fo4::updater updater;
+		updater.open(original);
+		REQUIRE(updater.erase(bsa::fo4::archive::key_type{ erased }));
+		REQUIRE_THROWS_AS(patch.apply(updater), bsa::exception);
+		REQUIRE(updater.size() == from.size() - 1);
+	}
+
+	SECTION("corrupt patches are rejected")
+	{
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		auto noStrings = meta;
+		noStrings.strings = false;
+		patch.write(os, noStrings);
+		auto bytes = std::move(os.get<binary_io::memory_ostream>().rdbuf());
+
+		bsa::fo4::patch read;
+		REQUIRE_NOTHROW(read.read({ std::span{ bytes }, bsa::copy_type::shallow }));
+
+		// the last bytes are the data of the last file, now that there is no string table
+		bytes.back() ^= std::byte{ 0xFF };
+		REQUIRE_THROWS_AS(read.read({ std::span{ bytes }, bsa::copy_type::shallow }), bsa::exception);
+
+		bytes[0] = std::byte{ 0 };
+		REQUIRE_THROWS_AS(read.read({ std::span{ bytes }, bsa::copy_type::shallow }), bsa::exception);
+	}
+}
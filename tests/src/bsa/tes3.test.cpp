@@ -1,5 +1,6 @@
 #include "utility.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstring>
@@ -68,6 +69,30 @@ TEST_CASE("bsa::tes3::hashing", "[src][tes3][hashing]")
 		const bsa::tes3::hashing::hash rhs{ 1, 0 };
 		REQUIRE(lhs < rhs);
 	}
+
+	SECTION("hashing paths in bulk is equivalent to hashing each path")
+	{
+		const std::array paths{
+			"meshes/c/artifact_bloodring_01.nif"sv,
+			"Textures\\Architecture\\Windhelm\\WHWall01.dds"sv,
+			"sound/voice/skyrim.esm/maleuniquedbguardian/dbguardian_00027fa2_1.fuz"sv,
+			"a.kf"sv,
+			""sv,
+		};
+
+		const auto hashes = bsa::tes3::hashing::hash_file_many(paths);
+		REQUIRE(hashes.size() == paths.size());
+		for (std::size_t i = 0; i < paths.size(); ++i) {
+			REQUIRE(hashes[i] == bsa::tes3::hashing::hash_file(paths[i]));
+		}
+	}
+
+	SECTION("hashes can be computed at compile time")
+	{
+		constexpr auto h = bsa::tes3::hashing::hash_file("Meshes/C/Artifact_BloodRing_01.NIF"sv);
+		static_assert(h.numeric() == 0x1C3C1149920D5F0C);
+		REQUIRE(h == bsa::tes3::hashing::hash_file("meshes/c/artifact_bloodring_01.nif"s));
+	}
 }
 
 TEST_CASE("bsa::tes3::file", "[src][tes3][vfs]")
@@ -91,6 +116,48 @@ TEST_CASE("bsa::tes3::archive", "[src][tes3][archive]")
 		REQUIRE(bsa.size() == 0);
 	}
 
+	SECTION("archives stay sorted by hash as they are modified")
+	{
+		constexpr std::array names{
+			"meshes/m/probe_journeyman_01.nif"sv,
+			"textures/menu_rightbuttonup_top.dds"sv,
+			"icons/a/tx_templar_skirt.dds"sv,
+			"meshes/i/in_de_shack_02.nif"sv,
+			"sound/fx/item/ring.wav"sv,
+			"textures/tx_rock_brown_01.dds"sv,
+		};
+
+		bsa::tes3::archive bsa;
+		for (const auto& name : names) {
+			REQUIRE(bsa.insert(name, bsa::tes3::file{}).second);
+		}
+		REQUIRE(!bsa.insert(names[0], bsa::tes3::file{}).second);
+		REQUIRE(bsa.erase(names[3]));
+		REQUIRE(!bsa.erase(names[3]));
+		REQUIRE(bsa.size() == names.size() - 1);
+
+		const auto verify = [&](const bsa::tes3::archive& a_archive) {
+			REQUIRE(std::is_sorted(
+				a_archive.begin(),
+				a_archive.end(),
+				[](const auto& a_lhs, const auto& a_rhs) {
+					return a_lhs.first < a_rhs.first;
+				}));
+			for (std::size_t i = 0; i < names.size(); ++i) {
+				const auto it = a_archive.find(names[i]);
+				REQUIRE((it != a_archive.end()) == (i != 3));
+				REQUIRE(static_cast<bool>(a_archive[names[i]]) == (i != 3));
+			}
+		};
+
+		verify(bsa);
+
+		bsa::tes3::archive copy;
+		REQUIRE(copy.insert(names[3], bsa::tes3::file{}).second);
+		copy = bsa;
+		verify(copy);
+	}
+
 	SECTION("we can read archives")
 	{
 		const std::filesystem::path root{ "tes3_read_test"sv };
@@ -262,3 +329,61 @@ TEST_CASE("bsa::tes3::archive", "[src][tes3][archive]")
 			});
 	}
 }
+
+TEST_CASE("bsa::tes3::archive_view", "[src][tes3][archive]")
+{
+	SECTION("archive views start empty")
+	{
+		const bsa::tes3::archive_view bsa;
+		REQUIRE(bsa.empty());
+		REQUIRE(bsa.size() == 0);
+		REQUIRE(!bsa.contains("share/License.txt"sv));
+		REQUIRE(!bsa.find("share/License.txt"sv));
+	}
+
+	SECTION("lookups read the hash table in place")
+	{
+		const std::filesystem::path root{ "tes3_read_test"sv };
+		const auto disk = map_file(root / "test.bsa"sv);
+		const std::span bytes{ disk.data(), disk.size() };
+
+		bsa::tes3::archive expected;
+		expected.read(root / "test.bsa"sv);
+
+		bsa::tes3::archive_view bsa;
+		bsa.read({ bytes, bsa::copy_type::shallow });
+		REQUIRE(bsa.size() == expected.size());
+
+		for (const auto& [key, file] : expected) {
+			REQUIRE(bsa.contains(key));
+			const auto data = bsa.find(key.hash());
+			REQUIRE(data);
+			REQUIRE(data->data() >= bytes.data());
+			REQUIRE(data->data() + data->size() <= bytes.data() + bytes.size());
+			assert_byte_equality(*data, file.as_bytes());
+		}
+
+		const auto license = bsa.find("Share\\License.txt"sv);
+		REQUIRE(license);
+		const auto original = map_file(root / "share/License.txt"sv);
+		assert_byte_equality(*license, std::span{ original.data(), original.size() });
+
+		REQUIRE(!bsa.contains("share/missing.txt"sv));
+		REQUIRE(!bsa.find(bsa::tes3::hashing::hash{}));
+
+		bsa.clear();
+		REQUIRE(bsa.empty());
+		REQUIRE(!bsa.find("share/License.txt"sv));
+	}
+
+	SECTION("archive views will bail on malformed inputs")
+	{
+		const std::filesystem::path root{ "tes3_invalid_test"sv };
+
+		bsa::tes3::archive_view bsa;
+		REQUIRE_THROWS_WITH(
+			bsa.read(root / "invalid_magic.bsa"sv),
+			make_substr_matcher("magic"sv));
+		REQUIRE_THROWS(bsa.read(root / "invalid_exhausted.bsa"sv));
+	}
+}
@@ -1,13 +1,20 @@
 #include "utility.hpp"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cctype>
+#include <cstddef>
 #include <cstring>
 #include <exception>
 #include <filesystem>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <span>
+#include <string>
 #include <string_view>
 #include <system_error>
 #include <utility>
@@ -128,6 +135,59 @@ TEST_CASE("bsa::tes4::hashing", "[src][tes4][hashing]")
 
 		REQUIRE(h1 == h2);
 	}
+
+	SECTION("hashing paths in bulk is equivalent to hashing each path")
+	{
+		const std::array paths{
+			"meshes/c/artifact_bloodring_01.nif"sv,
+			"Textures\\Architecture\\Windhelm\\WHWall01.dds"sv,
+			"sound/voice/skyrim.esm/maleuniquedbguardian/dbguardian_00027fa2_1.fuz"sv,
+			"a.kf"sv,
+			""sv,
+		};
+
+		const std::vector<std::string> owned(paths.begin(), paths.end());
+		const auto directories = bsa::tes4::hashing::hash_directory_many(owned);
+		const auto files = bsa::tes4::hashing::hash_file_many(paths);
+		REQUIRE(directories.size() == paths.size());
+		REQUIRE(files.size() == paths.size());
+		for (std::size_t i = 0; i < paths.size(); ++i) {
+			REQUIRE(directories[i] == bsa::tes4::hashing::hash_directory(paths[i]));
+			REQUIRE(files[i] == bsa::tes4::hashing::hash_file(paths[i]));
+		}
+	}
+
+	SECTION("hashes can be computed at compile time")
+	{
+		constexpr auto directory = bsa::tes4::hashing::hash_directory("Textures\\Architecture\\Windhelm\\"sv);
+		constexpr auto file = bsa::tes4::hashing::hash_file("sound/Elder_Council_Amulet_N.DDS"sv);
+		static_assert(directory.numeric() == 0xC1D97EBE741E6C6D);
+		static_assert(file.numeric() == 0xDC531E2F6516DFEE);
+		REQUIRE(directory == bsa::tes4::hashing::hash_directory("textures/architecture/windhelm"s));
+		REQUIRE(file == bsa::tes4::hashing::hash_file("elder_council_amulet_n.dds"s));
+	}
+
+	SECTION("hashing a view is equivalent to hashing in place")
+	{
+		const std::string long_name(300, 'A');
+		const std::array paths{
+			"//Meshes\\Clutter/BOTTLE01.NIF\\"sv,
+			"\\/\\"sv,
+			"/"sv,
+			"textures/architecture/windhelm/whwall01.dds"sv,
+			std::string_view{ long_name },
+			std::string_view{ long_name }.substr(0, 259),
+		};
+
+		for (const auto path : paths) {
+			std::string directory{ path };
+			std::string file{ path };
+			REQUIRE(bsa::tes4::hashing::hash_directory(path) ==
+					bsa::tes4::hashing::hash_directory_in_place(directory));
+			REQUIRE(bsa::tes4::hashing::hash_file(path) ==
+					bsa::tes4::hashing::hash_file_in_place(file));
+		}
+	}
 }
 
 TEST_CASE("bsa::tes4::directory", "[src][tes4][vfs]")
@@ -167,6 +227,79 @@ TEST_CASE("bsa::tes4::file", "[src][tes4][vfs]")
 		f.clear();
 		REQUIRE(f.empty());
 	}
+
+	SECTION("compression policies can skip data which will not shrink")
+	{
+		const auto noise = make_noise(1u << 16);
+		const std::vector<std::byte> zeroes(1u << 16);
+
+		for (const auto version : { bsa::tes4::version::tes5, bsa::tes4::version::sse }) {
+			bsa::tes4::file f;
+			f.set_data(std::span{ noise });
+			f.compress({ .version_ = version });
+			REQUIRE(f.compressed());
+
+			f.set_data(std::span{ noise });
+			f.compress({ .version_ = version, .compression_policy_ = { .max_entropy = 7.9 } });
+			REQUIRE(!f.compressed());
+			REQUIRE(f.as_bytes().data() == noise.data());
+
+			f.compress({ .version_ = version, .compression_policy_ = { .max_ratio = 0.95 } });
+			REQUIRE(!f.compressed());
+
+			f.set_data(std::span{ zeroes });
+			f.compress({
+				.version_ = version,
+				.compression_policy_ = { .max_entropy = 7.9, .max_ratio = 0.95 },
+			});
+			REQUIRE(f.compressed());
+		}
+	}
+
+	SECTION("files round trip through every available deflate backend")
+	{
+		REQUIRE(bsa::deflate_backend_available(bsa::deflate_backend::zlib));
+		REQUIRE(bsa::deflate_backend_is_reference(bsa::deflate_backend::zlib));
+		REQUIRE(!bsa::deflate_backend_is_reference(bsa::deflate_backend::libdeflate));
+
+		std::vector<std::byte> payload(1u << 16);
+		for (std::size_t i = 0; i < payload.size(); ++i) {
+			payload[i] = static_cast<std::byte>((i * i) >> 7);
+		}
+
+		const auto original = bsa::get_deflate_backend();
+		for (const auto backend : {
+				 bsa::deflate_backend::zlib,
+				 bsa::deflate_backend::zlib_ng,
+				 bsa::deflate_backend::libdeflate,
+			 }) {
+			if (!bsa::deflate_backend_available(backend)) {
+				const auto current = bsa::get_deflate_backend();
+				REQUIRE(!bsa::set_deflate_backend(backend));
+				REQUIRE(bsa::get_deflate_backend() == current);
+				continue;
+			}
+
+			REQUIRE(bsa::set_deflate_backend(backend));
+			bsa::tes4::file f;
+			f.set_data(std::span{ payload });
+			f.compress({ .version_ = bsa::tes4::version::tes5 });
+			REQUIRE(f.compressed());
+			REQUIRE(f.size() < payload.size());
+
+			// every backend must be able to read what every other backend writes
+			for (const auto reader : {
+					 bsa::deflate_backend::zlib,
+					 backend,
+				 }) {
+				REQUIRE(bsa::set_deflate_backend(reader));
+				auto copy = f;
+				copy.decompress({ .version_ = bsa::tes4::version::tes5 });
+				assert_byte_equality(copy.as_bytes(), std::span{ payload });
+			}
+		}
+		REQUIRE(bsa::set_deflate_backend(original));
+	}
 }
 
 TEST_CASE("bsa::tes4::archive", "[src][tes4][archive]")
@@ -246,6 +379,19 @@ TEST_CASE("bsa::tes4::archive", "[src][tes4][archive]")
 				REQUIRE(read->decompressed_size() == original.decompressed_size());
 				assert_byte_equality(read->as_bytes(), original.as_bytes());
 
+				{
+					auto stream = read->open_stream({ .version_ = version });
+					REQUIRE(stream.size() == origsrc.size());
+					std::vector<std::byte> streamed(stream.size());
+					for (std::span out{ streamed }; !out.empty();) {
+						const auto size = stream.read_some(out.first((std::min<std::size_t>)(out.size(), 1000)));
+						REQUIRE(size > 0);
+						out = out.subspan(size);
+					}
+					REQUIRE(stream.eof());
+					assert_byte_equality(streamed, std::span{ origsrc.data(), origsrc.size() });
+				}
+
 				read->decompress({ .version_ = version });
 				assert_byte_equality(read->as_bytes(), std::span{ origsrc.data(), origsrc.size() });
 			}
@@ -339,6 +485,375 @@ TEST_CASE("bsa::tes4::archive", "[src][tes4][archive]")
 		}
 	}
 
+	SECTION("compressing an archive in bulk is equivalent to compressing each file")
+	{
+		const std::filesystem::path root{ "tes4_compression_test"sv };
+		constexpr std::array archives{
+			std::make_pair("test_104.bsa"sv, bsa::tes4::version::tes5),
+			std::make_pair("test_105.bsa"sv, bsa::tes4::version::sse),
+		};
+
+		for (const auto& [name, version] : archives) {
+			bsa::tes4::archive serial;
+			REQUIRE(serial.read(root / name) == version);
+			for (auto& dir : serial) {
+				for (auto& file : dir.second) {
+					file.second.decompress({ .version_ = version });
+				}
+			}
+
+			auto bulk = serial;
+			for (auto& dir : serial) {
+				for (auto& file : dir.second) {
+					file.second.compress({ .version_ = version });
+				}
+			}
+			bulk.compress_all({ .version_ = version }, 4);
+
+			for (const auto& dir : serial) {
+				for (const auto& file : dir.second) {
+					const auto other = bulk[dir.first][file.first];
+					REQUIRE(other);
+					REQUIRE(other->compressed());
+					REQUIRE(other->decompressed_size() == file.second.decompressed_size());
+					assert_byte_equality(other->as_bytes(), file.second.as_bytes());
+				}
+			}
+		}
+	}
+
+	SECTION("access profiles only change how archives are paged in")
+	{
+		const std::filesystem::path path{ "tes4_compression_test/test_104.bsa"sv };
+		bsa::tes4::archive expected;
+		const auto version = expected.read(path);
+
+		for (const auto profile : {
+				 bsa::access_profile::normal,
+				 bsa::access_profile::sequential,
+				 bsa::access_profile::random,
+				 bsa::access_profile::prefault,
+				 bsa::access_profile::huge_pages,
+			 }) {
+			bsa::tes4::archive bsa;
+			REQUIRE(bsa.read({ path, profile }) == version);
+			REQUIRE(bsa.size() == expected.size());
+			for (const auto& [dkey, dir] : expected) {
+				for (const auto& [fkey, file] : dir) {
+					const auto other = bsa[dkey.hash()][fkey.hash()];
+					REQUIRE(other);
+					other->prefetch();
+					assert_byte_equality(other->as_bytes(), file.as_bytes());
+				}
+			}
+		}
+
+		bsa::prefetch({});
+	}
+
+	SECTION("archives read asynchronously match archives read through a mapping")
+	{
+		const std::filesystem::path path{ "tes4_compression_test/test_105.bsa"sv };
+		bsa::tes4::archive expected;
+		const auto version = expected.read(path);
+
+		bsa::tes4::archive bsa;
+		REQUIRE(bsa.read({ path, bsa::read_backend::async }) == version);
+		REQUIRE(bsa.size() == expected.size());
+		for (const auto& [dkey, dir] : expected) {
+			for (const auto& [fkey, file] : dir) {
+				const auto other = bsa[dkey.hash()][fkey.hash()];
+				REQUIRE(other);
+				assert_byte_equality(other->as_bytes(), file.as_bytes());
+			}
+		}
+
+		REQUIRE_THROWS_AS(
+			bsa.read({ std::filesystem::path{ "tes4_async_read_test/missing.bsa"sv }, bsa::read_backend::async }),
+			std::system_error);
+	}
+
+	SECTION("archives read asynchronously only read file data once it is needed")
+	{
+		class read_counter final :
+			public bsa::observer
+		{
+		public:
+			void on_io(io a_io, std::size_t a_bytes) noexcept override
+			{
+				if (a_io == io::read) {
+					bytes += a_bytes;
+				}
+			}
+
+			std::atomic_size_t bytes{ 0 };
+		};
+
+		constexpr auto version = bsa::tes4::version::sse;
+		const auto noise = make_noise(1u << 20);
+		const std::filesystem::path path{ "tes4_async_deferred_test_out.bsa"sv };
+		{
+			bsa::tes4::directory d;
+			for (std::size_t i = 0; i < 8; ++i) {
+				bsa::tes4::file f;
+				f.set_data(std::span{ noise }.subspan(i * 4096));
+				if (i % 2 == 0) {
+					f.compress({ .version_ = version });
+				}
+				REQUIRE(d.insert("file_" + std::to_string(i) + ".bin", std::move(f)).second);
+			}
+			bsa::tes4::archive bsa;
+			REQUIRE(bsa.insert("root"sv, std::move(d)).second);
+			bsa.archive_flags(
+				bsa::tes4::archive_flag::directory_strings |
+				bsa::tes4::archive_flag::file_strings |
+				bsa::tes4::archive_flag::embedded_file_names);
+			bsa.write(path, version);
+		}
+
+		read_counter counter;
+		bsa::set_observer(&counter);
+
+		bsa::tes4::archive bsa;
+		REQUIRE(bsa.read({ path, bsa::read_backend::async }) == version);
+		const auto size = std::filesystem::file_size(path);
+		REQUIRE(counter.bytes < size / 8);
+
+		const std::filesystem::path out{ "tes4_async_extract_test_out"sv };
+		std::filesystem::remove_all(out);
+		bsa.extract_all(out, { .version_ = version }, 4);
+		REQUIRE(counter.bytes < size + size / 8);  // every file streamed through once
+
+		bsa::set_observer(nullptr);
+
+		bsa::tes4::archive expected;
+		REQUIRE(expected.read(path) == version);
+		for (auto& [dkey, dir] : expected) {
+			for (auto& [fkey, file] : dir) {
+				const auto other = bsa[dkey.hash()][fkey.hash()];
+				REQUIRE(other);
+				assert_byte_equality(other->as_bytes(), file.as_bytes());
+
+				if (file.compressed()) {
+					file.decompress({ .version_ = version });
+				}
+				const auto extracted = map_file(out / dkey.name() / fkey.name());
+				assert_byte_equality(
+					std::span{ extracted.data(), extracted.size() },
+					file.as_bytes());
+			}
+		}
+	}
+
+	SECTION("decompressed contents can be cached")
+	{
+		bsa::tes4::archive bsa;
+		const auto version = bsa.read(std::filesystem::path{ "tes4_compression_test/test_104.bsa"sv });
+		bsa::content_cache cache{ 1u << 20 };
+
+		for ([[maybe_unused]] const auto pass : { 0, 1 }) {
+			for (const auto& [dkey, dir] : bsa) {
+				for (const auto& [fkey, file] : dir) {
+					const auto contents = bsa.decompress_cached(cache, dkey, fkey, { .version_ = version });
+					REQUIRE(contents);
+
+					auto expected = file;
+					expected.decompress({ .version_ = version });
+					assert_byte_equality(std::span{ *contents }, expected.as_bytes());
+				}
+			}
+		}
+
+		const auto stats = cache.stats();
+		REQUIRE(stats.misses == stats.hits);
+		REQUIRE(stats.hits > 0);
+		REQUIRE(!bsa.decompress_cached(cache, "missing"sv, "file.txt"sv, { .version_ = version }));
+
+		const auto make = [](std::byte a_contents) {
+			const std::array payload{ a_contents };
+			bsa::tes4::file f;
+			f.set_data(std::span{ payload });
+			bsa::tes4::directory d;
+			REQUIRE(d.insert("file.txt"sv, std::move(f)).second);
+			bsa::tes4::archive result;
+			REQUIRE(result.insert("root"sv, std::move(d)).second);
+
+			binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+			result.write(os, bsa::tes4::version::sse);
+			return std::move(os.get<binary_io::memory_ostream>().rdbuf());
+		};
+		const auto first = make(std::byte{ 1 });
+		const auto second = make(std::byte{ 2 });
+		const auto lookup = [&](const bsa::tes4::archive& a_archive) {
+			const auto contents = a_archive.decompress_cached(
+				cache, "root"sv, "file.txt"sv, { .version_ = bsa::tes4::version::sse });
+			REQUIRE(contents);
+			REQUIRE(contents->size() == 1);
+			return contents->front();
+		};
+
+		std::optional<bsa::tes4::archive> reused{ std::in_place };
+		reused->read({ std::span{ first }, bsa::copy_type::deep });
+		REQUIRE(lookup(*reused) == std::byte{ 1 });
+		reused->read({ std::span{ second }, bsa::copy_type::deep });
+		REQUIRE(lookup(*reused) == std::byte{ 2 });
+
+		const auto address = std::addressof(*reused);
+		reused.reset();
+		reused.emplace().read({ std::span{ first }, bsa::copy_type::deep });
+		REQUIRE(std::addressof(*reused) == address);
+		REQUIRE(lookup(*reused) == std::byte{ 1 });
+	}
+
+	SECTION("interning names leaves keys unchanged")
+	{
+		const std::filesystem::path path{ "tes4_compression_test/test_104.bsa"sv };
+		const auto file = map_file(path);
+		for (const bool mapped : { false, true }) {
+			bsa::tes4::archive bsa;
+			const auto version =
+				mapped ?
+					bsa.read(path) :
+					bsa.read({ std::span{ file.data(), file.size() }, bsa::copy_type::deep });
+
+			binary_io::any_ostream expected{ std::in_place_type<binary_io::memory_ostream> };
+			bsa.write(expected, version);
+
+			std::vector<std::pair<std::string, std::string>> names;
+			for (const auto& [dkey, dir] : bsa) {
+				for ([[maybe_unused]] const auto& [fkey, f] : dir) {
+					names.emplace_back(dkey.name(), fkey.name());
+				}
+			}
+
+			bsa.intern_names();
+			bsa.intern_names();
+			auto copy = bsa;
+			bsa.clear();
+			const auto [extra, inserted] = copy.insert("extra"sv, bsa::tes4::directory{});
+			REQUIRE(inserted);
+			REQUIRE(extra->second.insert("file.txt"sv, bsa::tes4::file{}).second);
+			copy.intern_names();
+			REQUIRE(copy.erase("extra"sv));
+
+			auto name = names.begin();
+			for (const auto& [dkey, dir] : copy) {
+				for ([[maybe_unused]] const auto& [fkey, f] : dir) {
+					REQUIRE(name != names.end());
+					REQUIRE(dkey.name() == name->first);
+					REQUIRE(fkey.name() == name->second);
+					++name;
+				}
+			}
+			REQUIRE(name == names.end());
+
+			binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+			copy.write(os, version);
+			assert_byte_equality(
+				os.get<binary_io::memory_ostream>().rdbuf(),
+				expected.get<binary_io::memory_ostream>().rdbuf());
+		}
+	}
+
+	SECTION("interned names are released once the archive reads something else")
+	{
+		const std::filesystem::path root{ "in_memory_test"sv };
+		const auto disk = map_file(root / "tes4.bsa"sv);
+
+		auto buffer = std::make_shared_for_overwrite<std::byte[]>(disk.size());
+		std::copy_n(disk.data(), disk.size(), buffer.get());
+		const std::weak_ptr<std::byte[]> observer = buffer;
+
+		bsa::tes4::archive bsa;
+		REQUIRE(bsa.read({ std::move(buffer), disk.size() }) == bsa::tes4::version::tes4);
+		bsa.intern_names();
+		bsa.intern_names();
+		REQUIRE(!observer.expired());
+
+		bsa.read(std::filesystem::path{ "tes4_compression_test/test_104.bsa"sv });
+		REQUIRE(observer.expired());
+		bsa.intern_names();
+		bsa.clear();
+		REQUIRE(bsa.empty());
+	}
+
+	SECTION("transcoding only recompresses files whose codec changes")
+	{
+		bsa::tes4::archive original;
+		const auto version = original.read(std::filesystem::path{ "tes4_compression_test/test_104.bsa"sv });
+		REQUIRE(original.archive_flags() & bsa::tes4::archive_flag::compressed);
+
+		std::size_t files = 0;
+		for (const auto& dir : original) {
+			files += dir.second.size();
+		}
+
+		// 103 and 104 both use zlib, so every file is kept as is
+		auto zlib = original;
+		const auto kept = zlib.transcode({ .version_ = version }, { .version_ = bsa::tes4::version::tes4 }, 4);
+		REQUIRE(kept.passed_through == files);
+		REQUIRE(kept.transcoded == 0);
+		for (const auto& [dkey, dir] : original) {
+			for (const auto& [fkey, file] : dir) {
+				const auto other = zlib[dkey.hash()][fkey.hash()];
+				REQUIRE(other);
+				assert_byte_equality(other->as_bytes(), file.as_bytes());
+			}
+		}
+
+		auto lz4 = original;
+		const auto report = lz4.transcode({ .version_ = version }, { .version_ = bsa::tes4::version::sse }, 4);
+		REQUIRE(report.passed_through == 0);
+		REQUIRE(report.transcoded == files);
+
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		lz4.write(os, bsa::tes4::version::sse);
+		bsa::tes4::archive in;
+		REQUIRE(in.read({ os.get<binary_io::memory_ostream>().rdbuf() }) == bsa::tes4::version::sse);
+		for (const auto& [dkey, dir] : original) {
+			for (const auto& [fkey, file] : dir) {
+				const auto other = in[dkey.hash()][fkey.hash()];
+				REQUIRE(other);
+				REQUIRE(other->compressed());
+				other->decompress({ .version_ = bsa::tes4::version::sse });
+
+				auto expected = file;
+				expected.decompress({ .version_ = version });
+				assert_byte_equality(other->as_bytes(), expected.as_bytes());
+			}
+		}
+	}
+
+	SECTION("we can extract archives to disk")
+	{
+		const std::filesystem::path root{ "tes4_compression_test"sv };
+		const std::filesystem::path out{ "tes4_extract_test_out"sv };
+		std::filesystem::remove_all(out);
+
+		bsa::tes4::archive bsa;
+		const auto version = bsa.read(root / "test_104.bsa"sv);
+		bsa.extract_all(out, { .version_ = version }, 4);
+
+		for (auto& dir : bsa) {
+			for (auto& [key, file] : dir.second) {
+				file.decompress({ .version_ = version });
+				const auto extracted = map_file(out / key.name());
+				assert_byte_equality(
+					std::span{ extracted.data(), extracted.size() },
+					file.as_bytes());
+			}
+		}
+
+		bsa::tes4::file f;
+		const std::array payload{ std::byte{ 1 } };
+		f.set_data(std::span{ payload });
+		bsa::tes4::directory d;
+		REQUIRE(d.insert("evil.txt"sv, std::move(f)).second);
+		bsa::tes4::archive evil;
+		REQUIRE(evil.insert("..\\.."sv, std::move(d)).second);
+		REQUIRE_THROWS_AS(evil.extract_all(out, {}), bsa::exception);
+	}
+
 	SECTION("we can validate the offsets within an archive (<2gb)")
 	{
 		bsa::tes4::archive bsa;
@@ -384,6 +899,130 @@ TEST_CASE("bsa::tes4::archive", "[src][tes4][archive]")
 		REQUIRE(!verify());
 	}
 
+	SECTION("archive sizes can be planned before compressing, and split to fit")
+	{
+		bsa::tes4::archive bsa;
+		const auto version = bsa.read(std::filesystem::path{ "in_memory_test/tes4.bsa"sv });
+		const bsa::tes4::file::compression_params params{ .version_ = version };
+		constexpr auto everything = (std::numeric_limits<std::size_t>::max)();
+
+		std::size_t count = 0;
+		for (const auto& dir : bsa) {
+			for (const auto& file : dir.second) {
+				REQUIRE(!file.second.compressed());
+				++count;
+			}
+		}
+
+		// sampling every file predicts the size exactly
+		const auto estimate = bsa.estimate_size(params, everything);
+		REQUIRE(estimate.fits());
+		REQUIRE(estimate.sampled == count);
+		REQUIRE(bsa.estimate_size(params, 1).sampled < count);
+
+		auto compressed = bsa;
+		compressed.compress_all(params);
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		compressed.write(os, version);
+		REQUIRE(os.get<binary_io::memory_ostream>().rdbuf().size() == estimate.size);
+
+		const auto flags = bsa.archive_flags();
+		const auto limit = estimate.last_offset / 2;
+		auto parts = bsa.split(params, limit, everything);
+		REQUIRE(parts.size() > 1);
+		REQUIRE(bsa.empty());
+		REQUIRE(bsa.archive_flags() == flags);
+
+		std::size_t split = 0;
+		for (auto& part : parts) {
+			REQUIRE(part.archive_flags() == flags);
+			REQUIRE(part.estimate_size(params, everything).last_offset <= limit);
+			for (const auto& [dkey, dir] : part) {
+				for (const auto& [fkey, file] : dir) {
+					REQUIRE(compressed[dkey.hash()][fkey.hash()]);
+					++split;
+				}
+			}
+		}
+		REQUIRE(split == count);
+
+		REQUIRE(compressed.split(params).size() == 1);
+	}
+
+	SECTION("we can verify the integrity of an archive")
+	{
+		const std::filesystem::path root{ "tes4_compression_test"sv };
+		for (const auto name : { "test_104.bsa"sv, "test_105.bsa"sv }) {
+			bsa::tes4::archive bsa;
+			const auto version = bsa.read(root / name);
+
+			std::size_t files = 0;
+			std::uint64_t bytes = 0;
+			for (const auto& dir : bsa) {
+				for (const auto& [key, file] : dir.second) {
+					++files;
+					bytes += file.compressed() ? file.decompressed_size() : file.size();
+				}
+			}
+
+			for (const std::size_t threads : { 1u, 4u }) {
+				const auto report = bsa.verify({ .version_ = version }, threads);
+				REQUIRE(report.ok());
+				REQUIRE(report.entries == files);
+				REQUIRE(report.bytes == bytes);
+			}
+		}
+
+		constexpr auto payload = "the quick brown fox jumps over the lazy dog"sv;
+		const std::span bytes{
+			reinterpret_cast<const std::byte*>(payload.data()),
+			payload.size()
+		};
+
+		bsa::tes4::archive bsa;
+		bsa.archive_flags(bsa::tes4::archive_flag::directory_strings | bsa::tes4::archive_flag::file_strings);
+		bsa::tes4::directory d;
+		for (const auto filename : { "a.txt"sv, "b.txt"sv, "c.txt"sv }) {
+			bsa::tes4::file f;
+			f.set_data(bytes);
+			f.compress({ .version_ = bsa::tes4::version::sse });
+			REQUIRE(d.insert(filename, std::move(f)).second);
+		}
+		REQUIRE(bsa.insert("misc"sv, std::move(d)).second);
+		REQUIRE(bsa.verify({ .version_ = bsa::tes4::version::sse }).ok());
+
+		// rename a file behind its hash's back, and claim another is larger than it is
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		bsa.write(os, bsa::tes4::version::sse);
+		auto& written = os.get<binary_io::memory_ostream>().rdbuf();
+		const auto name = std::search(
+			written.begin(),
+			written.end(),
+			reinterpret_cast<const std::byte*>("a.txt"),
+			reinterpret_cast<const std::byte*>("a.txt") + 6);
+		REQUIRE(name != written.end());
+		*name = std::byte{ 'z' };
+
+		bsa::tes4::archive corrupt;
+		corrupt.read({ written });
+		const auto lying = corrupt["misc"sv]["b.txt"sv];
+		REQUIRE(lying);
+		const auto data = lying->as_bytes();
+		lying->set_data(std::vector(data.begin(), data.end()), lying->decompressed_size() + 1);
+
+		const auto report = corrupt.verify({ .version_ = bsa::tes4::version::sse }, 2);
+		REQUIRE(!report.ok());
+		REQUIRE(report.offsets);
+		REQUIRE(report.entries == 3);
+		REQUIRE(report.failures.size() == 2);
+		std::vector<std::string> paths;
+		for (const auto& failure : report.failures) {
+			paths.push_back(failure.path);
+		}
+		std::sort(paths.begin(), paths.end());
+		REQUIRE(paths == std::vector<std::string>{ "misc\\b.txt"s, "misc\\z.txt"s });
+	}
+
 	SECTION("we can write archives with a variety of flags")
 	{
 		const std::filesystem::path root{ "tes4_flags_test"sv };
@@ -500,6 +1139,144 @@ TEST_CASE("bsa::tes4::archive", "[src][tes4][archive]")
 		}
 	}
 
+	SECTION("archives can share the data of identical files")
+	{
+		constexpr auto payload = "the quick brown fox jumps over the lazy dog"sv;
+		constexpr auto other = "pack my box with five dozen liquor jugs"sv;
+		const auto bytes = [](std::string_view a_data) noexcept {
+			return std::span{
+				reinterpret_cast<const std::byte*>(a_data.data()),
+				a_data.size()
+			};
+		};
+
+		bsa::tes4::archive bsa;
+		for (const auto dirname : { "misc1"sv, "misc2"sv, "misc3"sv }) {
+			bsa::tes4::directory d;
+			for (const auto filename : { "a.txt"sv, "b.txt"sv }) {
+				bsa::tes4::file f;
+				f.set_data(bytes(payload));
+				REQUIRE(d.insert(filename, std::move(f)).second);
+			}
+			bsa::tes4::file f;
+			f.set_data(bytes(other));
+			REQUIRE(d.insert("c.txt"sv, std::move(f)).second);
+			REQUIRE(bsa.insert(dirname, std::move(d)).second);
+		}
+
+		const auto write = [&](bool a_deduplicate) {
+			binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+			bsa.write(os, bsa::tes4::version::sse, { .deduplicate = a_deduplicate });
+			return std::move(os.get<binary_io::memory_ostream>().rdbuf());
+		};
+
+		for (const auto flags : {
+				 bsa::tes4::archive_flag::directory_strings | bsa::tes4::archive_flag::file_strings,
+				 bsa::tes4::archive_flag::xbox_archive,
+			 }) {
+			bsa.archive_flags(flags);
+			const auto full = write(false);
+			const auto shared = write(true);
+			REQUIRE(full.size() - shared.size() == payload.size() * 5 + other.size() * 2);
+
+			bsa::tes4::archive in;
+			REQUIRE(in.read({ shared }) == bsa::tes4::version::sse);
+			REQUIRE(in.size() == bsa.size());
+			for (const auto& [dkey, dir] : bsa) {
+				for (const auto& [fkey, file] : dir) {
+					const auto read = in[dkey.hash()][fkey.hash()];
+					REQUIRE(read);
+					assert_byte_equality(read->as_bytes(), file.as_bytes());
+				}
+			}
+		}
+
+		// every file's data is unique once it is prefixed with its name
+		bsa.archive_flags(bsa::tes4::archive_flag::embedded_file_names);
+		assert_byte_equality(write(false), write(true));
+	}
+
+	SECTION("mapped writes are identical to streamed writes")
+	{
+		const std::array archives{
+			std::filesystem::path{ "tes4_compression_test/test_104.bsa"sv },
+			std::filesystem::path{ "tes4_compression_test/test_105.bsa"sv },
+			std::filesystem::path{ "tes4_data_sharing_name_test/share.bsa"sv },
+			std::filesystem::path{ "tes4_xbox_read_test/normal.bsa"sv },
+			std::filesystem::path{ "tes4_xbox_read_test/xbox.bsa"sv },
+		};
+		const std::filesystem::path out{ "tes4_mapped_write_test_out.bsa"sv };
+
+		for (const auto& path : archives) {
+			bsa::tes4::archive bsa;
+			const auto version = bsa.read(path);
+			for (const bool deduplicate : { false, true }) {
+				binary_io::any_ostream expected{ std::in_place_type<binary_io::memory_ostream> };
+				bsa.write(expected, version, { .deduplicate = deduplicate });
+
+				for (const std::size_t threads : { 1u, 4u }) {
+					bsa.write_mapped(out, version, { .deduplicate = deduplicate }, threads);
+					const auto written = map_file(out);
+					assert_byte_equality(
+						std::span{ written.data(), written.size() },
+						expected.get<binary_io::memory_ostream>().rdbuf());
+				}
+			}
+		}
+
+		REQUIRE_THROWS_AS(
+			bsa::tes4::archive{}.write_mapped("tes4_mapped_write_test_missing/out.bsa"sv, bsa::tes4::version::sse, {}),
+			std::system_error);
+	}
+
+	SECTION("file data can be laid out in the order it will be accessed")
+	{
+		bsa::tes4::archive bsa;
+		const auto version = bsa.read(std::filesystem::path{ "tes4_compression_test/test_104.bsa"sv });
+
+		// access the files in the reverse of their record order
+		std::vector<std::pair<bsa::tes4::archive::key_type, bsa::tes4::directory::key_type>> order;
+		for (const auto& [dkey, dir] : bsa) {
+			for (const auto& [fkey, file] : dir) {
+				order.emplace_back(dkey, fkey);
+			}
+		}
+		std::reverse(order.begin(), order.end());
+		REQUIRE(order.size() > 1);
+		order.emplace_back("missing"sv, "file.txt"sv);
+		order.push_back(order.front());
+
+		binary_io::any_ostream os{ std::in_place_type<binary_io::memory_ostream> };
+		bsa.write(os, version, { .data_order = order });
+		const auto& written = os.get<binary_io::memory_ostream>().rdbuf();
+
+		const std::filesystem::path out{ "tes4_data_order_test_out.bsa"sv };
+		bsa.write_mapped(out, version, { .data_order = order }, 4);
+		const auto mapped = map_file(out);
+		assert_byte_equality(std::span{ mapped.data(), mapped.size() }, written);
+
+		std::size_t last = 0;
+		for (const auto& [dkey, fkey] : std::span{ order }.first(order.size() - 2)) {
+			const auto data = bsa[dkey.hash()][fkey.hash()]->as_bytes();
+			const auto pos = static_cast<std::size_t>(
+				std::search(written.begin(), written.end(), data.begin(), data.end()) -
+				written.begin());
+			REQUIRE(pos < written.size());
+			REQUIRE(pos > last);
+			last = pos;
+		}
+
+		bsa::tes4::archive in;
+		REQUIRE(in.read({ written }) == version);
+		for (const auto& [dkey, dir] : bsa) {
+			for (const auto& [fkey, file] : dir) {
+				const auto other = in[dkey.hash()][fkey.hash()];
+				REQUIRE(other);
+				assert_byte_equality(other->as_bytes(), file.as_bytes());
+			}
+		}
+	}
+
 	SECTION("archives will bail on malformed inputs")
 	{
 		const std::filesystem::path root{ "tes4_invalid_test"sv };
@@ -523,6 +1300,39 @@ TEST_CASE("bsa::tes4::archive", "[src][tes4][archive]")
 		}
 	}
 
+	SECTION("paths can be looked up without constructing a key")
+	{
+		const std::filesystem::path path{ "tes4_compression_test/test_104.bsa"sv };
+		bsa::tes4::archive bsa;
+		bsa.read(path);
+		const auto& cbsa = bsa;
+
+		for (const auto& [dkey, dir] : bsa) {
+			const std::string dname{ dkey.name() };
+			REQUIRE(bsa.find(dname) == bsa.find(dkey));
+			REQUIRE(cbsa.find(std::string_view{ dname }) == cbsa.find(dkey));
+			for (const auto& [fkey, f] : dir) {
+				const std::string fname{ fkey.name() };
+				std::string upper;
+				for (const auto ch : dname + '/' + fname) {
+					upper += static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+				}
+				REQUIRE(dir.find(fname.c_str()) == dir.find(fkey));
+				const auto index = bsa[dname][fname];
+				REQUIRE(index);
+				REQUIRE(&*index == &f);
+				const auto cindex = cbsa[std::string_view{ dname }][fname.c_str()];
+				REQUIRE(cindex);
+				REQUIRE(&*cindex == &f);
+				REQUIRE(bsa.find(upper.substr(0, dname.size()))->second.find(upper) ==
+						dir.find(fkey));
+			}
+		}
+
+		REQUIRE(bsa.find("missing"sv) == bsa.end());
+		REQUIRE(!bsa["missing"sv]["file.txt"]);
+	}
+
 	SECTION("we can use multi-level indexing even when the given directory doesn't exist")
 	{
 		bsa::tes4::archive bsa;
@@ -563,6 +1373,82 @@ TEST_CASE("bsa::tes4::archive", "[src][tes4][archive]")
 			});
 	}
 
+	SECTION("archives can share ownership of the buffer they were read from")
+	{
+		const std::filesystem::path root{ "in_memory_test"sv };
+		const auto disk = map_file(root / "tes4.bsa"sv);
+
+		auto buffer = std::make_shared_for_overwrite<std::byte[]>(disk.size());
+		std::copy_n(disk.data(), disk.size(), buffer.get());
+		const std::weak_ptr<std::byte[]> observer = buffer;
+		const auto first = buffer.get();
+		const auto last = first + disk.size();
+
+		auto bsa = std::make_unique<bsa::tes4::archive>();
+		REQUIRE(bsa->read({ std::move(buffer), disk.size() }) == bsa::tes4::version::tes4);
+		REQUIRE(!observer.expired());
+		REQUIRE(!bsa->empty());
+
+		bsa::tes4::archive expected;
+		expected.read(root / "tes4.bsa"sv);
+		for (const auto& [dkey, dir] : *bsa) {
+			for (const auto& [fkey, file] : dir) {
+				const auto bytes = file.as_bytes();
+				REQUIRE(bytes.data() >= first);
+				REQUIRE(bytes.data() + bytes.size() <= last);
+				assert_byte_equality(bytes, expected[dkey.hash()][fkey.hash()]->as_bytes());
+			}
+		}
+
+		bsa.reset();
+		REQUIRE(observer.expired());
+	}
+
+	SECTION("the xmem compression codec is available on every platform")
+	{
+		const std::filesystem::path root{ "tes4_xmem_test"sv };
+		constexpr std::array paths{
+			std::make_pair("Background"sv, "background_middle.png"sv),
+			std::make_pair("Characters"sv, "character_0012.png"sv),
+			std::make_pair("Construct 3"sv, "Pixel Platformer.c3p"sv),
+			std::make_pair("Share"sv, "License.txt"sv),
+			std::make_pair("Tilemap"sv, "tiles.png"sv),
+			std::make_pair("Tiles"sv, "tile_0013.png"sv),
+		};
+		const bsa::tes4::file::compression_params params{
+			.version_ = bsa::tes4::version::tes5,
+			.compression_codec_ = bsa::tes4::compression_codec::xmem,
+		};
+
+		bsa::tes4::archive bsa;
+		REQUIRE(bsa.read(root / "xmem.bsa"sv) == bsa::tes4::version::tes5);
+		for (const auto& [dirname, filename] : paths) {
+			const auto disk = map_file(root / "data"sv / dirname / filename);
+			const auto memory = bsa[dirname][filename];
+			REQUIRE(memory);
+			REQUIRE(memory->compressed());
+			REQUIRE(memory->decompressed_size() == disk.size());
+
+			memory->decompress(params);
+			REQUIRE(!memory->compressed());
+			assert_byte_equality(memory->as_bytes(), std::span{ disk.data(), disk.size() });
+
+			memory->compress(params);
+			REQUIRE(memory->compressed());
+			REQUIRE(memory->decompressed_size() == disk.size());
+			memory->decompress(params);
+			assert_byte_equality(memory->as_bytes(), std::span{ disk.data(), disk.size() });
+		}
+
+		SECTION("corrupt streams are rejected")
+		{
+			bsa::tes4::file f;
+			std::vector<std::byte> garbage(64, std::byte{ 0x5A });
+			f.set_data(std::move(garbage), 128);
+			REQUIRE_THROWS_AS(f.decompress(params), bsa::compression_error);
+		}
+	}
+
 #ifdef BSA_SUPPORT_XMEM
 	SECTION("we can utilize the xmem compression codec")
 	{
@@ -605,8 +1491,82 @@ TEST_CASE("bsa::tes4::archive", "[src][tes4][archive]")
 			assert_byte_equality(memory->as_bytes(), compressed);
 		}
 	}
+
+	SECTION("we can compress archives in bulk with the xmem compression codec")
+	{
+		const std::filesystem::path root{ "tes4_xmem_test"sv };
+		const bsa::tes4::file::compression_params params{
+			.version_ = bsa::tes4::version::tes5,
+			.compression_codec_ = bsa::tes4::compression_codec::xmem,
+		};
+
+		bsa::tes4::archive expected;
+		REQUIRE(expected.read(root / "xmem.bsa"sv) == bsa::tes4::version::tes5);
+
+		bsa::tes4::archive bulk;
+		for (auto& [dkey, dir] : expected) {
+			bsa::tes4::directory d;
+			for (auto& [fkey, file] : dir) {
+				REQUIRE(file.compressed());
+				bsa::tes4::file f = file;
+				f.decompress(params);
+				REQUIRE(d.insert(fkey, std::move(f)).second);
+			}
+			REQUIRE(bulk.insert(dkey, std::move(d)).second);
+		}
+
+		bulk.compress_all(params);
+		for (const auto& [dkey, dir] : expected) {
+			for (const auto& [fkey, file] : dir) {
+				const auto compressed = bulk[dkey.hash()][fkey.hash()];
+				REQUIRE(compressed);
+				REQUIRE(compressed->compressed());
+				assert_byte_equality(compressed->as_bytes(), file.as_bytes());
+			}
+		}
+	}
 #endif
 
+	SECTION("archives read inside a memory scope live entirely within its resource")
+	{
+		const std::filesystem::path root{ "tes4_compression_test"sv };
+		bsa::tes4::archive expected;
+		expected.read(root / "test_104.bsa"sv);
+
+		counting_resource arena;
+		{
+			const bsa::memory_scope scope{ arena };
+			REQUIRE(bsa::get_memory_resource() == &arena);
+
+			bsa::tes4::archive bsa;
+			bsa.read(root / "test_104.bsa"sv);
+			REQUIRE(bsa.get_allocator().resource() == &arena);
+			REQUIRE(arena.allocations() > 0);
+			REQUIRE(bsa.size() == expected.size());
+			for (const auto& [dkey, dir] : bsa) {
+				REQUIRE(dir.get_allocator().resource() == &arena);
+				REQUIRE(dir.size() == expected[dkey.hash()]->size());
+			}
+
+			// copies follow the scope they are made in, and inserted directories follow their parent
+			std::pmr::monotonic_buffer_resource inner;
+			{
+				const bsa::memory_scope nested{ inner };
+				const auto copy = bsa;
+				REQUIRE(copy.get_allocator().resource() == &inner);
+
+				bsa::tes4::archive moved;
+				REQUIRE(moved.insert("moved"sv, bsa::tes4::directory{ bsa.begin()->second }).second);
+				REQUIRE(moved.begin()->second.get_allocator().resource() == &inner);
+			}
+
+			bsa::tes4::directory heap{ bsa::tes4::directory::allocator_type{} };
+			REQUIRE(bsa.insert("heap"sv, std::move(heap)).second);
+			REQUIRE(bsa["heap"sv]->get_allocator().resource() == &arena);
+		}
+		REQUIRE(bsa::get_memory_resource() == std::pmr::get_default_resource());
+	}
+
 	SECTION("we can correctly parse file names out of archives which use file sharing and name embedding")
 	{
 		const std::filesystem::path root{ "tes4_data_sharing_name_test"sv };
@@ -628,3 +1588,225 @@ TEST_CASE("bsa::tes4::archive", "[src][tes4][archive]")
 		find("misc2"sv, "example2.txt"sv);
 	}
 }
+
+TEST_CASE("bsa::tes4::lazy_archive", "[src][tes4][archive]")
+{
+	SECTION("lazy archives start empty")
+	{
+		const bsa::tes4::lazy_archive bsa;
+		REQUIRE(bsa.empty());
+		REQUIRE(bsa.size() == 0);
+		REQUIRE(bsa.cache().empty());
+		REQUIRE(bsa.archive_flags() == bsa::tes4::archive_flag::none);
+		REQUIRE(bsa.archive_types() == bsa::tes4::archive_type::none);
+	}
+
+	SECTION("lazy lookups are equivalent to reading the whole archive")
+	{
+		const std::array archives{
+			std::filesystem::path{ "tes4_compression_test/test_104.bsa"sv },
+			std::filesystem::path{ "tes4_compression_test/test_105.bsa"sv },
+			std::filesystem::path{ "tes4_data_sharing_name_test/share.bsa"sv },
+			std::filesystem::path{ "tes4_xbox_read_test/normal.bsa"sv },
+			std::filesystem::path{ "tes4_xbox_read_test/xbox.bsa"sv },
+		};
+
+		for (const auto& path : archives) {
+			bsa::tes4::archive full;
+			const auto version = full.read(path);
+
+			bsa::tes4::lazy_archive lazy;
+			REQUIRE(lazy.read(path) == version);
+			REQUIRE(lazy.archive_flags() == full.archive_flags());
+			REQUIRE(lazy.archive_types() == full.archive_types());
+			REQUIRE(lazy.size() == full.size());
+			REQUIRE(lazy.cache().empty());
+
+			for (const auto& [dkey, dir] : full) {
+				for (const auto& [fkey, file] : dir) {
+					const auto found = lazy.lookup(dkey.name(), fkey.name());
+					REQUIRE(found);
+					REQUIRE(found->compressed() == file.compressed());
+					REQUIRE(found->size() == file.size());
+					assert_byte_equality(found->as_bytes(), file.as_bytes());
+					REQUIRE(&*lazy.lookup(dkey.name(), fkey.name()) == &*found);
+				}
+			}
+			REQUIRE(lazy.cache().size() == full.size());
+
+			REQUIRE(!lazy.lookup("not/a/directory"sv, "file.txt"sv));
+			REQUIRE(!lazy.lookup(full.begin()->first.name(), "not_a_file.txt"sv));
+		}
+	}
+
+	SECTION("lazy archives can reuse a sidecar index")
+	{
+		const std::filesystem::path path{ "tes4_compression_test/test_105.bsa"sv };
+		const std::filesystem::path other{ "tes4_compression_test/test_104.bsa"sv };
+		const std::filesystem::path cache{ "tes4_index_cache_test.idx"sv };
+		std::filesystem::remove(cache);
+
+		const auto compare = [](bsa::tes4::lazy_archive& a_lazy, const std::filesystem::path& a_path) {
+			bsa::tes4::archive full;
+			full.read(a_path);
+			REQUIRE(a_lazy.archive_flags() == full.archive_flags());
+			REQUIRE(a_lazy.archive_types() == full.archive_types());
+			REQUIRE(a_lazy.size() == full.size());
+			for (const auto& [dkey, dir] : full) {
+				for (const auto& [fkey, file] : dir) {
+					const auto found = a_lazy.lookup(dkey.name(), fkey.name());
+					REQUIRE(found);
+					assert_byte_equality(found->as_bytes(), file.as_bytes());
+				}
+			}
+		};
+
+		const auto version = [&]() {
+			bsa::tes4::lazy_archive lazy;
+			return lazy.read(path);
+		}();
+
+		{
+			bsa::tes4::lazy_archive lazy;
+			REQUIRE(lazy.read(path, cache) == version);
+			REQUIRE(std::filesystem::exists(cache));
+			compare(lazy, path);
+		}
+
+		// an unchanged archive reuses the sidecar as is
+		const auto stale = std::filesystem::file_time_type{};
+		std::filesystem::last_write_time(cache, stale);
+		{
+			bsa::tes4::lazy_archive lazy;
+			REQUIRE(lazy.read(path, cache) == version);
+			REQUIRE(std::filesystem::last_write_time(cache) == stale);
+			compare(lazy, path);
+		}
+
+		// sidecars for a different archive are rebuilt
+		{
+			bsa::tes4::lazy_archive lazy;
+			lazy.read(other, cache);
+			REQUIRE(std::filesystem::last_write_time(cache) != stale);
+			compare(lazy, other);
+		}
+
+		// malformed sidecars are rebuilt
+		std::filesystem::resize_file(cache, 8);
+		{
+			bsa::tes4::lazy_archive lazy;
+			REQUIRE(lazy.read(path, cache) == version);
+			REQUIRE(std::filesystem::file_size(cache) > 8);
+			compare(lazy, path);
+		}
+	}
+
+	SECTION("lazy lookups by hash recover names from the archive")
+	{
+		const std::filesystem::path root{ "tes4_data_sharing_name_test"sv };
+		bsa::tes4::lazy_archive lazy;
+		REQUIRE(lazy.read(root / "share.bsa"sv) == bsa::tes4::version::tes5);
+
+		const auto found = lazy.lookup(
+			bsa::tes4::hashing::hash_directory("misc1"sv),
+			bsa::tes4::hashing::hash_file("example1.txt"sv));
+		REQUIRE(found);
+
+		const auto dir = lazy.cache().find("misc1"sv);
+		REQUIRE(dir != lazy.cache().end());
+		REQUIRE(dir->first.name() == "misc1"sv);
+		const auto file = dir->second.find("example1.txt"sv);
+		REQUIRE(file != dir->second.end());
+		REQUIRE(file->first.name() == "example1.txt"sv);
+	}
+
+	SECTION("lazy archives keep deep copied sources alive")
+	{
+		const std::filesystem::path path{ "tes4_compression_test/test_105.bsa"sv };
+
+		bsa::tes4::archive full;
+		full.read(path);
+
+		bsa::tes4::lazy_archive lazy;
+		{
+			const auto disk = map_file(path);
+			std::vector<std::byte> buffer(
+				reinterpret_cast<const std::byte*>(disk.data()),
+				reinterpret_cast<const std::byte*>(disk.data()) + disk.size());
+			lazy.read({ std::span{ buffer }, bsa::copy_type::deep });
+		}
+
+		for (const auto& [dkey, dir] : full) {
+			for (const auto& [fkey, file] : dir) {
+				const auto found = lazy.lookup(dkey.name(), fkey.name());
+				REQUIRE(found);
+				assert_byte_equality(found->as_bytes(), file.as_bytes());
+			}
+		}
+
+		lazy.clear();
+		REQUIRE(lazy.empty());
+		REQUIRE(lazy.cache().empty());
+	}
+}
+
+TEST_CASE("bsa::tes4::stream_writer", "[src][tes4][archive]")
+{
+	SECTION("stream writers start empty")
+	{
+		const bsa::tes4::stream_writer writer;
+		REQUIRE(writer.empty());
+		REQUIRE(writer.size() == 0);
+		REQUIRE(writer.archive_flags() == bsa::tes4::archive_flag::none);
+		REQUIRE(writer.archive_types() == bsa::tes4::archive_type::none);
+	}
+
+	SECTION("stream writers will not insert the same file twice")
+	{
+		bsa::tes4::stream_writer writer;
+		const auto source = []() { return bsa::tes4::file{}; };
+		REQUIRE(writer.insert("misc"sv, "example.txt"sv, source));
+		REQUIRE(writer.insert("misc"sv, "other.txt"sv, source));
+		REQUIRE(!writer.insert("misc"sv, "example.txt"sv, source));
+		REQUIRE(writer.size() == 2);
+
+		writer.clear();
+		REQUIRE(writer.empty());
+	}
+
+	SECTION("streamed archives are identical to archives written from memory")
+	{
+		const std::array archives{
+			std::filesystem::path{ "tes4_compression_test/test_104.bsa"sv },
+			std::filesystem::path{ "tes4_compression_test/test_105.bsa"sv },
+			std::filesystem::path{ "tes4_data_sharing_name_test/share.bsa"sv },
+			std::filesystem::path{ "tes4_xbox_read_test/normal.bsa"sv },
+			std::filesystem::path{ "tes4_xbox_read_test/xbox.bsa"sv },
+		};
+
+		for (const auto& path : archives) {
+			bsa::tes4::archive full;
+			const auto version = full.read(path);
+
+			bsa::tes4::stream_writer writer;
+			writer.archive_flags(full.archive_flags());
+			writer.archive_types(full.archive_types());
+			for (const auto& [dkey, dir] : full) {
+				for (const auto& [fkey, file] : dir) {
+					REQUIRE(writer.insert(dkey, fkey, [&]() { return file; }));
+				}
+			}
+
+			binary_io::any_ostream expected{ std::in_place_type<binary_io::memory_ostream> };
+			full.write(expected, version);
+
+			binary_io::any_ostream streamed{ std::in_place_type<binary_io::memory_ostream> };
+			writer.write(streamed, version);
+
+			assert_byte_equality(
+				expected.get<binary_io::memory_ostream>().rdbuf(),
+				streamed.get<binary_io::memory_ostream>().rdbuf());
+		}
+	}
+}
+
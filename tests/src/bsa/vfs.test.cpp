@@ -0,0 +1,168 @@
+#include "utility.hpp"
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include "catch2.hpp"
+
+#include "bsa/vfs.hpp"
+
+namespace
+{
+	[[nodiscard]] auto make_tes4(
+		std::string_view a_directory,
+		std::string_view a_file,
+		std::span<const std::byte> a_data)
+		-> bsa::tes4::archive
+	{
+		bsa::tes4::file f;
+		f.set_data(a_data);
+		bsa::tes4::directory d;
+		REQUIRE(d.insert(a_file, std::move(f)).second);
+		bsa::tes4::archive bsa;
+		REQUIRE(bsa.insert(a_directory, std::move(d)).second);
+		return bsa;
+	}
+
+	[[nodiscard]] auto make_fo4(
+		std::string_view a_path,
+		std::span<const std::byte> a_data)
+		-> bsa::fo4::archive
+	{
+		bsa::fo4::file f;
+		f.emplace_back().set_data(a_data);
+		bsa::fo4::archive ba2;
+		REQUIRE(ba2.insert(a_path, std::move(f)).second);
+		return ba2;
+	}
+
+	template <class File>
+	[[nodiscard]] auto resolve(
+		const bsa::vfs::overlay& a_overlay,
+		std::string_view a_path)
+		-> std::pair<bsa::vfs::archive_id, const File*>
+	{
+		const auto ref = a_overlay.find(a_path);
+		REQUIRE(ref);
+		const auto file = std::get_if<const File*>(&ref->file);
+		REQUIRE(file);
+		return { ref->archive, *file };
+	}
+}
+
+TEST_CASE("bsa::vfs::overlay", "[src][vfs]")
+{
+	constexpr std::array payload1{ std::byte{ 1 } };
+	constexpr std::array payload2{ std::byte{ 2 } };
+	constexpr std::array payload3{ std::byte{ 3 } };
+
+	SECTION("overlays start empty")
+	{
+		const bsa::vfs::overlay vfs;
+		REQUIRE(vfs.empty());
+		REQUIRE(vfs.size() == 0);
+		REQUIRE(!vfs.contains("meshes/clutter/bucket.nif"sv));
+		REQUIRE(vfs.archive(0) == nullptr);
+	}
+
+	SECTION("archives mounted later take priority over archives mounted earlier")
+	{
+		bsa::vfs::overlay vfs;
+		const auto first = vfs.mount(make_tes4("meshes\\clutter"sv, "bucket.nif"sv, payload1), bsa::tes4::version::sse);
+		const auto second = vfs.mount(make_tes4("meshes\\clutter"sv, "bucket.nif"sv, payload2), bsa::tes4::version::sse);
+		const auto third = vfs.mount(make_tes4("meshes\\clutter"sv, "pail.nif"sv, payload3), bsa::tes4::version::sse);
+		REQUIRE(vfs.size() == 3);
+		REQUIRE(vfs.archive(second)->tes4_version == bsa::tes4::version::sse);
+
+		{
+			const auto [id, file] = resolve<bsa::tes4::file>(vfs, "Meshes/Clutter/Bucket.nif"sv);
+			REQUIRE(id == second);
+			assert_byte_equality(file->as_bytes(), payload2);
+		}
+
+		{
+			const auto [id, file] = resolve<bsa::tes4::file>(vfs, "meshes\\clutter\\pail.nif"sv);
+			REQUIRE(id == third);
+			assert_byte_equality(file->as_bytes(), payload3);
+		}
+
+		REQUIRE(!vfs.contains("meshes/clutter/basket.nif"sv));
+		REQUIRE(!vfs.contains("meshes/bucket.nif"sv));
+		REQUIRE(vfs.contains("\\MESHES/clutter\\pail.NIF/"sv));
+		REQUIRE(!vfs.contains(std::string(bsa::detail::max_path, 'a')));
+
+		SECTION("unmounting an archive reveals the archives beneath it")
+		{
+			REQUIRE(vfs.unmount(second));
+			REQUIRE(!vfs.unmount(second));
+			REQUIRE(vfs.archive(second) == nullptr);
+
+			const auto [id, file] = resolve<bsa::tes4::file>(vfs, "meshes/clutter/bucket.nif"sv);
+			REQUIRE(id == first);
+			assert_byte_equality(file->as_bytes(), payload1);
+
+			REQUIRE(vfs.unmount(first));
+			REQUIRE(!vfs.contains("meshes/clutter/bucket.nif"sv));
+			REQUIRE(vfs.contains("meshes/clutter/pail.nif"sv));
+
+			// ids are never reused
+			REQUIRE(vfs.mount(make_tes4("meshes"sv, "bucket.nif"sv, payload1), bsa::tes4::version::sse) > third);
+		}
+
+		SECTION("clearing an overlay unmounts everything")
+		{
+			vfs.clear();
+			REQUIRE(vfs.empty());
+			REQUIRE(!vfs.contains("meshes/clutter/bucket.nif"sv));
+		}
+	}
+
+	SECTION("overlays can mix archive formats")
+	{
+		bsa::vfs::overlay vfs;
+		const auto tes4 = vfs.mount(make_tes4("textures"sv, "sky.dds"sv, payload1), bsa::tes4::version::tes5);
+		const auto fo4 = vfs.mount(make_fo4("textures/sky.dds"sv, payload2), {});
+
+		{
+			const auto [id, file] = resolve<bsa::fo4::file>(vfs, "textures/sky.dds"sv);
+			REQUIRE(id == fo4);
+			REQUIRE(file->size() == 1);
+			assert_byte_equality(file->front().as_bytes(), payload2);
+		}
+
+		REQUIRE(vfs.unmount(fo4));
+
+		{
+			const auto [id, file] = resolve<bsa::tes4::file>(vfs, "textures/sky.dds"sv);
+			REQUIRE(id == tes4);
+			assert_byte_equality(file->as_bytes(), payload1);
+		}
+	}
+
+	SECTION("we can mount archives from disk")
+	{
+		bsa::vfs::overlay vfs;
+		const auto tes3 = vfs.mount(std::filesystem::path{ "common_guess_test/tes3.bsa"sv });
+		const auto tes4 = vfs.mount(std::filesystem::path{ "common_guess_test/tes4.bsa"sv });
+		const auto fo4 = vfs.mount(std::filesystem::path{ "common_guess_test/fo4.ba2"sv });
+		REQUIRE(vfs.size() == 3);
+		REQUIRE(std::holds_alternative<bsa::tes3::archive>(vfs.archive(tes3)->archive));
+		REQUIRE(std::holds_alternative<bsa::tes4::archive>(vfs.archive(tes4)->archive));
+		REQUIRE(std::holds_alternative<bsa::fo4::archive>(vfs.archive(fo4)->archive));
+
+		const auto ref = vfs.find("misc/example.txt"sv);
+		REQUIRE(ref);
+		REQUIRE(ref->archive == fo4);
+
+		REQUIRE_THROWS_AS(
+			vfs.mount(std::filesystem::path{ "common_guess_test/data/misc/example.txt"sv }),
+			bsa::exception);
+		REQUIRE(vfs.size() == 3);
+	}
+}
@@ -5,15 +5,20 @@
 #endif
 
 #include <array>
+#include <atomic>
 #include <cctype>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <filesystem>
 #include <functional>
 #include <initializer_list>
+#include <memory_resource>
 #include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -113,6 +118,21 @@ inline auto make_substr_matcher(std::string_view a_str) noexcept
 	};
 }
 
+// bytes which no compressor can shrink, from a fixed seed so every run sees the same noise
+[[nodiscard]] inline auto make_noise(std::size_t a_size)
+	-> std::vector<std::byte>
+{
+	std::vector<std::byte> result(a_size);
+	std::uint32_t state = 0x9E3779B9u;  // xorshift32
+	for (auto& byte : result) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		byte = static_cast<std::byte>(state >> 24);
+	}
+	return result;
+}
+
 inline void assert_byte_equality(
 	std::span<const std::byte> a_lhs,
 	std::span<const std::byte> a_rhs)
@@ -187,3 +207,40 @@ inline void compare_to_master_copy(
 
 	a_compare(copy, master);
 }
+
+// an arena which counts what it hands out, to tell which allocations it served, and which
+//	notes whether it was ever used from a thread other than the one which made it
+class counting_resource final :
+	public std::pmr::memory_resource
+{
+public:
+	[[nodiscard]] std::size_t allocations() const noexcept { return _allocations; }
+	[[nodiscard]] bool used_across_threads() const noexcept { return _foreign.load(); }
+
+private:
+	void* do_allocate(std::size_t a_bytes, std::size_t a_alignment) override
+	{
+		if (std::this_thread::get_id() != _owner) {
+			_foreign = true;
+		}
+		++_allocations;
+		return _arena.allocate(a_bytes, a_alignment);
+	}
+
+	void do_deallocate(void*, std::size_t, std::size_t) noexcept override
+	{
+		if (std::this_thread::get_id() != _owner) {
+			_foreign = true;
+		}
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& a_rhs) const noexcept override
+	{
+		return this == &a_rhs;
+	}
+
+	std::pmr::monotonic_buffer_resource _arena;
+	std::size_t _allocations{ 0 };
+	std::thread::id _owner{ std::this_thread::get_id() };
+	std::atomic_bool _foreign{ false };
+};